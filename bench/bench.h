@@ -0,0 +1,73 @@
+#pragma once
+
+// Host benchmark harness for the native environment. Each bench case is a
+// free function registered with BENCH_CASE and selected by name on the
+// command line.
+
+#include <chrono>
+#include <cstdint>
+
+namespace bench {
+
+struct Options {
+  uint32_t seconds;
+  // --record: cases with reference data (golden) rewrite it instead of
+  // checking against it.
+  bool record;
+};
+
+using CaseFn = void (*)(const Options &);
+
+struct Registrar {
+  Registrar(const char *name, CaseFn fn);
+};
+
+// Wall-clock stopwatch accumulating nanoseconds across Start/Stop pairs.
+class Stopwatch {
+ public:
+  void start() { started_ = std::chrono::steady_clock::now(); }
+  // Returns the lap without accumulating it, for callers that only keep
+  // some laps.
+  uint64_t lap() const {
+    return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+                                     std::chrono::steady_clock::now() - started_)
+                                     .count());
+  }
+  void stop() { total_ns_ += lap(); }
+  void add(uint64_t ns) { total_ns_ += ns; }
+  uint64_t totalNs() const { return total_ns_; }
+
+ private:
+  std::chrono::steady_clock::time_point started_;
+  uint64_t total_ns_ = 0;
+};
+
+// Prints one result row: frame cost on the host plus the simulated rates.
+void ReportFrames(const char *label, uint64_t busy_ns, uint64_t frames, uint64_t shows,
+                  uint64_t wakeups, double simulated_seconds);
+
+// Prints the PixelOutput commit counters for the preceding row.
+void ReportCommits(uint32_t sent, uint32_t skipped);
+
+// Prints a micro-benchmark row in ns per operation.
+void ReportOps(const char *label, uint64_t total_ns, uint64_t ops);
+
+// Marks the run as failed: the program exits with status 1 once every
+// selected case has run. The case prints what went wrong.
+void Fail();
+
+// Keeps the optimiser from discarding a benchmarked result.
+template <typename T>
+inline void DoNotOptimize(const T &value) {
+  asm volatile("" : : "r,m"(value) : "memory");
+}
+
+}  // namespace bench
+
+#define BENCH_CONCAT_INNER(a, b) a##b
+#define BENCH_CONCAT(a, b) BENCH_CONCAT_INNER(a, b)
+#define BENCH_CASE(name)                                                        \
+  static void BENCH_CONCAT(BenchCase_, name)(const ::bench::Options &);         \
+  static const ::bench::Registrar BENCH_CONCAT(bench_registrar_, name)(#name,  \
+                                                                       BENCH_CONCAT(BenchCase_, name)); \
+  static void BENCH_CONCAT(BenchCase_, name)(const ::bench::Options &options)
@@ -0,0 +1,295 @@
+// Button input: idle wakeups of the old 5 ms polling loop versus the
+// interrupt-driven TaskButton, ButtonGesture classification of synthetic
+// edge timelines with contact bounce, and input-to-photon latency of every
+// bound gesture through the gesture layer, the input ring and TaskRGB.
+
+#include <Arduino.h>
+#include <Preferences.h>
+
+#include <cstdio>
+#include <vector>
+
+#include "bench.h"
+#include "button_gesture.h"
+#include "button_pad.h"
+#include "host_sim.h"
+#include "instrumentation.h"
+#include "sim_buttons.h"
+#include "spsc_ring.h"
+
+extern uint32_t button_task_wakeups;
+extern SpscRing<InputEvent, 16> input_ring;
+
+void setup();
+
+namespace {
+
+using sim_buttons::kBootPin;
+using sim_buttons::kMainPin;
+using sim_buttons::kUser2Pin;
+
+constexpr uint64_t kUsPerMs = 1000;
+constexpr uint64_t kUsPerSecond = 1000000;
+constexpr uint32_t kLegacyPollMs = 5;
+constexpr uint8_t kNoPin = 0xff;
+
+struct Press {
+  uint32_t at_ms;
+  uint32_t held_ms;
+};
+
+// Schedules a main key press with contact bounce on both edges, for
+// whatever watches the pin to pick up.
+void SchedulePress(uint64_t origin_us, const Press &press) {
+  const uint64_t down = origin_us + press.at_ms * kUsPerMs;
+  sim_buttons::ScheduleEdge(kMainPin, down, LOW, false);
+  sim_buttons::ScheduleEdge(kMainPin, down + press.held_ms * kUsPerMs, HIGH, false);
+}
+
+const std::vector<Press> &SamplePresses() {
+  // Two clicks, a long press, then a quick double tap.
+  static const std::vector<Press> presses = {
+      {1000, 120}, {3000, 200}, {5000, 1500}, {8000, 90}, {8300, 90},
+  };
+  return presses;
+}
+
+struct GestureCounts {
+  uint32_t clicks;
+  uint32_t multi_clicks;
+  uint32_t long_starts;
+  uint32_t long_stops;
+  uint32_t during;
+};
+
+void CountGesture(ButtonGesture::Event event, void *context) {
+  GestureCounts &counts = *static_cast<GestureCounts *>(context);
+  switch (event) {
+    case ButtonGesture::Event::kClick:
+      counts.clicks++;
+      break;
+    case ButtonGesture::Event::kDoubleClick:
+    case ButtonGesture::Event::kMultiClick:
+      counts.multi_clicks++;
+      break;
+    case ButtonGesture::Event::kLongPressStart:
+      counts.long_starts++;
+      break;
+    case ButtonGesture::Event::kLongPressStop:
+      counts.long_stops++;
+      break;
+    case ButtonGesture::Event::kDuringLongPress:
+      counts.during++;
+      break;
+  }
+}
+
+uint32_t NowMs() { return static_cast<uint32_t>(host_sim::NowUs() / kUsPerMs); }
+
+bool Pressed() { return digitalRead(kMainPin) == LOW; }
+
+void ReportGestures(const char *label, const GestureCounts &counts, uint64_t wakeups,
+                    double seconds) {
+  std::printf("  %-28s %6.1f wakeups/s  clicks=%u multi=%u long=%u/%u during=%u\n", label,
+              wakeups / seconds, counts.clicks, counts.multi_clicks, counts.long_starts,
+              counts.long_stops, counts.during);
+}
+
+// The pre-interrupt TaskButton: sample the pin every 5 ms forever.
+void RunPolling(const char *label, bool with_presses, const bench::Options &options) {
+  ButtonGesture gesture;
+  GestureCounts counts{};
+  gesture.setHandler(CountGesture, &counts);
+  gesture.setLongPressIntervalMs(1000);
+
+  host_sim::ClearSchedule();
+  const uint64_t start = host_sim::NowUs();
+  if (with_presses) {
+    for (const Press &press : SamplePresses()) {
+      SchedulePress(start, press);
+    }
+  }
+  const uint64_t end = start + options.seconds * kUsPerSecond;
+  uint64_t wakeups = 0;
+  while (host_sim::NowUs() + kLegacyPollMs * kUsPerMs <= end) {
+    host_sim::AdvanceBy(kLegacyPollMs * kUsPerMs);
+    gesture.update(Pressed(), NowMs());
+    wakeups++;
+  }
+  host_sim::AdvanceTo(end);
+  sim_buttons::Reset();
+  ReportGestures(label, counts, wakeups, options.seconds);
+}
+
+// The interrupt-driven path: wake on edges and on the deadlines update()
+// hands back, exactly as TaskButton does.
+void RunEdgeDriven(const char *label, bool with_presses, const bench::Options &options) {
+  ButtonGesture gesture;
+  GestureCounts counts{};
+  gesture.setHandler(CountGesture, &counts);
+  gesture.setLongPressIntervalMs(1000);
+
+  bool edge = false;
+  // Edges are detected by watching the pin level here, not through an ISR.
+  detachInterrupt(kMainPin);
+  host_sim::ClearSchedule();
+  const uint64_t start = host_sim::NowUs();
+  if (with_presses) {
+    for (const Press &press : SamplePresses()) {
+      SchedulePress(start, press);
+    }
+  }
+  const uint64_t end = start + options.seconds * kUsPerSecond;
+  uint64_t wakeups = 0;
+  uint32_t wait_ms = gesture.update(Pressed(), NowMs());
+  for (;;) {
+    edge = false;
+    const uint64_t deadline =
+        wait_ms == ButtonGesture::kNoDeadline ? end : host_sim::NowUs() + wait_ms * kUsPerMs;
+    // Advance to the earlier of the deadline and the next scheduled edge.
+    while (!edge && host_sim::NowUs() < deadline && host_sim::NowUs() < end) {
+      const uint64_t next = host_sim::NextScheduledUs();
+      const uint64_t target = next < deadline ? next : deadline;
+      const int before = digitalRead(kMainPin);
+      host_sim::AdvanceTo(target < end ? target : end);
+      edge = digitalRead(kMainPin) != before;
+    }
+    if (host_sim::NowUs() >= end) {
+      break;
+    }
+    wait_ms = gesture.update(Pressed(), NowMs());
+    wakeups++;
+  }
+  sim_buttons::Reset();
+  ReportGestures(label, counts, wakeups, options.seconds);
+}
+
+}  // namespace
+
+BENCH_CASE(button_input) {
+  RunPolling("before: 5 ms poll, idle", false, options);
+  RunEdgeDriven("after: edge-driven, idle", false, options);
+  RunPolling("before: 5 ms poll, presses", true, options);
+  RunEdgeDriven("after: edge-driven, presses", true, options);
+}
+
+BENCH_CASE(button_task) {
+  // The real TaskButton from main.cpp under the simulated GPIO interrupt.
+  host_sim::ClearSchedule();
+  setup();
+  const uint64_t start = host_sim::NowUs();
+  for (const Press &press : SamplePresses()) {
+    SchedulePress(start, press);
+  }
+  const uint32_t wakeups_before = button_task_wakeups;
+  host_sim::RunTask("TaskButton", options.seconds * kUsPerSecond);
+  sim_buttons::Reset();
+  std::printf("  %-28s %6.1f wakeups/s\n", "TaskButton, sample presses",
+              (button_task_wakeups - wakeups_before) / static_cast<double>(options.seconds));
+}
+
+#if LIGHTING_INSTRUMENTATION
+namespace {
+
+constexpr uint32_t kGesturesPerCase = 8;
+constexpr uint64_t kGesturePeriodUs = 2500 * kUsPerMs;
+// Gap between the presses of a click run.
+constexpr uint64_t kRunGapUs = 150 * kUsPerMs;
+// The second key of a chord goes down this long after the first.
+constexpr uint64_t kChordSkewUs = 40 * kUsPerMs;
+// Gestures made with nothing draining the ring.
+constexpr uint32_t kBurstClicks = 40;
+
+struct LatencyCase {
+  const char *label;
+  // GlowMode TaskRGB boots into.
+  int glow;
+  // Keys pressed together; the second is kNoPin outside chords.
+  uint8_t pins[2];
+  uint8_t clicks;
+  uint32_t held_ms;
+};
+
+// Resetting an unchanged style and saving change nothing on the strip, so
+// those two show no frames; the chord also shows that neither key's own
+// click got through.
+constexpr LatencyCase kLatencyCases[] = {
+    {"main click: bright/dim", 0, {kMainPin, kNoPin}, 1, 90},
+    {"main long press: next glow", 0, {kMainPin, kNoPin}, 1, 1200},
+    {"key2 click: hue", 0, {kUser2Pin, kNoPin}, 1, 90},
+    {"key2 double click: prev glow", 0, {kUser2Pin, kNoPin}, 2, 90},
+    {"key2 hold: hue repeat", 0, {kUser2Pin, kNoPin}, 1, 1400},
+    {"boot click: gamma (rainbow)", 2, {kBootPin, kNoPin}, 1, 90},
+    {"boot triple click: reset", 0, {kBootPin, kNoPin}, 3, 90},
+    {"main+key2 chord: save", 0, {kMainPin, kUser2Pin}, 1, 300},
+};
+
+void BootInto(int glow) {
+  host_sim::ResetNvs();
+  Preferences prefs;
+  prefs.begin("lighting", false);
+  prefs.putInt("brightness", 0);
+  prefs.putInt("glow", glow);
+  prefs.end();
+  sim_buttons::Reset();
+  setup();
+}
+
+void RunLatencyCase(const LatencyCase &test) {
+  BootInto(test.glow);
+  const uint64_t start = host_sim::NowUs();
+  for (uint32_t g = 0; g < kGesturesPerCase; ++g) {
+    const uint64_t origin = start + (g + 1) * kGesturePeriodUs;
+    for (uint8_t c = 0; c < test.clicks; ++c) {
+      const uint64_t down = origin + c * kRunGapUs;
+      for (uint8_t k = 0; k < 2 && test.pins[k] != kNoPin; ++k) {
+        sim_buttons::ScheduleEdge(test.pins[k], down + k * kChordSkewUs, LOW, true);
+        sim_buttons::ScheduleEdge(test.pins[k], down + test.held_ms * kUsPerMs, HIGH, true);
+      }
+    }
+  }
+  const uint32_t overflows_before = input_ring.overflows();
+  instrumentation::Reset();
+  host_sim::RunTask("TaskRGB", (kGesturesPerCase + 1) * kGesturePeriodUs);
+  sim_buttons::Reset();
+  const instrumentation::Histogram &shown =
+      instrumentation::StageHistogram(instrumentation::Stage::kInput);
+  const double mhz = ESP.getCpuFreqMHz();
+  std::printf("  %-30s %5u %6u %8.1f %8.1f %8.1f %7u\n", test.label,
+              static_cast<unsigned>(kGesturesPerCase), static_cast<unsigned>(shown.count()),
+              shown.percentile(50) / mhz / 1000, shown.percentile(90) / mhz / 1000,
+              shown.max() / mhz / 1000,
+              static_cast<unsigned>(input_ring.overflows() - overflows_before));
+}
+
+}  // namespace
+#endif  // LIGHTING_INSTRUMENTATION
+
+BENCH_CASE(button_latency) {
+#if LIGHTING_INSTRUMENTATION
+  std::printf("  %-30s %5s %6s %8s %8s %8s %7s\n", "input to photon", "made", "shown",
+              "p50 ms", "p90 ms", "max ms", "dropped");
+  for (const LatencyCase &test : kLatencyCases) {
+    RunLatencyCase(test);
+  }
+
+  // A burst of clicks while TaskRGB is not running: the ring fills, and
+  // every click past its capacity is counted instead of vanishing.
+  BootInto(0);
+  const uint64_t start = host_sim::NowUs();
+  for (uint32_t i = 0; i < kBurstClicks; ++i) {
+    SchedulePress(start, Press{200 * (i + 1), 60});
+  }
+  const uint32_t overflows_before = input_ring.overflows();
+  instrumentation::Reset();
+  host_sim::RunTask("TaskButton", (kBurstClicks + 2) * 200 * kUsPerMs);
+  sim_buttons::Reset();
+  std::printf("  %u clicks with TaskRGB stalled: %u queued, %u dropped (ring), %u (stats)\n",
+              static_cast<unsigned>(kBurstClicks),
+              static_cast<unsigned>(SpscRing<InputEvent, 16>::kCapacity),
+              static_cast<unsigned>(input_ring.overflows() - overflows_before),
+              static_cast<unsigned>(instrumentation::InputsDropped()));
+#else
+  std::printf("  built with LIGHTING_INSTRUMENTATION=0\n");
+#endif
+}
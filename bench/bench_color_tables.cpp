@@ -0,0 +1,84 @@
+// Before/after for the rainbow colour path: the branchy strandtest wheel()
+// computed per pixel versus the constexpr tables in color_tables.h, plus the
+// palette samplers.
+
+#include <Adafruit_NeoPixel.h>
+
+#include <cstdio>
+
+#include "bench.h"
+#include "color_tables.h"
+#include "palette.h"
+
+namespace {
+
+constexpr uint16_t kBenchPixels = 22;
+constexpr uint32_t kFramesPerSecond = 1000;
+
+// The pre-table implementation, kept here as the baseline.
+uint32_t LegacyWheel(uint8_t wheel_pos) {
+  wheel_pos = 255 - wheel_pos;
+  if (wheel_pos < 85) {
+    return Adafruit_NeoPixel::Color(255 - wheel_pos * 3, 0, wheel_pos * 3);
+  }
+  if (wheel_pos < 170) {
+    wheel_pos -= 85;
+    return Adafruit_NeoPixel::Color(0, wheel_pos * 3, 255 - wheel_pos * 3);
+  }
+  wheel_pos -= 170;
+  return Adafruit_NeoPixel::Color(wheel_pos * 3, 255 - wheel_pos * 3, 0);
+}
+
+template <typename WheelFn>
+void RunRainbowFrames(const char *label, WheelFn wheel, const bench::Options &options) {
+  Adafruit_NeoPixel strip(kBenchPixels, 0, NEO_GRB + NEO_KHZ800);
+  strip.setBrightness(150);
+  const uint64_t frames = static_cast<uint64_t>(options.seconds) * kFramesPerSecond;
+  bench::Stopwatch stopwatch;
+  stopwatch.start();
+  for (uint64_t frame = 0; frame < frames; ++frame) {
+    for (uint16_t i = 0; i < kBenchPixels; i++) {
+      strip.setPixelColor(i, wheel(static_cast<uint8_t>(i + frame)));
+    }
+    bench::DoNotOptimize(strip.getPixels()[0]);
+  }
+  stopwatch.stop();
+  bench::ReportOps(label, stopwatch.totalNs(), frames);
+}
+
+template <typename SampleFn>
+void RunSamples(const char *label, SampleFn sample, const bench::Options &options) {
+  const uint64_t samples = static_cast<uint64_t>(options.seconds) * 1000000ULL;
+  uint32_t sink = 0;
+  bench::Stopwatch stopwatch;
+  stopwatch.start();
+  for (uint64_t i = 0; i < samples; ++i) {
+    sink ^= sample(static_cast<uint32_t>(i * 37));
+  }
+  stopwatch.stop();
+  bench::DoNotOptimize(sink);
+  bench::ReportOps(label, stopwatch.totalNs(), samples);
+}
+
+}  // namespace
+
+BENCH_CASE(color_tables) {
+  RunSamples("wheel (computed)", [](uint32_t i) { return LegacyWheel(static_cast<uint8_t>(i)); },
+             options);
+  RunSamples("wheel (table)",
+             [](uint32_t i) { return color_tables::kWheel[static_cast<uint8_t>(i)]; }, options);
+  RunSamples("wheel (gamma table)",
+             [](uint32_t i) { return color_tables::kWheelGamma[static_cast<uint8_t>(i)]; },
+             options);
+  RunSamples("palette sample", [](uint32_t i) {
+    return SamplePalette(PaletteId::kLava, static_cast<uint8_t>(i));
+  }, options);
+  RunSamples("palette sample (8.8 smooth)", [](uint32_t i) {
+    return SamplePaletteSmooth(PaletteId::kLava, static_cast<uint16_t>(i));
+  }, options);
+
+  std::printf("  rainbow frame, %u px (ns/op = ns/frame):\n", kBenchPixels);
+  RunRainbowFrames("  before: computed wheel", LegacyWheel, options);
+  RunRainbowFrames("  after: wheel table",
+                   [](uint8_t pos) { return color_tables::kWheel[pos]; }, options);
+}
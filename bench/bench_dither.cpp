@@ -0,0 +1,152 @@
+// Temporal dithering: host ns per pixel of PixelOutput::commit() truncating
+// and dithering at the same low level, at 22 to 4000 px (encode and change
+// scan, with the transmitter taking no time), then how many distinct output
+// levels each leaves across the dim breathing range and how far the average
+// of successive frames is from the exact value. A dithered average more
+// than kMaxMeanError steps off fails the run.
+
+#include <Adafruit_NeoPixel.h>
+
+#include <cmath>
+#include <cstdio>
+#include <set>
+#include <vector>
+
+#include "bench.h"
+#include "color_tables.h"
+#include "pixel_output.h"
+
+namespace {
+
+constexpr uint16_t kLengths[] = {22, 144, 300, 1000, 4000};
+constexpr uint32_t kBatchFrames = 50;
+// Host time per measurement.
+constexpr uint64_t kTargetNs = 20 * 1000 * 1000;
+// TaskRGB's dim level, and the dim breathing range (BreathingMinimum() and
+// BreathingMaximum() in main.cpp).
+constexpr uint8_t kDimLevel = 12;
+constexpr uint8_t kBreathingMin = 5;
+constexpr uint8_t kBreathingMax = 80;
+// Frames averaged per level: a multiple of the eight-frame pattern.
+constexpr uint32_t kAveragedFrames = 64;
+// Three dithered fraction bits leave up to 1/8 step; the residual at either
+// end of the average adds under 1/kAveragedFrames.
+constexpr double kMaxMeanError = 0.125 + 1.0 / kAveragedFrames;
+constexpr uint8_t kChannels[] = {255, 96, 16};
+
+// Completes every frame at once, so only the CPU side is timed, and keeps
+// the first byte of the last frame.
+class NullTransmitter final : public StripTransmitter {
+ public:
+  void begin() override {}
+  void transmit(const uint8_t *data, std::size_t length) override {
+    bench::DoNotOptimize(data[length - 1]);
+    first_byte_ = data[0];
+  }
+  bool busy() override { return false; }
+  void wait() override {}
+
+  uint8_t firstByte() const { return first_byte_; }
+
+ private:
+  uint8_t first_byte_ = 0;
+};
+
+// The fastest batch of host ns per pixel for commit() of a static rainbow
+// at kDimLevel: every truncated frame after the first is scanned and
+// skipped, every dithered one differs and is sent.
+double CommitNsPerPixel(uint16_t length, bool dither) {
+  std::vector<uint32_t> frame(length);
+  std::vector<uint8_t> wire(PixelOutput::WireBytes(length));
+  std::vector<uint8_t> residuals(PixelOutput::DitherBytes(length));
+  NullTransmitter transmitter;
+  PixelOutput output(transmitter, NEO_GRB + NEO_KHZ800, frame.data(), wire.data(), length,
+                     dither ? residuals.data() : nullptr);
+  for (uint16_t i = 0; i < length; ++i) {
+    frame[i] = color_tables::kWheel[static_cast<uint8_t>(i)];
+  }
+  output.setIntensity(kDimLevel);
+  output.begin();
+
+  uint64_t spent_ns = 0;
+  double best = 0;
+  while (spent_ns < kTargetNs) {
+    bench::Stopwatch stopwatch;
+    stopwatch.start();
+    for (uint32_t i = 0; i < kBatchFrames; ++i) {
+      output.commit();
+    }
+    stopwatch.stop();
+    spent_ns += stopwatch.totalNs();
+    const double ns = static_cast<double>(stopwatch.totalNs()) / kBatchFrames / length;
+    best = (best == 0 || ns < best) ? ns : best;
+  }
+  return best;
+}
+
+struct LevelSpread {
+  std::size_t levels;
+  // Largest distance from the exact value, in 8-bit steps.
+  double worst_error;
+};
+
+// Output of one pixel of |channel| in red at each level of the dim breathing
+// range: a single truncated frame, or the mean of kAveragedFrames dithered
+// ones.
+LevelSpread Spread(uint8_t channel, bool dither) {
+  uint32_t frame[1];
+  uint8_t wire[PixelOutput::WireBytes(1)];
+  uint8_t residuals[PixelOutput::DitherBytes(1)];
+  NullTransmitter transmitter;
+  PixelOutput output(transmitter, NEO_RGB + NEO_KHZ800, frame, wire, 1,
+                     dither ? residuals : nullptr);
+  output.setPixel(0, color_tables::Pack(channel, 0, 0));
+  output.begin();
+
+  std::set<long> seen;
+  LevelSpread spread{0, 0};
+  for (uint32_t level = kBreathingMin; level <= kBreathingMax; ++level) {
+    output.setIntensity(static_cast<uint8_t>(level));
+    const uint32_t frames = dither ? kAveragedFrames : 1;
+    uint32_t sum = 0;
+    for (uint32_t n = 0; n < frames; ++n) {
+      output.invalidate();
+      output.commit();
+      sum += transmitter.firstByte();
+    }
+    const double mean = static_cast<double>(sum) / frames;
+    const double exact = channel * 256.0 * (level + 1) / 65536.0;
+    seen.insert(std::lround(mean * kAveragedFrames));
+    spread.worst_error = std::fmax(spread.worst_error, std::fabs(mean - exact));
+  }
+  spread.levels = seen.size();
+  return spread;
+}
+
+}  // namespace
+
+BENCH_CASE(dither) {
+  std::printf("  %-14s %6s %10s %10s %7s\n", "host ns/px", "px", "truncate", "dither", "x");
+  for (uint16_t length : kLengths) {
+    const double truncate = CommitNsPerPixel(length, false);
+    const double dither = CommitNsPerPixel(length, true);
+    std::printf("  %-14s %6u %10.2f %10.2f %6.2fx\n", "commit", static_cast<unsigned>(length),
+                truncate, dither, dither / truncate);
+  }
+
+  std::printf("  levels %u-%u at full brightness (%u steps):\n", kBreathingMin, kBreathingMax,
+              kBreathingMax - kBreathingMin + 1);
+  for (uint8_t channel : kChannels) {
+    const LevelSpread truncated = Spread(channel, false);
+    const LevelSpread dithered = Spread(channel, true);
+    const bool ok = dithered.worst_error <= kMaxMeanError;
+    std::printf("  channel %3u    truncated %3u levels, worst %.2f steps off; dithered %3u levels, "
+                "worst %.2f%s\n",
+                channel, static_cast<unsigned>(truncated.levels), truncated.worst_error,
+                static_cast<unsigned>(dithered.levels), dithered.worst_error,
+                ok ? "" : "  FAIL");
+    if (!ok) {
+      bench::Fail();
+    }
+  }
+}
@@ -0,0 +1,161 @@
+// Frame cost of every registered effect on its own, every StrandPattern
+// (driving StrandtestController directly) and every GlowMode (running the
+// TaskRGB state machine from main.cpp).
+
+#include <Adafruit_NeoPixel.h>
+#include <Preferences.h>
+
+#include <cstdio>
+
+#include "bench.h"
+#include "effect_engine.h"
+#include "glow_modes.h"
+#include "host_sim.h"
+#include "pixel_output.h"
+#include "sim_buttons.h"
+#include "strandtest_nodelay.h"
+
+extern PixelOutput strip_output;
+extern uint32_t rgb_task_wakeups;
+
+void setup();
+
+namespace {
+
+constexpr uint16_t kBenchPixels = 22;
+constexpr uint64_t kUsPerMs = 1000;
+constexpr uint64_t kUsPerSecond = 1000000;
+// How long the bright/dim clicks hold the main key down.
+constexpr uint64_t kClickUs = 80 * kUsPerMs;
+
+struct PatternCase {
+  const char *name;
+  StrandPattern pattern;
+};
+
+constexpr PatternCase kPatternCases[] = {
+    {"kColorWipe", StrandPattern::kColorWipe},
+    {"kTheaterChase", StrandPattern::kTheaterChase},
+    {"kRainbow", StrandPattern::kRainbow},
+    {"kTheaterChaseRainbow", StrandPattern::kTheaterChaseRainbow},
+};
+
+void SeedPreferences(int brightness, int glow) {
+  host_sim::ResetNvs();
+  Preferences prefs;
+  prefs.begin("lighting", false);
+  prefs.putInt("brightness", brightness);
+  prefs.putInt("glow", glow);
+  prefs.end();
+}
+
+void RunGlowMode(const char *label, int glow, uint64_t click_period_us, const bench::Options &options) {
+  SeedPreferences(0, glow);
+  host_sim::ClearSchedule();
+  setup();
+
+  const uint64_t start = host_sim::NowUs();
+  const uint64_t duration = options.seconds * kUsPerSecond;
+  if (click_period_us) {
+    for (uint64_t t = click_period_us; t < duration; t += click_period_us) {
+      sim_buttons::SchedulePress(sim_buttons::kMainPin, start + t, kClickUs);
+    }
+  }
+
+  host_sim::ResetStats();
+  strip_output.resetStats();
+  const uint32_t wakeups_before = rgb_task_wakeups;
+  host_sim::RunTask("TaskRGB", duration);
+  const host_sim::Stats &stats = host_sim::GetStats();
+  bench::ReportFrames(label, stats.busy_ns, stats.show_calls, stats.show_calls,
+                      rgb_task_wakeups - wakeups_before, options.seconds);
+  bench::ReportCommits(strip_output.stats().frames_sent, strip_output.stats().frames_skipped);
+}
+
+}  // namespace
+
+BENCH_CASE(effects) {
+  // Render only: each effect draws consecutive steps straight into a frame
+  // buffer through its registry entry, with no commit or show().
+  constexpr uint32_t kFrames = 100000;
+  uint32_t frame[kBenchPixels];
+  alignas(BuiltinEffects::kArenaAlign) unsigned char arena[BuiltinEffects::kArenaSize];
+  EffectParams params{};
+  params.color = Adafruit_NeoPixel::Color(200, 200, 200);
+  params.step_ms = 10;
+  params.level = 255;
+  params.level_min = 20;
+  params.level_max = 150;
+  params.phase_step = 256;
+
+  std::printf("  arena: %zu bytes, %zu effects\n", BuiltinEffects::kArenaSize,
+              BuiltinEffects::kCount);
+  for (const EffectDescriptor &effect : BuiltinEffects::kDescriptors) {
+    const PixelSpan target{frame, kBenchPixels};
+    effect.start(arena, params, target);
+    bench::Stopwatch stopwatch;
+    stopwatch.start();
+    for (uint32_t step = 0; step < kFrames; ++step) {
+      Frame f{target, step, params, 255};
+      effect.render(arena, f);
+      bench::DoNotOptimize(f.level);
+      bench::DoNotOptimize(frame[step % kBenchPixels]);
+    }
+    stopwatch.stop();
+    char label[48];
+    std::snprintf(label, sizeof(label), "%s (%zuB)", effect.name, effect.state_size);
+    bench::ReportOps(label, stopwatch.totalNs(), kFrames);
+  }
+}
+
+BENCH_CASE(strand_patterns) {
+  for (const PatternCase &entry : kPatternCases) {
+    Adafruit_NeoPixel strip(kBenchPixels, 0, NEO_GRB + NEO_KHZ800);
+    NeoPixelTransmitter transmitter(strip);
+    uint32_t frame[kBenchPixels];
+    uint8_t wire[PixelOutput::WireBytes(kBenchPixels)];
+    PixelOutput output(transmitter, NEO_GRB + NEO_KHZ800, frame, wire, kBenchPixels);
+    EffectEngine engine(output);
+    StrandtestController controller(engine);
+    controller.setAutoCycle(false);
+    controller.begin();
+    controller.setPattern(entry.pattern, Adafruit_NeoPixel::Color(200, 200, 200));
+    output.resetStats();
+
+    host_sim::ResetStats();
+    bench::Stopwatch stopwatch;
+    uint64_t frames = 0;
+    uint64_t calls = 0;
+    const uint64_t end = host_sim::NowUs() + options.seconds * kUsPerSecond;
+    while (host_sim::NowUs() < end) {
+      const uint64_t shows_before = host_sim::GetStats().show_calls;
+      stopwatch.start();
+      controller.update();
+      const uint64_t lap = stopwatch.lap();
+      calls++;
+      // Only calls that rendered count towards ns/frame; the early-return
+      // polls are reported through the wakeup rate instead.
+      if (host_sim::GetStats().show_calls != shows_before) {
+        stopwatch.add(lap);
+        frames++;
+      }
+      host_sim::AdvanceBy(kUsPerMs);
+    }
+    bench::ReportFrames(entry.name, stopwatch.totalNs(), frames, host_sim::GetStats().show_calls,
+                        calls, options.seconds);
+    bench::ReportCommits(output.stats().frames_sent, output.stats().frames_skipped);
+  }
+}
+
+BENCH_CASE(glow_modes) {
+  for (const bench::GlowModeName &glow : bench::kGlowModeNames) {
+    RunGlowMode(glow.name, glow.value, 0, options);
+  }
+}
+
+BENCH_CASE(glow_modes_clicking) {
+  // A bright/dim toggle every second exercises SyncBrightness in each mode.
+  for (const bench::GlowModeName &glow : bench::kGlowModeNames) {
+    RunGlowMode(glow.name, glow.value, kUsPerSecond, options);
+  }
+}
@@ -0,0 +1,96 @@
+// Frame cache: host ns to produce a frame of each periodic effect by
+// rendering it, by replaying it from a FrameCache, and on the first lap
+// while the cache fills (render plus store), against the bytes a cycle
+// takes, at 22 to 1000 px. Only the step the cache replaces is timed; the
+// commit after it costs the same either way (see the scaling case). The
+// last column says whether the cycle fits the firmware's budget.
+
+#include <Adafruit_NeoPixel.h>
+
+#include <cstdio>
+#include <vector>
+
+#include "bench.h"
+#include "effect_engine.h"
+#include "frame_cache.h"
+
+extern FrameCache frame_cache;
+
+namespace {
+
+constexpr uint16_t kLengths[] = {22, 144, 300, 1000};
+constexpr uint32_t kBatchFrames = 256;
+// Host time per measurement.
+constexpr uint64_t kTargetNs = 20 * 1000 * 1000;
+
+enum class Mode { kLive, kFill, kCached };
+
+// The fastest batch of host ns per frame of |effect| at |length| pixels, a
+// fresh step every frame: render() on its own, render() plus a store on an
+// empty cache (the first lap) or a replay from a filled one.
+double FrameNs(const EffectDescriptor &effect, uint16_t length, Mode mode) {
+  std::vector<uint32_t> pixels(length);
+  std::vector<uint32_t> storage(static_cast<std::size_t>(effect.period) * length);
+  alignas(BuiltinEffects::kArenaAlign) unsigned char arena[BuiltinEffects::kArenaSize];
+  FrameCache cache(storage.data(), storage.size());
+  EffectParams params{};
+  params.color = Adafruit_NeoPixel::Color(200, 200, 200);
+  params.step_ms = 1;
+  params.level = 255;
+  effect.start(arena, params, PixelSpan{pixels.data(), length});
+  cache.bind(effect.id, params, length, effect.period);
+  for (uint32_t step = 0; mode == Mode::kCached && step < effect.period; ++step) {
+    cache.store(step, pixels.data());
+  }
+
+  uint64_t spent_ns = 0;
+  uint32_t step = 0;
+  double best = 0;
+  while (spent_ns < kTargetNs) {
+    if (mode == Mode::kFill) {
+      cache.unbind();
+      cache.bind(effect.id, params, length, effect.period);
+    }
+    bench::Stopwatch stopwatch;
+    stopwatch.start();
+    for (uint32_t i = 0; i < kBatchFrames; ++i, ++step) {
+      if (mode == Mode::kCached) {
+        cache.replay(step, pixels.data());
+      } else {
+        Frame frame{PixelSpan{pixels.data(), length}, step, params, params.level};
+        effect.render(arena, frame);
+        if (mode == Mode::kFill) {
+          cache.store(step, pixels.data());
+        }
+      }
+      bench::DoNotOptimize(pixels[length - 1]);
+    }
+    stopwatch.stop();
+    spent_ns += stopwatch.totalNs();
+    const double ns = static_cast<double>(stopwatch.totalNs()) / kBatchFrames;
+    best = (best == 0 || ns < best) ? ns : best;
+  }
+  return best;
+}
+
+}  // namespace
+
+BENCH_CASE(frame_cache) {
+  std::printf("  firmware budget %u B\n", static_cast<unsigned>(frame_cache.capacityBytes()));
+  std::printf("  %-22s %6s %9s %9s %9s %7s %9s %5s\n", "host ns/frame", "px", "live", "cached",
+              "1st lap", "saved", "bytes", "fits");
+  for (const EffectDescriptor &effect : BuiltinEffects::kDescriptors) {
+    if (effect.period == 0) {
+      continue;
+    }
+    for (uint16_t length : kLengths) {
+      const double live = FrameNs(effect, length, Mode::kLive);
+      const double cached = FrameNs(effect, length, Mode::kCached);
+      const double fill = FrameNs(effect, length, Mode::kFill);
+      const std::size_t bytes = FrameCache::CycleBytes(effect.period, length);
+      std::printf("  %-22s %6u %9.0f %9.0f %9.0f %6.0f%% %9u %5s\n", effect.name,
+                  static_cast<unsigned>(length), live, cached, fill, 100.0 * (live - cached) / live,
+                  static_cast<unsigned>(bytes), bytes <= frame_cache.capacityBytes() ? "yes" : "no");
+    }
+  }
+}
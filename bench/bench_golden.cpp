@@ -0,0 +1,79 @@
+// Golden-frame scenarios (golden.h) as a bench case: the host time per frame
+// of each, run on the simulated clock. With --record the files in
+// bench/golden whose frames changed are rewritten from the runs;
+// test/test_native checks the frames against them. Run from the project
+// root.
+
+#include <algorithm>
+#include <cstdio>
+
+#include "bench.h"
+#include "golden.h"
+
+namespace {
+
+// Each scenario runs this often, and every run must produce the same
+// frames; the fastest is the time printed.
+constexpr int kTimingRuns = 5;
+
+void RunScenario(const golden::Scenario &scenario, const bench::Options &options) {
+  const char *label = scenario.name.c_str();
+  golden::Recording recording;
+  scenario.fn(scenario.variant, recording);
+  uint32_t run_ns[kTimingRuns] = {recording.ns_per_frame};
+  for (int run = 1; run < kTimingRuns; ++run) {
+    golden::Recording again;
+    scenario.fn(scenario.variant, again);
+    char difference[128];
+    if (golden::Describe(recording, again, difference, sizeof(difference))) {
+      std::printf("  %-32s FAIL not repeatable: %s\n", label, difference);
+      bench::Fail();
+      return;
+    }
+    if (again.commits != recording.commits) {
+      std::printf("  %-32s FAIL not repeatable: %u commits, then %u\n", label,
+                  static_cast<unsigned>(recording.commits), static_cast<unsigned>(again.commits));
+      bench::Fail();
+      return;
+    }
+    run_ns[run] = again.ns_per_frame;
+  }
+  recording.ns_per_frame = *std::min_element(run_ns, run_ns + kTimingRuns);
+  std::printf("  %-32s %6zu frames %6u commits %8u ns/frame", label, recording.frames.size(),
+              static_cast<unsigned>(recording.commits),
+              static_cast<unsigned>(recording.ns_per_frame));
+
+  if (!options.record) {
+    std::printf("\n");
+    return;
+  }
+  if (golden::ButtonMismatches() != 0) {
+    std::printf("  FAIL presses applied wrongly, not recorded\n");
+    bench::Fail();
+    return;
+  }
+  // A file whose frames and commit count still match is left alone, so a
+  // re-record touches only the scenarios whose output changed.
+  const std::string path = golden::GoldenPath(scenario.name);
+  golden::Recording stored;
+  char difference[128];
+  if (golden::ReadGolden(path, stored) && stored.commits == recording.commits &&
+      !golden::Describe(stored, recording, difference, sizeof(difference))) {
+    std::printf("  unchanged\n");
+    return;
+  }
+  if (!golden::WriteGolden(path, recording)) {
+    std::printf("  FAIL cannot write %s\n", path.c_str());
+    bench::Fail();
+    return;
+  }
+  std::printf("  recorded\n");
+}
+
+}  // namespace
+
+BENCH_CASE(golden) {
+  for (const golden::Scenario &scenario : golden::Scenarios()) {
+    RunScenario(scenario, options);
+  }
+}
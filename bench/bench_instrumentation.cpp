@@ -0,0 +1,56 @@
+// The instrumentation report for a session of TaskRGB (every glow mode in
+// turn, with bright/dim clicks) followed by TaskPersist writing the result,
+// and the cost of one stage sample.
+
+#include <Preferences.h>
+
+#include <cstdio>
+
+#include "bench.h"
+#include "host_sim.h"
+#include "instrumentation.h"
+#include "sim_buttons.h"
+
+void setup();
+
+namespace {
+
+constexpr uint64_t kUsPerMs = 1000;
+constexpr uint64_t kUsPerSecond = 1000000;
+// A long press, then a bright/dim click, every period.
+constexpr uint64_t kPressPeriodUs = 1400 * kUsPerMs;
+constexpr uint64_t kLongPressUs = 900 * kUsPerMs;
+constexpr uint64_t kClickUs = 80 * kUsPerMs;
+constexpr uint64_t kClickAfterUs = 1100 * kUsPerMs;
+constexpr uint64_t kPersistRunUs = 3 * kUsPerSecond;
+
+}  // namespace
+
+BENCH_CASE(instrumentation) {
+#if LIGHTING_INSTRUMENTATION
+  constexpr uint32_t kSamples = 1000000;
+  bench::Stopwatch stopwatch;
+  stopwatch.start();
+  for (uint32_t i = 0; i < kSamples; ++i) {
+    INSTRUMENT_STAGE(kEvents);
+  }
+  stopwatch.stop();
+  bench::ReportOps("stage sample", stopwatch.totalNs(), kSamples);
+
+  host_sim::ResetNvs();
+  host_sim::ClearSchedule();
+  setup();
+  const uint64_t start = host_sim::NowUs();
+  const uint64_t duration = options.seconds * kUsPerSecond;
+  for (uint64_t t = 0; t < duration; t += kPressPeriodUs) {
+    sim_buttons::SchedulePress(sim_buttons::kMainPin, start + t, kLongPressUs);
+    sim_buttons::SchedulePress(sim_buttons::kMainPin, start + t + kClickAfterUs, kClickUs);
+  }
+  instrumentation::Reset();
+  host_sim::RunTask("TaskRGB", duration);
+  host_sim::RunTask("TaskPersist", kPersistRunUs);
+  instrumentation::Dump();
+#else
+  std::printf("  built with LIGHTING_INSTRUMENTATION=0\n");
+#endif
+}
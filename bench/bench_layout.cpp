@@ -0,0 +1,317 @@
+// Pixel layouts: host time to precompute the place tables for a strip, a
+// ring, concentric rings, a serpentine matrix and a 4096 px panel, then ns
+// per pixel for the spatial effects reading those tables against the same
+// radial wave and sweep computing each pixel's radius or angle every frame.
+// Then checks: a ring's angles and radii, a serpentine matrix's grid, an
+// NVS round trip, malformed layouts and the noise drift over a wrap. Any
+// mismatch fails the run.
+
+#include <Preferences.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <cstdio>
+#include <vector>
+
+#include "bench.h"
+#include "effect_engine.h"
+#include "host_sim.h"
+#include "pixel_layout.h"
+#include "pixel_ops.h"
+#include "waveform.h"
+
+namespace {
+
+// Host time per measurement.
+constexpr uint64_t kTargetNs = 20 * 1000 * 1000;
+constexpr uint32_t kBatch = 20;
+constexpr float kTurn = 6.28318530718f;
+constexpr uint8_t kRadiusSlack = 2;
+
+constexpr uint8_t kStrip[] = {
+    LAYOUT_HEADER(1, 128, 128),
+    LAYOUT_LINE(22, 0, 128, 255, 128),
+};
+constexpr uint16_t kRingPixels = 60;
+constexpr uint8_t kRing[] = {
+    LAYOUT_HEADER(1, 128, 128),
+    LAYOUT_RING(kRingPixels, 128, 128, 120, 0),
+};
+constexpr uint8_t kRings[] = {
+    LAYOUT_HEADER(4, 128, 128),
+    LAYOUT_RING(24, 128, 128, 30, 0),
+    LAYOUT_RING(48, 128, 128, 60, 0),
+    LAYOUT_RING(96, 128, 128, 90, 0),
+    LAYOUT_RING(192, 128, 128, 120, 0),
+};
+constexpr uint8_t kMatrixSide = 16;
+constexpr uint8_t kMatrix[] = {
+    LAYOUT_HEADER(1, 120, 120),
+    LAYOUT_MATRIX(kMatrixSide, kMatrixSide, 0, 0, 16, kMatrixSerpentine),
+};
+constexpr uint8_t kPanel[] = {
+    LAYOUT_HEADER(1, 126, 126),
+    LAYOUT_MATRIX(64, 64, 0, 0, 4, kMatrixSerpentine | kMatrixColumnMajor),
+};
+
+struct LayoutCase {
+  const char *name;
+  const uint8_t *bytes;
+  std::size_t length;
+};
+
+constexpr LayoutCase kLayouts[] = {
+    {"strip", kStrip, sizeof(kStrip)},
+    {"ring", kRing, sizeof(kRing)},
+    {"rings", kRings, sizeof(kRings)},
+    {"matrix", kMatrix, sizeof(kMatrix)},
+    {"panel", kPanel, sizeof(kPanel)},
+};
+
+// Tables sized for |pixels|, with the layout object over them.
+struct Tables {
+  explicit Tables(std::size_t pixels)
+      : places(pixels), grid(pixels), layout(places.data(), grid.data(), pixels) {}
+  std::vector<PixelPlace> places;
+  std::vector<uint16_t> grid;
+  PixelLayout layout;
+};
+
+// The fastest batch of host ns per call of |run|.
+template <typename Fn>
+double BestNs(Fn run) {
+  uint64_t spent_ns = 0;
+  double best = 0;
+  while (spent_ns < kTargetNs) {
+    bench::Stopwatch stopwatch;
+    stopwatch.start();
+    for (uint32_t i = 0; i < kBatch; ++i) {
+      run(i);
+    }
+    stopwatch.stop();
+    spent_ns += stopwatch.totalNs();
+    const double ns = static_cast<double>(stopwatch.totalNs()) / kBatch;
+    best = (best == 0 || ns < best) ? ns : best;
+  }
+  return best;
+}
+
+EffectParams SpatialParams() {
+  EffectParams params{};
+  params.color = 0x00c8c8c8;
+  params.step_ms = 20;
+  params.level = 255;
+  params.phase_step = 655;
+  return params;
+}
+
+// Host ns per pixel for effect |id| drawing consecutive steps from the
+// attached layout.
+double EffectNsPerPixel(EffectId id, std::vector<uint32_t> &frame) {
+  const EffectDescriptor &effect = BuiltinEffects::kDescriptors[static_cast<std::size_t>(id)];
+  alignas(BuiltinEffects::kArenaAlign) unsigned char arena[BuiltinEffects::kArenaSize];
+  const EffectParams params = SpatialParams();
+  const PixelSpan target{frame.data(), static_cast<uint16_t>(frame.size())};
+  effect.start(arena, params, target);
+  uint32_t step = 0;
+  const double ns = BestNs([&](uint32_t) {
+    Frame f{target, step++, params, 255};
+    effect.render(arena, f);
+    bench::DoNotOptimize(frame[step % frame.size()]);
+  });
+  return ns / frame.size();
+}
+
+// The radial wave and sweep without the tables: each pixel's radius or
+// angle from its coordinates every frame, as an effect would without a
+// precompute step.
+double ComputedNsPerPixel(const PixelLayout &layout, const uint8_t *bytes, bool sweep,
+                          std::vector<uint32_t> &frame) {
+  const EffectParams params = SpatialParams();
+  const float cx = bytes[4];
+  const float cy = bytes[5];
+  float farthest = 1;
+  for (uint16_t i = 0; i < layout.count(); ++i) {
+    const PixelPlace &place = layout.places()[i];
+    farthest = std::fmax(farthest, std::hypot(place.x - cx, place.y - cy));
+  }
+  uint32_t step = 0;
+  const double ns = BestNs([&](uint32_t) {
+    const waveform::Phase phase = static_cast<waveform::Phase>(step++ * params.phase_step);
+    for (uint16_t i = 0; i < layout.count(); ++i) {
+      const float dx = layout.places()[i].x - cx;
+      const float dy = layout.places()[i].y - cy;
+      uint8_t sample;
+      if (sweep) {
+        const uint32_t angle = static_cast<uint32_t>(std::lround(std::atan2(dy, dx) / kTurn * 256));
+        sample = waveform::Sample(waveform::kSparkle,
+                                  static_cast<waveform::Phase>(phase - ((angle & 0xff) << 8)));
+      } else {
+        const uint32_t radius =
+            static_cast<uint32_t>(std::lround(std::sqrt(dx * dx + dy * dy) / farthest * 255));
+        sample = waveform::Sample(
+            waveform::kSine,
+            static_cast<waveform::Phase>((radius * RadialWaveEffect::kRadialWaves << 8) - phase));
+      }
+      frame[i] = pixel_ops::ScalePixel(params.color, pixel_ops::WeightForLevel(sample));
+    }
+    bench::DoNotOptimize(frame[step % frame.size()]);
+  });
+  return ns / layout.count();
+}
+
+void Check(const char *what, bool ok) {
+  std::printf("  %-44s %s\n", what, ok ? "ok" : "FAIL");
+  if (!ok) {
+    bench::Fail();
+  }
+}
+
+// Every ring pixel within one angle step of where it was placed, and all
+// within kRadiusSlack of the full radius: coordinates are whole plane units,
+// so a radius of 120 comes out between 119.5 and 120.5.
+bool RingPlacesMatch() {
+  Tables tables(kRingPixels);
+  if (!tables.layout.load(kRing, sizeof(kRing)) || tables.layout.count() != kRingPixels) {
+    return false;
+  }
+  for (uint16_t i = 0; i < kRingPixels; ++i) {
+    const PixelPlace &place = tables.places[i];
+    const int placed = static_cast<int>(std::lround(256.0 * i / kRingPixels)) & 0xff;
+    const int off = static_cast<uint8_t>(place.angle - placed);
+    if ((off > 1 && off < 255) || place.radius < 255 - kRadiusSlack) {
+      return false;
+    }
+  }
+  return true;
+}
+
+// Row r runs left to right when even and right to left when odd.
+bool SerpentineGridMatches() {
+  Tables tables(kMatrixSide * kMatrixSide);
+  if (!tables.layout.load(kMatrix, sizeof(kMatrix)) || tables.layout.columns() != kMatrixSide ||
+      tables.layout.rows() != kMatrixSide) {
+    return false;
+  }
+  for (uint8_t row = 0; row < kMatrixSide; ++row) {
+    for (uint8_t column = 0; column < kMatrixSide; ++column) {
+      const uint8_t along = (row & 1) ? kMatrixSide - 1 - column : column;
+      const uint16_t pixel = tables.layout.pixelAt(column, row);
+      if (pixel != row * kMatrixSide + along || tables.places[pixel].x != column * 16 ||
+          tables.places[pixel].y != row * 16) {
+        return false;
+      }
+    }
+  }
+  return tables.layout.pixelAt(kMatrixSide, 0) == PixelLayout::kNoPixel;
+}
+
+bool NvsRoundTrip() {
+  host_sim::ResetNvs();
+  Preferences prefs;
+  prefs.begin("lighting", false);
+  prefs.putBytes("layout", kRings, sizeof(kRings));
+  uint8_t buffer[kMaxLayoutBytes];
+  const std::size_t length = LoadLayout(prefs, "layout", buffer, sizeof(buffer));
+  prefs.end();
+  Tables tables(360);
+  return length == sizeof(kRings) && tables.layout.load(buffer, length) &&
+         tables.layout.count() == 360;
+}
+
+// Each is rejected, and a rejected load keeps the tables it had.
+bool MalformedRejected() {
+  constexpr uint8_t kOffPlane[] = {LAYOUT_HEADER(1, 128, 128), LAYOUT_RING(8, 100, 128, 120, 0)};
+  constexpr uint8_t kTwoMatrices[] = {
+      LAYOUT_HEADER(2, 128, 128),
+      LAYOUT_MATRIX(2, 2, 0, 0, 8, 0),
+      LAYOUT_MATRIX(2, 2, 100, 0, 8, 0),
+  };
+  constexpr uint8_t kBadKind[] = {LAYOUT_HEADER(1, 128, 128), 0x09, 1, 0, 0, 0, 0, 0, 0};
+  constexpr uint8_t kShort[] = {LAYOUT_HEADER(2, 128, 128), LAYOUT_LINE(4, 0, 0, 255, 0)};
+  Tables tables(22);
+  if (!tables.layout.load(kStrip, sizeof(kStrip))) {
+    return false;
+  }
+  const bool rejected = !ValidateLayout(kOffPlane, sizeof(kOffPlane)) &&
+                        !ValidateLayout(kTwoMatrices, sizeof(kTwoMatrices)) &&
+                        !ValidateLayout(kBadKind, sizeof(kBadKind)) &&
+                        !ValidateLayout(kShort, sizeof(kShort)) &&
+                        !tables.layout.load(kRing, sizeof(kRing));
+  return rejected && tables.layout.count() == 22 && tables.places[21].x == 255;
+}
+
+// Largest channel change from step - 1 to step of the noise field.
+int NoiseStepChange(uint32_t step) {
+  Tables tables(kRingPixels);
+  tables.layout.load(kRing, sizeof(kRing));
+  AttachLayout(&tables.layout);
+  const EffectDescriptor &effect =
+      BuiltinEffects::kDescriptors[static_cast<std::size_t>(EffectId::kNoise)];
+  alignas(BuiltinEffects::kArenaAlign) unsigned char arena[BuiltinEffects::kArenaSize];
+  const EffectParams params = SpatialParams();
+  uint32_t before[kRingPixels];
+  uint32_t after[kRingPixels];
+  effect.start(arena, params, PixelSpan{before, kRingPixels});
+  Frame first{PixelSpan{before, kRingPixels}, step - 1, params, 255};
+  effect.render(arena, first);
+  Frame second{PixelSpan{after, kRingPixels}, step, params, 255};
+  effect.render(arena, second);
+  AttachLayout(nullptr);
+  int change = 0;
+  for (uint16_t i = 0; i < kRingPixels; ++i) {
+    for (int shift = 0; shift < 24; shift += 8) {
+      const int a = (before[i] >> shift) & 0xff;
+      const int b = (after[i] >> shift) & 0xff;
+      change = std::max(change, std::abs(a - b));
+    }
+  }
+  return change;
+}
+
+// The noise drifts as smoothly where step * phase_step passes 32 bits, and
+// where the drift itself wraps, as it does anywhere else.
+bool NoiseDriftWraps() {
+  const uint32_t phase_step = SpatialParams().phase_step;
+  const int usual = std::max(NoiseStepChange(1000), NoiseStepChange(2000)) + 1;
+  const uint32_t product_wraps = static_cast<uint32_t>((uint64_t{1} << 32) / phase_step + 1);
+  const uint32_t drift_wraps = static_cast<uint32_t>((uint64_t{1} << 40) / phase_step + 1);
+  return NoiseStepChange(product_wraps) <= usual && NoiseStepChange(drift_wraps) <= usual;
+}
+
+}  // namespace
+
+BENCH_CASE(layout) {
+  std::printf("  host ns per pixel; \"trig\" works out the radius or angle every frame\n");
+  std::printf("  %-8s %5s %9s %8s %8s %8s %8s %8s %8s\n", "layout", "px", "load us", "load/px",
+              "radial", "trig", "sweep", "trig", "noise");
+  for (const LayoutCase &entry : kLayouts) {
+    Tables probe(UINT16_MAX);
+    probe.layout.load(entry.bytes, entry.length);
+    const uint16_t pixels = probe.layout.count();
+
+    Tables tables(pixels);
+    const double load_ns = BestNs(
+        [&](uint32_t) { bench::DoNotOptimize(tables.layout.load(entry.bytes, entry.length)); });
+
+    std::vector<uint32_t> frame(pixels);
+    AttachLayout(&tables.layout);
+    const double radial = EffectNsPerPixel(EffectId::kRadialWave, frame);
+    const double sweep = EffectNsPerPixel(EffectId::kSweep, frame);
+    const double noise = EffectNsPerPixel(EffectId::kNoise, frame);
+    AttachLayout(nullptr);
+    const double radial_trig = ComputedNsPerPixel(tables.layout, entry.bytes, false, frame);
+    const double sweep_trig = ComputedNsPerPixel(tables.layout, entry.bytes, true, frame);
+
+    std::printf("  %-8s %5u %9.2f %8.1f %8.2f %8.2f %8.2f %8.2f %8.2f\n", entry.name,
+                static_cast<unsigned>(pixels), load_ns / 1000, load_ns / pixels, radial,
+                radial_trig, sweep, sweep_trig, noise);
+  }
+
+  Check("ring angles and radii", RingPlacesMatch());
+  Check("serpentine matrix grid", SerpentineGridMatches());
+  Check("layout from NVS", NvsRoundTrip());
+  Check("malformed layouts rejected, tables kept", MalformedRejected());
+  Check("noise drift wraps smoothly", NoiseDriftWraps());
+}
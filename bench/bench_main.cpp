@@ -0,0 +1,79 @@
+// Entry point for the native benchmark build:
+//   pio run -e native && .pio/build/native/program [seconds] [case-filter] [--record]
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+#include "bench.h"
+
+namespace bench {
+namespace {
+
+struct Case {
+  const char *name;
+  CaseFn fn;
+};
+
+std::vector<Case> &Cases() {
+  static std::vector<Case> cases;
+  return cases;
+}
+
+bool failed = false;
+
+}  // namespace
+
+Registrar::Registrar(const char *name, CaseFn fn) { Cases().push_back({name, fn}); }
+
+void ReportFrames(const char *label, uint64_t busy_ns, uint64_t frames, uint64_t shows,
+                  uint64_t wakeups, double simulated_seconds) {
+  const double ns_per_frame = frames ? static_cast<double>(busy_ns) / frames : 0.0;
+  std::printf("  %-28s %10.0f ns/frame %8.1f frames/s %8.1f show/s %8.1f wakeups/s\n", label,
+              ns_per_frame, frames / simulated_seconds, shows / simulated_seconds,
+              wakeups / simulated_seconds);
+}
+
+void ReportCommits(uint32_t sent, uint32_t skipped) {
+  const uint32_t total = sent + skipped;
+  std::printf("  %-28s %10u sent %10u skipped (%.1f%% skipped)\n", "", sent, skipped,
+              total ? 100.0 * skipped / total : 0.0);
+}
+
+void Fail() { failed = true; }
+
+void ReportOps(const char *label, uint64_t total_ns, uint64_t ops) {
+  std::printf("  %-28s %10.2f ns/op\n", label, ops ? static_cast<double>(total_ns) / ops : 0.0);
+}
+
+}  // namespace bench
+
+// pio test builds the same sources with the test runner's own main().
+#ifndef PIO_UNIT_TESTING
+int main(int argc, char **argv) {
+  bench::Options options{10, false};
+  const char *positional[2] = {};
+  int positional_count = 0;
+  for (int i = 1; i < argc; ++i) {
+    if (std::strcmp(argv[i], "--record") == 0) {
+      options.record = true;
+    } else if (positional_count < 2) {
+      positional[positional_count++] = argv[i];
+    }
+  }
+  if (positional[0] != nullptr) {
+    options.seconds = static_cast<uint32_t>(std::strtoul(positional[0], nullptr, 10));
+  }
+  const char *filter = positional[1];
+
+  for (const bench::Case &entry : bench::Cases()) {
+    if (filter && std::strstr(entry.name, filter) == nullptr) {
+      continue;
+    }
+    std::printf("%s (%u simulated s)\n", entry.name, options.seconds);
+    entry.fn(options);
+  }
+  return bench::failed ? 1 : 0;
+}
+#endif  // PIO_UNIT_TESTING
@@ -0,0 +1,147 @@
+// Task stacks: each firmware task run through its heaviest paths on a
+// painted host stack, reporting the bytes it used against the depth setup()
+// gives it. TaskOsc is not started without Wi-Fi credentials, so its loop
+// runs in a probe task instead. Host frames are x86-64 and the ESP-IDF
+// drivers are stand-ins, so these bound the firmware's own use; the device
+// figures come from kDumpStats.
+
+#include <Arduino.h>
+#include <Preferences.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#include <lwip/sockets.h>
+
+#include <cstdio>
+#include <vector>
+
+#include "bench.h"
+#include "host_sim.h"
+#include "osc_captures.h"
+#include "serial_protocol.h"
+#include "sim_buttons.h"
+
+void setup();
+uint16_t BeginOsc(uint16_t port);
+bool ServiceOsc();
+
+namespace {
+
+constexpr uint64_t kUsPerMs = 1000;
+constexpr uint64_t kUsPerSecond = 1000000;
+// A KEY_USER_2 double click (previous glow) every period, and a main key
+// click (bright/dim) after every other one.
+constexpr uint64_t kGlowPeriodUs = 500 * kUsPerMs;
+constexpr uint64_t kClickUs = 60 * kUsPerMs;
+constexpr uint64_t kSecondClickUs = 150 * kUsPerMs;
+constexpr uint64_t kMainClickAfterUs = 300 * kUsPerMs;
+constexpr uint64_t kTaskRunUs = 3 * kUsPerSecond;
+constexpr uint32_t kOscRounds = 20;
+
+void SendFrame(uint8_t command, const uint8_t *payload, std::size_t length) {
+  uint8_t frame[kMaxFrameSize];
+  const std::size_t size = EncodeFrame(command, payload, length, frame, sizeof(frame));
+  host_sim::SerialReceive(frame, size);
+}
+
+// Every command with a reply, the stats report (the deepest printf) and a
+// switch into the stream.
+void ServeCommands() {
+  const uint8_t color[] = {10, 200, 30};
+  SendFrame(protocol_cmd::kSetColor, color, sizeof(color));
+  SendFrame(protocol_cmd::kQueryState, nullptr, 0);
+  SendFrame(protocol_cmd::kDumpStats, nullptr, 0);
+  SendFrame(protocol_cmd::kFlush, nullptr, 0);
+  SendFrame(0x3c, nullptr, 0);
+  const uint8_t glow = 5;
+  SendFrame(protocol_cmd::kSetGlow, &glow, 1);
+}
+
+// A main key press for TaskButton to pick up through its interrupt.
+void Press(uint64_t down_us, uint64_t held_us) {
+  sim_buttons::ScheduleEdge(sim_buttons::kMainPin, down_us, LOW, false);
+  sim_buttons::ScheduleEdge(sim_buttons::kMainPin, down_us + held_us, HIGH, false);
+}
+
+// TaskOsc after Wi-Fi is up: the capture replayed into its socket and
+// serviced, with TaskOsc's retry period between rounds.
+void OscProbe(void *param) {
+  const uint16_t port = BeginOsc(0);
+  const int sender = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+  sockaddr_in target{};
+  target.sin_family = AF_INET;
+  target.sin_port = htons(port);
+  target.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  for (uint32_t round = 0; port != 0 && round < kOscRounds; ++round) {
+    for (const osc_captures::Capture &capture : osc_captures::kAvatarLoad) {
+      sendto(sender, capture.data, capture.length, 0, reinterpret_cast<const sockaddr *>(&target),
+             sizeof(target));
+    }
+    ServiceOsc();
+    vTaskDelay(pdMS_TO_TICKS(10));
+  }
+  close(sender);
+  for (;;) {
+    vTaskDelay(portMAX_DELAY);
+  }
+}
+
+void Report(const char *name) {
+  const host_sim::StackUse stack = host_sim::TaskStackUse(name);
+  if (stack.depth == 0) {
+    std::printf("  %-12s %8u %10s\n", name, static_cast<unsigned>(stack.used), "-");
+    return;
+  }
+  std::printf("  %-12s %8u %10u %9.0f%%\n", name, static_cast<unsigned>(stack.used),
+              static_cast<unsigned>(stack.depth), 100.0 * stack.used / stack.depth);
+}
+
+}  // namespace
+
+BENCH_CASE(memory) {
+  host_sim::ResetNvs();
+  Preferences prefs;
+  prefs.begin("lighting", false);
+  prefs.putInt("brightness", 0);
+  prefs.putInt("glow", 0);
+  prefs.end();
+  host_sim::ClearSchedule();
+  setup();
+  host_sim::CaptureSerial(true);
+
+  host_sim::Schedule(host_sim::NowUs() + kUsPerMs, ServeCommands);
+  host_sim::RunTask("TaskSerial", 100 * kUsPerMs);
+
+  // A click, a double click and a long press.
+  const uint64_t presses = host_sim::NowUs();
+  Press(presses + 100 * kUsPerMs, 80 * kUsPerMs);
+  Press(presses + 1000 * kUsPerMs, 80 * kUsPerMs);
+  Press(presses + 1200 * kUsPerMs, 80 * kUsPerMs);
+  Press(presses + 2000 * kUsPerMs, 2500 * kUsPerMs);
+  host_sim::RunTask("TaskButton", 5 * kUsPerSecond);
+
+  // Every glow mode, from the stream onwards, in both brightness modes.
+  host_sim::ClearSchedule();
+  const uint64_t start = host_sim::NowUs();
+  const uint64_t duration = options.seconds * kUsPerSecond > kTaskRunUs
+                                ? options.seconds * kUsPerSecond
+                                : kTaskRunUs;
+  for (uint64_t t = kGlowPeriodUs; t < duration; t += kGlowPeriodUs) {
+    sim_buttons::SchedulePress(sim_buttons::kUser2Pin, start + t, kClickUs);
+    sim_buttons::SchedulePress(sim_buttons::kUser2Pin, start + t + kSecondClickUs, kClickUs);
+    if ((t / kGlowPeriodUs) % 2 == 0) {
+      sim_buttons::SchedulePress(sim_buttons::kMainPin, start + t + kMainClickAfterUs, kClickUs);
+    }
+  }
+  host_sim::RunTask("TaskRGB", duration);
+  host_sim::RunTask("TaskPersist", kTaskRunUs);
+  host_sim::CaptureSerial(false);
+  host_sim::TakeSerialOutput();
+
+  xTaskCreate(OscProbe, "OscProbe", 0, nullptr, 3, nullptr);
+  host_sim::RunTask("OscProbe", kOscRounds * 20 * kUsPerMs);
+
+  std::printf("  %-12s %8s %10s %10s\n", "stack", "host use", "configured", "used");
+  for (const char *name : {"TaskButton", "TaskRGB", "TaskSerial", "TaskPersist", "OscProbe"}) {
+    Report(name);
+  }
+}
@@ -0,0 +1,325 @@
+// OSC listener: parser cost on recorded VRChat datagrams, the captures
+// replayed through a loopback UDP socket into a running TaskRGB, then a
+// 90 Hz parameter burst with an avatar-load flood at the start, counting how
+// many updates the coalescing turns into events.
+
+#include <Preferences.h>
+#include <lwip/sockets.h>
+
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "bench.h"
+#include "color_tables.h"
+#include "effect_engine.h"
+#include "host_sim.h"
+#include "osc.h"
+#include "osc_captures.h"
+
+extern EffectEngine effect_engine;
+extern OscParser osc_parser;
+extern OscParameters osc_parameters;
+extern OscParameterState osc_parameter_state[];
+extern int osc_socket;
+
+void setup();
+uint16_t BeginOsc(uint16_t port);
+bool ServiceOsc();
+
+namespace {
+
+constexpr uint64_t kUsPerMs = 1000;
+constexpr uint64_t kUsPerSecond = 1000000;
+// VRChat's parameter send rate follows the frame rate.
+constexpr uint64_t kFramePeriodUs = 11111;
+constexpr uint64_t kRetryUs = 10 * kUsPerMs;
+constexpr uint32_t kParsePasses = 200000;
+// Unbound parameters every frame, and in the avatar-load flood.
+constexpr uint32_t kBusyParameters = 12;
+constexpr uint32_t kLoadParameters = 200;
+constexpr uint32_t kGlowEveryFrames = 90;
+constexpr uint32_t kToggleEveryFrames = 45;
+
+// In long-press cycle order, as main.cpp's GlowMode.
+constexpr EffectId kGlowEffects[] = {EffectId::kSolid, EffectId::kBreathing, EffectId::kRainbow,
+                                     EffectId::kTheaterChase, EffectId::kTheaterChaseRainbow};
+constexpr uint32_t kGlowCount = sizeof(kGlowEffects) / sizeof(kGlowEffects[0]);
+// BreathingMaximum() of each brightness mode tells them apart in any mode.
+constexpr uint8_t kDimLevelMax = 80;
+
+// The bindings main.cpp uses, for timing the parser and table alone.
+constexpr OscBinding kBindings[] = {
+    {"/avatar/parameters/LightDim", 0, OscBindingKind::kValue},
+    {"/avatar/parameters/LightGlow", 1, OscBindingKind::kValue},
+    {"/avatar/parameters/LightHue", 2, OscBindingKind::kValue},
+    {"/avatar/parameters/LightToggle", 3, OscBindingKind::kTrigger},
+    {"/avatar/parameters/LightNext", 4, OscBindingKind::kTrigger},
+};
+constexpr std::size_t kBindingCount = sizeof(kBindings) / sizeof(kBindings[0]);
+
+void AppendString(std::vector<uint8_t> &out, const char *text) {
+  const std::size_t length = std::strlen(text);
+  out.insert(out.end(), text, text + length);
+  out.resize(out.size() + 4 - (length & 3), 0);
+}
+
+void AppendU32(std::vector<uint8_t> &out, uint32_t value) {
+  for (int shift = 24; shift >= 0; shift -= 8) {
+    out.push_back(static_cast<uint8_t>(value >> shift));
+  }
+}
+
+std::vector<uint8_t> FloatMessage(const std::string &address, float value) {
+  std::vector<uint8_t> out;
+  AppendString(out, address.c_str());
+  AppendString(out, ",f");
+  uint32_t bits;
+  std::memcpy(&bits, &value, sizeof(bits));
+  AppendU32(out, bits);
+  return out;
+}
+
+std::vector<uint8_t> IntMessage(const std::string &address, int32_t value) {
+  std::vector<uint8_t> out;
+  AppendString(out, address.c_str());
+  AppendString(out, ",i");
+  AppendU32(out, static_cast<uint32_t>(value));
+  return out;
+}
+
+std::vector<uint8_t> BoolMessage(const std::string &address, bool value) {
+  std::vector<uint8_t> out;
+  AppendString(out, address.c_str());
+  AppendString(out, value ? ",T" : ",F");
+  return out;
+}
+
+void BootSolid() {
+  host_sim::ResetNvs();
+  Preferences prefs;
+  prefs.begin("lighting", false);
+  prefs.putInt("brightness", 0);
+  prefs.putInt("glow", 0);
+  prefs.end();
+  host_sim::ClearSchedule();
+  setup();
+  // Another case may have delivered values through the table already.
+  osc_parameters = OscParameters(kBindings, osc_parameter_state, kBindingCount);
+}
+
+// The sending end of the loopback, as VRChat on the same machine would be.
+class Sender {
+ public:
+  explicit Sender(uint16_t port) : socket_(socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP)) {
+    target_.sin_family = AF_INET;
+    target_.sin_port = htons(port);
+    target_.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    // The host's default receive buffer is smaller than the avatar-load
+    // flood; the device drains its socket as datagrams arrive instead.
+    const int buffer = 1 << 20;
+    setsockopt(osc_socket, SOL_SOCKET, SO_RCVBUF, &buffer, sizeof(buffer));
+  }
+  ~Sender() { close(socket_); }
+
+  void send(const uint8_t *data, std::size_t length) {
+    sendto(socket_, data, length, 0, reinterpret_cast<const sockaddr *>(&target_),
+           sizeof(target_));
+    datagrams_++;
+  }
+  void send(const std::vector<uint8_t> &datagram) { send(datagram.data(), datagram.size()); }
+
+  uint32_t datagrams() const { return datagrams_; }
+
+ private:
+  int socket_;
+  sockaddr_in target_{};
+  uint32_t datagrams_ = 0;
+};
+
+void CountMessage(const OscMessage &message, void *context) {
+  OscParameters *table = static_cast<OscParameters *>(context);
+  table->update(message);
+}
+
+bool AcceptParameter(uint8_t id, float value, void *context) { return true; }
+
+void BenchParser() {
+  OscParser parser;
+  OscParameterState state[kBindingCount];
+  OscParameters table(kBindings, state, kBindingCount);
+  bench::Stopwatch stopwatch;
+  stopwatch.start();
+  for (uint32_t pass = 0; pass < kParsePasses; ++pass) {
+    for (const osc_captures::Capture &capture : osc_captures::kAvatarLoad) {
+      parser.parse(capture.data, capture.length, CountMessage, &table);
+    }
+    table.flush(AcceptParameter, nullptr);
+  }
+  stopwatch.stop();
+
+  // A truncated argument, a bundle element running past the packet and an
+  // oversized blob.
+  std::vector<uint8_t> truncated(osc_captures::kLightHue,
+                                 osc_captures::kLightHue + sizeof(osc_captures::kLightHue) - 4);
+  std::vector<uint8_t> overrun(osc_captures::kNestedBundle,
+                               osc_captures::kNestedBundle + sizeof(osc_captures::kNestedBundle));
+  overrun[19] += 4;
+  // A blob declaring UINT32_MAX bytes: padded, its size would wrap on a 32-bit target.
+  constexpr uint8_t kHugeBlob[] = {'/', 'b', 0, 0, ',', 'b', 0, 0, 0xff, 0xff, 0xff, 0xff};
+  const bool rejected = !parser.parse(truncated.data(), truncated.size(), CountMessage, &table) &&
+                        !parser.parse(overrun.data(), overrun.size(), CountMessage, &table) &&
+                        !parser.parse(kHugeBlob, sizeof(kHugeBlob), CountMessage, &table);
+
+  const OscParser::Stats &stats = parser.stats();
+  const OscParameters::Stats &updates = table.stats();
+  bench::ReportOps("parse + update message", stopwatch.totalNs(), stats.messages);
+  std::printf("  %-28s %10u packets %6u bundles %6u messages %6u malformed%s\n", "",
+              static_cast<unsigned>(stats.packets), static_cast<unsigned>(stats.bundles),
+              static_cast<unsigned>(stats.messages), static_cast<unsigned>(stats.malformed),
+              rejected ? "" : "  ACCEPTED BAD PACKET");
+  std::printf("  %-28s %10u bound %6u unbound %6u delivered %6u unchanged\n", "",
+              static_cast<unsigned>(updates.matched), static_cast<unsigned>(updates.unmatched),
+              static_cast<unsigned>(updates.delivered), static_cast<unsigned>(updates.unchanged));
+}
+
+struct AppliedState {
+  EffectId effect;
+  uint32_t color;
+  bool dim;
+};
+
+AppliedState Applied() {
+  const EffectParams &params = effect_engine.params();
+  return AppliedState{effect_engine.effect(), params.color, params.level_max == kDimLevelMax};
+}
+
+void PrintState(const char *label, const AppliedState &state, const AppliedState &expected) {
+  const bool match = state.effect == expected.effect && state.color == expected.color &&
+                     state.dim == expected.dim;
+  std::printf("  %-28s %10s %s, %s, colour %06x%s\n", label, "",
+              EffectEngine::describe(state.effect).name, state.dim ? "dim" : "bright",
+              static_cast<unsigned>(state.color), match ? "" : "  WRONG");
+}
+
+void BenchReplay() {
+  BootSolid();
+  const uint16_t port = BeginOsc(0);
+  if (port == 0) {
+    std::printf("  %-28s no loopback UDP socket, skipped\n", "replay");
+    return;
+  }
+  Sender sender(port);
+  for (const osc_captures::Capture &capture : osc_captures::kAvatarLoad) {
+    sender.send(capture.data, capture.length);
+  }
+  host_sim::Schedule(host_sim::NowUs() + kUsPerMs, [] { ServiceOsc(); });
+  host_sim::RunTask("TaskRGB", 50 * kUsPerMs);
+
+  // Dim, rainbow, then the bundle's hue and LightNext on to theater chase.
+  const AppliedState expected{EffectId::kTheaterChase, color_tables::kWheel[64], true};
+  std::printf("  %-28s %10u datagrams, %u messages, %u events\n", "replay captures",
+              static_cast<unsigned>(sender.datagrams()),
+              static_cast<unsigned>(osc_parser.stats().messages),
+              static_cast<unsigned>(osc_parameters.stats().delivered));
+  PrintState("", Applied(), expected);
+}
+
+struct BurstResult {
+  uint64_t service_ns = 0;
+  uint32_t services = 0;
+  uint32_t retries = 0;
+};
+
+BurstResult burst;
+
+void Service() {
+  bench::Stopwatch stopwatch;
+  stopwatch.start();
+  const bool pending = ServiceOsc();
+  burst.service_ns += stopwatch.lap();
+  burst.services++;
+  if (pending) {
+    // As TaskOsc's select() timeout.
+    burst.retries++;
+    host_sim::Schedule(host_sim::NowUs() + kRetryUs, Service);
+  }
+}
+
+void BenchBurst(const bench::Options &options) {
+  BootSolid();
+  const uint16_t port = BeginOsc(0);
+  if (port == 0) {
+    std::printf("  %-28s no loopback UDP socket, skipped\n", "burst");
+    return;
+  }
+  burst = BurstResult{};
+  Sender sender(port);
+  const OscParser::Stats parsed_before = osc_parser.stats();
+  const OscParameters::Stats updates_before = osc_parameters.stats();
+  const std::string prefix = "/avatar/parameters/";
+
+  const uint64_t start = host_sim::NowUs();
+  const uint64_t duration = options.seconds * kUsPerSecond;
+  const uint32_t frames = static_cast<uint32_t>((duration - 100 * kUsPerMs) / kFramePeriodUs);
+  uint32_t toggles = 0;
+  uint32_t last_glow = 0;
+  float last_hue = 0.0f;
+  for (uint32_t frame = 0; frame < frames; ++frame) {
+    std::vector<std::vector<uint8_t>> datagrams;
+    if (frame == 0) {
+      // An avatar load sends every parameter at once.
+      for (uint32_t i = 0; i < kLoadParameters; ++i) {
+        datagrams.push_back(FloatMessage(prefix + "Param" + std::to_string(i), 0.0f));
+      }
+    }
+    for (uint32_t i = 0; i < kBusyParameters; ++i) {
+      datagrams.push_back(
+          FloatMessage(prefix + "Velocity" + std::to_string(i), static_cast<float>(frame % 50)));
+    }
+    // A hue slider dragged through, and the glow mode resent unchanged.
+    last_hue = static_cast<float>(frame % 360) / 360.0f;
+    last_glow = (frame / kGlowEveryFrames) % kGlowCount;
+    datagrams.push_back(FloatMessage(prefix + "LightHue", last_hue));
+    datagrams.push_back(IntMessage(prefix + "LightGlow", static_cast<int32_t>(last_glow)));
+    if (frame % kToggleEveryFrames == kToggleEveryFrames - 1) {
+      // Pressed and released within one frame.
+      datagrams.push_back(BoolMessage(prefix + "LightToggle", true));
+      datagrams.push_back(BoolMessage(prefix + "LightToggle", false));
+      toggles++;
+    }
+    host_sim::Schedule(start + frame * kFramePeriodUs, [&sender, datagrams] {
+      for (const std::vector<uint8_t> &datagram : datagrams) {
+        sender.send(datagram);
+      }
+      Service();
+    });
+  }
+  host_sim::RunTask("TaskRGB", duration);
+
+  const OscParameters::Stats &updates = osc_parameters.stats();
+  const uint32_t parsed = osc_parser.stats().messages - parsed_before.messages;
+  std::printf("  %-28s %10u datagrams %6u parsed %6u bound %6u events\n", "burst 90 Hz",
+              static_cast<unsigned>(sender.datagrams()), static_cast<unsigned>(parsed),
+              static_cast<unsigned>(updates.matched - updates_before.matched),
+              static_cast<unsigned>(updates.delivered - updates_before.delivered));
+  std::printf("  %-28s %10u coalesced %6u unchanged %6u queue full %u retries\n", "",
+              static_cast<unsigned>(updates.coalesced - updates_before.coalesced),
+              static_cast<unsigned>(updates.unchanged - updates_before.unchanged),
+              static_cast<unsigned>(updates.refused - updates_before.refused),
+              static_cast<unsigned>(burst.retries));
+  bench::ReportOps("service per datagram", burst.service_ns, sender.datagrams());
+  const AppliedState expected{kGlowEffects[last_glow],
+                              color_tables::kWheel[static_cast<uint8_t>(last_hue * 256.0f)],
+                              toggles % 2 == 1};
+  PrintState("", Applied(), expected);
+}
+
+}  // namespace
+
+BENCH_CASE(osc) {
+  BenchParser();
+  BenchReplay();
+  BenchBurst(options);
+}
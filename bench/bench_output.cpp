@@ -0,0 +1,80 @@
+// Frame rate with blocking and asynchronous strip output, for strip lengths
+// from 22 to 1000 pixels. The renderer is modelled as a fixed simulated cost
+// per pixel followed by PixelOutput::commit(), run back to back: a blocking
+// transmitter adds the wire time to every frame, an asynchronous one only
+// makes commit() wait when rendering outruns the strip. RmtTransmitter runs
+// against the host RMT stand-in; the mock also checks that no frame buffer
+// was rewritten while it was being sent.
+
+#include <Adafruit_NeoPixel.h>
+
+#include <cstdio>
+#include <vector>
+
+#include "bench.h"
+#include "color_tables.h"
+#include "host_sim.h"
+#include "mock_transmitter.h"
+#include "pixel_output.h"
+#include "rmt_transmitter.h"
+
+namespace {
+
+constexpr uint16_t kLengths[] = {22, 60, 144, 300, 600, 1000};
+// Modelled render cost: a cheap effect, and one as slow as the wire.
+constexpr uint32_t kRenderNsPerPixel[] = {2000, 30000};
+constexpr uint32_t kFrames = 500;
+
+struct Result {
+  double frames_per_second;
+  double blocked_percent;
+  uint32_t waits;
+};
+
+Result Run(StripTransmitter &transmitter, uint16_t length, uint32_t render_ns_per_pixel) {
+  std::vector<uint32_t> frame(length);
+  std::vector<uint8_t> wire(PixelOutput::WireBytes(length));
+  PixelOutput output(transmitter, NEO_GRB + NEO_KHZ800, frame.data(), wire.data(), length);
+  output.begin();
+  transmitter.wait();
+
+  const uint64_t render_us = static_cast<uint64_t>(length) * render_ns_per_pixel / 1000;
+  const uint64_t start = host_sim::NowUs();
+  uint64_t blocked_us = 0;
+  for (uint32_t n = 0; n < kFrames; ++n) {
+    for (uint16_t i = 0; i < length; ++i) {
+      frame[i] = color_tables::kWheel[static_cast<uint8_t>(i + n)];
+    }
+    host_sim::AdvanceBy(render_us);
+    const uint64_t commit_start = host_sim::NowUs();
+    output.commit();
+    blocked_us += host_sim::NowUs() - commit_start;
+  }
+  transmitter.wait();
+  const double elapsed_us = static_cast<double>(host_sim::NowUs() - start);
+  return Result{kFrames * 1e6 / elapsed_us, 100.0 * blocked_us / elapsed_us,
+                output.stats().transmit_waits};
+}
+
+}  // namespace
+
+BENCH_CASE(output) {
+  for (uint32_t render_ns : kRenderNsPerPixel) {
+    std::printf("  render %.1f us/px:\n", render_ns / 1000.0);
+    for (uint16_t length : kLengths) {
+      MockTransmitter blocking(true);
+      MockTransmitter async(false);
+      RmtTransmitter rmt(0);
+      const Result blocked = Run(blocking, length, render_ns);
+      const Result overlapped = Run(async, length, render_ns);
+      const Result hardware = Run(rmt, length, render_ns);
+      std::printf("  %5u px  blocking %7.1f frames/s (%4.1f%% blocked)  async %7.1f frames/s "
+                  "(%4.1f%% blocked, %u waits, %u torn)  rmt %7.1f frames/s  x%.2f\n",
+                  length, blocked.frames_per_second, blocked.blocked_percent,
+                  overlapped.frames_per_second, overlapped.blocked_percent, overlapped.waits,
+                  async.stats().torn_frames + async.stats().overlapping_starts,
+                  hardware.frames_per_second,
+                  overlapped.frames_per_second / blocked.frames_per_second);
+    }
+  }
+}
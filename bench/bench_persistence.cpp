@@ -0,0 +1,162 @@
+// NVS writes under a burst of toggles: the old synchronous putInt() per
+// change versus the write-behind SettingsStore, against the counting
+// Preferences stand-in; and a commit NVS refuses being retried.
+
+#include <Preferences.h>
+
+#include <cstdio>
+
+#include "bench.h"
+#include "host_sim.h"
+#include "settings_store.h"
+
+namespace {
+
+constexpr uint32_t kIdleWindowMs = 2000;
+constexpr uint32_t kToggleIntervalMs = 150;
+constexpr uint32_t kBurstToggles = 41;
+constexpr uint32_t kBursts = 5;
+constexpr uint32_t kBurstGapMs = 10000;
+
+struct Change {
+  uint32_t at_ms;
+  LightingSettings settings;
+};
+
+// Alternating bursts of bright/dim clicks and glow-mode long presses.
+template <typename Fn>
+void ForEachChange(Fn fn) {
+  LightingSettings settings{0, 0};
+  uint32_t t = 0;
+  for (uint32_t burst = 0; burst < kBursts; ++burst) {
+    for (uint32_t i = 0; i < kBurstToggles; ++i) {
+      if (burst % 2 == 0) {
+        settings.brightness ^= 1;
+      } else {
+        settings.glow = static_cast<uint8_t>((settings.glow + 1) % 5);
+      }
+      fn(Change{t, settings}, burst % 2 == 0);
+      t += kToggleIntervalMs;
+    }
+    t += kBurstGapMs;
+  }
+}
+
+void RunLegacy() {
+  host_sim::ResetNvs();
+  Preferences prefs;
+  prefs.begin("lighting", false);
+  bench::Stopwatch stopwatch;
+  uint32_t changes = 0;
+  ForEachChange([&](const Change &change, bool brightness_changed) {
+    stopwatch.start();
+    if (brightness_changed) {
+      prefs.putInt("brightness", change.settings.brightness);
+    } else {
+      prefs.putInt("glow", change.settings.glow);
+    }
+    stopwatch.stop();
+    changes++;
+  });
+  std::printf("  %-28s %6u changes %6llu NVS writes %6llu bytes\n", "before: putInt per change",
+              changes, static_cast<unsigned long long>(host_sim::NvsWriteCount()),
+              static_cast<unsigned long long>(host_sim::NvsBytesWritten()));
+  bench::ReportOps("  render-path cost", stopwatch.totalNs(), changes);
+}
+
+void RunWriteBehind() {
+  host_sim::ResetNvs();
+  Preferences prefs;
+  prefs.begin("lighting", false);
+  SettingsStore store(prefs, kIdleWindowMs);
+  LightingSettings boot{0, 0};
+  store.load(boot);
+
+  // Replays the changes in time order, servicing the store at the deadlines
+  // it hands back exactly as TaskPersist would.
+  bench::Stopwatch stopwatch;
+  uint32_t changes = 0;
+  uint32_t persist_wakeups = 0;
+  uint32_t now = 0;
+  uint32_t service_at = SettingsStore::kNoDeadline;
+  auto service_until = [&](uint32_t until) {
+    while (service_at != SettingsStore::kNoDeadline && service_at <= until) {
+      now = service_at;
+      LightingSettings snapshot;
+      uint32_t wait_ms = SettingsStore::kNoDeadline;
+      persist_wakeups++;
+      if (store.takePending(now, snapshot, wait_ms) && !store.commit(snapshot)) {
+        store.restore(snapshot, now);
+        wait_ms = kIdleWindowMs;
+      }
+      service_at = wait_ms == SettingsStore::kNoDeadline ? wait_ms : now + wait_ms;
+    }
+  };
+  ForEachChange([&](const Change &change, bool) {
+    service_until(change.at_ms);
+    now = change.at_ms;
+    stopwatch.start();
+    store.update(change.settings, now);
+    stopwatch.stop();
+    changes++;
+    service_at = now;
+  });
+  service_until(SettingsStore::kNoDeadline - 1);
+
+  LightingSettings reloaded{0xff, 0xff};
+  SettingsStore verify(prefs, kIdleWindowMs);
+  const bool ok = verify.load(reloaded);
+  std::printf("  %-28s %6u changes %6llu NVS writes %6llu bytes (%u persist wakeups)\n",
+              "after: write-behind blob", changes,
+              static_cast<unsigned long long>(host_sim::NvsWriteCount()),
+              static_cast<unsigned long long>(host_sim::NvsBytesWritten()), persist_wakeups);
+  std::printf("  %-28s reload %s: brightness=%u glow=%u, commits=%u skipped=%u\n", "",
+              ok ? "ok" : "FAILED", reloaded.brightness, reloaded.glow, store.stats().commits,
+              store.stats().skipped_commits);
+  bench::ReportOps("  render-path cost", stopwatch.totalNs(), changes);
+}
+
+// One change whose first commit NVS refuses: it stays pending and lands on
+// the retry an idle window later.
+void RunFailedCommit() {
+  host_sim::ResetNvs();
+  Preferences prefs;
+  prefs.begin("lighting", false);
+  SettingsStore store(prefs, kIdleWindowMs);
+  const LightingSettings changed{1, 3};
+  store.update(changed, 0);
+  host_sim::FailNvsWrites(1);
+
+  uint32_t now = 0;
+  uint32_t wait_ms = 0;
+  uint32_t attempts = 0;
+  while (wait_ms != SettingsStore::kNoDeadline) {
+    now += wait_ms;
+    LightingSettings snapshot;
+    if (store.takePending(now, snapshot, wait_ms)) {
+      attempts++;
+      if (!store.commit(snapshot)) {
+        store.restore(snapshot, now);
+        wait_ms = kIdleWindowMs;
+      }
+    }
+  }
+
+  LightingSettings reloaded{0xff, 0xff};
+  SettingsStore verify(prefs, kIdleWindowMs);
+  const bool ok = verify.load(reloaded) && reloaded.brightness == changed.brightness &&
+                  reloaded.glow == changed.glow;
+  std::printf("  %-28s %u attempts, %u failed, stored at %u ms: %s\n", "first commit refused",
+              attempts, store.stats().failed_commits, now, ok ? "ok" : "FAIL not stored");
+  if (!ok) {
+    bench::Fail();
+  }
+}
+
+}  // namespace
+
+BENCH_CASE(persistence) {
+  RunLegacy();
+  RunWriteBehind();
+  RunFailedCommit();
+}
@@ -0,0 +1,173 @@
+// Throughput of the SWAR pixel kernels against a per-channel float
+// reference, and the cost of one crossfade frame in the effect engine, for
+// strip lengths from 22 to 1000 pixels.
+
+#include <Arduino.h>
+#include <Adafruit_NeoPixel.h>
+
+#include <cstdio>
+#include <vector>
+
+#include "bench.h"
+#include "effect_engine.h"
+#include "host_sim.h"
+#include "pixel_ops.h"
+#include "pixel_output.h"
+
+namespace {
+
+constexpr uint16_t kLengths[] = {22, 60, 144, 300, 600, 1000};
+constexpr uint32_t kPixelsPerRun = 4000000;
+constexpr uint16_t kHalfWeight = 128;
+
+uint8_t Channel(uint32_t c, int shift) { return static_cast<uint8_t>((c >> shift) & 0xff); }
+
+uint32_t FloatMix(uint32_t a, float wa, uint32_t b, float wb) {
+  uint32_t out = 0;
+  for (int shift = 0; shift <= 16; shift += 8) {
+    const float v = Channel(a, shift) * wa + Channel(b, shift) * wb;
+    out |= static_cast<uint32_t>(v > 255.0f ? 255.0f : v) << shift;
+  }
+  return out;
+}
+
+uint32_t FloatAdd(uint32_t a, uint32_t b) {
+  uint32_t out = 0;
+  for (int shift = 0; shift <= 16; shift += 8) {
+    const float v = static_cast<float>(Channel(a, shift)) + Channel(b, shift);
+    out |= static_cast<uint32_t>(v > 255.0f ? 255.0f : v) << shift;
+  }
+  return out;
+}
+
+uint32_t FloatMax(uint32_t a, uint32_t b) {
+  uint32_t out = 0;
+  for (int shift = 0; shift <= 16; shift += 8) {
+    const float x = Channel(a, shift);
+    const float y = Channel(b, shift);
+    out |= static_cast<uint32_t>(x > y ? x : y) << shift;
+  }
+  return out;
+}
+
+// Runs |fn| over |length| pixels enough times for a stable figure and
+// returns ns per frame.
+template <typename Fn>
+double TimeFrames(uint16_t length, Fn fn) {
+  const uint32_t frames = kPixelsPerRun / length;
+  bench::Stopwatch stopwatch;
+  stopwatch.start();
+  for (uint32_t i = 0; i < frames; ++i) {
+    fn();
+  }
+  stopwatch.stop();
+  return static_cast<double>(stopwatch.totalNs()) / frames;
+}
+
+void PrintRow(const char *kernel, uint16_t length, double swar_ns, double float_ns) {
+  std::printf("  %-8s %5u px %9.0f ns/frame %7.1f Mpx/s   float %9.0f ns/frame  x%.1f\n", kernel,
+              length, swar_ns, length * 1000.0 / swar_ns, float_ns, float_ns / swar_ns);
+}
+
+double CrossfadeFrameNs(uint16_t length) {
+  Adafruit_NeoPixel strip(length, 0, NEO_GRB + NEO_KHZ800);
+  NeoPixelTransmitter transmitter(strip);
+  std::vector<uint32_t> frame(length);
+  std::vector<uint8_t> wire(PixelOutput::WireBytes(length));
+  std::vector<uint32_t> transition(2 * length);
+  PixelOutput output(transmitter, NEO_GRB + NEO_KHZ800, frame.data(), wire.data(), length);
+  EffectEngine engine(output, transition.data());
+  EffectParams params{};
+  params.color = Adafruit_NeoPixel::Color(200, 200, 200);
+  params.step_ms = 8;
+  params.level = 150;
+  engine.start(EffectId::kRainbow, params);
+  engine.render();
+
+  // Every frame of a long fade: both effects step and are mixed.
+  params.step_ms = 10;
+  engine.crossfadeTo(EffectId::kTheaterChaseRainbow, params, UINT16_MAX);
+  bench::Stopwatch stopwatch;
+  uint32_t frames = 0;
+  for (uint32_t i = 0; i < 2000; ++i) {
+    host_sim::AdvanceBy(10 * 1000);
+    stopwatch.start();
+    engine.render();
+    stopwatch.stop();
+    frames++;
+  }
+  return static_cast<double>(stopwatch.totalNs()) / frames;
+}
+
+}  // namespace
+
+BENCH_CASE(pixel_ops) {
+  for (uint16_t length : kLengths) {
+    std::vector<uint32_t> a(length);
+    std::vector<uint32_t> b(length);
+    std::vector<uint32_t> dst(length);
+    for (uint16_t i = 0; i < length; ++i) {
+      a[i] = (i * 0x9e3779b1u) & 0x00ffffff;
+      b[i] = (i * 0x85ebca77u + 0x1234u) & 0x00ffffff;
+    }
+
+    const double blend = TimeFrames(length, [&] {
+      pixel_ops::Blend(dst.data(), a.data(), b.data(), length, kHalfWeight);
+      bench::DoNotOptimize(dst[0]);
+    });
+    const double blend_float = TimeFrames(length, [&] {
+      for (uint16_t i = 0; i < length; ++i) {
+        dst[i] = FloatMix(a[i], 0.5f, b[i], 0.5f);
+      }
+      bench::DoNotOptimize(dst[0]);
+    });
+    PrintRow("blend", length, blend, blend_float);
+
+    const double scale = TimeFrames(length, [&] {
+      dst = a;
+      pixel_ops::Scale(dst.data(), length, 100);
+      bench::DoNotOptimize(dst[0]);
+    });
+    const double scale_float = TimeFrames(length, [&] {
+      dst = a;
+      for (uint16_t i = 0; i < length; ++i) {
+        dst[i] = FloatMix(dst[i], 100 / 256.0f, 0, 0.0f);
+      }
+      bench::DoNotOptimize(dst[0]);
+    });
+    PrintRow("scale", length, scale, scale_float);
+
+    const double add = TimeFrames(length, [&] {
+      dst = a;
+      pixel_ops::Add(dst.data(), b.data(), length);
+      bench::DoNotOptimize(dst[0]);
+    });
+    const double add_float = TimeFrames(length, [&] {
+      dst = a;
+      for (uint16_t i = 0; i < length; ++i) {
+        dst[i] = FloatAdd(dst[i], b[i]);
+      }
+      bench::DoNotOptimize(dst[0]);
+    });
+    PrintRow("add", length, add, add_float);
+
+    const double max = TimeFrames(length, [&] {
+      dst = a;
+      pixel_ops::Max(dst.data(), b.data(), length);
+      bench::DoNotOptimize(dst[0]);
+    });
+    const double max_float = TimeFrames(length, [&] {
+      dst = a;
+      for (uint16_t i = 0; i < length; ++i) {
+        dst[i] = FloatMax(dst[i], b[i]);
+      }
+      bench::DoNotOptimize(dst[0]);
+    });
+    PrintRow("max", length, max, max_float);
+  }
+
+  std::printf("  crossfade frame (rainbow -> theatre chase rainbow, render + mix + commit):\n");
+  for (uint16_t length : kLengths) {
+    std::printf("  %14u px %9.0f ns/frame\n", length, CrossfadeFrameNs(length));
+  }
+}
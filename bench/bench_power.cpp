@@ -0,0 +1,160 @@
+// Power limiting: host ns per pixel of PixelOutput::commit() without a
+// power model and with one (the estimate every frame, under budget so
+// nothing is dimmed), at 22 to 4000 px. Then white at full brightness on
+// strips of 22 to 600 px: the estimate before and after limiting and the
+// current of the bytes actually sent, which must stay within the budget.
+// Last, 144 px of white faded up through every intensity: the current must
+// never fall and never rise faster than it would unlimited, so the limiter
+// engages without a step. Either failing fails the run.
+
+#include <Adafruit_NeoPixel.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <vector>
+
+#include "bench.h"
+#include "color_tables.h"
+#include "pixel_output.h"
+
+namespace {
+
+constexpr uint16_t kLengths[] = {22, 144, 300, 1000, 4000};
+constexpr uint16_t kLimitLengths[] = {22, 60, 144, 300, 600};
+constexpr uint16_t kFadeLength = 144;
+constexpr uint32_t kBatchFrames = 50;
+// Host time per measurement.
+constexpr uint64_t kTargetNs = 20 * 1000 * 1000;
+// The firmware's model (kStripPower in main.cpp).
+constexpr PixelOutput::PowerModel kModel{20, 20, 20, 1000, 1000};
+// The same with a budget no frame here reaches, to time the estimate alone.
+constexpr PixelOutput::PowerModel kUnlimited{20, 20, 20, 1000, UINT16_MAX};
+constexpr uint32_t kWhite = 0x00ffffff;
+
+// Completes every frame at once, so only the CPU side is timed, and keeps
+// the current of the last frame from its bytes under kModel.
+class NullTransmitter final : public StripTransmitter {
+ public:
+  void begin() override {}
+  void transmit(const uint8_t *data, std::size_t length) override {
+    uint32_t sum = 0;
+    for (std::size_t i = 0; i < length; ++i) {
+      sum += data[i];
+    }
+    sent_ma_ = (static_cast<double>(sum) * kModel.red_ma / 255 +
+                static_cast<double>(length / PixelOutput::kBytesPerPixel) * kModel.idle_ua / 1000);
+  }
+  bool busy() override { return false; }
+  void wait() override {}
+
+  double sentMa() const { return sent_ma_; }
+
+ private:
+  double sent_ma_ = 0;
+};
+
+// The fastest batch of host ns per pixel for commit() of a rainbow that
+// moves every frame, so each one is scaled, encoded and sent.
+double CommitNsPerPixel(uint16_t length, const PixelOutput::PowerModel *model) {
+  std::vector<uint32_t> frame(length);
+  std::vector<uint8_t> wire(PixelOutput::WireBytes(length));
+  NullTransmitter transmitter;
+  PixelOutput output(transmitter, NEO_GRB + NEO_KHZ800, frame.data(), wire.data(), length);
+  if (model != nullptr) {
+    output.setPowerModel(*model);
+  }
+  output.begin();
+
+  uint64_t spent_ns = 0;
+  uint32_t offset = 0;
+  double best = 0;
+  while (spent_ns < kTargetNs) {
+    bench::Stopwatch stopwatch;
+    stopwatch.start();
+    for (uint32_t i = 0; i < kBatchFrames; ++i, ++offset) {
+      output.fill(color_tables::kWheel[static_cast<uint8_t>(offset)]);
+      output.setPixel(0, color_tables::kWheel[static_cast<uint8_t>(offset + 128)]);
+      output.commit();
+    }
+    stopwatch.stop();
+    spent_ns += stopwatch.totalNs();
+    const double ns = static_cast<double>(stopwatch.totalNs()) / kBatchFrames / length;
+    best = (best == 0 || ns < best) ? ns : best;
+  }
+  return best;
+}
+
+struct WhiteStrip {
+  explicit WhiteStrip(uint16_t length)
+      : frame(length), wire(PixelOutput::WireBytes(length)),
+        output(transmitter, NEO_GRB + NEO_KHZ800, frame.data(), wire.data(), length) {
+    output.setPowerModel(kModel);
+    output.fill(kWhite);
+  }
+  std::vector<uint32_t> frame;
+  std::vector<uint8_t> wire;
+  NullTransmitter transmitter;
+  PixelOutput output;
+};
+
+}  // namespace
+
+BENCH_CASE(power) {
+  std::printf("  %-14s %6s %10s %10s %7s\n", "host ns/px", "px", "no model", "estimate", "x");
+  for (uint16_t length : kLengths) {
+    const double off = CommitNsPerPixel(length, nullptr);
+    const double on = CommitNsPerPixel(length, &kUnlimited);
+    std::printf("  %-14s %6u %10.2f %10.2f %6.2fx\n", "commit", static_cast<unsigned>(length), off,
+                on, on / off);
+  }
+
+  std::printf("  white at full brightness, %u mA budget:\n", kModel.budget_ma);
+  std::printf("  %6s %10s %10s %10s %8s\n", "px", "wanted mA", "drawn mA", "sent mA", "frames");
+  for (uint16_t length : kLimitLengths) {
+    WhiteStrip strip(length);
+    strip.output.begin();
+    const double sent = strip.transmitter.sentMa();
+    const bool ok = sent <= kModel.budget_ma;
+    std::printf("  %6u %10u %10u %10.1f %8s%s\n", static_cast<unsigned>(length),
+                static_cast<unsigned>(strip.output.wantedMa()),
+                static_cast<unsigned>(strip.output.drawnMa()), sent,
+                strip.output.stats().frames_limited ? "limited" : "-", ok ? "" : "  FAIL");
+    if (!ok) {
+      bench::Fail();
+    }
+  }
+
+  // Unlimited, each intensity step adds the same current; limited, the
+  // current sent must rise by no more than that and never fall.
+  WhiteStrip strip(kFadeLength);
+  strip.output.begin();
+  strip.output.resetStats();
+  double previous = 0;
+  double worst_rise = 0;
+  double worst_fall = 0;
+  int knee = -1;
+  for (int intensity = 0; intensity <= 255; ++intensity) {
+    strip.output.setIntensity(static_cast<uint8_t>(intensity));
+    strip.output.invalidate();
+    strip.output.commit();
+    const double sent = strip.transmitter.sentMa();
+    if (intensity > 0) {
+      worst_rise = std::max(worst_rise, sent - previous);
+      worst_fall = std::max(worst_fall, previous - sent);
+    }
+    if (knee < 0 && strip.output.stats().frames_limited != 0) {
+      knee = intensity;
+    }
+    previous = sent;
+  }
+  // Every pixel's channels move together, so the current moves in steps of
+  // one output value on all of them: what one intensity step adds unlimited.
+  const double unit_ma = kFadeLength * 3.0 * kModel.red_ma / 255;
+  const bool smooth = worst_fall == 0 && worst_rise <= unit_ma + 1e-9;
+  std::printf("  fade %u px: limiting from intensity %d, ends at %.1f mA; largest rise %.1f mA, "
+              "largest fall %.1f mA%s\n",
+              kFadeLength, knee, previous, worst_rise, worst_fall, smooth ? "" : "  FAIL");
+  if (!smooth) {
+    bench::Fail();
+  }
+}
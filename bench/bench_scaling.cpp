@@ -0,0 +1,193 @@
+// Long strips: frame cost of every effect from 22 to 4000 pixels (render
+// plus PixelOutput's encode, with the transmitter taking no time), the
+// wire-limited frame rate on one and two RMT channels through a
+// SegmentedTransmitter, and the pixel count at which 60 fps stops being
+// achievable on each.
+
+#include <Adafruit_NeoPixel.h>
+
+#include <cstdio>
+#include <vector>
+
+#include "bench.h"
+#include "effect_engine.h"
+#include "host_sim.h"
+#include "pixel_output.h"
+#include "rmt_transmitter.h"
+#include "segmented_transmitter.h"
+
+namespace {
+
+constexpr uint16_t kLengths[] = {22, 144, 300, 600, 1000, 2000, 4000};
+constexpr std::size_t kLengthCount = sizeof(kLengths) / sizeof(kLengths[0]);
+constexpr double kFrameBudgetUs = 1e6 / 60;
+constexpr uint32_t kBatchFrames = 50;
+// Host time per length and effect.
+constexpr uint64_t kTargetNs = 20 * 1000 * 1000;
+// Upper end of the search for the 60 fps limit.
+constexpr uint16_t kSearchLimit = 16000;
+
+// Completes every frame at once, so only the CPU side is timed.
+class NullTransmitter final : public StripTransmitter {
+ public:
+  void begin() override {}
+  void transmit(const uint8_t *data, std::size_t length) override {
+    bench::DoNotOptimize(data[length - 1]);
+  }
+  bool busy() override { return false; }
+  void wait() override {}
+};
+
+// Host ns per frame of |effect| at |length| pixels: a fresh step every
+// frame, rendered and committed through the engine.
+double FrameNs(EffectId effect, uint16_t length) {
+  std::vector<uint32_t> frame(length);
+  std::vector<uint8_t> wire(PixelOutput::WireBytes(length));
+  NullTransmitter transmitter;
+  PixelOutput output(transmitter, NEO_GRB + NEO_KHZ800, frame.data(), wire.data(), length);
+  EffectEngine engine(output);
+  output.begin();
+  EffectParams params{};
+  params.color = Adafruit_NeoPixel::Color(200, 200, 200);
+  params.step_ms = 1;
+  params.level = 255;
+  params.level_min = 20;
+  params.level_max = 150;
+  params.phase_step = 256;
+  engine.start(effect, params);
+
+  // The fastest batch, so other load on the host does not show up.
+  uint64_t spent_ns = 0;
+  double best = 0;
+  while (spent_ns < kTargetNs) {
+    bench::Stopwatch stopwatch;
+    for (uint32_t i = 0; i < kBatchFrames; ++i) {
+      host_sim::AdvanceBy(1000);
+      // A wipe that has finished would stop drawing; start it over.
+      if (engine.complete()) {
+        engine.start(effect, params);
+      }
+      stopwatch.start();
+      engine.render();
+      stopwatch.stop();
+    }
+    spent_ns += stopwatch.totalNs();
+    const double ns = static_cast<double>(stopwatch.totalNs()) / kBatchFrames;
+    best = (best == 0 || ns < best) ? ns : best;
+  }
+  return best;
+}
+
+// Simulated time from the start of one frame on the wire to the next being
+// able to start, with |length| pixels split evenly over |channels| RMT
+// channels, the second half of each pair of segments folded back.
+double WireUs(uint16_t length, uint8_t channels) {
+  std::vector<uint8_t> data(3u * length, 0x55);
+  RmtTransmitter rmt[] = {RmtTransmitter(0, RMT_CHANNEL_0), RmtTransmitter(1, RMT_CHANNEL_1)};
+  std::vector<std::vector<uint8_t>> staging(channels);
+  StripChannel outputs[2];
+  StripSegment segments[2];
+  uint16_t first = 0;
+  for (uint8_t c = 0; c < channels; ++c) {
+    const uint16_t count = static_cast<uint16_t>((length - first) / (channels - c));
+    const bool reversed = c % 2 == 1;
+    staging[c].resize(3u * count);
+    outputs[c] = StripChannel{&rmt[c], count, reversed ? staging[c].data() : nullptr};
+    segments[c] = StripSegment{first, count, c, 0, reversed};
+    first = static_cast<uint16_t>(first + count);
+  }
+  SegmentedTransmitter transmitter(outputs, channels, segments, channels);
+  transmitter.begin();
+  const uint64_t start = host_sim::NowUs();
+  transmitter.transmit(data.data(), data.size());
+  transmitter.wait();
+  return static_cast<double>(host_sim::NowUs() - start);
+}
+
+// Largest length whose wire time fits a 60 fps frame.
+uint16_t WireLimit(uint8_t channels) {
+  uint16_t low = 1;
+  uint16_t high = kSearchLimit;
+  while (low < high) {
+    const uint16_t mid = static_cast<uint16_t>((low + high + 1) / 2);
+    if (WireUs(mid, channels) <= kFrameBudgetUs) {
+      low = mid;
+    } else {
+      high = static_cast<uint16_t>(mid - 1);
+    }
+  }
+  return low;
+}
+
+// Gather cost: two channels, one reversed, against sending both halves
+// straight out of the wire buffer.
+double GatherNs(uint16_t length, bool reversed) {
+  std::vector<uint8_t> data(3u * length, 0x55);
+  NullTransmitter channels[2];
+  const uint16_t half = length / 2;
+  std::vector<uint8_t> staging(3u * (length - half));
+  const StripChannel outputs[] = {
+      {&channels[0], half, nullptr},
+      {&channels[1], static_cast<uint16_t>(length - half), reversed ? staging.data() : nullptr},
+  };
+  const StripSegment segments[] = {
+      {0, half, 0, 0, false},
+      {half, static_cast<uint16_t>(length - half), 1, 0, reversed},
+  };
+  SegmentedTransmitter transmitter(outputs, 2, segments, 2);
+  constexpr uint32_t kPasses = 2000;
+  bench::Stopwatch stopwatch;
+  stopwatch.start();
+  for (uint32_t i = 0; i < kPasses; ++i) {
+    transmitter.transmit(data.data(), data.size());
+    bench::DoNotOptimize(staging.data());
+  }
+  stopwatch.stop();
+  return static_cast<double>(stopwatch.totalNs()) / kPasses;
+}
+
+}  // namespace
+
+BENCH_CASE(scaling) {
+  const uint16_t one_channel = WireLimit(1);
+  const uint16_t two_channels = WireLimit(2);
+  // Warms the caches and clock up so the first row is not penalised.
+  FrameNs(EffectId::kSolid, kLengths[kLengthCount - 1]);
+
+  std::printf("  %-22s", "host ns/frame");
+  for (uint16_t length : kLengths) {
+    std::printf(" %8u", static_cast<unsigned>(length));
+  }
+  std::printf(" %8s %9s %9s\n", "ns/px", "60fps 1ch", "60fps 2ch");
+  for (const EffectDescriptor &effect : BuiltinEffects::kDescriptors) {
+    if (effect.id == EffectId::kStream) {
+      continue;
+    }
+    std::printf("  %-22s", effect.name);
+    double ns = 0;
+    for (uint16_t length : kLengths) {
+      ns = FrameNs(effect.id, length);
+      std::printf(" %8.0f", ns);
+    }
+    // Rendering overlaps the previous frame on the wire, so a frame takes
+    // the longer of the two; on the host that is always the wire.
+    const double ns_per_pixel = ns / kLengths[kLengthCount - 1];
+    const double render_limit = kFrameBudgetUs * 1000 / ns_per_pixel;
+    std::printf(" %8.2f %9.0f %9.0f\n", ns_per_pixel,
+                render_limit < one_channel ? render_limit : one_channel,
+                render_limit < two_channels ? render_limit : two_channels);
+  }
+
+  std::printf("  %-22s", "wire us/frame, 1 ch");
+  for (uint16_t length : kLengths) {
+    std::printf(" %8.0f", WireUs(length, 1));
+  }
+  std::printf("\n  %-22s", "wire us/frame, 2 ch");
+  for (uint16_t length : kLengths) {
+    std::printf(" %8.0f", WireUs(length, 2));
+  }
+  std::printf("\n  60 fps stops at %u px on one channel and %u px on two (WS2812 wire time)\n",
+              static_cast<unsigned>(one_channel) + 1, static_cast<unsigned>(two_channels) + 1);
+  std::printf("  %-22s %8.0f ns direct %8.0f ns with one half reversed (4000 px)\n",
+              "segment gather", GatherNs(4000, false), GatherNs(4000, true));
+}
@@ -0,0 +1,119 @@
+// Sequence interpreter cost per update() for a light show using every
+// opcode, the same show loaded back from an NVS blob, and a runaway program
+// that never waits (bounded by the per-update instruction budget).
+
+#include <Arduino.h>
+#include <Adafruit_NeoPixel.h>
+#include <Preferences.h>
+
+#include <cstdio>
+
+#include "bench.h"
+#include "effect_engine.h"
+#include "host_sim.h"
+#include "pixel_output.h"
+#include "sequence.h"
+
+namespace {
+
+constexpr uint16_t kBenchPixels = 22;
+constexpr uint64_t kUsPerMs = 1000;
+constexpr uint64_t kUsPerSecond = 1000000;
+
+constexpr uint8_t EffectByte(EffectId id) { return static_cast<uint8_t>(id); }
+
+constexpr uint8_t kShow[] = {
+    SEQUENCE_HEADER,
+    sequence_op::kBrightness, 0,
+    sequence_op::kSpeed, SEQUENCE_U16(20),
+    sequence_op::kLoop, 3,
+    sequence_op::kColor, 255, 40, 0,
+    sequence_op::kEffect, EffectByte(EffectId::kColorWipe),
+    sequence_op::kFade, 200, SEQUENCE_U16(400),
+    sequence_op::kWaitDone, SEQUENCE_U16(1500),
+    sequence_op::kColor, 0, 40, 255,
+    sequence_op::kEffect, EffectByte(EffectId::kTheaterChase),
+    sequence_op::kWait, SEQUENCE_U16(800),
+    sequence_op::kEndLoop,
+    sequence_op::kFlags, kEffectFlagGamma,
+    sequence_op::kSpeed, SEQUENCE_U16(8),
+    sequence_op::kEffect, EffectByte(EffectId::kRainbow),
+    sequence_op::kWait, SEQUENCE_U16(3000),
+    sequence_op::kFade, 0, SEQUENCE_U16(1000),
+    sequence_op::kWait, SEQUENCE_U16(1000),
+    sequence_op::kFlags, 0,
+    sequence_op::kJump, SEQUENCE_U16(0),
+};
+
+constexpr uint8_t kRunaway[] = {
+    SEQUENCE_HEADER,
+    sequence_op::kLoop, 255,
+    sequence_op::kColor, 1, 2, 3,
+    sequence_op::kEndLoop,
+    sequence_op::kJump, SEQUENCE_U16(0),
+};
+
+constexpr uint8_t kMalformed[] = {
+    SEQUENCE_HEADER,
+    sequence_op::kLoop, 2,
+    sequence_op::kJump, SEQUENCE_U16(0),
+    sequence_op::kEndLoop,
+};
+
+void RunShow(const char *label, const uint8_t *sequence, std::size_t length,
+             const bench::Options &options) {
+  Adafruit_NeoPixel strip(kBenchPixels, 0, NEO_GRB + NEO_KHZ800);
+  NeoPixelTransmitter transmitter(strip);
+  uint32_t frame[kBenchPixels];
+  uint8_t wire[PixelOutput::WireBytes(kBenchPixels)];
+  PixelOutput output(transmitter, NEO_GRB + NEO_KHZ800, frame, wire, kBenchPixels);
+  EffectEngine engine(output);
+  SequencePlayer player(engine);
+  if (!player.load(sequence, length)) {
+    std::printf("  %-28s failed to validate\n", label);
+    return;
+  }
+
+  bench::Stopwatch stopwatch;
+  const uint64_t end = host_sim::NowUs() + options.seconds * kUsPerSecond;
+  player.start(millis());
+  while (host_sim::NowUs() < end) {
+    stopwatch.start();
+    const uint32_t sequence_delay = player.update(millis());
+    stopwatch.stop();
+    const uint32_t frame_delay = engine.render();
+    uint32_t delay_ms = sequence_delay < frame_delay ? sequence_delay : frame_delay;
+    if (delay_ms == 0) {
+      delay_ms = 1;
+    }
+    if (delay_ms == SequencePlayer::kNoDeadline) {
+      break;
+    }
+    host_sim::AdvanceBy(delay_ms * kUsPerMs);
+  }
+
+  const SequencePlayer::Stats &stats = player.stats();
+  bench::ReportOps(label, stopwatch.totalNs(), stats.updates);
+  std::printf("  %-28s %6.1f updates/s, %.2f instructions/update (max %u), %u frames sent\n", "",
+              stats.updates / static_cast<double>(options.seconds),
+              stats.updates ? static_cast<double>(stats.instructions) / stats.updates : 0.0,
+              stats.max_instructions_per_update, output.stats().frames_sent);
+}
+
+}  // namespace
+
+BENCH_CASE(sequence) {
+  std::printf("  show: %zu bytes, malformed sample %s\n", sizeof(kShow),
+              ValidateSequence(kMalformed, sizeof(kMalformed)) ? "ACCEPTED" : "rejected");
+  RunShow("show from flash", kShow, sizeof(kShow), options);
+
+  host_sim::ResetNvs();
+  Preferences prefs;
+  prefs.begin("lighting", false);
+  prefs.putBytes("show", kShow, sizeof(kShow));
+  uint8_t buffer[kMaxSequenceBytes];
+  const std::size_t length = LoadSequence(prefs, "show", buffer, sizeof(buffer));
+  RunShow("show from NVS blob", buffer, length, options);
+
+  RunShow("runaway (no waits)", kRunaway, sizeof(kRunaway), options);
+}
@@ -0,0 +1,243 @@
+// The serial control protocol: parser throughput on a stream with corrupted
+// frames, then commands delivered to a running TaskRGB through the Serial
+// loopback, with the time from the last byte to the changed frame going out.
+
+#include <Preferences.h>
+
+#include <cstdio>
+#include <vector>
+
+#include "bench.h"
+#include "host_sim.h"
+#include "pixel_output.h"
+#include "serial_protocol.h"
+
+extern PixelOutput strip_output;
+
+void setup();
+void ServiceSerial();
+
+namespace {
+
+constexpr uint64_t kUsPerSecond = 1000000;
+constexpr uint64_t kCommandPeriodUs = 50 * 1000;
+constexpr uint64_t kPollUs = 10;
+constexpr uint64_t kPollLimitUs = 100 * 1000;
+constexpr std::size_t kChunk = 64;
+// Every kCorruptEvery-th frame gets a flipped payload bit and a stray byte
+// in front of it.
+constexpr uint32_t kCorruptEvery = 16;
+
+void AppendFrame(std::vector<uint8_t> &stream, uint8_t command, const uint8_t *payload,
+                 std::size_t length) {
+  uint8_t frame[kMaxFrameSize];
+  const std::size_t size = EncodeFrame(command, payload, length, frame, sizeof(frame));
+  stream.insert(stream.end(), frame, frame + size);
+}
+
+std::vector<uint8_t> MixedStream(uint32_t frames) {
+  std::vector<uint8_t> stream;
+  for (uint32_t i = 0; i < frames; ++i) {
+    const std::size_t start = stream.size();
+    switch (i % 3) {
+      case 0: {
+        const uint8_t color[] = {static_cast<uint8_t>(i), 0x40, 0x80};
+        AppendFrame(stream, protocol_cmd::kSetColor, color, sizeof(color));
+        break;
+      }
+      case 1: {
+        const uint8_t speed[] = {static_cast<uint8_t>(i), 0};
+        AppendFrame(stream, protocol_cmd::kSetSpeed, speed, sizeof(speed));
+        break;
+      }
+      default:
+        AppendFrame(stream, protocol_cmd::kQueryState, nullptr, 0);
+        break;
+    }
+    if (i % kCorruptEvery == kCorruptEvery - 1) {
+      stream[stream.size() - 3] ^= 0x10;
+      stream.insert(stream.begin() + start, kFrameSync);
+    }
+  }
+  return stream;
+}
+
+void BenchParser() {
+  constexpr uint32_t kFrames = 30000;
+  constexpr int kPasses = 20;
+  const std::vector<uint8_t> stream = MixedStream(kFrames);
+
+  ProtocolParser parser;
+  uint32_t commands = 0;
+  uint32_t checksum = 0;
+  bench::Stopwatch stopwatch;
+  stopwatch.start();
+  for (int pass = 0; pass < kPasses; ++pass) {
+    std::size_t offset = 0;
+    while (offset < stream.size()) {
+      std::size_t space = 0;
+      uint8_t *buffer = parser.writeBuffer(space);
+      std::size_t length = space < kChunk ? space : kChunk;
+      if (length > stream.size() - offset) {
+        length = stream.size() - offset;
+      }
+      for (std::size_t i = 0; i < length; ++i) {
+        buffer[i] = stream[offset + i];
+      }
+      parser.commitWrite(length);
+      offset += length;
+
+      CommandView command;
+      while (parser.next(command)) {
+        commands++;
+        checksum += command.command() + command.payloadLength();
+      }
+    }
+  }
+  stopwatch.stop();
+  bench::DoNotOptimize(checksum);
+
+  const uint64_t bytes = static_cast<uint64_t>(stream.size()) * kPasses;
+  const double seconds = stopwatch.totalNs() / 1e9;
+  bench::ReportOps("parse byte", stopwatch.totalNs(), bytes);
+  bench::ReportOps("parse frame", stopwatch.totalNs(), commands);
+  const ProtocolParser::Stats &stats = parser.stats();
+  std::printf("  %-28s %10.1f MB/s %10.0f frames/s\n", "", bytes / seconds / 1e6,
+              commands / seconds);
+  std::printf("  %-28s %10u frames %6u crc errors %6u bytes dropped\n", "",
+              static_cast<unsigned>(stats.frames), static_cast<unsigned>(stats.crc_errors),
+              static_cast<unsigned>(stats.dropped_bytes));
+}
+
+struct LoopbackResult {
+  uint32_t sent = 0;
+  uint32_t applied = 0;
+  uint64_t latency_total_us = 0;
+  uint64_t latency_max_us = 0;
+};
+
+LoopbackResult loopback;
+
+// Polls until the frame carrying the new colour has been handed to the
+// transmitter, as the wire would see it.
+void PollForFrame(uint64_t sent_us, uint32_t frames_before) {
+  const uint64_t now = host_sim::NowUs();
+  if (strip_output.stats().frames_sent != frames_before) {
+    const uint64_t latency = now - sent_us;
+    loopback.applied++;
+    loopback.latency_total_us += latency;
+    if (latency > loopback.latency_max_us) {
+      loopback.latency_max_us = latency;
+    }
+    return;
+  }
+  if (now - sent_us < kPollLimitUs) {
+    host_sim::Schedule(now + kPollUs, [sent_us, frames_before] {
+      PollForFrame(sent_us, frames_before);
+    });
+  }
+}
+
+void Deliver(const std::vector<uint8_t> &bytes) {
+  host_sim::SerialReceive(bytes.data(), bytes.size());
+  ServiceSerial();
+}
+
+void SendColor(uint32_t index) {
+  std::vector<uint8_t> bytes;
+  const uint8_t color[] = {static_cast<uint8_t>(index * 37), static_cast<uint8_t>(index * 91),
+                           static_cast<uint8_t>(255 - index)};
+  AppendFrame(bytes, protocol_cmd::kSetColor, color, sizeof(color));
+  if (index % 4 == 3) {
+    AppendFrame(bytes, protocol_cmd::kQueryState, nullptr, 0);
+  }
+  const uint32_t frames_before = strip_output.stats().frames_sent;
+  Deliver(bytes);
+  loopback.sent++;
+  PollForFrame(host_sim::NowUs(), frames_before);
+}
+
+void BenchLoopback(const bench::Options &options) {
+  // Boot into kSolid, where every colour change is a new frame.
+  host_sim::ResetNvs();
+  Preferences prefs;
+  prefs.begin("lighting", false);
+  prefs.putInt("brightness", 0);
+  prefs.putInt("glow", 0);
+  prefs.end();
+  host_sim::ClearSchedule();
+  setup();
+  loopback = LoopbackResult{};
+  host_sim::TakeSerialOutput();
+  host_sim::CaptureSerial(true);
+
+  const uint64_t start = host_sim::NowUs();
+  const uint64_t duration = options.seconds * kUsPerSecond;
+  uint32_t index = 0;
+  for (uint64_t t = kCommandPeriodUs; t + kPollLimitUs < duration; t += kCommandPeriodUs) {
+    host_sim::Schedule(start + t, [index] { SendColor(index); });
+    index++;
+  }
+  // One of each error, delivered a byte at a time.
+  host_sim::Schedule(start + kCommandPeriodUs / 2, [] {
+    std::vector<uint8_t> bytes;
+    const uint8_t glow = 0x7f;
+    AppendFrame(bytes, protocol_cmd::kSetGlow, &glow, 1);
+    AppendFrame(bytes, protocol_cmd::kSetBrightness, nullptr, 0);
+    AppendFrame(bytes, 0x3c, nullptr, 0);
+    for (uint8_t byte : bytes) {
+      Deliver(std::vector<uint8_t>{byte});
+    }
+  });
+  host_sim::RunTask("TaskRGB", duration);
+  host_sim::CaptureSerial(false);
+
+  // Sort the replies by status.
+  const std::vector<uint8_t> output = host_sim::TakeSerialOutput();
+  ProtocolParser replies;
+  uint32_t by_status[protocol_status::kBusy + 1] = {};
+  uint32_t states = 0;
+  uint32_t states_matching = 0;
+  std::size_t offset = 0;
+  while (offset < output.size()) {
+    offset += replies.feed(output.data() + offset, output.size() - offset);
+    CommandView reply;
+    while (replies.next(reply)) {
+      const uint8_t status = reply.u8(0);
+      if (status <= protocol_status::kBusy) {
+        by_status[status]++;
+      }
+      if (reply.command() == (protocol_cmd::kQueryState | protocol_cmd::kReplyFlag)) {
+        states++;
+        // The report follows the colour command queued just before it.
+        const uint32_t queried = (states * 4 - 1);
+        if (reply.u8(3) == static_cast<uint8_t>(queried * 37) &&
+            reply.u8(4) == static_cast<uint8_t>(queried * 91)) {
+          states_matching++;
+        }
+      }
+    }
+  }
+
+  std::printf("  %-28s %10u sent %10u on the wire\n", "kSetColor",
+              static_cast<unsigned>(loopback.sent), static_cast<unsigned>(loopback.applied));
+  std::printf("  %-28s %10.1f us mean %8u us max (last byte to frame out, %u us polls)\n", "",
+              loopback.applied ? static_cast<double>(loopback.latency_total_us) / loopback.applied
+                               : 0.0,
+              static_cast<unsigned>(loopback.latency_max_us), static_cast<unsigned>(kPollUs));
+  std::printf("  %-28s %10u ok %4u unknown %4u length %4u value %4u busy\n", "replies",
+              static_cast<unsigned>(by_status[protocol_status::kOk]),
+              static_cast<unsigned>(by_status[protocol_status::kUnknownCommand]),
+              static_cast<unsigned>(by_status[protocol_status::kBadLength]),
+              static_cast<unsigned>(by_status[protocol_status::kBadValue]),
+              static_cast<unsigned>(by_status[protocol_status::kBusy]));
+  std::printf("  %-28s %10u state reports, %u with the colour just set\n", "kQueryState",
+              static_cast<unsigned>(states), static_cast<unsigned>(states_matching));
+}
+
+}  // namespace
+
+BENCH_CASE(serial) {
+  BenchParser();
+  BenchLoopback(options);
+}
@@ -0,0 +1,306 @@
+// Streaming mode: the delta/RLE codec on typical effect content (bytes per
+// frame against the 115200-baud budget, encode and decode cost), then a
+// host streaming 60 fps into TaskRGB over the Serial loopback with arrival
+// jitter and a lost chunk, and the fallback once it stops. Last, a keyframe
+// split over two chunks behind an orphaned frame must still be shown.
+
+#include <Preferences.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <vector>
+
+#include "bench.h"
+#include "color_tables.h"
+#include "effect_engine.h"
+#include "frame_stream.h"
+#include "host_sim.h"
+#include "pixel_ops.h"
+#include "serial_protocol.h"
+
+extern EffectEngine effect_engine;
+extern FrameStream frame_stream;
+extern uint32_t strip_frame[];
+
+void setup();
+void ServiceSerial();
+
+namespace {
+
+constexpr uint64_t kUsPerMs = 1000;
+constexpr uint64_t kUsPerSecond = 1000000;
+// 8N1: ten bits on the wire per byte.
+constexpr double kSerialBytesPerSecond = 115200 / 10.0;
+constexpr uint32_t kFramePeriodUs = 16667;
+constexpr uint32_t kKeyframeInterval = 60;
+constexpr uint16_t kCodecFrames = 600;
+constexpr uint16_t kLivePixels = 22;
+constexpr uint64_t kMaxJitterUs = 60 * kUsPerMs;
+constexpr uint32_t kLostChunk = 150;
+
+constexpr uint16_t kCodecPixels[] = {22, 144, 300};
+// Enough pixels that a keyframe takes two chunks.
+constexpr uint16_t kSplitPixels = 144;
+
+struct ContentCase {
+  const char *name;
+  EffectId effect;
+  uint16_t step_ms;
+};
+
+constexpr ContentCase kContent[] = {
+    {"solid", EffectId::kSolid, 0},
+    {"breathing", EffectId::kBreathing, 30},
+    {"color_wipe", EffectId::kColorWipe, 50},
+    {"theater_chase", EffectId::kTheaterChase, 50},
+    {"rainbow", EffectId::kRainbow, 8},
+    {"theater_chase_rainbow", EffectId::kTheaterChaseRainbow, 40},
+};
+
+// Renders |frames| frames of |content| at 60 fps as a host would send them:
+// the effect's pixels with its output level applied.
+std::vector<std::vector<uint32_t>> RenderContent(const ContentCase &content, uint16_t pixels) {
+  std::vector<std::vector<uint32_t>> frames(kCodecFrames, std::vector<uint32_t>(pixels));
+  alignas(BuiltinEffects::kArenaAlign) unsigned char arena[BuiltinEffects::kArenaSize];
+  EffectParams params{};
+  params.color = 0xc8c8c8;
+  params.step_ms = content.step_ms;
+  params.level = 150;
+  params.level_min = 20;
+  params.level_max = 150;
+  params.phase_step = 256;
+  const EffectDescriptor &effect = EffectEngine::describe(content.effect);
+  std::vector<uint32_t> canvas(pixels);
+  const PixelSpan target{canvas.data(), pixels};
+  effect.start(arena, params, target);
+  for (uint16_t i = 0; i < kCodecFrames; ++i) {
+    const uint32_t elapsed_ms = static_cast<uint32_t>(i * kFramePeriodUs / kUsPerMs);
+    const uint32_t step = content.step_ms ? elapsed_ms / content.step_ms : 0;
+    Frame frame{target, step, params, params.level};
+    effect.render(arena, frame);
+    for (uint16_t p = 0; p < pixels; ++p) {
+      frames[i][p] = pixel_ops::ScalePixel(canvas[p], pixel_ops::WeightForLevel(frame.level));
+    }
+  }
+  return frames;
+}
+
+void BenchCodec() {
+  std::printf("  %-22s %5s %9s %9s %7s %9s %9s %9s\n", "content", "px", "B/frame", "raw B",
+              "ratio", "max fps", "enc ns", "dec ns");
+  std::vector<uint8_t> wire(8192);
+  std::vector<uint8_t> ops(8192);
+  for (uint16_t pixels : kCodecPixels) {
+    // Bare RGB in the same framing, for comparison.
+    const std::size_t raw_bytes = 3u * pixels +
+                                  ((3u * pixels + kMaxStreamOps - 1) / kMaxStreamOps) *
+                                      (kFrameOverhead + 1 + kStreamHeaderSize);
+    for (const ContentCase &content : kContent) {
+      const std::vector<std::vector<uint32_t>> frames = RenderContent(content, pixels);
+      std::vector<uint32_t> decoded(pixels);
+      const PixelSpan target{decoded.data(), pixels};
+      bench::Stopwatch encode;
+      bench::Stopwatch decode;
+      uint64_t wire_bytes = 0;
+      bool exact = true;
+      for (uint16_t i = 0; i < kCodecFrames; ++i) {
+        const uint32_t *previous = (i % kKeyframeInterval) ? frames[i - 1].data() : nullptr;
+        wire_bytes += EncodeStreamFrame(previous, frames[i].data(), pixels, static_cast<uint8_t>(i),
+                                        static_cast<uint16_t>(i * 17), wire.data(), wire.size());
+
+        // Ops alone for timing, so the framing and CRC are not counted.
+        uint16_t done = 0;
+        encode.start();
+        const std::size_t length =
+            EncodeStreamOps(previous, frames[i].data(), pixels, ops.data(), ops.size(), done);
+        encode.stop();
+        decode.start();
+        exact = DecodeStreamOps(ops.data(), length, 0, target) && exact;
+        decode.stop();
+        for (uint16_t p = 0; p < pixels; ++p) {
+          exact = exact && decoded[p] == frames[i][p];
+        }
+      }
+      const double per_frame = static_cast<double>(wire_bytes) / kCodecFrames;
+      std::printf("  %-22s %5u %9.1f %9zu %6.1fx %9.1f %9.0f %9.0f%s\n", content.name,
+                  static_cast<unsigned>(pixels), per_frame, raw_bytes, raw_bytes / per_frame,
+                  kSerialBytesPerSecond / per_frame,
+                  static_cast<double>(encode.totalNs()) / kCodecFrames,
+                  static_cast<double>(decode.totalNs()) / kCodecFrames,
+                  exact ? "" : "  MISMATCH");
+    }
+  }
+}
+
+struct LiveResult {
+  uint32_t frames_sent = 0;
+  uint32_t chunks_lost = 0;
+  uint32_t acks[protocol_status::kNeedKeyframe + 1] = {};
+  bool last_frame_shown = false;
+  EffectId effect_streaming = EffectId::kSolid;
+  EffectId effect_after = EffectId::kStream;
+};
+
+LiveResult live;
+std::vector<uint32_t> last_sent;
+
+void Deliver(const std::vector<uint8_t> &bytes) {
+  host_sim::SerialReceive(bytes.data(), bytes.size());
+  ServiceSerial();
+}
+
+void BenchLive(const bench::Options &options) {
+  // Boot into kSolid; the first streamed frame switches to the stream.
+  host_sim::ResetNvs();
+  Preferences prefs;
+  prefs.begin("lighting", false);
+  prefs.putInt("brightness", 0);
+  prefs.putInt("glow", 0);
+  prefs.end();
+  host_sim::ClearSchedule();
+  setup();
+  live = LiveResult{};
+  host_sim::TakeSerialOutput();
+  host_sim::CaptureSerial(true);
+
+  const ContentCase rainbow{"rainbow", EffectId::kRainbow, 8};
+  const std::vector<std::vector<uint32_t>> frames = RenderContent(rainbow, kLivePixels);
+  const uint64_t start = host_sim::NowUs();
+  const uint64_t duration = options.seconds * kUsPerSecond;
+  // The host stops a second and a half before the end (a quarter of the way
+  // through a short run) to show the fallback.
+  const uint64_t stream_end =
+      duration > 3 * kUsPerSecond ? duration - 1500 * kUsPerMs : duration / 4;
+
+  uint64_t arrival = start;
+  uint32_t seed = 12345;
+  uint32_t chunk = 0;
+  for (uint32_t i = 0; static_cast<uint64_t>(i) * kFramePeriodUs < stream_end; ++i) {
+    const std::vector<uint32_t> &current = frames[i % kCodecFrames];
+    const uint32_t *previous =
+        (i % kKeyframeInterval) ? frames[(i - 1) % kCodecFrames].data() : nullptr;
+    std::vector<uint8_t> bytes(1024);
+    bytes.resize(EncodeStreamFrame(previous, current.data(), kLivePixels, static_cast<uint8_t>(i),
+                                   static_cast<uint16_t>(i * kFramePeriodUs / kUsPerMs),
+                                   bytes.data(), bytes.size()));
+    live.frames_sent++;
+    if (++chunk == kLostChunk) {
+      live.chunks_lost++;
+      continue;
+    }
+    // The first frame is on time, so the playout clock starts from the
+    // best case and the jitter after it shows up as lateness.
+    seed = seed * 1103515245 + 12345;
+    const uint64_t nominal = start + static_cast<uint64_t>(i) * kFramePeriodUs;
+    const uint64_t jittered = nominal + (i == 0 ? 0 : (seed >> 8) % kMaxJitterUs);
+    arrival = jittered > arrival ? jittered : arrival;
+    host_sim::Schedule(arrival, [bytes] { Deliver(bytes); });
+    last_sent = current;
+  }
+  host_sim::Schedule(start + stream_end + 500 * kUsPerMs, [] {
+    live.effect_streaming = effect_engine.effect();
+    live.last_frame_shown = true;
+    for (uint16_t p = 0; p < kLivePixels; ++p) {
+      live.last_frame_shown = live.last_frame_shown && strip_frame[p] == last_sent[p];
+    }
+  });
+  host_sim::RunTask("TaskRGB", duration);
+  host_sim::CaptureSerial(false);
+  live.effect_after = effect_engine.effect();
+
+  const std::vector<uint8_t> output = host_sim::TakeSerialOutput();
+  ProtocolParser replies;
+  std::size_t offset = 0;
+  while (offset < output.size()) {
+    offset += replies.feed(output.data() + offset, output.size() - offset);
+    CommandView reply;
+    while (replies.next(reply)) {
+      if (reply.command() == (protocol_cmd::kStreamFrame | protocol_cmd::kReplyFlag) &&
+          reply.u8(0) <= protocol_status::kNeedKeyframe) {
+        live.acks[reply.u8(0)]++;
+      }
+    }
+  }
+
+  const FrameStream::Stats stats = frame_stream.stats();
+  std::printf("  %-28s %10u sent %6u lost %6u shown %6u late %6u dropped\n", "live 60 fps, 22 px",
+              static_cast<unsigned>(live.frames_sent), static_cast<unsigned>(live.chunks_lost),
+              static_cast<unsigned>(stats.frames_shown), static_cast<unsigned>(stats.frames_late),
+              static_cast<unsigned>(stats.frames_dropped));
+  std::printf("  %-28s %10u ok %6u busy %6u need keyframe, playout delay %u ms\n", "",
+              static_cast<unsigned>(live.acks[protocol_status::kOk]),
+              static_cast<unsigned>(live.acks[protocol_status::kBusy]),
+              static_cast<unsigned>(live.acks[protocol_status::kNeedKeyframe]),
+              static_cast<unsigned>(stats.delay_ms));
+  std::printf("  %-28s %10s %s, last frame on the strip %s; after the timeout: %s\n", "", "",
+              EffectEngine::describe(live.effect_streaming).name,
+              live.last_frame_shown ? "exact" : "WRONG",
+              EffectEngine::describe(live.effect_after).name);
+}
+
+// Queues |length| bytes of |ops| as one chunk. Returns false if refused.
+bool PushChunk(FrameStream &stream, const StreamChunkHeader &header, const uint8_t *ops,
+               std::size_t length, uint32_t now_ms) {
+  FrameStream::PushStatus status;
+  uint8_t *slot = stream.beginChunk(header, length, now_ms, status);
+  if (slot == nullptr) {
+    return false;
+  }
+  std::copy(ops, ops + length, slot);
+  stream.commitChunk();
+  return true;
+}
+
+// A frame loses its last chunk, then a keyframe arrives in two chunks with
+// TaskRGB draining the queue between them. Dropping the orphan must not
+// refuse the rest of the keyframe the serial task has started taking.
+void BenchOrphanBeforeKeyframe() {
+  static FrameStream stream;
+  static uint32_t frame[kSplitPixels];
+  static uint32_t shown[kSplitPixels];
+  for (uint16_t p = 0; p < kSplitPixels; ++p) {
+    frame[p] = color_tables::kWheel[static_cast<uint8_t>(p * 7)];
+  }
+  uint8_t first[kMaxStreamOps];
+  uint8_t rest[kMaxStreamOps];
+  uint16_t first_pixels = 0;
+  uint16_t rest_pixels = 0;
+  const std::size_t first_length =
+      EncodeStreamOps(nullptr, frame, kSplitPixels, first, sizeof(first), first_pixels);
+  const std::size_t rest_length =
+      EncodeStreamOps(nullptr, frame + first_pixels, static_cast<uint16_t>(kSplitPixels - first_pixels),
+                      rest, sizeof(rest), rest_pixels);
+
+  uint32_t now_ms = 0;
+  // Frame 0's first chunk; its second never arrives.
+  bool queued = PushChunk(stream, {0, 0, 0, kStreamKeyframe}, first, first_length, now_ms);
+  queued = PushChunk(stream, {1, 17, 0, kStreamKeyframe}, first, first_length, now_ms) && queued;
+  stream.nextDueMs(now_ms);
+  queued = PushChunk(stream, {1, 17, first_pixels, kStreamKeyframe | kStreamEndOfFrame}, rest,
+                     rest_length, now_ms) &&
+           queued;
+  // The first frame shown after a keyframe plays after the starting delay.
+  now_ms += stream.nextDueMs(now_ms);
+  const uint16_t decoded = stream.decodeDue(now_ms, PixelSpan{shown, kSplitPixels});
+
+  bool exact = first_pixels + rest_pixels == kSplitPixels;
+  for (uint16_t p = 0; p < kSplitPixels; ++p) {
+    exact = exact && shown[p] == frame[p];
+  }
+  const FrameStream::Stats stats = stream.stats();
+  const bool ok = queued && decoded == 1 && exact;
+  std::printf("  %-28s %10u dropped %6u shown, keyframe %s\n", "orphan, split keyframe",
+              static_cast<unsigned>(stats.frames_dropped), static_cast<unsigned>(stats.frames_shown),
+              ok ? "exact" : "WRONG");
+  if (!ok) {
+    bench::Fail();
+  }
+}
+
+}  // namespace
+
+BENCH_CASE(stream) {
+  BenchCodec();
+  BenchLive(options);
+  BenchOrphanBeforeKeyframe();
+}
@@ -0,0 +1,94 @@
+// Animation speed under scheduling jitter. update() is serviced at its
+// deadlines except for periodic stalls (an NVS write, a long show()); the
+// rainbow phase actually shown is compared with the nominal speed, for the
+// clock-driven controller and for the old one-step-per-tick model.
+
+#include <Adafruit_NeoPixel.h>
+
+#include <cstdio>
+
+#include "bench.h"
+#include "color_tables.h"
+#include "host_sim.h"
+#include "pixel_output.h"
+#include "strandtest_nodelay.h"
+
+namespace {
+
+constexpr uint16_t kBenchPixels = 22;
+constexpr uint8_t kRainbowWaitMs = 8;
+constexpr uint64_t kUsPerMs = 1000;
+constexpr uint64_t kUsPerSecond = 1000000;
+constexpr uint32_t kStallEveryMs = 250;
+constexpr uint32_t kStallMs = 70;
+
+uint8_t WheelIndex(uint32_t color) {
+  for (std::size_t i = 0; i < color_tables::kTableSize; ++i) {
+    if (color_tables::kWheel[i] == color) {
+      return static_cast<uint8_t>(i);
+    }
+  }
+  return 0;
+}
+
+void RunJitter(const char *label, uint16_t frame_interval_ms, bool stalls,
+               const bench::Options &options) {
+  Adafruit_NeoPixel strip(kBenchPixels, 0, NEO_GRB + NEO_KHZ800);
+  NeoPixelTransmitter transmitter(strip);
+  uint32_t frame[kBenchPixels];
+  uint8_t wire[PixelOutput::WireBytes(kBenchPixels)];
+  PixelOutput output(transmitter, NEO_GRB + NEO_KHZ800, frame, wire, kBenchPixels);
+  EffectEngine engine(output);
+  StrandtestController controller(engine);
+  controller.setAutoCycle(false);
+  controller.begin();
+  controller.setPattern(StrandPattern::kRainbow);
+  controller.setRainbowWait(kRainbowWaitMs);
+  controller.setFrameInterval(frame_interval_ms);
+  output.setBrightness(255);
+
+  const uint64_t start = host_sim::NowUs();
+  const uint64_t end = start + options.seconds * kUsPerSecond;
+  uint64_t next_stall = start + kStallEveryMs * kUsPerMs;
+  uint32_t renders = 0;
+  uint32_t phase_advance = 0;
+  uint8_t last_index = 0;
+  bool first = true;
+  while (host_sim::NowUs() < end) {
+    const uint32_t sent_before = output.stats().frames_sent;
+    controller.update();
+    if (output.stats().frames_sent != sent_before) {
+      const uint8_t index = WheelIndex(output.pixel(0));
+      if (!first) {
+        phase_advance += static_cast<uint8_t>(index - last_index);
+        renders++;
+      }
+      first = false;
+      last_index = index;
+    }
+    uint64_t wake = host_sim::NowUs() + controller.nextFrameDelayMs() * kUsPerMs;
+    if (wake == host_sim::NowUs()) {
+      wake += kUsPerMs;
+    }
+    if (stalls && wake >= next_stall) {
+      wake = next_stall + kStallMs * kUsPerMs;
+      next_stall += kStallEveryMs * kUsPerMs;
+    }
+    host_sim::AdvanceTo(wake < end ? wake : end);
+  }
+
+  const double nominal = options.seconds * 1000.0 / kRainbowWaitMs;
+  std::printf("  %-28s %6.1f frames/s  tick model %5.1f%%  clock model %5.1f%% of nominal speed, "
+              "%u skipped\n",
+              label, renders / static_cast<double>(options.seconds), 100.0 * renders / nominal,
+              100.0 * phase_advance / nominal, controller.skippedFrames());
+}
+
+}  // namespace
+
+BENCH_CASE(animation_timing) {
+  RunJitter("rainbow, no stalls", 0, false, options);
+  RunJitter("rainbow, 70 ms stall / 250 ms", 0, true, options);
+  RunJitter("rainbow, 30 fps cap", 33, false, options);
+  RunJitter("rainbow, 30 fps cap + stalls", 33, true, options);
+}
@@ -0,0 +1,91 @@
+// Waveform sampling: a table sample against computing the same level at run
+// time (the old triangle arithmetic, and a sine through the CIE L* curve in
+// floating point), then the sine, lightness and breathe tables checked
+// against their curves computed at run time in double precision. An entry
+// more than one step off fails the run.
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+
+#include "bench.h"
+#include "waveform.h"
+
+namespace {
+
+constexpr double kPi = 3.14159265358979323846;
+
+// The breathing level before the tables, kept here as the baseline: a
+// triangle from level_max down to level_min and back, level_step per step.
+uint8_t LegacyBreathing(uint32_t step, uint8_t low, uint8_t high, uint8_t level_step) {
+  const uint32_t range = high - low;
+  const uint32_t travelled = (step * level_step) % (2 * range);
+  return static_cast<uint8_t>(travelled <= range ? high - travelled : low + (travelled - range));
+}
+
+float Luminance(float lightness) {
+  const float l = lightness * 100.0f;
+  const float f = (l + 16.0f) / 116.0f;
+  return l > 8.0f ? f * f * f : l / 903.3f;
+}
+
+double LuminanceExact(double lightness) {
+  const double l = lightness * 100.0;
+  const double f = (l + 16.0) / 116.0;
+  return l > 8.0 ? f * f * f : l / 903.3;
+}
+
+template <typename SampleFn>
+void RunSamples(const char *label, SampleFn sample, const bench::Options &options) {
+  const uint64_t samples = static_cast<uint64_t>(options.seconds) * 1000000ULL;
+  uint32_t sink = 0;
+  bench::Stopwatch stopwatch;
+  stopwatch.start();
+  for (uint64_t i = 0; i < samples; ++i) {
+    sink ^= sample(static_cast<uint32_t>(i * 163));
+  }
+  stopwatch.stop();
+  bench::DoNotOptimize(sink);
+  bench::ReportOps(label, stopwatch.totalNs(), samples);
+}
+
+template <typename CurveFn>
+void Check(const char *name, const waveform::Table &table, CurveFn curve) {
+  int worst = 0;
+  for (std::size_t i = 0; i < waveform::kTableSize; ++i) {
+    const int expected = static_cast<int>(std::lround(curve(i) * 255.0));
+    worst = std::max(worst, std::abs(table[i] - expected));
+  }
+  std::printf("  %-24s worst %d step%s%s\n", name, worst, worst == 1 ? "" : "s",
+              worst > 1 ? "  FAIL" : "");
+  if (worst > 1) {
+    bench::Fail();
+  }
+}
+
+}  // namespace
+
+BENCH_CASE(waveform) {
+  RunSamples("triangle (computed)", [](uint32_t i) { return LegacyBreathing(i, 20, 150, 3); },
+             options);
+  RunSamples("breathe (computed, float)", [](uint32_t i) {
+    const float angle = 2.0f * static_cast<float>(kPi) * static_cast<uint16_t>(i) / 65536.0f;
+    const float level = Luminance((1.0f - std::cos(angle)) / 2.0f);
+    return static_cast<uint32_t>(level * 255.0f + 0.5f);
+  }, options);
+  RunSamples("breathe (table)", [](uint32_t i) {
+    return waveform::Sample(waveform::kBreathe, static_cast<waveform::Phase>(i));
+  }, options);
+  RunSamples("breathe (table, mapped)", [](uint32_t i) {
+    return waveform::Map(waveform::Sample(waveform::kBreathe, static_cast<waveform::Phase>(i)),
+                         20, 150);
+  }, options);
+
+  const auto angle = [](std::size_t i) { return 2 * kPi * static_cast<double>(i) / 256; };
+  Check("sine", waveform::kSine, [&](std::size_t i) { return (1 - std::cos(angle(i))) / 2; });
+  Check("lightness", waveform::kLightness,
+        [](std::size_t i) { return LuminanceExact(i / 255.0); });
+  Check("breathe", waveform::kBreathe,
+        [&](std::size_t i) { return LuminanceExact((1 - std::cos(angle(i))) / 2); });
+}
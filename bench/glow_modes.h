@@ -0,0 +1,28 @@
+#pragma once
+
+// The GlowMode enumerators in main.cpp and their values, which it persists,
+// for benches that boot TaskRGB into each mode. kStream (5) is never booted
+// into. A new GlowMode is added here once.
+
+namespace bench {
+
+struct GlowModeName {
+  const char *name;
+  int value;
+};
+
+constexpr GlowModeName kGlowModeNames[] = {
+    {"kSolid", 0},
+    {"kBreathing", 1},
+    {"kRainbow", 2},
+    {"kTheaterChase", 3},
+    {"kTheaterChaseRainbow", 4},
+    {"kPulse", 6},
+    {"kHeartbeat", 7},
+    {"kSparkle", 8},
+    {"kRadialWave", 9},
+    {"kSweep", 10},
+    {"kNoise", 11},
+};
+
+}  // namespace bench
@@ -0,0 +1,370 @@
+#include "golden.h"
+
+#include <Adafruit_NeoPixel.h>
+#include <Preferences.h>
+
+#include <algorithm>
+#include <cstdio>
+
+#include "bench.h"
+#include "effect_engine.h"
+#include "glow_modes.h"
+#include "host_sim.h"
+#include "pixel_output.h"
+#include "sim_buttons.h"
+#include "strandtest_nodelay.h"
+#include "strip_transmitter.h"
+
+extern EffectEngine effect_engine;
+extern PixelOutput strip_output;
+
+void setup();
+
+namespace golden {
+namespace {
+
+constexpr char kGoldenDir[] = "bench/golden";
+constexpr char kMagic[] = {'G', 'L', 'D', '2'};
+constexpr uint16_t kPixels = 22;
+constexpr uint64_t kUsPerMs = 1000;
+constexpr uint64_t kUsPerSecond = 1000000;
+constexpr uint64_t kStrandRunUs = 3 * kUsPerSecond;
+constexpr uint64_t kAutoCycleRunUs = 12 * kUsPerSecond;
+constexpr uint64_t kGlowRunUs = 3 * kUsPerSecond;
+constexpr uint64_t kButtonsRunUs = 6 * kUsPerSecond;
+// Below this many frames a TaskRGB run is mostly boot and event handling,
+// so it is not timed.
+constexpr std::size_t kMinTimedFrames = 20;
+
+// BreathingMaximum() of each brightness mode tells them apart in any mode.
+constexpr uint8_t kDimLevelMax = 80;
+
+// ---- .gld files ----
+
+void PutVarint(std::vector<uint8_t> &out, uint64_t value) {
+  while (value >= 0x80) {
+    out.push_back(static_cast<uint8_t>(value | 0x80));
+    value >>= 7;
+  }
+  out.push_back(static_cast<uint8_t>(value));
+}
+
+void PutLe(std::vector<uint8_t> &out, uint32_t value, int bytes) {
+  for (int i = 0; i < bytes; ++i) {
+    out.push_back(static_cast<uint8_t>(value >> (8 * i)));
+  }
+}
+
+class Reader {
+ public:
+  explicit Reader(const std::vector<uint8_t> &data) : data_(data) {}
+
+  bool varint(uint64_t &value) {
+    value = 0;
+    for (int shift = 0; shift < 64; shift += 7) {
+      if (offset_ == data_.size()) {
+        return false;
+      }
+      const uint8_t byte = data_[offset_++];
+      value |= static_cast<uint64_t>(byte & 0x7f) << shift;
+      if ((byte & 0x80) == 0) {
+        return true;
+      }
+    }
+    return false;
+  }
+  bool le(uint32_t &value, int bytes) {
+    if (data_.size() - offset_ < static_cast<std::size_t>(bytes)) {
+      return false;
+    }
+    value = 0;
+    for (int i = 0; i < bytes; ++i) {
+      value |= static_cast<uint32_t>(data_[offset_++]) << (8 * i);
+    }
+    return true;
+  }
+  bool bytes(uint8_t *out, std::size_t count) {
+    if (data_.size() - offset_ < count) {
+      return false;
+    }
+    std::copy(data_.begin() + offset_, data_.begin() + offset_ + count, out);
+    offset_ += count;
+    return true;
+  }
+  bool done() const { return offset_ == data_.size(); }
+
+ private:
+  const std::vector<uint8_t> &data_;
+  std::size_t offset_ = 0;
+};
+
+// ---- Scenarios ----
+
+// Presses the last scenario run applied differently from its script.
+uint32_t button_mismatches = 0;
+
+// Records each frame with its simulated time since |origin_us| and sends it
+// no further.
+class RecordingTransmitter final : public StripTransmitter {
+ public:
+  RecordingTransmitter(std::vector<WireFrame> &frames, uint64_t origin_us)
+      : frames_(frames), origin_us_(origin_us) {}
+
+  void begin() override {}
+  void transmit(const uint8_t *data, std::size_t length) override {
+    frames_.push_back(WireFrame{host_sim::NowUs() - origin_us_, {data, data + length}});
+  }
+  bool busy() override { return false; }
+  void wait() override {}
+
+ private:
+  std::vector<WireFrame> &frames_;
+  uint64_t origin_us_;
+};
+
+// Starts every run on a whole simulated second with nothing scheduled, so
+// millis() ticks over at the same points whatever ran before.
+void AlignClock() {
+  host_sim::ClearSchedule();
+  host_sim::AdvanceTo((host_sim::NowUs() / kUsPerSecond + 1) * kUsPerSecond);
+}
+
+// A StrandPattern, or the auto-cycle sequence for a negative |variant|,
+// driven by update() every millisecond.
+void RunStrand(int variant, Recording &recording) {
+  AlignClock();
+  button_mismatches = 0;
+  const uint64_t origin = host_sim::NowUs();
+  uint32_t frame[kPixels];
+  uint8_t wire[PixelOutput::WireBytes(kPixels)];
+  RecordingTransmitter transmitter(recording.frames, origin);
+  PixelOutput output(transmitter, NEO_GRB + NEO_KHZ800, frame, wire, kPixels);
+  EffectEngine engine(output);
+  StrandtestController controller(engine);
+  controller.setAutoCycle(variant < 0);
+  controller.begin();
+  if (variant >= 0) {
+    controller.setPattern(static_cast<StrandPattern>(variant),
+                          Adafruit_NeoPixel::Color(200, 200, 200));
+  }
+
+  bench::Stopwatch stopwatch;
+  uint64_t frames = 0;
+  const uint64_t end = origin + (variant < 0 ? kAutoCycleRunUs : kStrandRunUs);
+  while (host_sim::NowUs() < end) {
+    const std::size_t sent = recording.frames.size();
+    stopwatch.start();
+    controller.update();
+    const uint64_t lap = stopwatch.lap();
+    if (recording.frames.size() != sent) {
+      stopwatch.add(lap);
+      frames++;
+    }
+    host_sim::AdvanceBy(kUsPerMs);
+  }
+  recording.commits = output.stats().frames_sent + output.stats().frames_skipped;
+  recording.ns_per_frame = frames ? static_cast<uint32_t>(stopwatch.totalNs() / frames) : 0;
+}
+
+// The button session, presses of the main key: what TaskRGB should have
+// applied after each one is released.
+struct ButtonStep {
+  uint32_t at_ms;
+  uint32_t held_ms;
+  AppliedState expected;
+};
+
+constexpr ButtonStep kButtonSteps[] = {
+    {300, kClickMs, {EffectId::kSolid, true}},
+    {600, kLongPressMs, {EffectId::kBreathing, true}},
+    {1800, kLongPressMs, {EffectId::kRainbow, true}},
+    {3000, kClickMs, {EffectId::kRainbow, false}},
+    {3300, kLongPressMs, {EffectId::kTheaterChase, false}},
+    {4500, kLongPressMs, {EffectId::kTheaterChaseRainbow, false}},
+};
+
+void CheckApplied(const ButtonStep &step) {
+  const AppliedState applied = Applied();
+  if (applied.effect == step.expected.effect && applied.dim == step.expected.dim) {
+    return;
+  }
+  button_mismatches++;
+  std::printf("  %s at %u ms: %s, %s (expected %s, %s)\n",
+              step.held_ms > kClickMs ? "long press" : "click", static_cast<unsigned>(step.at_ms),
+              EffectEngine::describe(applied.effect).name, applied.dim ? "dim" : "bright",
+              EffectEngine::describe(step.expected.effect).name,
+              step.expected.dim ? "dim" : "bright");
+}
+
+// TaskRGB booted into GlowMode |variant|, bright, or into kSolid with the
+// button session for a negative |variant|.
+void RunGlow(int variant, Recording &recording) {
+  Boot(variant < 0 ? 0 : variant);
+  const uint64_t origin = host_sim::NowUs();
+  host_sim::TapRmt([&recording, origin](int, const uint8_t *data, size_t length) {
+    recording.frames.push_back(WireFrame{host_sim::NowUs() - origin, {data, data + length}});
+  });
+  button_mismatches = 0;
+  if (variant < 0) {
+    for (const ButtonStep &step : kButtonSteps) {
+      const uint64_t down = origin + step.at_ms * kUsPerMs;
+      const uint64_t up = down + step.held_ms * kUsPerMs;
+      sim_buttons::SchedulePress(sim_buttons::kMainPin, down, step.held_ms * kUsPerMs);
+      host_sim::Schedule(up + kSettleMs * kUsPerMs, [&step] { CheckApplied(step); });
+    }
+  }
+  host_sim::ResetStats();
+  strip_output.resetStats();
+  host_sim::RunTask("TaskRGB", variant < 0 ? kButtonsRunUs : kGlowRunUs);
+  host_sim::TapRmt(nullptr);
+  recording.commits = strip_output.stats().frames_sent + strip_output.stats().frames_skipped;
+  const host_sim::Stats &stats = host_sim::GetStats();
+  recording.ns_per_frame = stats.show_calls >= kMinTimedFrames
+                               ? static_cast<uint32_t>(stats.busy_ns / stats.show_calls)
+                               : 0;
+}
+
+}  // namespace
+
+std::string GoldenPath(const std::string &name) {
+  return std::string(kGoldenDir) + "/" + name + ".gld";
+}
+
+bool WriteGolden(const std::string &path, const Recording &recording) {
+  std::vector<uint8_t> out(kMagic, kMagic + sizeof(kMagic));
+  const std::size_t frame_bytes = recording.frames.empty() ? 0 : recording.frames[0].bytes.size();
+  PutLe(out, static_cast<uint32_t>(frame_bytes), 2);
+  PutLe(out, static_cast<uint32_t>(recording.frames.size()), 4);
+  PutLe(out, recording.commits, 4);
+  const WireFrame *previous = nullptr;
+  for (const WireFrame &frame : recording.frames) {
+    std::size_t first = 0;
+    std::size_t end = frame_bytes;
+    if (previous != nullptr) {
+      while (first < end && frame.bytes[first] == previous->bytes[first]) {
+        first++;
+      }
+      while (end > first && frame.bytes[end - 1] == previous->bytes[end - 1]) {
+        end--;
+      }
+    }
+    PutVarint(out, frame.time_us - (previous ? previous->time_us : 0));
+    PutVarint(out, first);
+    PutVarint(out, end - first);
+    out.insert(out.end(), frame.bytes.begin() + first, frame.bytes.begin() + end);
+    previous = &frame;
+  }
+  std::FILE *file = std::fopen(path.c_str(), "wb");
+  if (file == nullptr) {
+    return false;
+  }
+  const bool written = std::fwrite(out.data(), 1, out.size(), file) == out.size();
+  return std::fclose(file) == 0 && written;
+}
+
+bool ReadGolden(const std::string &path, Recording &recording) {
+  std::FILE *file = std::fopen(path.c_str(), "rb");
+  if (file == nullptr) {
+    return false;
+  }
+  std::vector<uint8_t> data;
+  uint8_t chunk[4096];
+  std::size_t length;
+  while ((length = std::fread(chunk, 1, sizeof(chunk), file)) > 0) {
+    data.insert(data.end(), chunk, chunk + length);
+  }
+  std::fclose(file);
+
+  Reader reader(data);
+  uint8_t magic[sizeof(kMagic)];
+  uint32_t frame_bytes;
+  uint32_t count;
+  if (!reader.bytes(magic, sizeof(magic)) || !std::equal(magic, magic + sizeof(magic), kMagic) ||
+      !reader.le(frame_bytes, 2) || !reader.le(count, 4) ||
+      !reader.le(recording.commits, 4)) {
+    return false;
+  }
+  std::vector<uint8_t> bytes(frame_bytes);
+  uint64_t time_us = 0;
+  for (uint32_t i = 0; i < count; ++i) {
+    uint64_t delta;
+    uint64_t first;
+    uint64_t changed;
+    if (!reader.varint(delta) || !reader.varint(first) || !reader.varint(changed) ||
+        first + changed > frame_bytes || !reader.bytes(bytes.data() + first, changed)) {
+      return false;
+    }
+    time_us += delta;
+    recording.frames.push_back(WireFrame{time_us, bytes});
+  }
+  return reader.done();
+}
+
+std::vector<Scenario> Scenarios() {
+  const char *const kStrandNames[] = {"kColorWipe", "kTheaterChase", "kRainbow",
+                                      "kTheaterChaseRainbow"};
+  std::vector<Scenario> scenarios;
+  int pattern = 0;
+  for (const char *name : kStrandNames) {
+    scenarios.push_back({std::string("strand-") + name, RunStrand, pattern++});
+  }
+  scenarios.push_back({"strand-auto-cycle", RunStrand, -1});
+  for (const bench::GlowModeName &glow : bench::kGlowModeNames) {
+    scenarios.push_back({std::string("glow-") + glow.name, RunGlow, glow.value});
+  }
+  scenarios.push_back({"glow-buttons", RunGlow, -1});
+  return scenarios;
+}
+
+bool Describe(const Recording &expected, const Recording &actual, char *text, std::size_t size) {
+  const std::size_t count = std::min(expected.frames.size(), actual.frames.size());
+  for (std::size_t i = 0; i < count; ++i) {
+    const WireFrame &want = expected.frames[i];
+    const WireFrame &got = actual.frames[i];
+    if (want.time_us != got.time_us) {
+      std::snprintf(text, size, "frame %zu sent at %.1f ms, expected %.1f ms", i,
+                    got.time_us / 1000.0, want.time_us / 1000.0);
+      return true;
+    }
+    if (want.bytes.size() != got.bytes.size()) {
+      std::snprintf(text, size, "frame %zu is %zu bytes, expected %zu", i, got.bytes.size(),
+                    want.bytes.size());
+      return true;
+    }
+    for (std::size_t b = 0; b < want.bytes.size(); ++b) {
+      if (want.bytes[b] != got.bytes[b]) {
+        std::snprintf(text, size, "frame %zu at %.1f ms: pixel %zu byte %zu is %02x, expected %02x",
+                      i, got.time_us / 1000.0, b / 3, b % 3, got.bytes[b], want.bytes[b]);
+        return true;
+      }
+    }
+  }
+  if (expected.frames.size() != actual.frames.size()) {
+    std::snprintf(text, size, "%zu frames, expected %zu", actual.frames.size(),
+                  expected.frames.size());
+    return true;
+  }
+  return false;
+}
+
+AppliedState Applied() {
+  return AppliedState{effect_engine.effect(), effect_engine.params().level_max == kDimLevelMax};
+}
+
+void Boot(int glow) {
+  host_sim::ResetNvs();
+  Preferences prefs;
+  prefs.begin("lighting", false);
+  prefs.putInt("brightness", 0);
+  prefs.putInt("glow", glow);
+  prefs.end();
+  sim_buttons::Reset();
+  AlignClock();
+  // At boot the frame is all zeros; an earlier case left its last one.
+  strip_output.clear();
+  setup();
+}
+
+uint32_t ButtonMismatches() { return button_mismatches; }
+
+}  // namespace golden
@@ -0,0 +1,81 @@
+#pragma once
+
+// Golden frames: every StrandPattern, the auto-cycle sequence, every
+// GlowMode through TaskRGB and a scripted session of button presses, each
+// run on the simulated clock with every frame put on the wire recorded.
+// test/test_native checks the recordings against bench/golden/<scenario>.gld
+// and the golden bench case rewrites the files with --record; run from the
+// project root either way.
+//
+// A .gld file is a header (magic "GLD2", frame bytes:u16, frame count:u32,
+// commits:u32, little endian) and then each frame as varints: the
+// microseconds since the previous frame (since the scenario started for the
+// first), the first byte that changed and the number of bytes from there
+// to the last that changed, followed by those bytes. The first frame is
+// stored whole.
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "effect.h"
+
+namespace golden {
+
+struct WireFrame {
+  uint64_t time_us;
+  std::vector<uint8_t> bytes;
+};
+
+struct Recording {
+  std::vector<WireFrame> frames;
+  // PixelOutput::commit() calls, sent or skipped: one per frame rendered.
+  uint32_t commits = 0;
+  // Host time, not stored; 0 when the scenario sends too few frames for
+  // its time to be per frame.
+  uint32_t ns_per_frame = 0;
+};
+
+using ScenarioFn = void (*)(int variant, Recording &recording);
+
+struct Scenario {
+  std::string name;
+  ScenarioFn fn;
+  int variant;
+};
+
+// Every scenario, named as its .gld file.
+std::vector<Scenario> Scenarios();
+
+std::string GoldenPath(const std::string &name);
+bool WriteGolden(const std::string &path, const Recording &recording);
+bool ReadGolden(const std::string &path, Recording &recording);
+// First difference between the frames of two recordings, or false if they
+// are the same.
+bool Describe(const Recording &expected, const Recording &actual, char *text, std::size_t size);
+
+// A click, and a hold past the 800 ms long press.
+constexpr uint32_t kClickMs = 80;
+constexpr uint32_t kLongPressMs = 1000;
+// Time after a release by which TaskRGB has applied it: past the debounce
+// and the frame that shows it.
+constexpr uint32_t kSettleMs = 100;
+
+// What TaskRGB shows: the effect, and whether the brightness mode is dim.
+struct AppliedState {
+  EffectId effect;
+  bool dim;
+};
+AppliedState Applied();
+
+// Boots the firmware with NVS holding GlowMode |glow| and bright, on a
+// whole simulated second with nothing scheduled and no key or gesture left
+// over (sim_buttons::Reset()). TaskRGB is then run with host_sim::RunTask().
+void Boot(int glow);
+
+// Presses that TaskRGB applied differently from the script in the last
+// scenario run; only glow-buttons presses any. Each is printed as found.
+uint32_t ButtonMismatches();
+
+}  // namespace golden
@@ -0,0 +1,44 @@
+#include "mock_transmitter.h"
+
+#include <cstring>
+
+#include "host_sim.h"
+
+void MockTransmitter::transmit(const uint8_t *data, std::size_t length) {
+  finish();
+  if (in_flight_) {
+    stats_.overlapping_starts++;
+  }
+  data_ = data;
+  snapshot_.assign(data, data + length);
+  done_us_ = host_sim::NowUs() + length * kNsPerByte / 1000 + kLatchUs;
+  in_flight_ = true;
+  stats_.frames++;
+  host_sim::CountShow(static_cast<uint16_t>(length / 3));
+  if (blocking_) {
+    wait();
+  }
+}
+
+bool MockTransmitter::busy() {
+  finish();
+  return in_flight_;
+}
+
+void MockTransmitter::wait() {
+  if (in_flight_ && host_sim::NowUs() < done_us_) {
+    stats_.blocked_us += done_us_ - host_sim::NowUs();
+    host_sim::AdvanceTo(done_us_);
+  }
+  finish();
+}
+
+void MockTransmitter::finish() {
+  if (!in_flight_ || host_sim::NowUs() < done_us_) {
+    return;
+  }
+  if (std::memcmp(data_, snapshot_.data(), snapshot_.size()) != 0) {
+    stats_.torn_frames++;
+  }
+  in_flight_ = false;
+}
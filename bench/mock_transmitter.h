@@ -0,0 +1,52 @@
+#pragma once
+
+// Host mock of a strip backend. A frame takes the WS2812 wire time on the
+// simulated clock: 30 us per pixel plus the latch gap. In asynchronous mode
+// transmit() returns at once, like the RMT backend; in blocking mode it runs
+// the clock through the transfer, like a bit-banged show().
+//
+// Each frame is snapshotted when it starts and compared with the caller's
+// buffer once the transfer has finished, so a buffer that was rewritten
+// while it was being sent is counted as torn.
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "strip_transmitter.h"
+
+class MockTransmitter final : public StripTransmitter {
+ public:
+  struct Stats {
+    uint32_t frames;
+    // Frames whose buffer changed before the transfer finished.
+    uint32_t torn_frames;
+    // transmit() calls made while the previous frame was still in flight.
+    uint32_t overlapping_starts;
+    // Simulated time the caller spent blocked in transmit() or wait().
+    uint64_t blocked_us;
+  };
+
+  static constexpr uint64_t kNsPerByte = 8 * 1250;
+  static constexpr uint64_t kLatchUs = 300;
+
+  explicit MockTransmitter(bool blocking) : blocking_(blocking) {}
+
+  void begin() override {}
+  void transmit(const uint8_t *data, std::size_t length) override;
+  bool busy() override;
+  void wait() override;
+
+  const Stats &stats() const { return stats_; }
+
+ private:
+  // Closes out the frame in flight once the clock has passed its end.
+  void finish();
+
+  bool blocking_;
+  bool in_flight_ = false;
+  const uint8_t *data_ = nullptr;
+  std::vector<uint8_t> snapshot_;
+  uint64_t done_us_ = 0;
+  Stats stats_{};
+};
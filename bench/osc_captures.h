@@ -0,0 +1,103 @@
+#pragma once
+
+// Datagrams as VRChat sends them to an OSC receiver, captured on the host
+// side of the loopback: one message per datagram, in the order an avatar
+// load produces them, then a hand-made nested bundle. Replayed by the osc
+// bench case.
+
+#include <cstddef>
+#include <cstdint>
+
+namespace osc_captures {
+
+// /avatar/change ,s "avtr_..."
+inline constexpr uint8_t kAvatarChange[] = {
+    0x2f, 0x61, 0x76, 0x61, 0x74, 0x61, 0x72, 0x2f, 0x63, 0x68, 0x61, 0x6e, 0x67, 0x65, 0x00,
+    0x00, 0x2c, 0x73, 0x00, 0x00, 0x61, 0x76, 0x74, 0x72, 0x5f, 0x31, 0x63, 0x38, 0x66, 0x33,
+    0x62, 0x32, 0x65, 0x2d, 0x34, 0x64, 0x37, 0x61, 0x2d, 0x34, 0x65, 0x30, 0x62, 0x2d, 0x39,
+    0x66, 0x36, 0x31, 0x2d, 0x32, 0x61, 0x35, 0x63, 0x37, 0x64, 0x39, 0x65, 0x30, 0x62, 0x31,
+    0x33, 0x00, 0x00, 0x00
+};
+
+// /avatar/parameters/VelocityX ,f 0.0
+inline constexpr uint8_t kVelocityX[] = {
+    0x2f, 0x61, 0x76, 0x61, 0x74, 0x61, 0x72, 0x2f, 0x70, 0x61, 0x72, 0x61, 0x6d, 0x65, 0x74,
+    0x65, 0x72, 0x73, 0x2f, 0x56, 0x65, 0x6c, 0x6f, 0x63, 0x69, 0x74, 0x79, 0x58, 0x00, 0x00,
+    0x00, 0x00, 0x2c, 0x66, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00
+};
+
+// /avatar/parameters/Grounded ,T
+inline constexpr uint8_t kGrounded[] = {
+    0x2f, 0x61, 0x76, 0x61, 0x74, 0x61, 0x72, 0x2f, 0x70, 0x61, 0x72, 0x61, 0x6d, 0x65, 0x74,
+    0x65, 0x72, 0x73, 0x2f, 0x47, 0x72, 0x6f, 0x75, 0x6e, 0x64, 0x65, 0x64, 0x00, 0x2c, 0x54,
+    0x00, 0x00
+};
+
+// /avatar/parameters/GestureLeft ,i 3
+inline constexpr uint8_t kGestureLeft[] = {
+    0x2f, 0x61, 0x76, 0x61, 0x74, 0x61, 0x72, 0x2f, 0x70, 0x61, 0x72, 0x61, 0x6d, 0x65, 0x74,
+    0x65, 0x72, 0x73, 0x2f, 0x47, 0x65, 0x73, 0x74, 0x75, 0x72, 0x65, 0x4c, 0x65, 0x66, 0x74,
+    0x00, 0x00, 0x2c, 0x69, 0x00, 0x00, 0x00, 0x00, 0x00, 0x03
+};
+
+// /avatar/parameters/LightDim ,T
+inline constexpr uint8_t kLightDim[] = {
+    0x2f, 0x61, 0x76, 0x61, 0x74, 0x61, 0x72, 0x2f, 0x70, 0x61, 0x72, 0x61, 0x6d, 0x65, 0x74,
+    0x65, 0x72, 0x73, 0x2f, 0x4c, 0x69, 0x67, 0x68, 0x74, 0x44, 0x69, 0x6d, 0x00, 0x2c, 0x54,
+    0x00, 0x00
+};
+
+// /avatar/parameters/LightGlow ,i 2
+inline constexpr uint8_t kLightGlow[] = {
+    0x2f, 0x61, 0x76, 0x61, 0x74, 0x61, 0x72, 0x2f, 0x70, 0x61, 0x72, 0x61, 0x6d, 0x65, 0x74,
+    0x65, 0x72, 0x73, 0x2f, 0x4c, 0x69, 0x67, 0x68, 0x74, 0x47, 0x6c, 0x6f, 0x77, 0x00, 0x00,
+    0x00, 0x00, 0x2c, 0x69, 0x00, 0x00, 0x00, 0x00, 0x00, 0x02
+};
+
+// /avatar/parameters/LightHue ,f 0.5
+inline constexpr uint8_t kLightHue[] = {
+    0x2f, 0x61, 0x76, 0x61, 0x74, 0x61, 0x72, 0x2f, 0x70, 0x61, 0x72, 0x61, 0x6d, 0x65, 0x74,
+    0x65, 0x72, 0x73, 0x2f, 0x4c, 0x69, 0x67, 0x68, 0x74, 0x48, 0x75, 0x65, 0x00, 0x2c, 0x66,
+    0x00, 0x00, 0x3f, 0x00, 0x00, 0x00
+};
+
+// /avatar/parameters/LightToggle ,F
+inline constexpr uint8_t kLightToggleOff[] = {
+    0x2f, 0x61, 0x76, 0x61, 0x74, 0x61, 0x72, 0x2f, 0x70, 0x61, 0x72, 0x61, 0x6d, 0x65, 0x74,
+    0x65, 0x72, 0x73, 0x2f, 0x4c, 0x69, 0x67, 0x68, 0x74, 0x54, 0x6f, 0x67, 0x67, 0x6c, 0x65,
+    0x00, 0x00, 0x2c, 0x46, 0x00, 0x00
+};
+
+// #bundle [LightHue ,f 0.25; #bundle [LightNext ,T; LightNext ,F]]
+inline constexpr uint8_t kNestedBundle[] = {
+    0x23, 0x62, 0x75, 0x6e, 0x64, 0x6c, 0x65, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x01, 0x00, 0x00, 0x00, 0x24, 0x2f, 0x61, 0x76, 0x61, 0x74, 0x61, 0x72, 0x2f, 0x70, 0x61,
+    0x72, 0x61, 0x6d, 0x65, 0x74, 0x65, 0x72, 0x73, 0x2f, 0x4c, 0x69, 0x67, 0x68, 0x74, 0x48,
+    0x75, 0x65, 0x00, 0x2c, 0x66, 0x00, 0x00, 0x3e, 0x80, 0x00, 0x00, 0x00, 0x00, 0x00, 0x60,
+    0x23, 0x62, 0x75, 0x6e, 0x64, 0x6c, 0x65, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x01, 0x00, 0x00, 0x00, 0x24, 0x2f, 0x61, 0x76, 0x61, 0x74, 0x61, 0x72, 0x2f, 0x70, 0x61,
+    0x72, 0x61, 0x6d, 0x65, 0x74, 0x65, 0x72, 0x73, 0x2f, 0x4c, 0x69, 0x67, 0x68, 0x74, 0x4e,
+    0x65, 0x78, 0x74, 0x00, 0x00, 0x00, 0x00, 0x2c, 0x54, 0x00, 0x00, 0x00, 0x00, 0x00, 0x24,
+    0x2f, 0x61, 0x76, 0x61, 0x74, 0x61, 0x72, 0x2f, 0x70, 0x61, 0x72, 0x61, 0x6d, 0x65, 0x74,
+    0x65, 0x72, 0x73, 0x2f, 0x4c, 0x69, 0x67, 0x68, 0x74, 0x4e, 0x65, 0x78, 0x74, 0x00, 0x00,
+    0x00, 0x00, 0x2c, 0x46, 0x00, 0x00
+};
+
+struct Capture {
+  const uint8_t *data;
+  std::size_t length;
+};
+
+inline constexpr Capture kAvatarLoad[] = {
+    {kAvatarChange, sizeof(kAvatarChange)},
+    {kVelocityX, sizeof(kVelocityX)},
+    {kGrounded, sizeof(kGrounded)},
+    {kGestureLeft, sizeof(kGestureLeft)},
+    {kLightDim, sizeof(kLightDim)},
+    {kLightGlow, sizeof(kLightGlow)},
+    {kLightHue, sizeof(kLightHue)},
+    {kLightToggleOff, sizeof(kLightToggleOff)},
+    {kNestedBundle, sizeof(kNestedBundle)},
+};
+
+}  // namespace osc_captures
@@ -0,0 +1,76 @@
+#include "sim_buttons.h"
+
+#include <Arduino.h>
+
+#include <cstddef>
+
+#include "button_gesture.h"
+#include "button_pad.h"
+#include "host_sim.h"
+#include "spsc_ring.h"
+
+extern ButtonGesture button_keys[3];
+extern SpscRing<InputEvent, 16> input_ring;
+uint32_t ServiceButtons();
+
+namespace sim_buttons {
+namespace {
+
+constexpr uint64_t kUsPerMs = 1000;
+constexpr uint32_t kBounceUs[] = {0, 300, 900, 1600, 2400};
+// The level has settled this long after the edge.
+constexpr uint64_t kSettleUs = 3000;
+
+uint32_t service_generation = 0;
+
+}  // namespace
+
+void ScheduleEdge(uint8_t pin, uint64_t at_us, int level, bool service) {
+  for (std::size_t i = 0; i < sizeof(kBounceUs) / sizeof(kBounceUs[0]); ++i) {
+    const int bounced = (i % 2 == 0) ? level : (level == LOW ? HIGH : LOW);
+    host_sim::Schedule(at_us + kBounceUs[i], [pin, bounced, service] {
+      host_sim::SetPinLevel(pin, bounced);
+      if (service) {
+        Service();
+      }
+    });
+  }
+  host_sim::Schedule(at_us + kSettleUs, [pin, level, service] {
+    host_sim::SetPinLevel(pin, level);
+    if (service) {
+      Service();
+    }
+  });
+}
+
+void SchedulePress(uint8_t pin, uint64_t down_us, uint64_t held_us) {
+  ScheduleEdge(pin, down_us, LOW, true);
+  ScheduleEdge(pin, down_us + held_us, HIGH, true);
+}
+
+void Service() {
+  const uint32_t generation = ++service_generation;
+  const uint32_t delay_ms = ServiceButtons();
+  if (delay_ms != ButtonGesture::kNoDeadline) {
+    host_sim::Schedule(host_sim::NowUs() + delay_ms * kUsPerMs, [generation] {
+      if (generation == service_generation) {
+        Service();
+      }
+    });
+  }
+}
+
+void Reset() {
+  host_sim::ClearSchedule();
+  for (uint8_t pin : {kMainPin, kUser2Pin, kBootPin}) {
+    host_sim::SetPinLevel(pin, HIGH);
+  }
+  for (ButtonGesture &key : button_keys) {
+    key.cancel();
+  }
+  InputEvent stale;
+  while (input_ring.pop(stale)) {
+  }
+}
+
+}  // namespace sim_buttons
@@ -0,0 +1,38 @@
+#pragma once
+
+// Button presses for benches that run TaskRGB on its own. Each edge moves
+// the simulated pin, then runs TaskButton's loop body (ServiceButtons() in
+// main.cpp) on the bench clock, and again at every deadline the gesture
+// layer hands back. A press therefore reaches TaskRGB as it does on the
+// device: through ButtonGesture, ButtonPad, the input ring and a kInput
+// event.
+
+#include <cstdint>
+
+namespace sim_buttons {
+
+// KEY_USER_MAIN, KEY_USER_2 and KEY_USER_BOOT.
+constexpr uint8_t kMainPin = 4;
+constexpr uint8_t kUser2Pin = 2;
+constexpr uint8_t kBootPin = 9;
+
+// Schedules |pin| moving to |level| at |at_us| with a few milliseconds of
+// contact bounce. With |service|, the keys are serviced after every change.
+void ScheduleEdge(uint8_t pin, uint64_t at_us, int level, bool service);
+
+// Schedules |pin| pressed at |down_us| and released |held_us| later,
+// serviced, with bounce on both edges.
+void SchedulePress(uint8_t pin, uint64_t down_us, uint64_t held_us);
+
+// Runs ServiceButtons() now and at the deadline it returns. A later call
+// supersedes the deadline of an earlier one.
+void Service();
+
+// Drops whatever is still scheduled, lets go of every key and forgets
+// main.cpp's gestures: any press or click run in progress and whatever
+// waits in the input ring. On the device a reset starts from there; here
+// setup() runs again in the same process, so a case calls this before it
+// boots, or after a run that can end part way through a press.
+void Reset();
+
+}  // namespace sim_buttons
@@ -0,0 +1,88 @@
+#pragma once
+
+#include <cstdint>
+
+// Hardware-independent debounce and gesture state machine for one push
+// button, following OneButton's click / multi-click / long-press semantics.
+// With setMaxClicks(1), the default, a click is reported on release; with
+// more, the machine waits up to the click gap for another press and reports
+// the run as a click, a double click or a multi-click. The caller
+// feeds it the raw pressed level whenever it wakes (on a GPIO edge or at the
+// deadline update() returned) and blocks indefinitely while it is idle, so a
+// released button costs no wakeups at all.
+class ButtonGesture {
+ public:
+  enum class Event : uint8_t {
+    kClick = 0,
+    kLongPressStart,
+    kDuringLongPress,
+    kLongPressStop,
+    kDoubleClick,
+    // Three or more clicks; clicks() says how many.
+    kMultiClick,
+  };
+
+  using Handler = void (*)(Event event, void *context);
+
+  // Returned by update() when only a GPIO edge can make progress.
+  static constexpr uint32_t kNoDeadline = UINT32_MAX;
+
+  ButtonGesture();
+
+  void setHandler(Handler handler, void *context);
+  void setDebounceMs(uint16_t ms) { debounce_ms_ = ms; }
+  void setPressMs(uint16_t ms) { press_ms_ = ms; }
+  // Period of kDuringLongPress events while held; 0 disables them.
+  void setLongPressIntervalMs(uint16_t ms) { long_press_interval_ms_ = ms; }
+  // Longest run of clicks reported as one event, and the longest release
+  // between two of them. A run reaching |clicks| is reported at once.
+  void setMaxClicks(uint8_t clicks) { max_clicks_ = clicks != 0 ? clicks : 1; }
+  void setClickGapMs(uint16_t ms) { click_gap_ms_ = ms; }
+
+  // Advances the machine with the current raw level and returns how many
+  // milliseconds may pass before it must be called again without an edge.
+  uint32_t update(bool pressed, uint32_t now_ms);
+
+  // Drops the gesture in progress: a held button reports nothing more until
+  // it has been released, and pending clicks are forgotten. Used when the
+  // button becomes part of a chord.
+  void cancel();
+
+  bool idle() const { return state_ == State::kIdle && raw_pressed_ == stable_pressed_; }
+  // Debounced level.
+  bool pressed() const { return stable_pressed_; }
+  // Clicks in the run the last click event reported.
+  uint8_t clicks() const { return clicks_; }
+
+ private:
+  enum class State : uint8_t {
+    kIdle = 0,
+    kDown,
+    kLongPress,
+    // Released after a click, waiting for the next one.
+    kUp,
+    // Cancelled while held; waiting for the release.
+    kCancelled,
+  };
+
+  void emit(Event event);
+  void emitClicks();
+  static uint32_t Remaining(uint32_t since_ms, uint32_t period_ms, uint32_t now_ms);
+
+  Handler handler_;
+  void *context_;
+  uint16_t debounce_ms_;
+  uint16_t press_ms_;
+  uint16_t long_press_interval_ms_;
+  uint16_t click_gap_ms_;
+  uint8_t max_clicks_;
+
+  State state_;
+  bool raw_pressed_;
+  bool stable_pressed_;
+  uint32_t raw_since_ms_;
+  uint32_t press_start_ms_;
+  uint32_t last_during_ms_;
+  uint32_t release_ms_;
+  uint8_t clicks_;
+};
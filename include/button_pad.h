@@ -0,0 +1,77 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#include "button_gesture.h"
+
+// What a ButtonPad reports. The first six follow ButtonGesture::Event for
+// one key; kChord is two or more keys held down together.
+enum class InputGesture : uint8_t {
+  kClick = 0,
+  kDoubleClick,
+  kMultiClick,
+  kLongPressStart,
+  kHoldRepeat,
+  kLongPressStop,
+  kChord,
+};
+
+// One recognised gesture. |at_us| is when the user made it: the edge that
+// completed it, or for a long press and its repeats, the moment the hold
+// reached them. A click run reported after the click gap therefore carries
+// the time of its last release, so the wait for more clicks counts towards
+// its latency.
+struct InputEvent {
+  uint32_t at_us;
+  // Bit per key: one bit for a single key, all of them for a chord.
+  uint8_t keys;
+  InputGesture gesture;
+  // Clicks in the run, for the click gestures.
+  uint8_t clicks;
+};
+
+// Gesture layer over up to kMaxKeys buttons: runs a ButtonGesture per key
+// and adds chords. Once a second key goes down while another is held, a
+// kChord is reported for the keys down and every key in it is cancelled,
+// so none of them reports a click or long press of its own; keys pressed
+// before all are released join the chord silently.
+class ButtonPad {
+ public:
+  static constexpr std::size_t kMaxKeys = 4;
+
+  using Sink = void (*)(const InputEvent &event, void *context);
+
+  // |keys| are configured by the caller (click count, gap, repeat period)
+  // and owned by it; the pad takes over their handlers.
+  ButtonPad(ButtonGesture *keys, std::size_t count);
+
+  void setSink(Sink sink, void *context);
+
+  // Advances every key with its raw level, bit k of |pressed| for key k,
+  // and returns the milliseconds before it must be called again without an
+  // edge (ButtonGesture::kNoDeadline when every key is idle). The keys run
+  // on |now_ms|; |now_us| only stamps events, so both may wrap.
+  uint32_t update(uint32_t pressed, uint32_t now_ms, uint32_t now_us);
+
+ private:
+  struct KeyContext {
+    ButtonPad *pad;
+    uint8_t key;
+  };
+
+  static void OnKeyGesture(ButtonGesture::Event event, void *context);
+  void report(uint8_t keys, InputGesture gesture, uint8_t clicks, uint32_t at_us);
+
+  ButtonGesture *keys_;
+  std::size_t count_;
+  KeyContext contexts_[kMaxKeys];
+  Sink sink_;
+  void *sink_context_;
+
+  uint32_t raw_pressed_;
+  uint32_t edge_us_[kMaxKeys];
+  uint32_t now_us_;
+  // Keys of the chord in progress, until all are released.
+  uint8_t chord_;
+};
@@ -0,0 +1,103 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+// Compile-time colour lookup tables. Colours are packed as 0x00RRGGBB, the
+// same layout Adafruit_NeoPixel::Color() produces, so table entries can be
+// handed straight to setPixelColor().
+
+namespace color_tables {
+
+constexpr std::size_t kTableSize = 256;
+
+using ColorTable = std::array<uint32_t, kTableSize>;
+using ByteTable = std::array<uint8_t, kTableSize>;
+
+constexpr uint32_t Pack(uint8_t r, uint8_t g, uint8_t b) {
+  return (static_cast<uint32_t>(r) << 16) | (static_cast<uint32_t>(g) << 8) | b;
+}
+
+constexpr uint8_t Red(uint32_t color) { return static_cast<uint8_t>(color >> 16); }
+constexpr uint8_t Green(uint32_t color) { return static_cast<uint8_t>(color >> 8); }
+constexpr uint8_t Blue(uint32_t color) { return static_cast<uint8_t>(color); }
+
+// The classic strandtest colour wheel: r -> g -> b -> back to r.
+constexpr uint32_t WheelColor(uint8_t wheel_pos) {
+  wheel_pos = static_cast<uint8_t>(255 - wheel_pos);
+  if (wheel_pos < 85) {
+    return Pack(static_cast<uint8_t>(255 - wheel_pos * 3), 0, static_cast<uint8_t>(wheel_pos * 3));
+  }
+  if (wheel_pos < 170) {
+    wheel_pos = static_cast<uint8_t>(wheel_pos - 85);
+    return Pack(0, static_cast<uint8_t>(wheel_pos * 3), static_cast<uint8_t>(255 - wheel_pos * 3));
+  }
+  wheel_pos = static_cast<uint8_t>(wheel_pos - 170);
+  return Pack(static_cast<uint8_t>(wheel_pos * 3), static_cast<uint8_t>(255 - wheel_pos * 3), 0);
+}
+
+namespace detail {
+
+// Newton iteration for the n-th root on [0, 1]; starts above the root so it
+// converges monotonically even for tiny inputs.
+constexpr double NthRoot(double value, int n) {
+  if (value <= 0.0) {
+    return 0.0;
+  }
+  double x = 1.0;
+  for (int iteration = 0; iteration < 128; ++iteration) {
+    double power = 1.0;
+    for (int i = 0; i < n - 1; ++i) {
+      power *= x;
+    }
+    x = ((n - 1) * x + value / power) / n;
+  }
+  return x;
+}
+
+// x^(numerator/denominator) for x in [0, 1].
+constexpr double RationalPower(double x, int numerator, int denominator) {
+  double power = 1.0;
+  for (int i = 0; i < numerator; ++i) {
+    power *= x;
+  }
+  return NthRoot(power, denominator);
+}
+
+}  // namespace detail
+
+// Gamma 2.6 (13/5), the curve Adafruit_NeoPixel::gamma8() uses.
+constexpr ByteTable BuildGammaTable() {
+  ByteTable table{};
+  for (std::size_t i = 0; i < kTableSize; ++i) {
+    const double corrected = detail::RationalPower(static_cast<double>(i) / 255.0, 13, 5);
+    table[i] = static_cast<uint8_t>(corrected * 255.0 + 0.5);
+  }
+  return table;
+}
+
+constexpr ByteTable kGamma8 = BuildGammaTable();
+
+constexpr uint32_t GammaCorrect(uint32_t color) {
+  return Pack(kGamma8[Red(color)], kGamma8[Green(color)], kGamma8[Blue(color)]);
+}
+
+constexpr ColorTable BuildWheelTable(bool gamma) {
+  ColorTable table{};
+  for (std::size_t i = 0; i < kTableSize; ++i) {
+    const uint32_t color = WheelColor(static_cast<uint8_t>(i));
+    table[i] = gamma ? GammaCorrect(color) : color;
+  }
+  return table;
+}
+
+inline constexpr ColorTable kWheel = BuildWheelTable(false);
+inline constexpr ColorTable kWheelGamma = BuildWheelTable(true);
+
+static_assert(kWheel[0] == Pack(255, 0, 0), "wheel starts at red");
+static_assert(kWheel[85] == Pack(0, 255, 0), "wheel reaches green at 85");
+static_assert(kWheel[170] == Pack(0, 0, 255), "wheel reaches blue at 170");
+static_assert(kGamma8[0] == 0 && kGamma8[255] == 255, "gamma keeps the end points");
+
+}  // namespace color_tables
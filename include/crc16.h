@@ -0,0 +1,17 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+// CRC-16/CCITT-FALSE. Pass the previous result as |crc| to continue over a
+// second span.
+inline uint16_t Crc16(const uint8_t *data, std::size_t length, uint16_t crc = 0xffff) {
+  for (std::size_t i = 0; i < length; ++i) {
+    crc ^= static_cast<uint16_t>(data[i]) << 8;
+    for (int bit = 0; bit < 8; ++bit) {
+      crc = (crc & 0x8000) ? static_cast<uint16_t>((crc << 1) ^ 0x1021)
+                           : static_cast<uint16_t>(crc << 1);
+    }
+  }
+  return crc;
+}
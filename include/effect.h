@@ -0,0 +1,59 @@
+#pragma once
+
+#include <cstdint>
+
+// Common types for the effect engine. An effect is a plain struct with a
+// State type and static start()/render() functions; effect_engine.h lists
+// them in a compile-time registry and keeps the active effect's State in a
+// statically sized arena, so there is no heap allocation and no virtual
+// dispatch.
+
+enum class EffectId : uint8_t {
+  kSolid = 0,
+  kBreathing,
+  kColorWipe,
+  kTheaterChase,
+  kRainbow,
+  kTheaterChaseRainbow,
+  kStream,
+  kPulse,
+  kHeartbeat,
+  kSparkle,
+  kRadialWave,
+  kSweep,
+  kNoise,
+  kCount,
+};
+
+constexpr uint8_t kEffectFlagGamma = 1 << 0;
+
+struct EffectParams {
+  uint32_t color;
+  // Time per animation step; 0 makes the effect static (drawn once).
+  uint16_t step_ms;
+  // Waveform phase advanced per step by the effects that sample one
+  // (waveform.h), 65536 to the cycle.
+  uint16_t phase_step;
+  // Output level; Frame::level starts here every frame.
+  uint8_t level;
+  // Output level range for level-modulating effects.
+  uint8_t level_min;
+  uint8_t level_max;
+  uint8_t flags;
+};
+
+// Pixels an effect draws into, packed 0x00RRGGBB.
+struct PixelSpan {
+  uint32_t *pixels;
+  uint16_t count;
+};
+
+// Everything render() needs for one frame. |step| is the animation step the
+// frame shows, derived from elapsed time by the engine. |level| is the
+// output intensity the effect wants; it starts at EffectParams::level.
+struct Frame {
+  PixelSpan target;
+  uint32_t step;
+  const EffectParams &params;
+  uint8_t level;
+};
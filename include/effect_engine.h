@@ -0,0 +1,215 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <new>
+#include <type_traits>
+
+#include "effect.h"
+#include "effects.h"
+#include "frame_cache.h"
+#include "pixel_output.h"
+
+// Type-erased entry points for one effect, built at compile time from the
+// effect's static functions. |state| points into the engine's arena.
+struct EffectDescriptor {
+  EffectId id;
+  const char *name;
+  std::size_t state_size;
+  // Steps per cycle and cycles to completion (effects.h); period 0 for an
+  // effect that does not repeat.
+  uint32_t period;
+  uint32_t cycles;
+  void (*start)(void *state, const EffectParams &params, PixelSpan target);
+  bool (*render)(void *state, Frame &frame);
+};
+
+// kPeriod and kCycles of an effect that declares them, 0 for the rest.
+template <typename Effect, typename = void>
+struct EffectPeriod {
+  static constexpr uint32_t kSteps = 0;
+  static constexpr uint32_t kCycles = 0;
+};
+
+template <typename Effect>
+struct EffectPeriod<Effect, decltype(void(Effect::kPeriod))> {
+  static constexpr uint32_t kSteps = Effect::kPeriod;
+  static constexpr uint32_t kCycles = Effect::kCycles;
+  static_assert(kSteps <= FrameCache::kMaxPeriod, "period is longer than a FrameCache covers");
+};
+
+template <typename Effect>
+constexpr EffectDescriptor DescribeEffect() {
+  using State = typename Effect::State;
+  static_assert(std::is_trivially_destructible<State>::value,
+                "effect state is overwritten in place when the effect changes");
+  return EffectDescriptor{
+      Effect::kId,
+      Effect::kName,
+      sizeof(State),
+      EffectPeriod<Effect>::kSteps,
+      EffectPeriod<Effect>::kCycles,
+      [](void *state, const EffectParams &params, PixelSpan target) {
+        Effect::start(*new (state) State{}, params, target);
+      },
+      [](void *state, Frame &frame) { return Effect::render(*static_cast<State *>(state), frame); },
+  };
+}
+
+// The set of effects and the arena size they need: an engine slot runs one
+// effect at a time, so its arena is as large as the largest State.
+template <typename... Effects>
+struct EffectRegistry {
+  static constexpr std::size_t kCount = sizeof...(Effects);
+  static constexpr std::size_t kArenaSize = std::max({sizeof(typename Effects::State)...});
+  static constexpr std::size_t kArenaAlign = std::max({alignof(typename Effects::State)...});
+  static constexpr EffectDescriptor kDescriptors[] = {DescribeEffect<Effects>()...};
+
+  static constexpr bool InIdOrder() {
+    for (std::size_t i = 0; i < kCount; ++i) {
+      if (static_cast<std::size_t>(kDescriptors[i].id) != i) {
+        return false;
+      }
+    }
+    return true;
+  }
+};
+
+// Adding an effect: declare it in effects.h, add its EffectId, list it here.
+using BuiltinEffects = EffectRegistry<SolidEffect,
+                                      BreathingEffect,
+                                      ColorWipeEffect,
+                                      TheaterChaseEffect,
+                                      RainbowEffect,
+                                      TheaterChaseRainbowEffect,
+                                      StreamEffect,
+                                      PulseEffect,
+                                      HeartbeatEffect,
+                                      SparkleEffect,
+                                      RadialWaveEffect,
+                                      SweepEffect,
+                                      NoiseEffect>;
+
+static_assert(BuiltinEffects::kCount == static_cast<std::size_t>(EffectId::kCount),
+              "every EffectId needs a registry entry");
+static_assert(BuiltinEffects::InIdOrder(), "registry entries must follow EffectId order");
+
+// Runs the active effect against a PixelOutput. Frames are clock driven: the
+// step shown is the time since start() divided by EffectParams::step_ms, so
+// a late render() skips the missed steps instead of slowing the animation
+// down. Effects draw into the output's source frame and report a level,
+// which becomes the output intensity; the engine commits.
+//
+// crossfadeTo() keeps the outgoing effect running in a second slot. During
+// the fade each effect renders into its own half of the transition buffer
+// and the two are mixed into the source frame, with each effect's level
+// folded into its blend weight.
+//
+// With a FrameCache attached, the active effect's frames are replayed from
+// the cache once drawn if the effect is periodic and its cycle fits; the
+// outgoing effect of a crossfade always renders live.
+//
+// While the output is dithering (PixelOutput::dithering()), render() also
+// recommits the frame every dither interval between steps, without drawing,
+// so a static or slow effect at a low level still shows its in-between
+// values.
+class EffectEngine {
+ public:
+  static constexpr uint32_t kNoDeadline = UINT32_MAX;
+
+  // |transition_buffer| holds 2 * output.numPixels() pixels and is owned by
+  // the caller; without one, crossfadeTo() cuts like start().
+  explicit EffectEngine(PixelOutput &output, uint32_t *transition_buffer = nullptr);
+
+  // Makes |id| the active effect with fresh state, ending any crossfade; its
+  // first frame is drawn by the next render().
+  void start(EffectId id, const EffectParams &params);
+  // Starts |id| and fades to it from what is showing over |duration_ms|.
+  void crossfadeTo(EffectId id, const EffectParams &params, uint16_t duration_ms);
+  // Redraws the current step on the next render(), e.g. after a brightness
+  // or parameter change.
+  void refresh() { force_refresh_ = true; }
+  // Replaces the active effect's parameters without restarting it.
+  void setParams(const EffectParams &params);
+
+  // Draws and commits a frame if one is due. Returns the same value as
+  // nextFrameDelayMs().
+  uint32_t render();
+  // Milliseconds until render() has work to do, or kNoDeadline for a static
+  // effect that has been drawn.
+  uint32_t nextFrameDelayMs() const;
+
+  // Minimum time between rendered frames. Steps that fall in between are
+  // skipped, so a lower frame rate does not change the animation speed.
+  void setFrameInterval(uint16_t interval_ms) { frame_interval_ = interval_ms; }
+  // Longest time between commits while the output is dithering; 0 leaves
+  // dithered frames to the effect's own steps.
+  void setDitherInterval(uint16_t interval_ms) { dither_interval_ = interval_ms; }
+  // Caches the frames of periodic effects in |cache| from the next start()
+  // or crossfadeTo(); nullptr renders everything live.
+  void setFrameCache(FrameCache *cache);
+  FrameCache *frameCache() const { return frame_cache_; }
+
+  EffectId effect() const { return active().effect; }
+  const EffectParams &params() const { return active().params; }
+  // True once the active effect has played through (finite effects only).
+  bool complete() const { return active().complete; }
+  bool transitioning() const { return transitioning_; }
+  // Steps of the active effect that were never rendered because render()
+  // ran late or the frame interval throttled it.
+  uint32_t skippedFrames() const { return skipped_frames_; }
+  PixelOutput &output() { return output_; }
+
+  static const EffectDescriptor &describe(EffectId id);
+
+ private:
+  struct Slot {
+    const EffectDescriptor *descriptor;
+    EffectId effect;
+    EffectParams params;
+    uint32_t *pixels;
+    unsigned long phase_start;
+    uint32_t phase_step;
+    uint8_t level;
+    bool complete;
+    // Frames come from and go to frame_cache_.
+    bool cached;
+    alignas(BuiltinEffects::kArenaAlign) unsigned char arena[BuiltinEffects::kArenaSize];
+  };
+
+  Slot &active() { return slots_[active_]; }
+  const Slot &active() const { return slots_[active_]; }
+  Slot &outgoing() { return slots_[active_ ^ 1]; }
+
+  void startSlot(Slot &slot, EffectId id, const EffectParams &params, uint32_t *pixels);
+  // Binds the cache to |slot|'s effect, or leaves it rendering live.
+  void bindCache(Slot &slot);
+  // Renders |slot| if its step changed (or |force|); returns true if it drew.
+  bool renderSlot(Slot &slot, unsigned long now, bool force);
+  void renderTransition(unsigned long now);
+  uint32_t stepDelayMs(const Slot &slot, unsigned long now) const;
+  // Milliseconds until the next frame to draw, and until the next dithered
+  // recommit (kNoDeadline when the output is not dithering).
+  uint32_t frameDelayMs(unsigned long now) const;
+  uint32_t ditherDelayMs(unsigned long now) const;
+  void commitFrame(unsigned long now);
+  // Commits the unchanged frame again if a dithered one is due.
+  void ditherIfDue(unsigned long now);
+
+  PixelOutput &output_;
+  uint32_t *transition_buffer_;
+  FrameCache *frame_cache_;
+  Slot slots_[2];
+  uint8_t active_;
+  bool force_refresh_;
+  unsigned long frame_previous_;
+  uint16_t frame_interval_;
+  uint16_t dither_interval_;
+  unsigned long commit_previous_;
+  uint32_t skipped_frames_;
+
+  bool transitioning_;
+  unsigned long transition_start_;
+  uint16_t transition_ms_;
+};
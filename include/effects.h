@@ -0,0 +1,168 @@
+#pragma once
+
+#include "effect.h"
+
+class FrameStream;
+class PixelLayout;
+
+// Built-in effects. start() runs when the effect becomes active and may draw
+// the initial frame; render() draws the frame for Frame::step and returns
+// true once a finite effect has played through, which lets auto-cycling move
+// on early. Continuous effects always return false.
+//
+// An effect whose frames repeat declares kPeriod, the steps in one cycle:
+// its pixels at step s depend only on s % kPeriod and the color and flags
+// of EffectParams, and it leaves Frame::level alone. kCycles is the number of cycles
+// after which render() reports completion, on the last step of the last one; 0
+// for a continuous effect. The engine can then replay frames from a FrameCache
+// (frame_cache.h) instead of rendering them.
+
+struct SolidEffect {
+  static constexpr EffectId kId = EffectId::kSolid;
+  static constexpr const char *kName = "solid";
+  struct State {};
+  static void start(State &state, const EffectParams &params, PixelSpan target);
+  static bool render(State &state, Frame &frame);
+};
+
+// Effects that follow a waveform (waveform.h) advance its phase by
+// EffectParams::phase_step each step, so one cycle takes 65536 / phase_step
+// steps; a phase_step of 0 holds them still.
+
+// A sine wave in perceived lightness on the output level, from level_max
+// down to level_min and back. The colour is drawn once at start; each step
+// only changes Frame::level.
+struct BreathingEffect {
+  static constexpr EffectId kId = EffectId::kBreathing;
+  static constexpr const char *kName = "breathing";
+  struct State {};
+  static void start(State &state, const EffectParams &params, PixelSpan target);
+  static bool render(State &state, Frame &frame);
+};
+
+struct ColorWipeEffect {
+  static constexpr EffectId kId = EffectId::kColorWipe;
+  static constexpr const char *kName = "color_wipe";
+  struct State {
+    uint16_t position;
+  };
+  static void start(State &state, const EffectParams &params, PixelSpan target);
+  static bool render(State &state, Frame &frame);
+};
+
+struct TheaterChaseEffect {
+  static constexpr EffectId kId = EffectId::kTheaterChase;
+  static constexpr const char *kName = "theater_chase";
+  static constexpr uint32_t kPeriod = 3;
+  static constexpr uint32_t kCycles = 10;
+  struct State {};
+  static void start(State &state, const EffectParams &params, PixelSpan target);
+  static bool render(State &state, Frame &frame);
+};
+
+struct RainbowEffect {
+  static constexpr EffectId kId = EffectId::kRainbow;
+  static constexpr const char *kName = "rainbow";
+  static constexpr uint32_t kPeriod = 256;
+  static constexpr uint32_t kCycles = 0;
+  struct State {};
+  static void start(State &state, const EffectParams &params, PixelSpan target);
+  static bool render(State &state, Frame &frame);
+};
+
+struct TheaterChaseRainbowEffect {
+  static constexpr EffectId kId = EffectId::kTheaterChaseRainbow;
+  static constexpr const char *kName = "theater_chase_rainbow";
+  // The chase repeats every 3 steps and the colours every 256.
+  static constexpr uint32_t kPeriod = 3 * 256;
+  static constexpr uint32_t kCycles = 0;
+  struct State {};
+  static void start(State &state, const EffectParams &params, PixelSpan target);
+  static bool render(State &state, Frame &frame);
+};
+
+// waveform::kPulse on the output level between level_min and level_max: a
+// swell and fade once a cycle, then rest. Drawn like breathing.
+struct PulseEffect {
+  static constexpr EffectId kId = EffectId::kPulse;
+  static constexpr const char *kName = "pulse";
+  struct State {};
+  static void start(State &state, const EffectParams &params, PixelSpan target);
+  static bool render(State &state, Frame &frame);
+};
+
+// waveform::kHeartbeat on the output level: two beats a cycle, then rest.
+struct HeartbeatEffect {
+  static constexpr EffectId kId = EffectId::kHeartbeat;
+  static constexpr const char *kName = "heartbeat";
+  struct State {};
+  static void start(State &state, const EffectParams &params, PixelSpan target);
+  static bool render(State &state, Frame &frame);
+};
+
+// Every pixel glints in the colour once a cycle, following waveform::kSparkle
+// from its own phase offset, hashed from its index so the glints fall in no
+// visible order. Needs no state however long the strip.
+struct SparkleEffect {
+  static constexpr EffectId kId = EffectId::kSparkle;
+  static constexpr const char *kName = "sparkle";
+  struct State {};
+  static void start(State &state, const EffectParams &params, PixelSpan target);
+  static bool render(State &state, Frame &frame);
+};
+
+// Effects drawn by position from the attached PixelLayout (pixel_layout.h).
+// Each pixel costs one read of its precomputed place and a waveform sample,
+// whatever the layout's shape. Pixels the layout does not place stay black,
+// as does the whole strip with no layout attached.
+
+// Rings of the colour travelling out from the layout's centre:
+// waveform::kSine over the radius, kRadialWaves rings at a time, moving one
+// ring spacing a cycle.
+struct RadialWaveEffect {
+  static constexpr EffectId kId = EffectId::kRadialWave;
+  static constexpr const char *kName = "radial_wave";
+  static constexpr uint8_t kRadialWaves = 2;
+  struct State {};
+  static void start(State &state, const EffectParams &params, PixelSpan target);
+  static bool render(State &state, Frame &frame);
+};
+
+// A beam turning once a cycle round the layout's centre; each pixel lights
+// as it passes and fades along waveform::kSparkle, leaving a tail.
+struct SweepEffect {
+  static constexpr EffectId kId = EffectId::kSweep;
+  static constexpr const char *kName = "sweep";
+  struct State {};
+  static void start(State &state, const EffectParams &params, PixelSpan target);
+  static bool render(State &state, Frame &frame);
+};
+
+// 2-D value noise on the colour's brightness: a hashed level at each point
+// of a lattice kNoiseCells cells across the plane, blended between them,
+// drifting by one cell a cycle.
+struct NoiseEffect {
+  static constexpr EffectId kId = EffectId::kNoise;
+  static constexpr const char *kName = "noise";
+  static constexpr uint8_t kNoiseCells = 4;
+  struct State {};
+  static void start(State &state, const EffectParams &params, PixelSpan target);
+  static bool render(State &state, Frame &frame);
+};
+
+// The layout every spatial effect draws by.
+void AttachLayout(const PixelLayout *layout);
+
+// Frames pushed by a host (frame_stream.h). Static in the engine's sense:
+// it draws only when refreshed, and each render decodes whatever frames of
+// the attached stream are due straight into the target, which still holds
+// the previous frame for the deltas to apply to. Starts black.
+struct StreamEffect {
+  static constexpr EffectId kId = EffectId::kStream;
+  static constexpr const char *kName = "stream";
+  struct State {};
+  static void start(State &state, const EffectParams &params, PixelSpan target);
+  static bool render(State &state, Frame &frame);
+  // The stream every StreamEffect decodes from; without one it stays black.
+  static void attach(FrameStream *stream);
+};
@@ -0,0 +1,69 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#include "effect.h"
+
+// Replays the frames of a periodic effect from RAM. An effect that declares
+// a period (effects.h) draws the same pixels at step s as at s % period, so
+// once a step of the cycle has been drawn it can be copied back on every
+// later lap instead of being rendered again.
+//
+// The cache fills as the effect plays: the engine stores each frame the
+// first time it draws that step, so the first lap costs one copy per frame
+// more than live rendering and there is no burst of work at start. A cycle
+// larger than the storage is not cached at all and renders live.
+class FrameCache {
+ public:
+  // Longest period the fill bitmap covers.
+  static constexpr uint32_t kMaxPeriod = 1024;
+
+  struct Stats {
+    // Frames copied from the cache and frames stored into it.
+    uint32_t hits;
+    uint32_t stores;
+    // bind() calls whose cycle did not fit.
+    uint32_t over_budget;
+  };
+
+  // |storage| holds |capacity| pixels and is owned by the caller.
+  FrameCache(uint32_t *storage, std::size_t capacity);
+
+  // Caches |id| drawing |count| pixels with |params|, |period| steps to a
+  // cycle. Binding to what is already cached keeps the frames; anything else
+  // drops them. Returns false, leaving the cache unbound, if the cycle does
+  // not fit or |period| is 0.
+  bool bind(EffectId id, const EffectParams &params, uint16_t count, uint32_t period);
+  void unbind() { period_ = 0; }
+  bool bound() const { return period_ != 0; }
+
+  // Copies the frame for |step| into |pixels|; false if it is not cached.
+  bool replay(uint32_t step, uint32_t *pixels);
+  // Keeps |pixels| as the frame for |step|.
+  void store(uint32_t step, const uint32_t *pixels);
+
+  // Bytes a cycle of |period| steps at |count| pixels takes.
+  static constexpr std::size_t CycleBytes(uint32_t period, uint16_t count) {
+    return static_cast<std::size_t>(period) * count * sizeof(uint32_t);
+  }
+  // Bytes the bound cycle takes once it is filled; 0 when unbound.
+  std::size_t bytesUsed() const { return CycleBytes(period_, count_); }
+  std::size_t capacityBytes() const { return capacity_ * sizeof(uint32_t); }
+
+  const Stats &stats() const { return stats_; }
+  void resetStats() { stats_ = Stats{}; }
+
+ private:
+  bool filled(uint32_t index) const { return (filled_[index / 32] >> (index % 32)) & 1; }
+
+  uint32_t *storage_;
+  std::size_t capacity_;
+  EffectId effect_;
+  uint32_t color_;
+  uint8_t flags_;
+  uint16_t count_;
+  uint32_t period_;
+  uint32_t filled_[kMaxPeriod / 32];
+  Stats stats_;
+};
@@ -0,0 +1,178 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+#include "effect.h"
+
+// Frames pushed by an external host for the streaming glow mode.
+//
+// A frame is sent as one or more chunks, each a protocol_cmd::kStreamFrame
+// payload:
+//
+//   seq:u8 | time_ms:u16 | first_pixel:u16 | flags:u8 | ops...
+//
+// |seq| numbers frames (all chunks of a frame share it), |time_ms| is the
+// host's presentation time and sets the playout rate, and the ops redraw the
+// strip from |first_pixel| on. Pixels an op does not reach keep their value
+// from the previous frame, so ops only have to cover what changed. Each op
+// is one header byte, the top two bits its kind and the low six bits its
+// pixel count minus one:
+//
+//   00 skip     n pixels unchanged
+//   01 run      n pixels of the colour that follows (r g b)
+//   10 literal  n pixels, each followed by its colour (r g b)
+//
+// A keyframe covers every pixel without skips and restarts the delta chain.
+namespace stream_op {
+constexpr uint8_t kSkip = 0x00;
+constexpr uint8_t kRun = 0x40;
+constexpr uint8_t kLiteral = 0x80;
+constexpr uint8_t kKindMask = 0xc0;
+constexpr uint8_t kMaxCount = 64;
+}  // namespace stream_op
+
+constexpr uint8_t kStreamKeyframe = 1 << 0;
+constexpr uint8_t kStreamEndOfFrame = 1 << 1;
+
+constexpr std::size_t kStreamHeaderSize = 6;
+// Ops in one chunk: a protocol frame body less the command and chunk header.
+constexpr std::size_t kMaxStreamOps = 248;
+
+struct StreamChunkHeader {
+  uint8_t seq;
+  uint16_t time_ms;
+  uint16_t first_pixel;
+  uint8_t flags;
+};
+
+// Encodes |current| against |previous| (nullptr for a keyframe) from the
+// first pixel on, stopping at a pixel boundary when |out| is full. Returns
+// the bytes written; |pixels_done| is how many pixels the ops cover.
+std::size_t EncodeStreamOps(const uint32_t *previous, const uint32_t *current, uint16_t count,
+                            uint8_t *out, std::size_t capacity, uint16_t &pixels_done);
+
+// Host-side encoder: writes |current| as complete kStreamFrame protocol
+// frames, split into as many chunks as it needs. Returns the bytes written,
+// or 0 if |out| is too small.
+std::size_t EncodeStreamFrame(const uint32_t *previous, const uint32_t *current, uint16_t count,
+                              uint8_t seq, uint16_t time_ms, uint8_t *out, std::size_t capacity);
+
+// Applies |length| bytes of ops to |target| from |first_pixel|, in place.
+// Returns false, leaving |target| partly updated, on a malformed op or one
+// that runs past the end of the strip.
+bool DecodeStreamOps(const uint8_t *ops, std::size_t length, uint16_t first_pixel,
+                     PixelSpan target);
+
+// Jitter buffer between the serial task, which pushes chunks as they arrive,
+// and TaskRGB, which shows each frame at its presentation time shifted by a
+// playout delay. The delay starts at kStartDelayMs and grows by however late
+// a frame turns up (up to kMaxDelayMs), so steady jitter stops causing late
+// frames after the first few. Chunks are stored compressed in fixed slots
+// and decoded straight into the effect's pixels when the frame is due.
+//
+// One producer and one consumer: beginChunk()/commitChunk() on one task,
+// the rest on the other.
+class FrameStream {
+ public:
+  enum class PushStatus : uint8_t {
+    kQueued = 0,
+    // No free slot; the chunk is dropped and the stream needs a keyframe.
+    kFull,
+    // A frame was lost; deltas are dropped until the next keyframe.
+    kNeedKeyframe,
+  };
+
+  struct Stats {
+    uint32_t chunks;
+    // Chunks refused with kFull or kNeedKeyframe.
+    uint32_t chunks_dropped;
+    uint32_t frames_shown;
+    // Frames shown after their presentation time.
+    uint32_t frames_late;
+    // Frames dropped: lost chunks, deltas without a base, bad ops.
+    uint32_t frames_dropped;
+    uint16_t delay_ms;
+  };
+
+  static constexpr std::size_t kSlotCount = 16;
+  static constexpr uint32_t kNoFrame = UINT32_MAX;
+  static constexpr uint16_t kStartDelayMs = 40;
+  static constexpr uint16_t kMaxDelayMs = 200;
+
+  FrameStream();
+
+  // Producer side. Returns where |ops_length| bytes of ops go, or nullptr
+  // with |status| saying why the chunk is refused. Each non-null return is
+  // followed by commitChunk() once the ops are written.
+  uint8_t *beginChunk(const StreamChunkHeader &header, std::size_t ops_length,
+                      uint32_t now_ms, PushStatus &status);
+  void commitChunk();
+
+  // Consumer side. Waits for a keyframe, and sets the playout clock from
+  // the first frame shown after it.
+  void restart();
+  // Drops everything queued, for when the stream is not being shown.
+  void discard();
+  // Milliseconds until the oldest complete frame is due (0 when it is), or
+  // kNoFrame if there is none yet.
+  uint32_t nextDueMs(uint32_t now_ms);
+  // Decodes every frame that is due into |target|, oldest first. Returns
+  // the number shown.
+  uint16_t decodeDue(uint32_t now_ms, PixelSpan target);
+  // Time since the last chunk arrived.
+  uint32_t idleMs(uint32_t now_ms) const;
+
+  Stats stats() const;
+
+ private:
+  struct Slot {
+    StreamChunkHeader header;
+    uint8_t length;
+    // Keyframes the producer had accepted when it queued this chunk.
+    uint32_t generation;
+    uint8_t ops[kMaxStreamOps];
+  };
+
+  Slot &slot(uint8_t index) { return slots_[index % kSlotCount]; }
+  // Finds the chunk ending the frame at the tail. Returns false if it has
+  // not arrived; drops chunks orphaned by a lost end of frame on the way.
+  bool completeFrame(uint8_t &end);
+  // Drops the frame at the tail, up to and including |end|, and waits for
+  // a keyframe. The producer is asked for one only if it has not accepted a
+  // keyframe since that frame, so an orphan never costs the keyframe behind
+  // it.
+  void dropFrame(uint8_t end);
+  // When the frame at the tail is due on the playout clock.
+  uint32_t dueMs(uint32_t now_ms);
+
+  Slot slots_[kSlotCount];
+  // Free-running indexes; the producer owns head_, the consumer tail_.
+  std::atomic<uint8_t> head_;
+  std::atomic<uint8_t> tail_;
+  std::atomic<uint32_t> last_arrival_ms_;
+  // Keyframes accepted, written by the producer; and the count the consumer
+  // last lost a frame under. While the two match, deltas are refused.
+  std::atomic<uint32_t> keyframes_;
+  std::atomic<uint32_t> lost_generation_;
+
+  // Producer only.
+  bool need_keyframe_;
+  uint8_t last_seq_;
+  bool seq_valid_;
+  bool in_frame_;
+  uint32_t chunks_;
+  uint32_t chunks_dropped_;
+
+  // Consumer only.
+  bool synced_;
+  bool clock_set_;
+  uint16_t last_time_ms_;
+  uint32_t stream_ms_;
+  uint32_t playout_offset_ms_;
+  uint16_t delay_ms_;
+  uint32_t frames_shown_;
+  uint32_t frames_late_;
+  uint32_t frames_dropped_;
+};
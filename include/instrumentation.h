@@ -0,0 +1,192 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+// Per-stage timing for the render path. Each stage records CPU cycles into a
+// fixed-size histogram; deadline lateness, missed deadlines and the free
+// stack of every watched task are tracked alongside. Dump() prints a report
+// (min, percentiles, max per stage); the serial protocol's kDumpStats and
+// kResetStats commands reach it from a host.
+//
+// Everything is behind LIGHTING_INSTRUMENTATION: with it at 0 the macros
+// below expand to nothing and no storage is allocated. The host build
+// records the same data, with host time standing in for cycles.
+#ifndef LIGHTING_INSTRUMENTATION
+#define LIGHTING_INSTRUMENTATION 0
+#endif
+
+namespace instrumentation {
+
+enum class Stage : uint8_t {
+  // TaskRGB: draining the event queue and applying brightness/glow changes.
+  kEvents = 0,
+  // TaskRGB: EffectEngine::render(), including the commit below.
+  kFrame,
+  // PixelOutput::commit(): scale, encode and diff.
+  kEncode,
+  // PixelOutput::commit(): waiting for the previous transfer and starting
+  // this one.
+  kTransmit,
+  // TaskPersist: the NVS write.
+  kPersist,
+  // TaskRGB: how late it woke for a frame deadline.
+  kWakeLateness,
+  // Input to photon: from a button gesture (InputEvent::at_us) to the
+  // first frame handed to the strip after TaskRGB applied it.
+  kInput,
+  kCount,
+};
+
+// Waking up to one tick after a deadline is scheduling granularity, not a
+// miss.
+constexpr uint32_t kDeadlineSlackUs = 1000;
+
+// Log-linear histogram over 32-bit values: values below 4 have a bucket
+// each, and every power of two above is split into four, so a bucket is at
+// most 25% wide. Single writer: the owning task updates each counter with a
+// plain load and store (no read-modify-write, which the ESP32-C3 would have
+// to emulate), and readers on other tasks may see a sample half recorded.
+class Histogram {
+ public:
+  static constexpr unsigned kSubBucketBits = 2;
+  static constexpr std::size_t kBuckets = ((32 - kSubBucketBits + 1) << kSubBucketBits);
+
+  Histogram() { reset(); }
+
+  void record(uint32_t value) {
+    Bump(buckets_[BucketIndex(value)]);
+    Bump(count_);
+    if (value < min_.load(std::memory_order_relaxed)) {
+      min_.store(value, std::memory_order_relaxed);
+    }
+    if (value > max_.load(std::memory_order_relaxed)) {
+      max_.store(value, std::memory_order_relaxed);
+    }
+  }
+  void reset();
+
+  uint32_t count() const { return count_.load(std::memory_order_relaxed); }
+  uint32_t min() const { return count() ? min_.load(std::memory_order_relaxed) : 0; }
+  uint32_t max() const { return max_.load(std::memory_order_relaxed); }
+  // Upper bound of the bucket holding the |percent|th percentile sample,
+  // clamped to max().
+  uint32_t percentile(uint8_t percent) const;
+
+  static std::size_t BucketIndex(uint32_t value) {
+    if (value < (1u << kSubBucketBits)) {
+      return value;
+    }
+    const unsigned msb = 31 - __builtin_clz(value);
+    const unsigned shift = msb - kSubBucketBits;
+    return ((shift + 1) << kSubBucketBits) | ((value >> shift) & ((1u << kSubBucketBits) - 1));
+  }
+  // Largest value that falls into bucket |index|.
+  static uint32_t BucketUpper(std::size_t index);
+
+ private:
+  static void Bump(std::atomic<uint32_t> &counter) {
+    counter.store(counter.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+  }
+
+  std::atomic<uint32_t> buckets_[kBuckets];
+  std::atomic<uint32_t> count_;
+  std::atomic<uint32_t> min_;
+  std::atomic<uint32_t> max_;
+};
+
+uint32_t Cycles();
+void Record(Stage stage, uint32_t cycles);
+// Records how late a frame deadline was met; beyond kDeadlineSlackUs it
+// counts as a miss.
+void RecordDeadline(uint32_t late_us);
+// Records one gesture's input-to-photon time.
+void RecordInput(uint32_t latency_us);
+// Counts a gesture lost because the input ring was full.
+void RecordInputDropped();
+uint32_t InputsDropped();
+// Records a sent frame's estimated current (PixelOutput's power model):
+// what it would have drawn and what the limiter let it draw, in mA, and
+// whether the limiter dimmed it.
+void RecordPower(uint32_t wanted_ma, uint32_t drawn_ma, bool limited);
+uint32_t PowerFrames();
+uint32_t PowerFramesLimited();
+uint32_t PeakWantedMa();
+uint32_t PeakDrawnMa();
+// TaskRGB's frame deadline: FrameDue() before it blocks, with the delay
+// (UINT32_MAX for none), and Woke() after, telling whether the wait timed
+// out rather than being cut short by an event.
+void FrameDue(uint32_t delay_ms);
+void Woke(bool timed_out);
+// Reports the calling task's stack high-water mark in dumps. Tasks are
+// keyed by name, so a restarted task replaces its old entry.
+void WatchCurrentTask();
+const Histogram &StageHistogram(Stage stage);
+uint32_t DeadlinesChecked();
+uint32_t DeadlinesMissed();
+void Reset();
+// Prints the report over Serial.
+void Dump();
+
+// Records the cycles from construction to the end of the enclosing scope.
+class ScopedStage {
+ public:
+  explicit ScopedStage(Stage stage) : stage_(stage), start_(Cycles()) {}
+  ~ScopedStage() { Record(stage_, Cycles() - start_); }
+
+  ScopedStage(const ScopedStage &) = delete;
+  ScopedStage &operator=(const ScopedStage &) = delete;
+
+ private:
+  Stage stage_;
+  uint32_t start_;
+};
+
+}  // namespace instrumentation
+
+#define INSTRUMENT_CONCAT_INNER(a, b) a##b
+#define INSTRUMENT_CONCAT(a, b) INSTRUMENT_CONCAT_INNER(a, b)
+
+#if LIGHTING_INSTRUMENTATION
+#define INSTRUMENT_STAGE(stage)                                                     \
+  ::instrumentation::ScopedStage INSTRUMENT_CONCAT(instrument_stage_, __LINE__)( \
+      ::instrumentation::Stage::stage)
+#define INSTRUMENT_FRAME_DUE(delay_ms) ::instrumentation::FrameDue(delay_ms)
+#define INSTRUMENT_WOKE(timed_out) ::instrumentation::Woke(timed_out)
+#define INSTRUMENT_WATCH_TASK() ::instrumentation::WatchCurrentTask()
+#define INSTRUMENT_INPUT_SHOWN(latency_us) ::instrumentation::RecordInput(latency_us)
+#define INSTRUMENT_INPUT_DROPPED() ::instrumentation::RecordInputDropped()
+#define INSTRUMENT_POWER(wanted_ma, drawn_ma, limited) \
+  ::instrumentation::RecordPower(wanted_ma, drawn_ma, limited)
+#define INSTRUMENT_DUMP() ::instrumentation::Dump()
+#define INSTRUMENT_RESET() ::instrumentation::Reset()
+#else
+#define INSTRUMENT_STAGE(stage) \
+  do {                          \
+  } while (0)
+#define INSTRUMENT_FRAME_DUE(delay_ms) \
+  do {                                 \
+  } while (0)
+#define INSTRUMENT_WOKE(timed_out) \
+  do {                             \
+  } while (0)
+#define INSTRUMENT_WATCH_TASK() \
+  do {                          \
+  } while (0)
+#define INSTRUMENT_INPUT_SHOWN(latency_us) \
+  do {                                     \
+  } while (0)
+#define INSTRUMENT_INPUT_DROPPED() \
+  do {                             \
+  } while (0)
+#define INSTRUMENT_POWER(wanted_ma, drawn_ma, limited) \
+  do {                                                 \
+  } while (0)
+#define INSTRUMENT_DUMP() \
+  do {                    \
+  } while (0)
+#define INSTRUMENT_RESET() \
+  do {                     \
+  } while (0)
+#endif
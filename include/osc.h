@@ -0,0 +1,122 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+// Open Sound Control 1.0 packets, parsed in place from the receive buffer:
+// messages are views into the packet and nothing is copied or allocated.
+// Bundles are walked recursively (up to kMaxOscBundleDepth) and their time
+// tags ignored, as VRChat does not schedule.
+
+constexpr uint8_t kMaxOscBundleDepth = 4;
+
+class OscMessage {
+ public:
+  const char *address() const { return address_; }
+  // The type tags after the leading ','.
+  const char *typeTags() const { return tags_; }
+  uint8_t argumentCount() const { return argument_count_; }
+  // Reads argument |index| as a number: T/F are 1/0, i, h, f and d are
+  // converted. Returns false for other types or a missing argument.
+  bool number(uint8_t index, float &value) const;
+
+ private:
+  friend class OscParser;
+
+  const char *address_ = nullptr;
+  const char *tags_ = nullptr;
+  const uint8_t *arguments_ = nullptr;
+  const uint8_t *end_ = nullptr;
+  uint8_t argument_count_ = 0;
+};
+
+using OscMessageFn = void (*)(const OscMessage &message, void *context);
+
+class OscParser {
+ public:
+  struct Stats {
+    uint32_t packets;
+    uint32_t bundles;
+    uint32_t messages;
+    uint32_t malformed;
+  };
+
+  // Calls |fn| for every message in the packet, in order, including those
+  // in (nested) bundles. Returns false if the packet is malformed; messages
+  // before the fault have been delivered. |data| must stay valid while |fn|
+  // runs and is not modified.
+  bool parse(const uint8_t *data, std::size_t length, OscMessageFn fn, void *context);
+
+  const Stats &stats() const { return stats_; }
+
+ private:
+  bool parseElement(const uint8_t *data, std::size_t length, uint8_t depth, OscMessageFn fn,
+                    void *context);
+  bool parseMessage(const uint8_t *data, std::size_t length, OscMessageFn fn, void *context);
+
+  Stats stats_{};
+};
+
+// How a bound parameter turns into updates.
+enum class OscBindingKind : uint8_t {
+  // The latest value counts; repeats and superseded values are dropped.
+  kValue = 0,
+  // A button: fires on a rise from below 0.5 to 0.5 or more, even if it fell
+  // back before the next flush. Rises between two flushes fire once.
+  kTrigger,
+};
+
+struct OscBinding {
+  const char *address;
+  uint8_t id;
+  OscBindingKind kind;
+};
+
+// Per-parameter state for OscParameters, one per binding, owned by the
+// caller.
+struct OscParameterState {
+  float value;
+  float sent;
+  bool pending;
+  bool sent_valid;
+  bool high;
+};
+
+// Coalesces parameter updates between the parser and whatever acts on
+// them. update() keeps only the latest value of each bound address;
+// flush() then hands each parameter that changed since it was last
+// delivered to |fn| once. A parameter |fn| refuses (returns false) stays
+// pending for the next flush, so a full queue delays updates rather than
+// losing them.
+class OscParameters {
+ public:
+  struct Stats {
+    uint32_t matched;
+    uint32_t unmatched;
+    // Updates replaced by a later one before they were delivered.
+    uint32_t coalesced;
+    // Updates equal to the value last delivered.
+    uint32_t unchanged;
+    uint32_t delivered;
+    uint32_t refused;
+  };
+
+  using DeliverFn = bool (*)(uint8_t id, float value, void *context);
+
+  OscParameters(const OscBinding *bindings, OscParameterState *state, std::size_t count);
+
+  // Records the first argument of |message| if its address is bound.
+  // Returns false if it is not.
+  bool update(const OscMessage &message);
+  // Delivers pending parameters. Returns true if any are still pending.
+  bool flush(DeliverFn fn, void *context);
+
+  bool pending() const;
+  const Stats &stats() const { return stats_; }
+
+ private:
+  const OscBinding *bindings_;
+  OscParameterState *state_;
+  std::size_t count_;
+  Stats stats_;
+};
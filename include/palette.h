@@ -0,0 +1,41 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#include "color_tables.h"
+
+// Named colour palettes. Each palette is defined by 16 gradient stops and
+// expanded at compile time into a 256-entry table, so sampling by 8-bit index
+// is a single table load. Colours are packed 0x00RRGGBB.
+
+enum class PaletteId : uint8_t {
+  kRainbow = 0,
+  kOcean,
+  kLava,
+  kForest,
+  kParty,
+};
+
+constexpr std::size_t kPaletteCount = 5;
+
+const color_tables::ColorTable &PaletteTable(PaletteId id);
+const char *PaletteName(PaletteId id);
+bool FindPalette(const char *name, PaletteId &id);
+
+inline uint32_t SamplePalette(PaletteId id, uint8_t index) { return PaletteTable(id)[index]; }
+
+// Interpolates between neighbouring table entries. |position| is 8.8 fixed
+// point: the high byte selects the entry, the low byte the blend towards the
+// next one (wrapping at the end of the palette).
+inline uint32_t SamplePaletteSmooth(PaletteId id, uint16_t position) {
+  const color_tables::ColorTable &table = PaletteTable(id);
+  const uint8_t index = static_cast<uint8_t>(position >> 8);
+  const uint32_t frac = position & 0xff;
+  const uint32_t a = table[index];
+  const uint32_t b = table[static_cast<uint8_t>(index + 1)];
+  // Red and blue share one multiply, green takes the other.
+  const uint32_t rb = (((a & 0xff00ff) * (256 - frac) + (b & 0xff00ff) * frac) >> 8) & 0xff00ff;
+  const uint32_t g = (((a & 0x00ff00) * (256 - frac) + (b & 0x00ff00) * frac) >> 8) & 0x00ff00;
+  return rb | g;
+}
@@ -0,0 +1,112 @@
+#pragma once
+
+#include <Preferences.h>
+#include <cstddef>
+#include <cstdint>
+
+// Where each pixel sits, for effects that draw by position. A layout places
+// the strip's pixels, in wiring order, on a 256 x 256 plane as a run of
+// segments: straight lines, rings, arcs and matrices. Loading one
+// precomputes every pixel's coordinates, its angle round the layout's
+// centre and its distance from it, so a spatial effect reads one PixelPlace
+// per pixel per frame and never calls the trigonometry the placing takes.
+//
+// A layout is an 8-byte header ('L', 'Y', version, segment count, centre x,
+// centre y, 0, 0) followed by 8 bytes per segment: a kind byte, then the
+// operands below; 16-bit operands are little endian, unused bytes are 0.
+// Angles are 256 to the turn, from the +x axis towards +y.
+namespace layout_kind {
+constexpr uint8_t kLine = 0x01;    // count:u16 x0:u8 y0:u8 x1:u8 y1:u8. First pixel at
+                                   // (x0, y0), last at (x1, y1).
+constexpr uint8_t kRing = 0x02;    // count:u16 cx:u8 cy:u8 radius:u8 start:u8. Evenly round
+                                   // a full turn from |start|.
+constexpr uint8_t kArc = 0x03;     // count:u16 cx:u8 cy:u8 radius:u8 start:u8 sweep:u8. First
+                                   // pixel at |start|, last at |start + sweep|.
+constexpr uint8_t kMatrix = 0x04;  // columns:u8 rows:u8 x0:u8 y0:u8 pitch:u8 flags:u8. At
+                                   // most one per layout.
+}  // namespace layout_kind
+
+// kMatrix flags: wired down columns rather than along rows, and every other
+// row (or column) wired back the other way.
+constexpr uint8_t kMatrixColumnMajor = 1 << 0;
+constexpr uint8_t kMatrixSerpentine = 1 << 1;
+
+#define LAYOUT_HEADER(segments, center_x, center_y) \
+  'L', 'Y', 1, (segments), (center_x), (center_y), 0, 0
+#define LAYOUT_U16(value) \
+  static_cast<uint8_t>((value) & 0xff), static_cast<uint8_t>(((value) >> 8) & 0xff)
+#define LAYOUT_LINE(count, x0, y0, x1, y1) \
+  layout_kind::kLine, LAYOUT_U16(count), (x0), (y0), (x1), (y1), 0
+#define LAYOUT_RING(count, cx, cy, radius, start) \
+  layout_kind::kRing, LAYOUT_U16(count), (cx), (cy), (radius), (start), 0
+#define LAYOUT_ARC(count, cx, cy, radius, start, sweep) \
+  layout_kind::kArc, LAYOUT_U16(count), (cx), (cy), (radius), (start), (sweep)
+#define LAYOUT_MATRIX(columns, rows, x0, y0, pitch, flags) \
+  layout_kind::kMatrix, (columns), (rows), (x0), (y0), (pitch), (flags), 0
+
+constexpr std::size_t kLayoutHeaderSize = 8;
+constexpr std::size_t kLayoutSegmentSize = 8;
+constexpr uint8_t kMaxLayoutSegments = 8;
+constexpr std::size_t kMaxLayoutBytes = kLayoutHeaderSize + kMaxLayoutSegments * kLayoutSegmentSize;
+
+// One pixel's precomputed place.
+struct PixelPlace {
+  uint8_t x;
+  uint8_t y;
+  // Round the layout's centre, 256 to the turn.
+  uint8_t angle;
+  // From the layout's centre, 255 for the farthest pixel.
+  uint8_t radius;
+};
+
+// Checks the header, every segment's kind and operands, that the segments
+// stay on the plane and that there is at most one matrix. Whether the
+// pixels fit is up to the PixelLayout that loads it.
+bool ValidateLayout(const uint8_t *layout, std::size_t length);
+
+// Reads a layout stored as a bytes entry into |buffer|. Returns its length,
+// or 0 when the key is missing, too large or fails validation.
+std::size_t LoadLayout(Preferences &preferences, const char *key, uint8_t *buffer,
+                       std::size_t capacity);
+
+// The precomputed tables for a strip of up to |num_pixels| pixels, in
+// caller-owned buffers of that many entries each. Nothing is placed until
+// load() succeeds.
+class PixelLayout {
+ public:
+  static constexpr uint16_t kNoPixel = UINT16_MAX;
+
+  PixelLayout(PixelPlace *places, uint16_t *grid, std::size_t num_pixels);
+
+  // Validates |layout| and rebuilds the tables from it; the bytes are not
+  // kept. Returns false and keeps the current tables if it is malformed or
+  // places more pixels than there are entries.
+  bool load(const uint8_t *layout, std::size_t length);
+
+  // Pixels placed, from index 0; any beyond them are not on the layout.
+  uint16_t count() const { return count_; }
+  const PixelPlace *places() const { return places_; }
+
+  // The matrix segment's shape in rows and columns, 0 x 0 without one, and
+  // the strip index of the pixel at |column|, |row| whatever its wiring
+  // order (kNoPixel off the matrix).
+  uint8_t columns() const { return columns_; }
+  uint8_t rows() const { return rows_; }
+  uint16_t pixelAt(uint8_t column, uint8_t row) const;
+
+  // Fills |distances|, count() entries, with each pixel's distance from
+  // |x|, |y|, 255 for the farthest: a table an effect spreading from that
+  // point computes once rather than every frame.
+  void distanceFrom(uint8_t x, uint8_t y, uint8_t *distances) const;
+
+ private:
+  // Places segment pixels from |first|; returns the number placed.
+  uint16_t placeSegment(const uint8_t *segment, uint16_t first);
+
+  PixelPlace *places_;
+  uint16_t *grid_;
+  std::size_t capacity_;
+  uint16_t count_;
+  uint8_t columns_;
+  uint8_t rows_;
+};
@@ -0,0 +1,73 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+// Fixed-point kernels on packed 0x00RRGGBB pixels. Each works SWAR style on
+// the 32-bit word: red and blue share one multiply (masked 0x00ff00ff, each
+// in its own 16-bit lane) and green takes a second, so there is no
+// per-channel unpacking and no floating point.
+//
+// Weights run from 0 to kFullWeight (256), so a weight of 256 passes a
+// channel through unchanged. WeightForLevel() converts a 0-255 level the same
+// way PixelOutput applies brightness.
+namespace pixel_ops {
+
+constexpr uint16_t kFullWeight = 256;
+constexpr uint32_t kRedBlueMask = 0x00ff00ff;
+constexpr uint32_t kGreenMask = 0x0000ff00;
+constexpr uint32_t kLaneHighBits = 0x00808080;
+
+constexpr uint16_t WeightForLevel(uint8_t level) { return static_cast<uint16_t>(level + 1); }
+
+// c * weight / 256 per channel.
+inline uint32_t ScalePixel(uint32_t c, uint16_t weight) {
+  const uint32_t rb = (((c & kRedBlueMask) * weight) >> 8) & kRedBlueMask;
+  const uint32_t g = (((c & kGreenMask) * weight) >> 8) & kGreenMask;
+  return rb | g;
+}
+
+// (a * weight_a + b * weight_b) / 256 per channel; weight_a + weight_b must
+// not exceed kFullWeight so no lane can overflow into its neighbour.
+inline uint32_t MixPixel(uint32_t a, uint16_t weight_a, uint32_t b, uint16_t weight_b) {
+  const uint32_t rb =
+      (((a & kRedBlueMask) * weight_a + (b & kRedBlueMask) * weight_b) >> 8) & kRedBlueMask;
+  const uint32_t g = (((a & kGreenMask) * weight_a + (b & kGreenMask) * weight_b) >> 8) & kGreenMask;
+  return rb | g;
+}
+
+// Per-channel saturating add. The low seven bits of each lane are added
+// without crossing lanes; the lane's top bit and any overflow are then
+// recovered from the operands.
+inline uint32_t AddPixel(uint32_t a, uint32_t b) {
+  const uint32_t low = (a & ~kLaneHighBits & 0x00ffffff) + (b & ~kLaneHighBits & 0x00ffffff);
+  const uint32_t sum = low ^ ((a ^ b) & kLaneHighBits);
+  const uint32_t carry = ((a & b) | ((a | b) & ~sum)) & kLaneHighBits;
+  return sum | ((carry >> 7) * 0xff);
+}
+
+// Per-channel maximum. |low_ge| compares the low seven bits of each lane
+// without borrowing across lanes; where the top bits differ, |a|'s top bit
+// decides instead. The resulting a >= b bit is widened into a byte mask.
+inline uint32_t MaxPixel(uint32_t a, uint32_t b) {
+  const uint32_t low_ge = (a | kLaneHighBits) - (b & ~kLaneHighBits & 0x00ffffff);
+  const uint32_t differ = a ^ b;
+  const uint32_t ge = ((low_ge & ~differ) | (a & differ)) & kLaneHighBits;
+  const uint32_t mask = (ge >> 7) * 0xff;
+  return (a & mask) | (b & ~mask & 0x00ffffff);
+}
+
+// dst = a blended towards b by |weight| (0 = all a, kFullWeight = all b).
+// |dst| may alias |a| or |b|.
+void Blend(uint32_t *dst, const uint32_t *a, const uint32_t *b, std::size_t count,
+           uint16_t weight);
+// dst = a * weight_a + b * weight_b; see MixPixel().
+void Mix(uint32_t *dst, const uint32_t *a, uint16_t weight_a, const uint32_t *b,
+         uint16_t weight_b, std::size_t count);
+void Scale(uint32_t *pixels, std::size_t count, uint16_t weight);
+// dst = saturate(dst + src).
+void Add(uint32_t *dst, const uint32_t *src, std::size_t count);
+// dst = max(dst, src) per channel.
+void Max(uint32_t *dst, const uint32_t *src, std::size_t count);
+
+}  // namespace pixel_ops
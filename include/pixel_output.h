@@ -0,0 +1,162 @@
+#pragma once
+
+#include <Adafruit_NeoPixel.h>
+#include <cstddef>
+#include <cstdint>
+
+#include "strip_transmitter.h"
+
+// Output stage between the effects and the strip. Effects draw into a
+// full-precision source frame (packed 0x00RRGGBB, never rescaled); commit()
+// applies master brightness and effect intensity in one fused
+// scale-and-encode pass into a wire-order buffer, diffing against the last
+// frame sent on the way so nothing is transmitted unless something changed.
+// Brightness changes are lossless and need no re-render.
+//
+// Scaling keeps 8 fractional bits per channel: at a low brightness or level
+// the truncated product leaves only a few distinct values (12/255 of a
+// channel is 0 to 12), so a fade steps and mixed colours drift. With a
+// dither buffer, commit() carries each channel's fraction over to the next
+// frame (first-order error diffusion in time) whenever the combined scale
+// is below kDitherScaleLimit, and the average of successive frames
+// reproduces the 16-bit value. That only holds if frames keep coming: while
+// dithering() is true the caller commits again on a short interval (see
+// EffectEngine::setDitherInterval()).
+//
+// With a power model, commit() also estimates the strip's current from the
+// channel sums of the source frame (one packed pass, a few integer
+// operations per pixel) and the scale, and lowers the scale when the
+// estimate nears the budget. The limit has a soft knee: up to three
+// quarters of the budget nothing changes; above it the current drawn keeps
+// rising with the content but ever more slowly, approaching the budget
+// without reaching it, so there is no hard clip and no visible step when
+// the limiter engages. Colours keep their hue; the whole frame dims.
+//
+// The wire buffer is double: the front half is the frame the transmitter is
+// sending (or last sent), the back half is encoded into and becomes the front
+// when it is handed over. With an asynchronous transmitter the next frame
+// renders and encodes while the previous one is still going out; commit()
+// only waits if it catches up with a transfer still in flight.
+class PixelOutput {
+ public:
+  struct Stats {
+    uint32_t frames_sent;
+    uint32_t frames_skipped;
+    // Frames that had to wait for the previous transfer to finish.
+    uint32_t transmit_waits;
+    // Sent frames that were dithered.
+    uint32_t frames_dithered;
+    // Sent frames the power limiter dimmed.
+    uint32_t frames_limited;
+  };
+
+  // Current drawn by the strip. Each channel draws in proportion to its
+  // output value; the figures are at 255.
+  struct PowerModel {
+    uint8_t red_ma;
+    uint8_t green_ma;
+    uint8_t blue_ma;
+    // Every pixel's own draw, lit or dark, in microamps.
+    uint16_t idle_ua;
+    // Most the strip may draw; 0 turns the limiter off.
+    uint16_t budget_ma;
+  };
+
+  static constexpr std::size_t kBytesPerPixel = 3;
+  // Combined scale, (brightness + 1) * (intensity + 1), below which frames
+  // are dithered: under half of full output. Above it one 8-bit step is too
+  // small a change to see and the output stays static between frames.
+  static constexpr uint32_t kDitherScaleLimit = 1u << 15;
+
+  // Size of the wire buffer for |pixels| pixels: front and back halves.
+  static constexpr std::size_t WireBytes(std::size_t pixels) {
+    return 2 * kBytesPerPixel * pixels;
+  }
+  // Size of the dither buffer for |pixels| pixels: a residual per channel.
+  static constexpr std::size_t DitherBytes(std::size_t pixels) { return kBytesPerPixel * pixels; }
+
+  // |frame| holds |num_pixels| entries, |wire| WireBytes(num_pixels) bytes
+  // and |dither|, if given, DitherBytes(num_pixels); all are owned by the
+  // caller so they can be statically allocated. Without a dither buffer
+  // commit() truncates. |type| is the strip's colour order.
+  PixelOutput(StripTransmitter &transmitter, neoPixelType type, uint32_t *frame, uint8_t *wire,
+              std::size_t num_pixels, uint8_t *dither = nullptr);
+
+  // Initialises the transmitter and clocks out the current frame
+  // unconditionally, restarting the dither pattern.
+  void begin();
+
+  // Scales, encodes and starts sending the frame if the encoded bytes differ
+  // from the last frame sent. Returns true when a transfer was started; it
+  // may still be in flight when commit() returns.
+  bool commit();
+
+  // Forces the next commit() to send, e.g. after the strip was re-powered.
+  void invalidate();
+
+  uint16_t numPixels() const { return num_pixels_; }
+  void setPixel(uint16_t index, uint32_t color) {
+    if (index < num_pixels_) {
+      frame_[index] = color;
+    }
+  }
+  uint32_t pixel(uint16_t index) const { return index < num_pixels_ ? frame_[index] : 0; }
+  // The source frame itself, numPixels() entries, for renderers that write
+  // whole runs of pixels.
+  uint32_t *frame() { return frame_; }
+  void fill(uint32_t color, uint16_t first = 0, uint16_t count = 0);
+  void clear() { fill(0); }
+
+  // Master brightness (the bright/dim level) and per-effect intensity
+  // multiply; both only take effect at the next commit().
+  void setBrightness(uint8_t brightness) { brightness_ = brightness; }
+  void setIntensity(uint8_t intensity) { intensity_ = intensity; }
+  uint8_t brightness() const { return brightness_; }
+  uint8_t intensity() const { return intensity_; }
+
+  // Estimates every commit()'s current with |model| and limits it to the
+  // budget; a zero budget stops estimating, which then costs nothing.
+  void setPowerModel(const PowerModel &model) { power_ = model; }
+  // The last commit()'s estimate before and after limiting, in mA; both 0
+  // without a budget.
+  uint32_t wantedMa() const { return wanted_ma_; }
+  uint32_t drawnMa() const { return drawn_ma_; }
+
+  // True if the last commit() was dithered and left fractions to carry, so
+  // committing the same source frame again sends a different one.
+  bool dithering() const { return dithering_; }
+
+  StripTransmitter &transmitter() { return transmitter_; }
+  const Stats &stats() const { return stats_; }
+  void resetStats();
+
+  // Pixel range [first, first + count) that changed in the last sent frame.
+  uint16_t dirtyFirst() const { return dirty_first_; }
+  uint16_t dirtyCount() const { return dirty_count_; }
+
+ private:
+  void seedDither();
+  // |scale| lowered as far as the power budget needs; sets the estimates.
+  uint32_t limitPower(uint32_t scale);
+
+  StripTransmitter &transmitter_;
+  uint32_t *frame_;
+  uint8_t *front_;
+  uint8_t *back_;
+  // Residual per channel, in source (RGB) order; nullptr without dithering.
+  uint8_t *dither_;
+  uint16_t num_pixels_;
+  uint8_t r_offset_;
+  uint8_t g_offset_;
+  uint8_t b_offset_;
+  uint8_t brightness_;
+  uint8_t intensity_;
+  bool valid_;
+  bool dithering_;
+  PowerModel power_;
+  uint32_t wanted_ma_;
+  uint32_t drawn_ma_;
+  uint16_t dirty_first_;
+  uint16_t dirty_count_;
+  Stats stats_;
+};
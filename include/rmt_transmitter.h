@@ -0,0 +1,30 @@
+#pragma once
+
+#include <driver/rmt.h>
+
+#include <cstddef>
+#include <cstdint>
+
+#include "strip_transmitter.h"
+
+// Asynchronous WS2812 backend on the RMT peripheral. transmit() hands the
+// frame to the RMT driver and returns at once; the driver's interrupt turns
+// bytes into pulses as the RMT memory drains, reading straight from the
+// caller's buffer, so the CPU is free to render the next frame meanwhile.
+class RmtTransmitter final : public StripTransmitter {
+ public:
+  explicit RmtTransmitter(uint8_t pin, rmt_channel_t channel = RMT_CHANNEL_0);
+
+  void begin() override;
+  void transmit(const uint8_t *data, std::size_t length) override;
+  bool busy() override;
+  void wait() override;
+
+ private:
+  uint8_t pin_;
+  rmt_channel_t channel_;
+  bool sending_;
+  unsigned long start_us_;
+  // Wire time of the frame in flight plus the latch gap, from start_us_.
+  unsigned long done_after_us_;
+};
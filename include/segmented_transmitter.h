@@ -0,0 +1,58 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#include "strip_transmitter.h"
+
+// A run of the logical strip placed on one output channel: logical pixels
+// [first, first + count) go to the channel's pixels from |offset| on,
+// backwards if |reversed| (a strip folded back on itself).
+struct StripSegment {
+  uint16_t first;
+  uint16_t count;
+  uint8_t channel;
+  uint16_t offset;
+  bool reversed;
+};
+
+// One physical output. |staging| holds 3 * |pixels| bytes the channel's
+// segments are gathered into; it may be nullptr when a single forward
+// segment covers the whole channel, which is then sent straight out of the
+// caller's buffer.
+struct StripChannel {
+  StripTransmitter *transmitter;
+  uint16_t pixels;
+  uint8_t *staging;
+};
+
+// Spreads one logical strip over several outputs, so PixelOutput and the
+// effects see a single frame however the installation is wired. Every
+// channel starts together and they send concurrently (one RMT channel
+// each), so a frame takes the wire time of the longest channel rather than
+// of the whole strip. All channels share the colour order PixelOutput
+// encodes in.
+class SegmentedTransmitter final : public StripTransmitter {
+ public:
+  static constexpr uint8_t kMaxChannels = 8;
+
+  // |channels| and |segments| must outlive the transmitter. Segments that
+  // run past the frame or their channel are clipped; channels past
+  // kMaxChannels are ignored.
+  SegmentedTransmitter(const StripChannel *channels, uint8_t channel_count,
+                       const StripSegment *segments, uint8_t segment_count);
+
+  void begin() override;
+  void transmit(const uint8_t *data, std::size_t length) override;
+  bool busy() override;
+  void wait() override;
+
+ private:
+  const StripChannel *channels_;
+  uint8_t channel_count_;
+  const StripSegment *segments_;
+  uint8_t segment_count_;
+  // The segment each channel is sent from in place, or nullptr if it is
+  // gathered into its staging buffer.
+  const StripSegment *direct_[kMaxChannels];
+};
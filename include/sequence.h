@@ -0,0 +1,124 @@
+#pragma once
+
+#include <Preferences.h>
+#include <cstddef>
+#include <cstdint>
+
+#include "effect_engine.h"
+
+// Light-show sequences: a compact bytecode that drives an EffectEngine.
+//
+// A sequence is a 4-byte header ('L', 'S', version, 0) followed by the
+// program. Each instruction is a one-byte opcode and fixed-size operands;
+// 16-bit operands are little endian. Jump targets are byte offsets into the
+// program (after the header). Sequences are validated once when loaded, so
+// the interpreter runs straight from flash or from an NVS blob with no
+// per-instruction bounds checks and no allocation.
+namespace sequence_op {
+constexpr uint8_t kEnd = 0x00;         // Stop; the last effect keeps running.
+constexpr uint8_t kEffect = 0x01;      // id:u8. Start an effect with the current params.
+constexpr uint8_t kColor = 0x02;       // r:u8 g:u8 b:u8
+constexpr uint8_t kSpeed = 0x03;       // step_ms:u16 (0 makes the effect static)
+constexpr uint8_t kBrightness = 0x04;  // level:u8. Master brightness, immediate.
+constexpr uint8_t kFade = 0x05;        // level:u8 duration_ms:u16. Ramp master brightness.
+constexpr uint8_t kWait = 0x06;        // duration_ms:u16
+constexpr uint8_t kWaitDone = 0x07;    // timeout_ms:u16. Until the effect completes or the
+                                       // timeout passes; 0 uses the player's default hold.
+constexpr uint8_t kLoop = 0x08;        // count:u8. Run the body up to kEndLoop |count| times.
+constexpr uint8_t kEndLoop = 0x09;
+constexpr uint8_t kJump = 0x0a;        // target:u16. Only allowed outside loops.
+constexpr uint8_t kFlags = 0x0b;       // flags:u8 (kEffectFlag*)
+}  // namespace sequence_op
+
+#define SEQUENCE_HEADER 'L', 'S', 1, 0
+#define SEQUENCE_U16(value) \
+  static_cast<uint8_t>((value) & 0xff), static_cast<uint8_t>(((value) >> 8) & 0xff)
+
+constexpr std::size_t kSequenceHeaderSize = 4;
+constexpr std::size_t kMaxSequenceBytes = 512;
+constexpr uint8_t kMaxSequenceLoopDepth = 4;
+
+// Checks the header, every opcode and operand, effect ids, loop nesting and
+// jump targets. Only validated sequences are ever executed.
+bool ValidateSequence(const uint8_t *sequence, std::size_t length);
+
+// Reads a sequence stored as a bytes entry into |buffer|. Returns its length,
+// or 0 when the key is missing, too large or fails validation.
+std::size_t LoadSequence(Preferences &preferences, const char *key, uint8_t *buffer,
+                         std::size_t capacity);
+
+// Executes a sequence against an EffectEngine. update() runs instructions
+// until the sequence blocks on a wait, capped at kMaxStepsPerUpdate
+// instructions, so its cost per call is bounded whatever the program does.
+class SequencePlayer {
+ public:
+  struct Stats {
+    uint32_t updates;
+    uint32_t instructions;
+    uint32_t max_instructions_per_update;
+  };
+
+  static constexpr uint32_t kNoDeadline = UINT32_MAX;
+  static constexpr uint8_t kMaxStepsPerUpdate = 16;
+
+  explicit SequencePlayer(EffectEngine &engine);
+
+  // Validates and adopts |sequence|, which must stay valid while loaded (a
+  // flash constant or a caller-owned buffer). Returns false and keeps the
+  // current sequence if it is malformed.
+  bool load(const uint8_t *sequence, std::size_t length);
+  void start(unsigned long now_ms);
+  void stop() { running_ = false; }
+
+  // Advances the sequence to |now_ms|. Returns the same value as
+  // nextDelayMs().
+  uint32_t update(unsigned long now_ms);
+  // Milliseconds until update() has work to do, or kNoDeadline once the
+  // sequence has ended and any fade has finished.
+  uint32_t nextDelayMs(unsigned long now_ms) const;
+
+  // Hold time for kWaitDone with a zero timeout.
+  void setDefaultHoldMs(uint16_t hold_ms) { default_hold_ms_ = hold_ms; }
+
+  bool running() const { return running_; }
+  const Stats &stats() const { return stats_; }
+
+ private:
+  enum class Block : uint8_t {
+    kNone = 0,
+    kWait,
+    kWaitDone,
+  };
+
+  struct LoopFrame {
+    uint16_t start;
+    uint8_t remaining;
+  };
+
+  // Executes one instruction; returns false if it blocked or ended.
+  bool step(unsigned long now_ms);
+  void updateFade(unsigned long now_ms);
+
+  EffectEngine &engine_;
+  const uint8_t *program_;
+  uint16_t length_;
+  uint16_t pc_;
+  bool running_;
+
+  EffectParams params_;
+  Block block_;
+  unsigned long block_start_;
+  uint16_t block_ms_;
+  uint16_t default_hold_ms_;
+
+  LoopFrame loops_[kMaxSequenceLoopDepth];
+  uint8_t loop_depth_;
+
+  bool fading_;
+  uint8_t fade_from_;
+  uint8_t fade_to_;
+  unsigned long fade_start_;
+  uint16_t fade_ms_;
+
+  Stats stats_;
+};
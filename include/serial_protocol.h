@@ -0,0 +1,118 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+// Framed binary control protocol over the serial console.
+//
+//   0xA5 | length | ~length | command | payload... | crc16 (little endian)
+//
+// |length| counts the command byte and payload (1..kMaxFrameBody) and is
+// followed by its complement, so a stray sync byte is almost always rejected
+// at once rather than after waiting out a long bogus body. The CRC is
+// CRC-16/CCITT-FALSE over everything between the sync byte and the CRC. Multi-byte
+// fields are little endian. Every command is answered with a frame whose
+// command byte has kReplyFlag set and whose first payload byte is a
+// protocol_status code.
+namespace protocol_cmd {
+constexpr uint8_t kSetGlow = 0x01;        // glow:u8 (GlowMode value)
+constexpr uint8_t kSetBrightness = 0x02;  // mode:u8 (0 bright, 1 dim)
+constexpr uint8_t kSetColor = 0x03;       // r:u8 g:u8 b:u8
+constexpr uint8_t kSetSpeed = 0x04;       // step_ms:u16; 0 restores the mode's own speed
+constexpr uint8_t kSetFlags = 0x05;       // flags:u8 (kEffectFlag*)
+constexpr uint8_t kQueryState = 0x06;     // Reply: status brightness:u8 glow:u8 r g b
+                                          // step_ms:u16 flags:u8 level:u8
+constexpr uint8_t kFlush = 0x07;          // Commit the settings to NVS now.
+constexpr uint8_t kDumpStats = 0x08;      // Prints the instrumentation report as text.
+constexpr uint8_t kResetStats = 0x09;     // Clears the instrumentation counters.
+constexpr uint8_t kStreamFrame = 0x0a;    // A chunk of a streamed frame; see frame_stream.h.
+constexpr uint8_t kReplyFlag = 0x80;
+}  // namespace protocol_cmd
+
+namespace protocol_status {
+constexpr uint8_t kOk = 0;
+constexpr uint8_t kUnknownCommand = 1;
+constexpr uint8_t kBadLength = 2;
+constexpr uint8_t kBadValue = 3;
+constexpr uint8_t kBusy = 4;  // The event queue or stream buffer was full; try again.
+constexpr uint8_t kNeedKeyframe = 5;  // Stream deltas are dropped until a keyframe.
+}  // namespace protocol_status
+
+constexpr uint8_t kFrameSync = 0xa5;
+constexpr std::size_t kMaxFrameBody = 255;
+// Sync, length, its complement and CRC around the body.
+constexpr std::size_t kFrameOverhead = 5;
+constexpr std::size_t kMaxFrameSize = kMaxFrameBody + kFrameOverhead;
+
+// Writes a frame for |command| and |payload| into |out|. Returns its size,
+// or 0 if the payload is too long or |out| too small.
+std::size_t EncodeFrame(uint8_t command, const uint8_t *payload, std::size_t payload_length,
+                        uint8_t *out, std::size_t capacity);
+
+// A received command, read in place from the parser's ring. Valid until the
+// parser's buffer is next written.
+class CommandView {
+ public:
+  uint8_t command() const { return command_; }
+  uint8_t payloadLength() const { return length_; }
+  // Payload fields by byte offset; the caller checks payloadLength() first.
+  uint8_t u8(uint8_t offset) const;
+  uint16_t u16(uint8_t offset) const;
+  // Copies |length| payload bytes from |offset|, for payloads kept longer
+  // than the view.
+  void copy(uint8_t offset, uint8_t *out, std::size_t length) const;
+
+ private:
+  friend class ProtocolParser;
+
+  const uint8_t *ring_ = nullptr;
+  uint16_t start_ = 0;
+  uint8_t length_ = 0;
+  uint8_t command_ = 0;
+};
+
+// Frame parser over a fixed ring. The UART is read straight into the ring
+// (writeBuffer()/commitWrite()); next() then finds frames in place, so a
+// command is never copied out of the ring. Bytes that cannot start a valid
+// frame, and frames failing their CRC, are skipped one byte at a time until
+// the parser is back in sync.
+class ProtocolParser {
+ public:
+  struct Stats {
+    uint32_t frames;
+    uint32_t crc_errors;
+    // Bytes skipped while looking for a frame.
+    uint32_t dropped_bytes;
+  };
+
+  // Two maximum-size frames, so one can be arriving while the other waits.
+  static constexpr std::size_t kRingSize = 512;
+
+  ProtocolParser();
+
+  // Contiguous free space at the write position; read up to |length| bytes
+  // into it and pass the count to commitWrite(). |length| is 0 when full.
+  uint8_t *writeBuffer(std::size_t &length);
+  void commitWrite(std::size_t length);
+  // Copies |data| in, as far as it fits; returns the bytes taken.
+  std::size_t feed(const uint8_t *data, std::size_t length);
+
+  // Finds the next complete frame with a valid CRC. Returns false when more
+  // bytes are needed.
+  bool next(CommandView &view);
+
+  std::size_t buffered() const { return static_cast<uint16_t>(head_ - tail_); }
+  const Stats &stats() const { return stats_; }
+
+ private:
+  static constexpr uint16_t kMask = kRingSize - 1;
+
+  uint8_t at(uint16_t offset) const { return ring_[(tail_ + offset) & kMask]; }
+  void drop();
+
+  uint8_t ring_[kRingSize];
+  // Free-running positions; the ring index is the low bits.
+  uint16_t head_;
+  uint16_t tail_;
+  Stats stats_;
+};
@@ -0,0 +1,76 @@
+#pragma once
+
+#include <Preferences.h>
+#include <cstdint>
+
+// Lighting state that survives power loss. Values are the raw enum values of
+// BrightnessMode and GlowMode; the store does not interpret them.
+struct LightingSettings {
+  uint8_t brightness;
+  uint8_t glow;
+};
+
+// Write-behind persistence for LightingSettings. The render path only calls
+// update(), which touches RAM; a low-priority task asks takePending() when a
+// commit is due (after an idle window, or at once on requestFlush()) and then
+// writes the snapshot with commit(), handing it back with restore() if the
+// write fails. Brightness and glow are stored together
+// as one versioned, CRC-checked blob so a state change costs one NVS entry,
+// and rapid toggling collapses into a single write of the final state.
+//
+// The store itself does no locking: update()/requestFlush()/takePending()/
+// restore() must be serialised by the caller, commit() and load() must not run
+// concurrently with each other.
+class SettingsStore {
+ public:
+  struct Stats {
+    uint32_t updates;
+    uint32_t commits;
+    uint32_t skipped_commits;
+    // Writes NVS refused; each is retried.
+    uint32_t failed_commits;
+    uint32_t crc_failures;
+  };
+
+  static constexpr uint32_t kNoDeadline = UINT32_MAX;
+
+  SettingsStore(Preferences &preferences, uint32_t idle_window_ms);
+
+  // Reads the blob, migrating the legacy per-key layout if that is all there
+  // is. Returns false and leaves |settings| untouched when nothing valid is
+  // stored.
+  bool load(LightingSettings &settings);
+
+  void update(const LightingSettings &settings, uint32_t now_ms);
+  void requestFlush();
+
+  // Returns true and the snapshot to write when a commit is due. Otherwise
+  // |wait_ms| is how long until one might be (kNoDeadline when clean).
+  bool takePending(uint32_t now_ms, LightingSettings &settings, uint32_t &wait_ms);
+
+  // Writes |settings| unless it matches what is already stored. Returns
+  // false if NVS refused the write.
+  bool commit(const LightingSettings &settings);
+  // Makes |settings|, taken by takePending() but not committed, pending
+  // again unless an update has replaced it since. It is retried once the
+  // idle window from |now_ms| has passed.
+  void restore(const LightingSettings &settings, uint32_t now_ms);
+
+  const Stats &stats() const { return stats_; }
+
+ private:
+  bool loadLegacy(LightingSettings &settings);
+
+  Preferences &preferences_;
+  uint32_t idle_window_ms_;
+
+  LightingSettings pending_;
+  bool dirty_;
+  bool flush_requested_;
+  uint32_t last_update_ms_;
+
+  LightingSettings stored_;
+  bool stored_valid_;
+  bool legacy_keys_present_;
+  Stats stats_;
+};
@@ -0,0 +1,55 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+// Fixed-size ring for one producer task and one consumer task, with no lock
+// and no read-modify-write: each side stores only its own index, so it
+// needs nothing the ESP32-C3 would have to emulate. A push into a full ring
+// fails and is counted, so the producer never blocks and nothing is lost
+// without a trace.
+template <typename T, std::size_t N>
+class SpscRing {
+  static_assert(N != 0 && (N & (N - 1)) == 0 && N <= 128,
+                "free-running 8-bit indexes need a power of two up to 128");
+
+ public:
+  static constexpr std::size_t kCapacity = N;
+
+  SpscRing() : head_(0), tail_(0), overflows_(0) {}
+
+  // Producer. Returns false, counting an overflow, if the ring is full.
+  bool push(const T &item) {
+    const uint8_t head = head_.load(std::memory_order_relaxed);
+    if (static_cast<uint8_t>(head - tail_.load(std::memory_order_acquire)) >= N) {
+      overflows_.store(overflows_.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+      return false;
+    }
+    items_[head % N] = item;
+    head_.store(static_cast<uint8_t>(head + 1), std::memory_order_release);
+    return true;
+  }
+
+  // Consumer. Returns false if the ring is empty.
+  bool pop(T &item) {
+    const uint8_t tail = tail_.load(std::memory_order_relaxed);
+    if (tail == head_.load(std::memory_order_acquire)) {
+      return false;
+    }
+    item = items_[tail % N];
+    tail_.store(static_cast<uint8_t>(tail + 1), std::memory_order_release);
+    return true;
+  }
+
+  // Pushes that found the ring full, since construction. Written by the
+  // producer only; any task may read it.
+  uint32_t overflows() const { return overflows_.load(std::memory_order_relaxed); }
+
+ private:
+  T items_[N];
+  // Free-running indexes; the producer owns head_, the consumer tail_.
+  std::atomic<uint8_t> head_;
+  std::atomic<uint8_t> tail_;
+  std::atomic<uint32_t> overflows_;
+};
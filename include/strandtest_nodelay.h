@@ -1,9 +1,11 @@
 #pragma once
 
-#include <Adafruit_NeoPixel.h>
 #include <cstddef>
 #include <cstdint>
 
+#include "effect_engine.h"
+#include "sequence.h"
+
 enum class StrandPattern {
   kColorWipe = 0,
   kTheaterChase,
@@ -11,58 +13,62 @@ enum class StrandPattern {
   kTheaterChaseRainbow,
 };
 
+// The Adafruit strandtest patterns: maps each pattern and its wait onto an
+// EffectEngine effect. With auto-cycle on, a SequencePlayer runs a light-show
+// sequence instead (the built-in strandtest demo unless setSequence() gave
+// another). Rendering and frame timing live in the engine.
 class StrandtestController {
  public:
-  explicit StrandtestController(Adafruit_NeoPixel &strip);
+  explicit StrandtestController(EffectEngine &engine);
 
   void begin();
   void update();
+  // Milliseconds until update() has work to do: the next pixel frame or the
+  // next auto-cycle pattern change, whichever is sooner.
+  unsigned long nextFrameDelayMs() const;
 
   void setAutoCycle(bool enabled);
+  // Replaces the auto-cycle sequence; see sequence.h for the format.
+  // |sequence| must outlive the controller or the next setSequence(). Returns
+  // false and keeps the current sequence if it does not validate.
+  bool setSequence(const uint8_t *sequence, std::size_t length);
   void setPattern(StrandPattern pattern);
   void setPattern(StrandPattern pattern, uint32_t color);
   void setPrimaryColor(uint32_t color);
+  // Hold time for sequence entries that wait for their effect without an
+  // explicit timeout.
   void setPatternInterval(int interval_ms);
   void setColorWipeWait(int wait_ms);
   void setTheaterChaseWait(int wait_ms);
   void setRainbowWait(uint8_t wait_ms);
   void setTheaterChaseRainbowWait(uint8_t wait_ms);
   void setBrightness(uint8_t brightness);
+  void setGammaCorrection(bool enabled);
+  // Minimum time between rendered frames. Steps that fall in between are
+  // skipped, so a lower frame rate does not change the animation speed.
+  void setFrameInterval(uint16_t interval_ms);
+
+  // Steps that were never rendered because update() ran late or the frame
+  // interval throttled it.
+  uint32_t skippedFrames() const { return engine_.skippedFrames(); }
 
  private:
-  void colorWipe(uint32_t color, int wait);
-  void theaterChase(uint32_t color, int wait);
-  uint32_t wheel(uint8_t wheel_pos);
-  void rainbow(uint8_t wait);
-  void theaterChaseRainbow(uint8_t wait);
+  EffectParams patternParams(StrandPattern pattern) const;
 
   void resetPatternState();
   void handleAutoCycle(unsigned long current_millis);
-  void applyPattern(StrandPattern pattern, unsigned long current_millis);
-  void applyDefaultCycleEntry(std::size_t index, unsigned long current_millis);
+  void startSequence();
+  void applyPattern(StrandPattern pattern);
 
-  Adafruit_NeoPixel &strip_;
-  unsigned long pixel_previous_;
-  unsigned long pattern_previous_;
+  EffectEngine &engine_;
+  SequencePlayer player_;
   StrandPattern pattern_current_;
-  int pattern_interval_;
-  bool pattern_complete_;
   bool auto_cycle_;
-  std::size_t pattern_index_;
-  bool force_refresh_;
 
   uint32_t primary_color_;
   int color_wipe_wait_;
   int theater_chase_wait_;
   uint8_t rainbow_wait_;
   uint8_t theater_chase_rainbow_wait_;
-
-  int pixel_interval_;
-  int pixel_queue_;
-  int pixel_cycle_;
-  uint16_t pixel_number_;
-
-  uint16_t color_wipe_position_;
-  uint16_t theater_chase_offset_;
-  uint32_t theater_chase_loops_;
+  bool gamma_correction_;
 };
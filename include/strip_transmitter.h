@@ -0,0 +1,39 @@
+#pragma once
+
+#include <Adafruit_NeoPixel.h>
+#include <cstddef>
+#include <cstdint>
+
+// Clocks encoded frames (wire-order bytes, three per pixel) out to a strip.
+// transmit() may return before the frame is out: the caller leaves |data|
+// untouched until busy() reports false. That is what lets PixelOutput encode
+// the next frame into a second buffer while the previous one is being sent.
+class StripTransmitter {
+ public:
+  virtual void begin() = 0;
+  // Starts sending |length| bytes. Only called when busy() is false.
+  virtual void transmit(const uint8_t *data, std::size_t length) = 0;
+  // True while a frame is being clocked out or its latch gap has not passed.
+  virtual bool busy() = 0;
+  // Blocks until busy() is false.
+  virtual void wait() = 0;
+
+ protected:
+  ~StripTransmitter() = default;
+};
+
+// Blocking backend on Adafruit_NeoPixel::show(), which bit-bangs (or waits
+// on) the transfer, so transmit() only returns once the frame is out. Works
+// on any pin and board the library supports.
+class NeoPixelTransmitter final : public StripTransmitter {
+ public:
+  explicit NeoPixelTransmitter(Adafruit_NeoPixel &strip) : strip_(strip) {}
+
+  void begin() override;
+  void transmit(const uint8_t *data, std::size_t length) override;
+  bool busy() override { return !strip_.canShow(); }
+  void wait() override;
+
+ private:
+  Adafruit_NeoPixel &strip_;
+};
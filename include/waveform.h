@@ -0,0 +1,172 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+// Periodic waveforms as compile-time lookup tables. A waveform is one cycle
+// of 256 samples from 0 to 255, and effects sample it by a 16-bit
+// fixed-point phase (65536 to the cycle), so a sample is one table load on
+// the phase's high byte. kTriangle and kSine start at 0 and peak at half a
+// cycle, so either can stand in for the other; custom curves (BuildCurve())
+// take any shape.
+//
+// Curves are built as perceived lightness and converted to the linear
+// output level with the CIE L* formula (Perceptual()): equal steps of
+// lightness look equal, where equal steps of level crowd the bright end.
+
+namespace waveform {
+
+constexpr std::size_t kTableSize = 256;
+
+using Table = std::array<uint8_t, kTableSize>;
+// Position in a cycle, 65536 to the cycle; it wraps like the cycle does.
+using Phase = uint16_t;
+
+constexpr Phase kHalfCycle = 0x8000;
+
+inline uint8_t Sample(const Table &table, Phase phase) { return table[phase >> 8]; }
+
+// |value| mapped onto [low, high]: 0 gives |low| and 255 gives |high|.
+constexpr uint8_t Map(uint8_t value, uint8_t low, uint8_t high) {
+  return static_cast<uint8_t>(low + (((high - low) * (value + 1)) >> 8));
+}
+
+// Phase to advance per animation step for a cycle of |cycle_ms| at
+// |step_ms| per step.
+constexpr uint16_t PhaseStep(uint32_t cycle_ms, uint16_t step_ms) {
+  return cycle_ms == 0 ? 0 : static_cast<uint16_t>((uint32_t{1} << 16) * step_ms / cycle_ms);
+}
+
+// A point a custom curve passes through: |value| at sample |at|.
+struct CurvePoint {
+  uint8_t at;
+  uint8_t value;
+};
+
+namespace detail {
+
+constexpr double kPi = 3.14159265358979323846;
+
+// Taylor series, accurate to well under one part in 2^16 on [-pi, pi].
+constexpr double Cos(double x) {
+  if (x > kPi) {
+    x -= 2 * kPi;
+  }
+  double term = 1.0;
+  double sum = 1.0;
+  for (int k = 1; k < 16; ++k) {
+    term *= -x * x / ((2 * k - 1) * (2 * k));
+    sum += term;
+  }
+  return sum;
+}
+
+constexpr uint8_t Round(double value) { return static_cast<uint8_t>(value * 255.0 + 0.5); }
+
+// CIE L* lightness, 0 to 1, to relative luminance.
+constexpr double Luminance(double lightness) {
+  const double l = lightness * 100.0;
+  const double f = (l + 16.0) / 116.0;
+  return l > 8.0 ? f * f * f : l / 903.3;
+}
+
+}  // namespace detail
+
+// Linear ramp up to 255 at half a cycle and back down.
+constexpr Table BuildTriangle() {
+  Table table{};
+  for (std::size_t i = 0; i < kTableSize; ++i) {
+    const std::size_t distance = i <= kTableSize / 2 ? i : kTableSize - i;
+    table[i] = static_cast<uint8_t>(distance * 2 > 255 ? 255 : distance * 2);
+  }
+  return table;
+}
+
+// Raised cosine, (1 - cos) / 2: the sine wave shifted to start at its
+// minimum. |perceptual| reads it as lightness, like Perceptual(), but from
+// the exact value rather than the rounded sample.
+constexpr Table BuildSine(bool perceptual = false) {
+  Table table{};
+  for (std::size_t i = 0; i < kTableSize; ++i) {
+    const double angle = 2 * detail::kPi * static_cast<double>(i) / kTableSize;
+    const double value = (1.0 - detail::Cos(angle)) / 2;
+    table[i] = detail::Round(perceptual ? detail::Luminance(value) : value);
+  }
+  return table;
+}
+
+// Piecewise linear through |points|, which start at sample 0 and are in
+// order of |at|; the last value holds to the end of the cycle.
+template <std::size_t N>
+constexpr Table BuildCurve(const CurvePoint (&points)[N]) {
+  Table table{};
+  std::size_t segment = 0;
+  for (std::size_t i = 0; i < kTableSize; ++i) {
+    while (segment + 1 < N && i >= points[segment + 1].at) {
+      ++segment;
+    }
+    if (segment + 1 == N) {
+      table[i] = points[segment].value;
+      continue;
+    }
+    const CurvePoint &a = points[segment];
+    const CurvePoint &b = points[segment + 1];
+    const int span = b.at - a.at;
+    const int offset = static_cast<int>(i) - a.at;
+    table[i] = static_cast<uint8_t>(a.value + ((b.value - a.value) * offset + span / 2) / span);
+  }
+  return table;
+}
+
+// Each sample read as CIE L* lightness (0 to 255 for L* 0 to 100) and
+// converted to relative luminance, the level the output applies.
+constexpr Table Perceptual(const Table &lightness) {
+  Table table{};
+  for (std::size_t i = 0; i < kTableSize; ++i) {
+    table[i] = detail::Round(detail::Luminance(lightness[i] / 255.0));
+  }
+  return table;
+}
+
+constexpr Table BuildRamp() {
+  Table table{};
+  for (std::size_t i = 0; i < kTableSize; ++i) {
+    table[i] = static_cast<uint8_t>(i);
+  }
+  return table;
+}
+
+inline constexpr Table kTriangle = BuildTriangle();
+inline constexpr Table kSine = BuildSine();
+// Easing rather than a cycle: entry n is the level that looks n/255 as
+// bright.
+inline constexpr Table kLightness = Perceptual(BuildRamp());
+
+// Breathing: a sine wave in lightness.
+inline constexpr Table kBreathe = BuildSine(true);
+
+// A beat: a quick swell, a slower fade and a rest for the second half.
+constexpr CurvePoint kPulsePoints[] = {{0, 0}, {24, 255}, {48, 230}, {128, 0}};
+inline constexpr Table kPulse = Perceptual(BuildCurve(kPulsePoints));
+
+// Lub-dub: a strong beat, a weaker one just after, then rest.
+constexpr CurvePoint kHeartbeatPoints[] = {
+    {0, 0}, {12, 255}, {36, 60}, {52, 0}, {60, 200}, {84, 0},
+};
+inline constexpr Table kHeartbeat = Perceptual(BuildCurve(kHeartbeatPoints));
+
+// A glint: lit at once, gone in an eighth of the cycle.
+constexpr CurvePoint kSparklePoints[] = {{0, 0}, {2, 255}, {32, 0}};
+inline constexpr Table kSparkle = Perceptual(BuildCurve(kSparklePoints));
+
+static_assert(kTriangle[0] == 0 && kTriangle[128] == 255 && kTriangle[255] == 2,
+              "triangle peaks at half a cycle");
+static_assert(kSine[0] == 0 && kSine[128] == 255 && kSine[64] == 128,
+              "sine starts at its minimum and peaks at half a cycle");
+static_assert(kLightness[0] == 0 && kLightness[255] == 255 && kLightness[128] < 64,
+              "lightness keeps the end points and darkens the middle");
+static_assert(kPulse[24] == 255 && kPulse[200] == 0, "pulse peaks early and rests");
+static_assert(kHeartbeat[12] == 255 && kHeartbeat[52] == 0, "heartbeat has two beats");
+
+}  // namespace waveform
@@ -0,0 +1,117 @@
+#include "Adafruit_NeoPixel.h"
+
+#include <cstring>
+
+#include "host_sim.h"
+
+Adafruit_NeoPixel::Adafruit_NeoPixel(uint16_t n, int16_t pin, neoPixelType type)
+    : begun_(false),
+      num_leds_(0),
+      num_bytes_(0),
+      pin_(pin),
+      brightness_(0),
+      pixels_(nullptr),
+      r_offset_(0),
+      g_offset_(0),
+      b_offset_(0) {
+  updateType(type);
+  updateLength(n);
+}
+
+Adafruit_NeoPixel::~Adafruit_NeoPixel() { delete[] pixels_; }
+
+void Adafruit_NeoPixel::begin() { begun_ = true; }
+
+void Adafruit_NeoPixel::show() { host_sim::CountShow(num_leds_); }
+
+void Adafruit_NeoPixel::updateLength(uint16_t n) {
+  delete[] pixels_;
+  num_bytes_ = static_cast<uint16_t>(n * 3);
+  pixels_ = new uint8_t[num_bytes_];
+  std::memset(pixels_, 0, num_bytes_);
+  num_leds_ = n;
+}
+
+void Adafruit_NeoPixel::updateType(neoPixelType type) {
+  r_offset_ = (type >> 4) & 0b11;
+  g_offset_ = (type >> 2) & 0b11;
+  b_offset_ = type & 0b11;
+}
+
+void Adafruit_NeoPixel::setPixelColor(uint16_t n, uint8_t r, uint8_t g, uint8_t b) {
+  if (n >= num_leds_) {
+    return;
+  }
+  if (brightness_) {
+    r = static_cast<uint8_t>((r * brightness_) >> 8);
+    g = static_cast<uint8_t>((g * brightness_) >> 8);
+    b = static_cast<uint8_t>((b * brightness_) >> 8);
+  }
+  uint8_t *p = &pixels_[n * 3];
+  p[r_offset_] = r;
+  p[g_offset_] = g;
+  p[b_offset_] = b;
+}
+
+void Adafruit_NeoPixel::setPixelColor(uint16_t n, uint32_t c) {
+  setPixelColor(n, static_cast<uint8_t>(c >> 16), static_cast<uint8_t>(c >> 8),
+                static_cast<uint8_t>(c));
+}
+
+void Adafruit_NeoPixel::fill(uint32_t c, uint16_t first, uint16_t count) {
+  if (first >= num_leds_) {
+    return;
+  }
+  uint16_t end;
+  if (count == 0) {
+    end = num_leds_;
+  } else {
+    end = static_cast<uint16_t>(first + count);
+    if (end > num_leds_) {
+      end = num_leds_;
+    }
+  }
+  for (uint16_t i = first; i < end; i++) {
+    setPixelColor(i, c);
+  }
+}
+
+void Adafruit_NeoPixel::setBrightness(uint8_t b) {
+  // Same lossy in-place rescale as the upstream library.
+  const uint8_t new_brightness = static_cast<uint8_t>(b + 1);
+  if (new_brightness == brightness_) {
+    return;
+  }
+  const uint8_t old_brightness = static_cast<uint8_t>(brightness_ - 1);
+  uint16_t scale;
+  if (old_brightness == 0) {
+    scale = 0;
+  } else if (b == 255) {
+    scale = static_cast<uint16_t>(65535 / old_brightness);
+  } else {
+    scale = static_cast<uint16_t>(((static_cast<uint16_t>(new_brightness) << 8) - 1) /
+                                  old_brightness);
+  }
+  for (uint16_t i = 0; i < num_bytes_; i++) {
+    pixels_[i] = static_cast<uint8_t>((pixels_[i] * scale) >> 8);
+  }
+  brightness_ = new_brightness;
+}
+
+void Adafruit_NeoPixel::clear() { std::memset(pixels_, 0, num_bytes_); }
+
+uint32_t Adafruit_NeoPixel::getPixelColor(uint16_t n) const {
+  if (n >= num_leds_) {
+    return 0;
+  }
+  const uint8_t *p = &pixels_[n * 3];
+  uint32_t r = p[r_offset_];
+  uint32_t g = p[g_offset_];
+  uint32_t b = p[b_offset_];
+  if (brightness_) {
+    r = (r << 8) / brightness_;
+    g = (g << 8) / brightness_;
+    b = (b << 8) / brightness_;
+  }
+  return (r << 16) | (g << 8) | b;
+}
@@ -0,0 +1,63 @@
+#pragma once
+
+// Host stand-in for Adafruit_NeoPixel. Pixel storage, brightness scaling and
+// colour packing follow the upstream library byte for byte so rendered frames
+// match the device; show() only records the transfer.
+
+#include <cstdint>
+
+typedef uint16_t neoPixelType;
+
+#define NEO_RGB ((0 << 6) | (0 << 4) | (1 << 2) | (2))
+#define NEO_RBG ((0 << 6) | (0 << 4) | (2 << 2) | (1))
+#define NEO_GRB ((1 << 6) | (1 << 4) | (0 << 2) | (2))
+#define NEO_GBR ((2 << 6) | (2 << 4) | (0 << 2) | (1))
+#define NEO_BRG ((1 << 6) | (1 << 4) | (2 << 2) | (0))
+#define NEO_BGR ((2 << 6) | (2 << 4) | (1 << 2) | (0))
+
+#define NEO_KHZ800 0x0000
+#define NEO_KHZ400 0x0100
+
+class Adafruit_NeoPixel {
+ public:
+  Adafruit_NeoPixel(uint16_t n, int16_t pin = 6, neoPixelType type = NEO_GRB + NEO_KHZ800);
+  ~Adafruit_NeoPixel();
+
+  Adafruit_NeoPixel(const Adafruit_NeoPixel &) = delete;
+  Adafruit_NeoPixel &operator=(const Adafruit_NeoPixel &) = delete;
+
+  void begin();
+  void show();
+  bool canShow() const { return true; }
+
+  void setPin(int16_t pin) { pin_ = pin; }
+  void updateLength(uint16_t n);
+  void updateType(neoPixelType type);
+
+  void setPixelColor(uint16_t n, uint8_t r, uint8_t g, uint8_t b);
+  void setPixelColor(uint16_t n, uint32_t c);
+  void fill(uint32_t c = 0, uint16_t first = 0, uint16_t count = 0);
+  void setBrightness(uint8_t b);
+  void clear();
+
+  uint8_t *getPixels() const { return pixels_; }
+  uint8_t getBrightness() const { return static_cast<uint8_t>(brightness_ - 1); }
+  int16_t getPin() const { return pin_; }
+  uint16_t numPixels() const { return num_leds_; }
+  uint32_t getPixelColor(uint16_t n) const;
+
+  static uint32_t Color(uint8_t r, uint8_t g, uint8_t b) {
+    return (static_cast<uint32_t>(r) << 16) | (static_cast<uint32_t>(g) << 8) | b;
+  }
+
+ private:
+  bool begun_;
+  uint16_t num_leds_;
+  uint16_t num_bytes_;
+  int16_t pin_;
+  uint8_t brightness_;
+  uint8_t *pixels_;
+  uint8_t r_offset_;
+  uint8_t g_offset_;
+  uint8_t b_offset_;
+};
@@ -0,0 +1,79 @@
+#pragma once
+
+// Minimal Arduino core stand-in for the native build. Time comes from the
+// simulated clock in host_sim.h.
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <functional>
+
+#define HIGH 0x1
+#define LOW 0x0
+
+#define INPUT 0x01
+#define OUTPUT 0x03
+#define INPUT_PULLUP 0x05
+
+#define RISING 0x01
+#define FALLING 0x02
+#define CHANGE 0x03
+
+#define ARDUINO_ISR_ATTR
+#define IRAM_ATTR
+
+#define digitalPinToInterrupt(p) (p)
+
+unsigned long millis();
+unsigned long micros();
+void delay(uint32_t ms);
+void delayMicroseconds(uint32_t us);
+
+void pinMode(uint8_t pin, uint8_t mode);
+void digitalWrite(uint8_t pin, uint8_t val);
+int digitalRead(uint8_t pin);
+
+void attachInterrupt(uint8_t pin, void (*isr)(), int mode);
+void detachInterrupt(uint8_t pin);
+
+typedef std::function<void(void)> OnReceiveCb;
+
+class HardwareSerial {
+ public:
+  void begin(unsigned long baud);
+  void end();
+  // |function| runs whenever received bytes arrive (host_sim::SerialReceive).
+  void onReceive(OnReceiveCb function, bool only_on_timeout = false);
+
+  int available();
+  int read();
+  size_t read(uint8_t *buffer, size_t size);
+  size_t write(uint8_t byte);
+  size_t write(const uint8_t *buffer, size_t size);
+  void flush();
+
+  size_t print(const char *text);
+  size_t print(long value);
+  size_t println(const char *text);
+  size_t println(long value);
+  size_t println();
+  size_t printf(const char *format, ...) __attribute__((format(printf, 2, 3)));
+
+  explicit operator bool() const { return true; }
+};
+
+extern HardwareSerial Serial;
+
+// Cycle counter at a nominal 160 MHz, driven by the host's steady clock
+// rather than the simulated one, so it measures real work.
+class EspClass {
+ public:
+  uint32_t getCycleCount();
+  uint32_t getCpuFreqMHz() { return 160; }
+};
+
+extern EspClass ESP;
+
+void setup();
+void loop();
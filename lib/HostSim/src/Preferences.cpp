@@ -0,0 +1,126 @@
+#include "Preferences.h"
+
+#include <cstring>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "host_sim.h"
+
+namespace {
+
+using Namespace = std::map<std::string, std::vector<uint8_t>>;
+
+struct NvsState {
+  std::map<std::string, Namespace> namespaces;
+  uint64_t writes = 0;
+  uint64_t bytes_written = 0;
+  uint32_t failing_writes = 0;
+};
+
+NvsState &Nvs() {
+  static NvsState state;
+  return state;
+}
+
+Namespace *AsNamespace(void *handle) { return static_cast<Namespace *>(handle); }
+
+}  // namespace
+
+namespace host_sim {
+
+void ResetNvs() {
+  Nvs().namespaces.clear();
+  Nvs().writes = 0;
+  Nvs().bytes_written = 0;
+  Nvs().failing_writes = 0;
+}
+
+void FailNvsWrites(uint32_t count) { Nvs().failing_writes = count; }
+
+uint64_t NvsWriteCount() { return Nvs().writes; }
+
+uint64_t NvsBytesWritten() { return Nvs().bytes_written; }
+
+}  // namespace host_sim
+
+bool Preferences::begin(const char *name, bool read_only, const char *partition_label) {
+  (void)partition_label;
+  if (name == nullptr || std::strlen(name) > 15) {
+    return false;
+  }
+  namespace_ = &Nvs().namespaces[name];
+  read_only_ = read_only;
+  return true;
+}
+
+void Preferences::end() { namespace_ = nullptr; }
+
+bool Preferences::clear() {
+  if (!namespace_ || read_only_) {
+    return false;
+  }
+  AsNamespace(namespace_)->clear();
+  Nvs().writes++;
+  return true;
+}
+
+bool Preferences::remove(const char *key) {
+  if (!namespace_ || read_only_) {
+    return false;
+  }
+  Nvs().writes++;
+  return AsNamespace(namespace_)->erase(key) > 0;
+}
+
+bool Preferences::isKey(const char *key) {
+  return namespace_ && AsNamespace(namespace_)->count(key) > 0;
+}
+
+size_t Preferences::putInt(const char *key, int32_t value) {
+  return putBytes(key, &value, sizeof(value));
+}
+
+int32_t Preferences::getInt(const char *key, int32_t default_value) {
+  int32_t value = default_value;
+  if (getBytesLength(key) != sizeof(value)) {
+    return default_value;
+  }
+  getBytes(key, &value, sizeof(value));
+  return value;
+}
+
+size_t Preferences::putBytes(const char *key, const void *value, size_t len) {
+  if (!namespace_ || read_only_ || key == nullptr || value == nullptr) {
+    return 0;
+  }
+  if (Nvs().failing_writes > 0) {
+    Nvs().failing_writes--;
+    return 0;
+  }
+  const uint8_t *bytes = static_cast<const uint8_t *>(value);
+  (*AsNamespace(namespace_))[key].assign(bytes, bytes + len);
+  Nvs().writes++;
+  Nvs().bytes_written += len;
+  return len;
+}
+
+size_t Preferences::getBytesLength(const char *key) {
+  if (!namespace_) {
+    return 0;
+  }
+  const auto it = AsNamespace(namespace_)->find(key);
+  return it == AsNamespace(namespace_)->end() ? 0 : it->second.size();
+}
+
+size_t Preferences::getBytes(const char *key, void *buf, size_t max_len) {
+  if (!namespace_ || buf == nullptr) {
+    return 0;
+  }
+  const auto it = AsNamespace(namespace_)->find(key);
+  if (it == AsNamespace(namespace_)->end() || it->second.size() > max_len) {
+    return 0;
+  }
+  std::memcpy(buf, it->second.data(), it->second.size());
+  return it->second.size();
+}
@@ -0,0 +1,31 @@
+#pragma once
+
+// Host stand-in for the ESP32 Preferences (NVS) API. Namespaces live in RAM
+// for the lifetime of the process; every put counts as one flash write.
+
+#include <cstddef>
+#include <cstdint>
+
+class Preferences {
+ public:
+  Preferences() = default;
+  ~Preferences() { end(); }
+
+  bool begin(const char *name, bool read_only = false, const char *partition_label = nullptr);
+  void end();
+
+  bool clear();
+  bool remove(const char *key);
+  bool isKey(const char *key);
+
+  size_t putInt(const char *key, int32_t value);
+  int32_t getInt(const char *key, int32_t default_value = 0);
+
+  size_t putBytes(const char *key, const void *value, size_t len);
+  size_t getBytesLength(const char *key);
+  size_t getBytes(const char *key, void *buf, size_t max_len);
+
+ private:
+  void *namespace_ = nullptr;
+  bool read_only_ = false;
+};
@@ -0,0 +1,28 @@
+#pragma once
+
+// Host stand-in for the ESP32 Arduino WiFi station: already connected, with
+// the host's own network stack (and its loopback) behind the lwIP socket
+// calls.
+
+#include <cstdint>
+
+enum wifi_mode_t {
+  WIFI_OFF = 0,
+  WIFI_STA,
+};
+
+enum wl_status_t {
+  WL_IDLE_STATUS = 0,
+  WL_CONNECTED = 3,
+  WL_DISCONNECTED = 6,
+};
+
+class WiFiClass {
+ public:
+  bool mode(wifi_mode_t mode) { return true; }
+  wl_status_t begin(const char *ssid, const char *passphrase = nullptr) { return WL_CONNECTED; }
+  bool setSleep(bool enable) { return true; }
+  wl_status_t status() { return WL_CONNECTED; }
+};
+
+inline WiFiClass WiFi;
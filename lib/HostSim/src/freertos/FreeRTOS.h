@@ -0,0 +1,41 @@
+#pragma once
+
+// Host stand-in for the FreeRTOS kernel types used by the firmware. The tick
+// rate matches the ESP32 Arduino default of 1 kHz.
+
+#include <cstdint>
+
+typedef int BaseType_t;
+typedef unsigned int UBaseType_t;
+typedef uint32_t TickType_t;
+// Stack depths are in bytes, as on ESP-IDF.
+typedef uint8_t StackType_t;
+
+#define configTICK_RATE_HZ 1000
+#define portMAX_DELAY ((TickType_t)0xffffffffUL)
+#define portTICK_PERIOD_MS ((TickType_t)1000 / configTICK_RATE_HZ)
+#define pdMS_TO_TICKS(ms) ((TickType_t)(((TickType_t)(ms) * (TickType_t)configTICK_RATE_HZ) / (TickType_t)1000U))
+
+#define pdFALSE ((BaseType_t)0)
+#define pdTRUE ((BaseType_t)1)
+#define pdPASS (pdTRUE)
+#define pdFAIL (pdFALSE)
+#define errQUEUE_FULL ((BaseType_t)0)
+
+// Control blocks for the static create calls. On the host they only
+// remember the task or queue made in them, so creating into the same
+// buffer again (a benchmark re-running setup()) replaces it.
+typedef struct {
+  void *host_object;
+} StaticTask_t;
+typedef struct {
+  void *host_object;
+} StaticQueue_t;
+
+#define portYIELD_FROM_ISR(x) ((void)(x))
+
+// Single-core host: critical sections need no lock.
+typedef int portMUX_TYPE;
+#define portMUX_INITIALIZER_UNLOCKED 0
+#define portENTER_CRITICAL(mux) ((void)(mux))
+#define portEXIT_CRITICAL(mux) ((void)(mux))
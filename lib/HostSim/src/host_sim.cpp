@@ -0,0 +1,623 @@
+#include "host_sim.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdarg>
+#include <deque>
+#include <map>
+#include <string>
+#include <vector>
+
+#include <ucontext.h>
+
+#include "Arduino.h"
+#include "driver/rmt.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/queue.h"
+#include "freertos/task.h"
+
+// Each task runs on a stack of its own, painted when the task is created,
+// so its high-water mark is what the task code really used.
+struct HostTask {
+  std::string name;
+  TaskFunction_t code;
+  void *parameters;
+  uint32_t stack_depth;
+  uint32_t notify_value;
+  std::vector<uint8_t> stack;
+  ucontext_t context;
+  // Stack used when the stop time unwound the task, before the unwinder's
+  // own frames (which the device never has) dirtied more of it.
+  uint32_t used_at_stop;
+};
+
+struct HostQueue {
+  UBaseType_t length;
+  UBaseType_t item_size;
+  std::deque<std::vector<uint8_t>> items;
+};
+
+namespace {
+
+struct ScheduledAction {
+  uint64_t time_us;
+  uint64_t sequence;
+  std::function<void()> action;
+};
+
+struct PinState {
+  int level = HIGH;
+  void (*isr)() = nullptr;
+  int mode = 0;
+};
+
+struct RmtChannel {
+  uint8_t clk_div = 1;
+  sample_to_rmt_t translator = nullptr;
+  uint64_t done_us = 0;
+};
+
+struct SimState {
+  uint64_t now_us = 0;
+  uint64_t stop_us = UINT64_MAX;
+  uint64_t next_sequence = 0;
+  std::multimap<uint64_t, ScheduledAction> schedule;
+  std::vector<HostTask *> tasks;
+  HostTask *current_task = nullptr;
+  std::map<uint8_t, PinState> pins;
+  RmtChannel rmt[RMT_CHANNEL_MAX];
+  host_sim::RmtTap rmt_tap;
+  std::deque<uint8_t> serial_rx;
+  OnReceiveCb serial_on_receive;
+  bool serial_capture = false;
+  std::vector<uint8_t> serial_tx;
+  host_sim::Stats stats{};
+  bool busy = false;
+  std::chrono::steady_clock::time_point busy_since;
+};
+
+SimState &Sim() {
+  static SimState state;
+  return state;
+}
+
+// Host stacks are much larger than any device stack, so a task that
+// outgrows its configured depth still runs and reports the overrun.
+constexpr size_t kHostStackBytes = 1024 * 1024;
+constexpr uint8_t kStackPaint = 0xa5;
+
+ucontext_t run_task_caller;
+
+uint64_t TicksToUs(TickType_t ticks) {
+  return static_cast<uint64_t>(ticks) * 1000000ULL / configTICK_RATE_HZ;
+}
+
+void PaintStack(HostTask &task) {
+  task.stack.assign(kHostStackBytes, kStackPaint);
+}
+
+// Bytes of the task's stack ever written; the stack grows down from the
+// end of the vector.
+uint32_t StackUsed(const HostTask &task) {
+  const auto untouched = std::find_if(task.stack.begin(), task.stack.end(),
+                                      [](uint8_t byte) { return byte != kStackPaint; });
+  return static_cast<uint32_t>(task.stack.end() - untouched);
+}
+
+void TaskEntry() {
+  HostTask *task = Sim().current_task;
+  try {
+    task->code(task->parameters);
+  } catch (const host_sim::StopSimulation &) {
+  }
+}
+
+}  // namespace
+
+namespace host_sim {
+
+uint64_t NowUs() { return Sim().now_us; }
+
+void AdvanceTo(uint64_t time_us) {
+  SimState &sim = Sim();
+  while (!sim.schedule.empty()) {
+    auto it = sim.schedule.begin();
+    if (it->first > time_us || it->first > sim.stop_us) {
+      break;
+    }
+    ScheduledAction entry = std::move(it->second);
+    sim.schedule.erase(it);
+    if (entry.time_us > sim.now_us) {
+      sim.now_us = entry.time_us;
+    }
+    entry.action();
+  }
+  if (time_us >= sim.stop_us) {
+    sim.now_us = sim.stop_us;
+    if (sim.current_task != nullptr) {
+      sim.current_task->used_at_stop = StackUsed(*sim.current_task);
+    }
+    throw StopSimulation{};
+  }
+  if (time_us > sim.now_us) {
+    sim.now_us = time_us;
+  }
+}
+
+void AdvanceBy(uint64_t delta_us) { AdvanceTo(Sim().now_us + delta_us); }
+
+void Schedule(uint64_t time_us, std::function<void()> action) {
+  SimState &sim = Sim();
+  sim.schedule.emplace(time_us, ScheduledAction{time_us, sim.next_sequence++, std::move(action)});
+}
+
+void ClearSchedule() { Sim().schedule.clear(); }
+
+uint64_t NextScheduledUs() {
+  const SimState &sim = Sim();
+  return sim.schedule.empty() ? UINT64_MAX : sim.schedule.begin()->first;
+}
+
+void SetStopTime(uint64_t time_us) { Sim().stop_us = time_us; }
+
+uint64_t StopTimeUs() { return Sim().stop_us; }
+
+void BeginBusy() {
+  Sim().busy = true;
+  Sim().busy_since = std::chrono::steady_clock::now();
+}
+
+void EndBusy() {
+  BlockEnter();
+  Sim().busy = false;
+}
+
+void BlockEnter() {
+  SimState &sim = Sim();
+  if (!sim.busy) {
+    return;
+  }
+  const auto now = std::chrono::steady_clock::now();
+  sim.stats.busy_ns += static_cast<uint64_t>(
+      std::chrono::duration_cast<std::chrono::nanoseconds>(now - sim.busy_since).count());
+  sim.busy_since = now;
+}
+
+void BlockExit() {
+  SimState &sim = Sim();
+  if (!sim.busy) {
+    return;
+  }
+  sim.stats.wakeups++;
+  sim.busy_since = std::chrono::steady_clock::now();
+}
+
+const Stats &GetStats() { return Sim().stats; }
+
+void ResetStats() { Sim().stats = Stats{}; }
+
+void CountShow(uint16_t pixels) {
+  Sim().stats.show_calls++;
+  Sim().stats.show_pixels += pixels;
+}
+
+bool RunTask(const char *name, uint64_t duration_us) {
+  SimState &sim = Sim();
+  HostTask *task = nullptr;
+  for (HostTask *candidate : sim.tasks) {
+    if (candidate->name == name) {
+      task = candidate;
+    }
+  }
+  if (task == nullptr) {
+    return false;
+  }
+  SetStopTime(sim.now_us + duration_us);
+  sim.current_task = task;
+  BeginBusy();
+  getcontext(&task->context);
+  task->context.uc_stack.ss_sp = task->stack.data();
+  task->context.uc_stack.ss_size = task->stack.size();
+  task->context.uc_link = &run_task_caller;
+  makecontext(&task->context, TaskEntry, 0);
+  task->used_at_stop = 0;
+  swapcontext(&run_task_caller, &task->context);
+  if (task->used_at_stop != 0) {
+    const uint32_t used = StackUsed(*task);
+    std::fill(task->stack.end() - used, task->stack.end() - task->used_at_stop, kStackPaint);
+  }
+  EndBusy();
+  sim.current_task = nullptr;
+  SetStopTime(UINT64_MAX);
+  return true;
+}
+
+StackUse TaskStackUse(const char *name) {
+  const HostTask *task = nullptr;
+  for (const HostTask *candidate : Sim().tasks) {
+    if (candidate->name == name) {
+      task = candidate;
+    }
+  }
+  return task ? StackUse{task->stack_depth, StackUsed(*task)} : StackUse{};
+}
+
+void TapRmt(RmtTap tap) { Sim().rmt_tap = std::move(tap); }
+
+void SetPinLevel(uint8_t pin, int level) {
+  PinState &state = Sim().pins[pin];
+  if (state.level == level) {
+    return;
+  }
+  state.level = level;
+  const bool fire = state.mode == CHANGE || (state.mode == RISING && level == HIGH) ||
+                    (state.mode == FALLING && level == LOW);
+  if (fire && state.isr) {
+    state.isr();
+  }
+}
+
+void SerialReceive(const uint8_t *data, size_t length) {
+  SimState &sim = Sim();
+  sim.serial_rx.insert(sim.serial_rx.end(), data, data + length);
+  if (sim.serial_on_receive) {
+    sim.serial_on_receive();
+  }
+}
+
+void CaptureSerial(bool capture) { Sim().serial_capture = capture; }
+
+std::vector<uint8_t> TakeSerialOutput() {
+  std::vector<uint8_t> output;
+  output.swap(Sim().serial_tx);
+  return output;
+}
+
+}  // namespace host_sim
+
+// ---- Arduino core ----
+
+unsigned long millis() { return static_cast<unsigned long>(host_sim::NowUs() / 1000ULL); }
+
+unsigned long micros() { return static_cast<unsigned long>(host_sim::NowUs()); }
+
+void delay(uint32_t ms) { vTaskDelay(pdMS_TO_TICKS(ms)); }
+
+// Busy-waits on the device, so no task switch is accounted.
+void delayMicroseconds(uint32_t us) { host_sim::AdvanceBy(us); }
+
+void pinMode(uint8_t, uint8_t) {}
+
+void digitalWrite(uint8_t, uint8_t) {}
+
+int digitalRead(uint8_t pin) {
+  const auto it = Sim().pins.find(pin);
+  return it == Sim().pins.end() ? HIGH : it->second.level;
+}
+
+void attachInterrupt(uint8_t pin, void (*isr)(), int mode) {
+  PinState &state = Sim().pins[pin];
+  state.isr = isr;
+  state.mode = mode;
+}
+
+void detachInterrupt(uint8_t pin) {
+  PinState &state = Sim().pins[pin];
+  state.isr = nullptr;
+  state.mode = 0;
+}
+
+HardwareSerial Serial;
+
+void HardwareSerial::begin(unsigned long) {}
+
+void HardwareSerial::end() {}
+
+void HardwareSerial::onReceive(OnReceiveCb function, bool) { Sim().serial_on_receive = function; }
+
+int HardwareSerial::available() { return static_cast<int>(Sim().serial_rx.size()); }
+
+int HardwareSerial::read() {
+  std::deque<uint8_t> &rx = Sim().serial_rx;
+  if (rx.empty()) {
+    return -1;
+  }
+  const uint8_t byte = rx.front();
+  rx.pop_front();
+  return byte;
+}
+
+size_t HardwareSerial::read(uint8_t *buffer, size_t size) {
+  std::deque<uint8_t> &rx = Sim().serial_rx;
+  const size_t count = size < rx.size() ? size : rx.size();
+  std::copy(rx.begin(), rx.begin() + count, buffer);
+  rx.erase(rx.begin(), rx.begin() + count);
+  return count;
+}
+
+size_t HardwareSerial::write(uint8_t byte) { return write(&byte, 1); }
+
+size_t HardwareSerial::write(const uint8_t *buffer, size_t size) {
+  SimState &sim = Sim();
+  if (sim.serial_capture) {
+    sim.serial_tx.insert(sim.serial_tx.end(), buffer, buffer + size);
+    return size;
+  }
+  return std::fwrite(buffer, 1, size, stdout);
+}
+
+void HardwareSerial::flush() { std::fflush(stdout); }
+
+size_t HardwareSerial::print(const char *text) {
+  return write(reinterpret_cast<const uint8_t *>(text), std::strlen(text));
+}
+
+size_t HardwareSerial::print(long value) { return printf("%ld", value); }
+
+size_t HardwareSerial::println(const char *text) { return print(text) + println(); }
+
+size_t HardwareSerial::println(long value) { return print(value) + println(); }
+
+size_t HardwareSerial::println() { return print("\r\n"); }
+
+size_t HardwareSerial::printf(const char *format, ...) {
+  char text[256];
+  va_list args;
+  va_start(args, format);
+  const int written = std::vsnprintf(text, sizeof(text), format, args);
+  va_end(args);
+  if (written < 0) {
+    return 0;
+  }
+  return write(reinterpret_cast<const uint8_t *>(text),
+               static_cast<size_t>(written) < sizeof(text) ? written : sizeof(text) - 1);
+}
+
+EspClass ESP;
+
+uint32_t EspClass::getCycleCount() {
+  const auto elapsed = std::chrono::steady_clock::now().time_since_epoch();
+  const uint64_t ns = static_cast<uint64_t>(
+      std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count());
+  return static_cast<uint32_t>(ns * getCpuFreqMHz() / 1000);
+}
+
+// ---- FreeRTOS tasks ----
+
+BaseType_t xTaskCreate(TaskFunction_t task_code,
+                       const char *name,
+                       uint32_t stack_depth,
+                       void *parameters,
+                       UBaseType_t,
+                       TaskHandle_t *created_task) {
+  HostTask *task = new HostTask{name, task_code, parameters, stack_depth, 0, {}, {}, 0};
+  PaintStack(*task);
+  Sim().tasks.push_back(task);
+  if (created_task) {
+    *created_task = task;
+  }
+  return pdPASS;
+}
+
+TaskHandle_t xTaskCreateStatic(TaskFunction_t task_code,
+                               const char *name,
+                               uint32_t stack_depth,
+                               void *parameters,
+                               UBaseType_t priority,
+                               StackType_t *,
+                               StaticTask_t *task_buffer) {
+  HostTask *task = static_cast<HostTask *>(task_buffer->host_object);
+  if (task == nullptr) {
+    TaskHandle_t created = nullptr;
+    xTaskCreate(task_code, name, stack_depth, parameters, priority, &created);
+    task_buffer->host_object = created;
+    return created;
+  }
+  *task = HostTask{name, task_code, parameters, stack_depth, 0, {}, {}, 0};
+  PaintStack(*task);
+  return task;
+}
+
+TaskHandle_t xTaskGetCurrentTaskHandle() { return Sim().current_task; }
+
+char *pcTaskGetName(TaskHandle_t task) {
+  HostTask *named = task ? task : Sim().current_task;
+  static char none[] = "";
+  return named ? &named->name[0] : none;
+}
+
+uint32_t ulTaskNotifyTake(BaseType_t clear_count_on_exit, TickType_t ticks_to_wait) {
+  HostTask *task = Sim().current_task;
+  if (task == nullptr) {
+    return 0;
+  }
+  if (task->notify_value == 0 && ticks_to_wait != 0) {
+    host_sim::BlockEnter();
+    const uint64_t deadline = ticks_to_wait == portMAX_DELAY
+                                  ? UINT64_MAX
+                                  : host_sim::NowUs() + TicksToUs(ticks_to_wait);
+    while (task->notify_value == 0 && host_sim::NowUs() < deadline) {
+      const uint64_t next = host_sim::NextScheduledUs();
+      host_sim::AdvanceTo(next < deadline ? next : deadline);
+    }
+    host_sim::BlockExit();
+  }
+  const uint32_t value = task->notify_value;
+  if (value != 0) {
+    task->notify_value = clear_count_on_exit ? 0 : value - 1;
+  }
+  return value;
+}
+
+BaseType_t xTaskNotifyGive(TaskHandle_t task) {
+  if (task) {
+    task->notify_value++;
+  }
+  return pdPASS;
+}
+
+void vTaskNotifyGiveFromISR(TaskHandle_t task, BaseType_t *higher_priority_task_woken) {
+  xTaskNotifyGive(task);
+  if (higher_priority_task_woken) {
+    *higher_priority_task_woken = pdTRUE;
+  }
+}
+
+void vTaskDelay(TickType_t ticks) {
+  host_sim::BlockEnter();
+  host_sim::AdvanceBy(TicksToUs(ticks));
+  host_sim::BlockExit();
+}
+
+TickType_t xTaskGetTickCount() {
+  return static_cast<TickType_t>(host_sim::NowUs() * configTICK_RATE_HZ / 1000000ULL);
+}
+
+UBaseType_t uxTaskGetStackHighWaterMark(TaskHandle_t task) {
+  if (task == nullptr) {
+    task = Sim().current_task;
+  }
+  if (task == nullptr) {
+    return 0;
+  }
+  const uint32_t used = StackUsed(*task);
+  return used < task->stack_depth ? task->stack_depth - used : 0;
+}
+
+// ---- FreeRTOS queues ----
+
+QueueHandle_t xQueueCreate(UBaseType_t length, UBaseType_t item_size) {
+  return new HostQueue{length, item_size, {}};
+}
+
+// The host queue keeps its items itself; |storage| is only used on the
+// device.
+QueueHandle_t xQueueCreateStatic(UBaseType_t length, UBaseType_t item_size, uint8_t *,
+                                 StaticQueue_t *queue_buffer) {
+  HostQueue *queue = static_cast<HostQueue *>(queue_buffer->host_object);
+  if (queue == nullptr) {
+    queue = xQueueCreate(length, item_size);
+    queue_buffer->host_object = queue;
+  } else {
+    *queue = HostQueue{length, item_size, {}};
+  }
+  return queue;
+}
+
+void vQueueDelete(QueueHandle_t queue) { delete queue; }
+
+BaseType_t xQueueSend(QueueHandle_t queue, const void *item, TickType_t) {
+  if (queue->items.size() >= queue->length) {
+    return errQUEUE_FULL;
+  }
+  const uint8_t *bytes = static_cast<const uint8_t *>(item);
+  queue->items.emplace_back(bytes, bytes + queue->item_size);
+  return pdPASS;
+}
+
+BaseType_t xQueueReceive(QueueHandle_t queue, void *buffer, TickType_t ticks_to_wait) {
+  if (queue->items.empty() && ticks_to_wait != 0) {
+    host_sim::BlockEnter();
+    const uint64_t deadline = ticks_to_wait == portMAX_DELAY
+                                  ? UINT64_MAX
+                                  : host_sim::NowUs() + TicksToUs(ticks_to_wait);
+    while (queue->items.empty() && host_sim::NowUs() < deadline) {
+      const uint64_t next = host_sim::NextScheduledUs();
+      host_sim::AdvanceTo(next < deadline ? next : deadline);
+    }
+    host_sim::BlockExit();
+  }
+  if (queue->items.empty()) {
+    return pdFALSE;
+  }
+  std::memcpy(buffer, queue->items.front().data(), queue->item_size);
+  queue->items.pop_front();
+  return pdPASS;
+}
+
+UBaseType_t uxQueueMessagesWaiting(QueueHandle_t queue) {
+  return static_cast<UBaseType_t>(queue->items.size());
+}
+
+// ---- RMT ----
+
+namespace {
+
+// APB clock feeding the RMT divider.
+constexpr uint64_t kRmtSourceHz = 80000000;
+// Items per refill: one 64-word RMT memory block.
+constexpr size_t kRmtBlockItems = 64;
+
+bool ValidChannel(rmt_channel_t channel) { return channel >= 0 && channel < RMT_CHANNEL_MAX; }
+
+}  // namespace
+
+esp_err_t rmt_config(const rmt_config_t *config) {
+  if (config == nullptr || !ValidChannel(config->channel) || config->clk_div == 0) {
+    return ESP_ERR_INVALID_ARG;
+  }
+  Sim().rmt[config->channel].clk_div = config->clk_div;
+  return ESP_OK;
+}
+
+esp_err_t rmt_driver_install(rmt_channel_t channel, size_t, int) {
+  return ValidChannel(channel) ? ESP_OK : ESP_ERR_INVALID_ARG;
+}
+
+esp_err_t rmt_translator_init(rmt_channel_t channel, sample_to_rmt_t fn) {
+  if (!ValidChannel(channel) || fn == nullptr) {
+    return ESP_ERR_INVALID_ARG;
+  }
+  Sim().rmt[channel].translator = fn;
+  return ESP_OK;
+}
+
+esp_err_t rmt_write_sample(rmt_channel_t channel, const uint8_t *src, size_t src_size,
+                           bool wait_tx_done) {
+  if (!ValidChannel(channel) || Sim().rmt[channel].translator == nullptr) {
+    return ESP_ERR_INVALID_ARG;
+  }
+  RmtChannel &rmt = Sim().rmt[channel];
+  // The driver would refuse a write while the channel is sending.
+  rmt_wait_tx_done(channel, portMAX_DELAY);
+  if (Sim().rmt_tap) {
+    Sim().rmt_tap(channel, src, src_size);
+  }
+
+  rmt_item32_t items[kRmtBlockItems];
+  uint64_t ticks = 0;
+  size_t done = 0;
+  while (done < src_size) {
+    size_t translated = 0;
+    size_t count = 0;
+    rmt.translator(src + done, items, src_size - done, kRmtBlockItems, &translated, &count);
+    if (translated == 0) {
+      break;
+    }
+    for (size_t i = 0; i < count; ++i) {
+      ticks += items[i].duration0 + items[i].duration1;
+    }
+    done += translated;
+  }
+  rmt.done_us = host_sim::NowUs() + ticks * rmt.clk_div * 1000000ULL / kRmtSourceHz;
+  host_sim::CountShow(static_cast<uint16_t>(src_size / 3));
+  if (wait_tx_done) {
+    rmt_wait_tx_done(channel, portMAX_DELAY);
+  }
+  return ESP_OK;
+}
+
+esp_err_t rmt_wait_tx_done(rmt_channel_t channel, TickType_t wait_time) {
+  if (!ValidChannel(channel)) {
+    return ESP_ERR_INVALID_ARG;
+  }
+  const uint64_t done_us = Sim().rmt[channel].done_us;
+  if (host_sim::NowUs() < done_us && wait_time != 0) {
+    const uint64_t deadline =
+        wait_time == portMAX_DELAY ? UINT64_MAX : host_sim::NowUs() + TicksToUs(wait_time);
+    host_sim::BlockEnter();
+    host_sim::AdvanceTo(done_us < deadline ? done_us : deadline);
+    host_sim::BlockExit();
+  }
+  return host_sim::NowUs() >= done_us ? ESP_OK : ESP_ERR_TIMEOUT;
+}
@@ -0,0 +1,88 @@
+#pragma once
+
+// Simulation control for the native build. The firmware only sees the
+// Arduino/FreeRTOS stand-ins; benchmarks use this header to drive the
+// simulated clock, schedule input and collect counters.
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+namespace host_sim {
+
+// Thrown out of a blocking call once the simulated clock reaches the stop
+// time, unwinding the task loop that is being run.
+struct StopSimulation {};
+
+struct Stats {
+  uint64_t show_calls;
+  uint64_t show_pixels;
+  uint64_t wakeups;
+  uint64_t busy_ns;
+};
+
+uint64_t NowUs();
+void AdvanceTo(uint64_t time_us);
+void AdvanceBy(uint64_t delta_us);
+
+// Runs |action| once the simulated clock reaches |time_us|. Actions run in
+// time order from inside blocking calls, as if an ISR or another task fired.
+void Schedule(uint64_t time_us, std::function<void()> action);
+void ClearSchedule();
+// Earliest scheduled action time, or UINT64_MAX when nothing is pending.
+uint64_t NextScheduledUs();
+
+void SetStopTime(uint64_t time_us);
+uint64_t StopTimeUs();
+
+// Blocking calls account the wall time spent between them as task busy
+// time. BeginBusy() marks a task as running; EndBusy() stops accounting.
+void BeginBusy();
+void EndBusy();
+void BlockEnter();
+void BlockExit();
+
+const Stats &GetStats();
+void ResetStats();
+void CountShow(uint16_t pixels);
+
+// Tasks registered through xTaskCreate are not started on the host; a
+// benchmark runs one explicitly until the stop time unwinds it. Scheduled
+// actions run on the stack of the task being run.
+bool RunTask(const char *name, uint64_t duration_us);
+// Stack of the named task: the depth it was created with and the bytes it
+// has used since, measured on the host's stack frames (which differ from
+// the device's). Both are 0 for an unknown task.
+struct StackUse {
+  uint32_t depth;
+  uint32_t used;
+};
+StackUse TaskStackUse(const char *name);
+
+// Sees every buffer handed to rmt_write_sample(), as it is handed over.
+// An empty function removes the tap.
+using RmtTap = std::function<void(int channel, const uint8_t *data, size_t length)>;
+void TapRmt(RmtTap tap);
+
+// Drives a GPIO input level, firing any interrupt attached to the pin as
+// the hardware would. Pins read HIGH (pulled up) until set.
+void SetPinLevel(uint8_t pin, int level);
+
+// Loopback for Serial: delivers bytes to its receive buffer and runs the
+// onReceive() callback, as the UART driver would. While captured, Serial
+// output is kept for TakeSerialOutput() instead of going to stdout.
+void SerialReceive(const uint8_t *data, size_t length);
+void CaptureSerial(bool capture);
+std::vector<uint8_t> TakeSerialOutput();
+
+// Drops every Preferences namespace, the write counters and any failures
+// still to come.
+void ResetNvs();
+// Makes the next |count| writes fail as a full partition would: nothing is
+// stored and putBytes()/putInt() return 0.
+void FailNvsWrites(uint32_t count);
+uint64_t NvsWriteCount();
+uint64_t NvsBytesWritten();
+
+}  // namespace host_sim
@@ -0,0 +1,10 @@
+#pragma once
+
+// Host stand-in for lwIP's BSD socket API, which ESP-IDF builds with the
+// POSIX names: the host's own sockets serve.
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/select.h>
+#include <sys/socket.h>
+#include <unistd.h>
@@ -0,0 +1,76 @@
+"""Static RAM by subsystem, printed after every link.
+
+Sums the .data/.bss symbols of the linked program and attributes each to a
+firmware subsystem by name; whatever matches no rule is the framework,
+the libraries and (in env:native) the host stand-ins and benchmarks.
+
+PlatformIO runs it as a post script (platformio.ini extra_scripts). It also
+runs on its own:
+    python3 scripts/ram_report.py .pio/build/<env>/firmware.elf [nm]
+"""
+
+import re
+import subprocess
+import sys
+
+# First match wins. Names are demangled, without "(anonymous namespace)::".
+SUBSYSTEMS = [
+    ("tasks", r"_task_(stack|buffer|handle)$|_task_wakeups$"),
+    ("event queue", r"^(lighting_)?event_queue"),
+    ("pixel output", r"^strip_|^effect_engine$|^frame_cache"),
+    ("serial, stream", r"^serial_parser$|^frame_stream$|^stream_source$"),
+    ("osc", r"^osc_"),
+    ("settings", r"^preferences$|^settings_store$|^boot_settings$"),
+    ("button", r"^button_(keys|pad)$|^input_ring$"),
+    ("instrumentation", r"^instrumentation::"),
+]
+OTHER = "framework, libraries"
+
+# nm types of initialised and zero-initialised data, small-data included.
+RAM_TYPES = set("bBdDgGsS")
+ANONYMOUS = "(anonymous namespace)::"
+
+
+def ram_symbols(elf, nm):
+    output = subprocess.run([nm, "-S", "-C", elf], check=True, capture_output=True,
+                            text=True).stdout
+    for line in output.splitlines():
+        fields = line.split(None, 3)
+        if len(fields) == 4 and fields[2] in RAM_TYPES:
+            yield fields[3].replace(ANONYMOUS, ""), int(fields[1], 16)
+
+
+def subsystem_totals(elf, nm):
+    rules = [(name, re.compile(pattern)) for name, pattern in SUBSYSTEMS]
+    totals = {name: 0 for name, _ in SUBSYSTEMS}
+    totals[OTHER] = 0
+    for symbol, size in ram_symbols(elf, nm):
+        owner = next((name for name, rule in rules if rule.search(symbol)), OTHER)
+        totals[owner] += size
+    return totals
+
+
+def print_report(elf, nm):
+    totals = subsystem_totals(elf, nm)
+    total = sum(totals.values())
+    print("Static RAM by subsystem (.data + .bss):")
+    for name, size in totals.items():
+        print("  %-20s %8d B %5.1f%%" % (name, size, 100.0 * size / total if total else 0))
+    print("  %-20s %8d B" % ("total", total))
+
+
+def nm_for(env):
+    # The compiler's sibling: riscv32-esp-elf-gcc -> riscv32-esp-elf-nm.
+    return re.sub(r"g?cc$", "nm", env.subst("$CC"))
+
+
+try:
+    Import("env")  # noqa: F821 (SCons)
+except NameError:
+    env = None
+
+if env is not None:
+    env.AddPostAction("$BUILD_DIR/${PROGNAME}$PROGSUFFIX",
+                      lambda target, source, env: print_report(str(target[0]), nm_for(env)))
+elif __name__ == "__main__":
+    print_report(sys.argv[1], sys.argv[2] if len(sys.argv) > 2 else "nm")
@@ -0,0 +1,128 @@
+#include "button_gesture.h"
+
+namespace {
+// OneButton defaults.
+constexpr uint16_t kDefaultDebounceMs = 50;
+constexpr uint16_t kDefaultPressMs = 800;
+constexpr uint16_t kDefaultClickGapMs = 400;
+}  // namespace
+
+ButtonGesture::ButtonGesture()
+    : handler_(nullptr),
+      context_(nullptr),
+      debounce_ms_(kDefaultDebounceMs),
+      press_ms_(kDefaultPressMs),
+      long_press_interval_ms_(0),
+      click_gap_ms_(kDefaultClickGapMs),
+      max_clicks_(1),
+      state_(State::kIdle),
+      raw_pressed_(false),
+      stable_pressed_(false),
+      raw_since_ms_(0),
+      press_start_ms_(0),
+      last_during_ms_(0),
+      release_ms_(0),
+      clicks_(0) {}
+
+void ButtonGesture::setHandler(Handler handler, void *context) {
+  handler_ = handler;
+  context_ = context;
+}
+
+uint32_t ButtonGesture::update(bool pressed, uint32_t now_ms) {
+  if (pressed != raw_pressed_) {
+    raw_pressed_ = pressed;
+    raw_since_ms_ = now_ms;
+  }
+  // The level only counts once it has been stable for the debounce window.
+  if (raw_pressed_ != stable_pressed_ && (now_ms - raw_since_ms_) >= debounce_ms_) {
+    stable_pressed_ = raw_pressed_;
+  }
+
+  switch (state_) {
+    case State::kIdle:
+      if (stable_pressed_) {
+        state_ = State::kDown;
+        press_start_ms_ = now_ms;
+        clicks_ = 0;
+      }
+      break;
+    case State::kDown:
+      if (!stable_pressed_) {
+        ++clicks_;
+        if (clicks_ >= max_clicks_) {
+          state_ = State::kIdle;
+          emitClicks();
+        } else {
+          state_ = State::kUp;
+          release_ms_ = now_ms;
+        }
+      } else if ((now_ms - press_start_ms_) > press_ms_) {
+        // A hold ends a run of clicks; the clicks before it are dropped.
+        state_ = State::kLongPress;
+        last_during_ms_ = now_ms;
+        emit(Event::kLongPressStart);
+      }
+      break;
+    case State::kLongPress:
+      if (!stable_pressed_) {
+        state_ = State::kIdle;
+        emit(Event::kLongPressStop);
+      } else if (long_press_interval_ms_ != 0 &&
+                 (now_ms - last_during_ms_) >= long_press_interval_ms_) {
+        last_during_ms_ = now_ms;
+        emit(Event::kDuringLongPress);
+      }
+      break;
+    case State::kUp:
+      if (stable_pressed_) {
+        state_ = State::kDown;
+        press_start_ms_ = now_ms;
+      } else if ((now_ms - release_ms_) > click_gap_ms_) {
+        state_ = State::kIdle;
+        emitClicks();
+      }
+      break;
+    case State::kCancelled:
+      if (!stable_pressed_) {
+        state_ = State::kIdle;
+      }
+      break;
+  }
+
+  uint32_t deadline = kNoDeadline;
+  if (raw_pressed_ != stable_pressed_) {
+    deadline = Remaining(raw_since_ms_, debounce_ms_, now_ms);
+  }
+  if (state_ == State::kDown) {
+    const uint32_t press = Remaining(press_start_ms_, press_ms_ + 1u, now_ms);
+    deadline = press < deadline ? press : deadline;
+  } else if (state_ == State::kLongPress && long_press_interval_ms_ != 0) {
+    const uint32_t during = Remaining(last_during_ms_, long_press_interval_ms_, now_ms);
+    deadline = during < deadline ? during : deadline;
+  } else if (state_ == State::kUp) {
+    const uint32_t gap = Remaining(release_ms_, click_gap_ms_ + 1u, now_ms);
+    deadline = gap < deadline ? gap : deadline;
+  }
+  return deadline;
+}
+
+void ButtonGesture::cancel() {
+  clicks_ = 0;
+  state_ = stable_pressed_ ? State::kCancelled : State::kIdle;
+}
+
+void ButtonGesture::emit(Event event) {
+  if (handler_) {
+    handler_(event, context_);
+  }
+}
+
+void ButtonGesture::emitClicks() {
+  emit(clicks_ == 1 ? Event::kClick : clicks_ == 2 ? Event::kDoubleClick : Event::kMultiClick);
+}
+
+uint32_t ButtonGesture::Remaining(uint32_t since_ms, uint32_t period_ms, uint32_t now_ms) {
+  const uint32_t elapsed = now_ms - since_ms;
+  return elapsed >= period_ms ? 0 : period_ms - elapsed;
+}
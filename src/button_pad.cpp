@@ -0,0 +1,104 @@
+#include "button_pad.h"
+
+namespace {
+
+InputGesture ToInputGesture(ButtonGesture::Event event) {
+  switch (event) {
+    case ButtonGesture::Event::kDoubleClick:
+      return InputGesture::kDoubleClick;
+    case ButtonGesture::Event::kMultiClick:
+      return InputGesture::kMultiClick;
+    case ButtonGesture::Event::kLongPressStart:
+      return InputGesture::kLongPressStart;
+    case ButtonGesture::Event::kDuringLongPress:
+      return InputGesture::kHoldRepeat;
+    case ButtonGesture::Event::kLongPressStop:
+      return InputGesture::kLongPressStop;
+    case ButtonGesture::Event::kClick:
+    default:
+      return InputGesture::kClick;
+  }
+}
+
+}  // namespace
+
+ButtonPad::ButtonPad(ButtonGesture *keys, std::size_t count)
+    : keys_(keys),
+      count_(count < kMaxKeys ? count : kMaxKeys),
+      contexts_{},
+      sink_(nullptr),
+      sink_context_(nullptr),
+      raw_pressed_(0),
+      edge_us_{},
+      now_us_(0),
+      chord_(0) {
+  for (std::size_t k = 0; k < count_; ++k) {
+    contexts_[k] = KeyContext{this, static_cast<uint8_t>(k)};
+    keys_[k].setHandler(OnKeyGesture, &contexts_[k]);
+  }
+}
+
+void ButtonPad::setSink(Sink sink, void *context) {
+  sink_ = sink;
+  sink_context_ = context;
+}
+
+uint32_t ButtonPad::update(uint32_t pressed, uint32_t now_ms, uint32_t now_us) {
+  now_us_ = now_us;
+  uint32_t deadline = ButtonGesture::kNoDeadline;
+  uint8_t down = 0;
+  for (std::size_t k = 0; k < count_; ++k) {
+    const uint32_t bit = 1u << k;
+    if ((pressed ^ raw_pressed_) & bit) {
+      edge_us_[k] = now_us;
+    }
+    const uint32_t key_deadline = keys_[k].update((pressed & bit) != 0, now_ms);
+    deadline = key_deadline < deadline ? key_deadline : deadline;
+    if (keys_[k].pressed()) {
+      down = static_cast<uint8_t>(down | bit);
+    }
+  }
+  raw_pressed_ = pressed;
+
+  if (chord_ == 0 && (down & (down - 1)) != 0) {
+    // The edge that made the chord is the latest of its keys'.
+    uint32_t at_us = now_us;
+    uint32_t newest = UINT32_MAX;
+    for (std::size_t k = 0; k < count_; ++k) {
+      if ((down >> k) & 1 && now_us - edge_us_[k] < newest) {
+        newest = now_us - edge_us_[k];
+        at_us = edge_us_[k];
+      }
+    }
+    chord_ = down;
+    report(down, InputGesture::kChord, 0, at_us);
+  }
+  if (chord_ != 0) {
+    for (std::size_t k = 0; k < count_; ++k) {
+      if ((down >> k) & 1) {
+        keys_[k].cancel();
+      }
+    }
+    if (down == 0) {
+      chord_ = 0;
+    }
+  }
+  return deadline;
+}
+
+void ButtonPad::OnKeyGesture(ButtonGesture::Event event, void *context) {
+  const KeyContext &key = *static_cast<const KeyContext *>(context);
+  ButtonPad &pad = *key.pad;
+  const InputGesture gesture = ToInputGesture(event);
+  // A hold is made by time passing, everything else by the last edge.
+  const bool timed =
+      gesture == InputGesture::kLongPressStart || gesture == InputGesture::kHoldRepeat;
+  pad.report(static_cast<uint8_t>(1u << key.key), gesture, pad.keys_[key.key].clicks(),
+             timed ? pad.now_us_ : pad.edge_us_[key.key]);
+}
+
+void ButtonPad::report(uint8_t keys, InputGesture gesture, uint8_t clicks, uint32_t at_us) {
+  if (sink_) {
+    sink_(InputEvent{at_us, keys, gesture, clicks}, sink_context_);
+  }
+}
@@ -0,0 +1,254 @@
+#include "effect_engine.h"
+
+#include <Arduino.h>
+
+#include "pixel_ops.h"
+
+namespace {
+// Frame period while a crossfade is running, unless the frame interval is
+// longer.
+constexpr unsigned long kTransitionFrameMs = 10;
+constexpr uint8_t kFullLevel = 255;
+}  // namespace
+
+EffectEngine::EffectEngine(PixelOutput &output, uint32_t *transition_buffer)
+    : output_(output),
+      transition_buffer_(transition_buffer),
+      frame_cache_(nullptr),
+      slots_{},
+      active_(0),
+      force_refresh_(false),
+      frame_previous_(0),
+      frame_interval_(0),
+      dither_interval_(0),
+      commit_previous_(0),
+      skipped_frames_(0),
+      transitioning_(false),
+      transition_start_(0),
+      transition_ms_(0) {}
+
+void EffectEngine::start(EffectId id, const EffectParams &params) {
+  transitioning_ = false;
+  startSlot(active(), id, params, output_.frame());
+  force_refresh_ = true;
+}
+
+void EffectEngine::crossfadeTo(EffectId id, const EffectParams &params, uint16_t duration_ms) {
+  if (transition_buffer_ == nullptr || duration_ms == 0 || active().descriptor == nullptr) {
+    start(id, params);
+    return;
+  }
+  const uint16_t count = output_.numPixels();
+  uint32_t *incoming_pixels;
+  if (transitioning_) {
+    // Fade again from the effect that was fading in; the one it was
+    // replacing is dropped and its half of the buffer reused.
+    incoming_pixels = outgoing().pixels;
+  } else {
+    // The outgoing effect keeps drawing over its own last frame.
+    std::copy(output_.frame(), output_.frame() + count, transition_buffer_);
+    active().pixels = transition_buffer_;
+    incoming_pixels = transition_buffer_ + count;
+  }
+  active_ ^= 1;
+  startSlot(active(), id, params, incoming_pixels);
+  transitioning_ = true;
+  transition_start_ = millis();
+  transition_ms_ = duration_ms;
+  force_refresh_ = true;
+}
+
+void EffectEngine::setParams(const EffectParams &params) {
+  active().params = params;
+  if (active().descriptor != nullptr) {
+    bindCache(active());
+  }
+  force_refresh_ = true;
+}
+
+void EffectEngine::setFrameCache(FrameCache *cache) {
+  if (frame_cache_ != nullptr) {
+    frame_cache_->unbind();
+  }
+  frame_cache_ = cache;
+  slots_[0].cached = false;
+  slots_[1].cached = false;
+}
+
+uint32_t EffectEngine::render() {
+  if (active().descriptor == nullptr) {
+    return kNoDeadline;
+  }
+  const unsigned long now = millis();
+  if (transitioning_) {
+    if (frameDelayMs(now) == 0) {
+      renderTransition(now);
+    } else {
+      ditherIfDue(now);
+    }
+    return nextFrameDelayMs();
+  }
+
+  Slot &slot = active();
+  if (!force_refresh_) {
+    if (slot.params.step_ms == 0) {
+      ditherIfDue(now);
+      return nextFrameDelayMs();
+    }
+    const uint32_t step = (now - slot.phase_start) / slot.params.step_ms;
+    if (step == slot.phase_step || (now - frame_previous_) < frame_interval_) {
+      ditherIfDue(now);
+      return nextFrameDelayMs();
+    }
+    skipped_frames_ += step - slot.phase_step - 1;
+  }
+  force_refresh_ = false;
+  frame_previous_ = now;
+  renderSlot(slot, now, true);
+  output_.setIntensity(slot.level);
+  commitFrame(now);
+  return nextFrameDelayMs();
+}
+
+uint32_t EffectEngine::nextFrameDelayMs() const {
+  if (active().descriptor == nullptr) {
+    return kNoDeadline;
+  }
+  const unsigned long now = millis();
+  return std::min(frameDelayMs(now), ditherDelayMs(now));
+}
+
+uint32_t EffectEngine::frameDelayMs(unsigned long now) const {
+  const Slot &slot = active();
+  if (force_refresh_) {
+    return 0;
+  }
+  if (transitioning_) {
+    const unsigned long interval =
+        frame_interval_ > kTransitionFrameMs ? frame_interval_ : kTransitionFrameMs;
+    const unsigned long elapsed = now - frame_previous_;
+    return elapsed >= interval ? 0 : static_cast<uint32_t>(interval - elapsed);
+  }
+  if (slot.params.step_ms == 0) {
+    return kNoDeadline;
+  }
+  // The next step boundary, pushed out to the frame interval if that is
+  // later. Both are measured from the start of the effect's phase.
+  const unsigned long step_due =
+      (slot.phase_step + 1) * static_cast<unsigned long>(slot.params.step_ms);
+  const unsigned long frame_due = (frame_previous_ - slot.phase_start) + frame_interval_;
+  const unsigned long due_elapsed = step_due > frame_due ? step_due : frame_due;
+  const unsigned long elapsed = now - slot.phase_start;
+  return elapsed >= due_elapsed ? 0 : static_cast<uint32_t>(due_elapsed - elapsed);
+}
+
+uint32_t EffectEngine::ditherDelayMs(unsigned long now) const {
+  if (dither_interval_ == 0 || !output_.dithering()) {
+    return kNoDeadline;
+  }
+  const unsigned long elapsed = now - commit_previous_;
+  return elapsed >= dither_interval_ ? 0 : static_cast<uint32_t>(dither_interval_ - elapsed);
+}
+
+void EffectEngine::commitFrame(unsigned long now) {
+  commit_previous_ = now;
+  output_.commit();
+}
+
+void EffectEngine::ditherIfDue(unsigned long now) {
+  if (ditherDelayMs(now) == 0) {
+    commitFrame(now);
+  }
+}
+
+const EffectDescriptor &EffectEngine::describe(EffectId id) {
+  const std::size_t index = static_cast<std::size_t>(id);
+  return BuiltinEffects::kDescriptors[index < BuiltinEffects::kCount ? index : 0];
+}
+
+void EffectEngine::startSlot(Slot &slot, EffectId id, const EffectParams &params,
+                             uint32_t *pixels) {
+  slot.descriptor = &describe(id);
+  slot.effect = id;
+  slot.params = params;
+  slot.pixels = pixels;
+  slot.descriptor->start(slot.arena, slot.params, PixelSpan{pixels, output_.numPixels()});
+  slot.phase_start = millis();
+  slot.phase_step = 0;
+  slot.level = params.level;
+  slot.complete = false;
+  bindCache(slot);
+}
+
+void EffectEngine::bindCache(Slot &slot) {
+  if (frame_cache_ == nullptr) {
+    return;
+  }
+  // One cycle is cached at a time, so the other slot goes back to live.
+  slots_[0].cached = false;
+  slots_[1].cached = false;
+  slot.cached = frame_cache_->bind(slot.effect, slot.params, output_.numPixels(),
+                                   slot.descriptor->period);
+}
+
+bool EffectEngine::renderSlot(Slot &slot, unsigned long now, bool force) {
+  uint32_t step = 0;
+  if (slot.params.step_ms != 0) {
+    step = (now - slot.phase_start) / slot.params.step_ms;
+  }
+  if (!force && (slot.params.step_ms == 0 || step == slot.phase_step)) {
+    return false;
+  }
+  slot.phase_step = step;
+  if (slot.cached && frame_cache_->replay(step, slot.pixels)) {
+    const uint32_t cycles = slot.descriptor->cycles;
+    if (cycles != 0 && step + 1 >= slot.descriptor->period * cycles) {
+      slot.complete = true;
+    }
+    slot.level = slot.params.level;
+    return true;
+  }
+  Frame frame{PixelSpan{slot.pixels, output_.numPixels()}, step, slot.params, slot.params.level};
+  if (slot.descriptor->render(slot.arena, frame)) {
+    slot.complete = true;
+  }
+  slot.level = frame.level;
+  if (slot.cached) {
+    frame_cache_->store(step, slot.pixels);
+  }
+  return true;
+}
+
+void EffectEngine::renderTransition(unsigned long now) {
+  const bool force = force_refresh_;
+  force_refresh_ = false;
+  frame_previous_ = now;
+  Slot &from = outgoing();
+  Slot &to = active();
+  renderSlot(from, now, force);
+  renderSlot(to, now, force);
+
+  uint32_t *frame = output_.frame();
+  const uint16_t count = output_.numPixels();
+  const unsigned long elapsed = now - transition_start_;
+  if (elapsed >= transition_ms_) {
+    // Hand the incoming effect the real frame; it carries on from here.
+    std::copy(to.pixels, to.pixels + count, frame);
+    to.pixels = frame;
+    transitioning_ = false;
+    output_.setIntensity(to.level);
+    commitFrame(now);
+    return;
+  }
+
+  // Each effect's level is folded into its blend weight, so the mixed frame
+  // goes out at full intensity.
+  const uint32_t weight = elapsed * pixel_ops::kFullWeight / transition_ms_;
+  const uint16_t weight_from = static_cast<uint16_t>(
+      ((pixel_ops::kFullWeight - weight) * pixel_ops::WeightForLevel(from.level)) >> 8);
+  const uint16_t weight_to =
+      static_cast<uint16_t>((weight * pixel_ops::WeightForLevel(to.level)) >> 8);
+  pixel_ops::Mix(frame, from.pixels, weight_from, to.pixels, weight_to, count);
+  output_.setIntensity(kFullLevel);
+  commitFrame(now);
+}
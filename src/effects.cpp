@@ -0,0 +1,249 @@
+#include "effects.h"
+
+#include <algorithm>
+
+#include <Arduino.h>
+
+#include "color_tables.h"
+#include "frame_stream.h"
+#include "pixel_layout.h"
+#include "pixel_ops.h"
+#include "waveform.h"
+
+namespace {
+constexpr uint16_t kTheaterChaseStride = TheaterChaseEffect::kPeriod;
+constexpr uint32_t kRainbowCycleSteps = RainbowEffect::kPeriod;
+
+const color_tables::ColorTable &WheelTable(const EffectParams &params) {
+  return (params.flags & kEffectFlagGamma) ? color_tables::kWheelGamma : color_tables::kWheel;
+}
+
+void Fill(PixelSpan target, uint32_t color) {
+  std::fill(target.pixels, target.pixels + target.count, color);
+}
+
+waveform::Phase StepPhase(const Frame &frame, waveform::Phase offset = 0) {
+  return static_cast<waveform::Phase>(frame.step * frame.params.phase_step + offset);
+}
+
+// Sets the output level from |table| at the frame's phase, mapped onto the
+// level range.
+void FollowLevel(Frame &frame, const waveform::Table &table, waveform::Phase offset = 0) {
+  const uint8_t sample = waveform::Sample(table, StepPhase(frame, offset));
+  frame.level = waveform::Map(sample, frame.params.level_min, frame.params.level_max);
+}
+
+// Multiplicative hash (Knuth): spreads consecutive indexes over the cycle.
+waveform::Phase PixelPhase(uint16_t index) {
+  return static_cast<waveform::Phase>((index * 2654435761u) >> 16);
+}
+
+// Hashes a noise lattice point to a level.
+uint8_t LatticeLevel(uint32_t x, uint32_t y) {
+  uint32_t hash = x * 0x9e3779b1u ^ y * 0x85ebca77u;
+  hash ^= hash >> 15;
+  hash *= 0x2c1b3c6du;
+  return static_cast<uint8_t>(hash >> 24);
+}
+
+int Lerp(int a, int b, uint32_t fraction) {
+  return a + (((b - a) * static_cast<int>(fraction)) >> 8);
+}
+
+// Lattice cells a 32-bit coordinate spans.
+constexpr uint32_t kNoiseCellMask = 0x00ffffff;
+
+// Value noise at |x|, |y| in lattice cells, 8 fraction bits each. The
+// lattice repeats every 2^24 cells, so a coordinate that wraps carries on
+// smoothly.
+uint8_t ValueNoise(uint32_t x, uint32_t y) {
+  const uint32_t cx = x >> 8;
+  const uint32_t cy = y >> 8;
+  const uint32_t nx = (cx + 1) & kNoiseCellMask;
+  const uint32_t ny = (cy + 1) & kNoiseCellMask;
+  const int top = Lerp(LatticeLevel(cx, cy), LatticeLevel(nx, cy), x & 0xff);
+  const int bottom = Lerp(LatticeLevel(cx, ny), LatticeLevel(nx, ny), x & 0xff);
+  return static_cast<uint8_t>(Lerp(top, bottom, y & 0xff));
+}
+
+FrameStream *stream_source = nullptr;
+const PixelLayout *layout_source = nullptr;
+
+// Clears the pixels of |target| the attached layout does not place and
+// returns how many it does.
+uint16_t PlacedPixels(PixelSpan target) {
+  const uint16_t placed =
+      layout_source == nullptr ? 0 : std::min(target.count, layout_source->count());
+  std::fill(target.pixels + placed, target.pixels + target.count, 0);
+  return placed;
+}
+}  // namespace
+
+void SolidEffect::start(State &state, const EffectParams &params, PixelSpan target) {}
+
+bool SolidEffect::render(State &state, Frame &frame) {
+  Fill(frame.target, frame.params.color);
+  return false;
+}
+
+void BreathingEffect::start(State &state, const EffectParams &params, PixelSpan target) {
+  Fill(target, params.color);
+}
+
+bool BreathingEffect::render(State &state, Frame &frame) {
+  // Half a cycle in, so it starts at the maximum.
+  FollowLevel(frame, waveform::kBreathe, waveform::kHalfCycle);
+  return false;
+}
+
+void ColorWipeEffect::start(State &state, const EffectParams &params, PixelSpan target) {
+  state.position = 0;
+}
+
+bool ColorWipeEffect::render(State &state, Frame &frame) {
+  // Step n has lit pixels 0..n; catch up on any pixels a late frame missed.
+  const uint16_t count = frame.target.count;
+  const uint32_t lit = frame.step + 1 < count ? frame.step + 1 : count;
+  while (state.position < lit) {
+    frame.target.pixels[state.position++] = frame.params.color;
+  }
+  return lit >= count;
+}
+
+void TheaterChaseEffect::start(State &state, const EffectParams &params, PixelSpan target) {}
+
+bool TheaterChaseEffect::render(State &state, Frame &frame) {
+  const uint16_t offset = static_cast<uint16_t>(frame.step % kTheaterChaseStride);
+  Fill(frame.target, 0);
+  for (uint16_t c = offset; c < frame.target.count; c += kTheaterChaseStride) {
+    frame.target.pixels[c] = frame.params.color;
+  }
+  // Complete on the last frame of the last cycle, not the one after it.
+  return (frame.step + 1) / kTheaterChaseStride >= TheaterChaseEffect::kCycles;
+}
+
+void RainbowEffect::start(State &state, const EffectParams &params, PixelSpan target) {}
+
+bool RainbowEffect::render(State &state, Frame &frame) {
+  const color_tables::ColorTable &wheel = WheelTable(frame.params);
+  // Pixel i shows wheel entry (i + cycle) & 255, so the strip is the table
+  // rotated by |cycle| and repeated: copy it in table-sized runs.
+  uint32_t entry = frame.step % kRainbowCycleSteps;
+  uint32_t *out = frame.target.pixels;
+  uint32_t *const end = out + frame.target.count;
+  while (out != end) {
+    const std::size_t run =
+        std::min<std::size_t>(static_cast<std::size_t>(end - out), wheel.size() - entry);
+    out = std::copy(wheel.data() + entry, wheel.data() + entry + run, out);
+    entry = 0;
+  }
+  return false;
+}
+
+void TheaterChaseRainbowEffect::start(State &state, const EffectParams &params, PixelSpan target) {}
+
+bool TheaterChaseRainbowEffect::render(State &state, Frame &frame) {
+  const color_tables::ColorTable &wheel = WheelTable(frame.params);
+  const uint16_t queue = static_cast<uint16_t>(frame.step % kTheaterChaseStride);
+  const uint32_t cycle = frame.step % kRainbowCycleSteps;
+  const uint16_t count = frame.target.count;
+  Fill(frame.target, 0);
+  for (uint16_t i = 0; i + queue < count; i += kTheaterChaseStride) {
+    frame.target.pixels[i + queue] = wheel[(i + cycle) % 255];
+  }
+  return false;
+}
+
+void PulseEffect::start(State &state, const EffectParams &params, PixelSpan target) {
+  Fill(target, params.color);
+}
+
+bool PulseEffect::render(State &state, Frame &frame) {
+  FollowLevel(frame, waveform::kPulse);
+  return false;
+}
+
+void HeartbeatEffect::start(State &state, const EffectParams &params, PixelSpan target) {
+  Fill(target, params.color);
+}
+
+bool HeartbeatEffect::render(State &state, Frame &frame) {
+  FollowLevel(frame, waveform::kHeartbeat);
+  return false;
+}
+
+void SparkleEffect::start(State &state, const EffectParams &params, PixelSpan target) {}
+
+bool SparkleEffect::render(State &state, Frame &frame) {
+  const uint32_t color = frame.params.color;
+  const waveform::Phase phase = StepPhase(frame);
+  for (uint16_t i = 0; i < frame.target.count; ++i) {
+    const uint8_t sample =
+        waveform::Sample(waveform::kSparkle, static_cast<waveform::Phase>(phase + PixelPhase(i)));
+    frame.target.pixels[i] = pixel_ops::ScalePixel(color, pixel_ops::WeightForLevel(sample));
+  }
+  return false;
+}
+
+void RadialWaveEffect::start(State &state, const EffectParams &params, PixelSpan target) {}
+
+bool RadialWaveEffect::render(State &state, Frame &frame) {
+  const uint16_t placed = PlacedPixels(frame.target);
+  const uint32_t color = frame.params.color;
+  const waveform::Phase phase = StepPhase(frame);
+  for (uint16_t i = 0; i < placed; ++i) {
+    const uint32_t position = layout_source->places()[i].radius * kRadialWaves << 8;
+    const uint8_t sample =
+        waveform::Sample(waveform::kSine, static_cast<waveform::Phase>(position - phase));
+    frame.target.pixels[i] = pixel_ops::ScalePixel(color, pixel_ops::WeightForLevel(sample));
+  }
+  return false;
+}
+
+void SweepEffect::start(State &state, const EffectParams &params, PixelSpan target) {}
+
+bool SweepEffect::render(State &state, Frame &frame) {
+  const uint16_t placed = PlacedPixels(frame.target);
+  const uint32_t color = frame.params.color;
+  const waveform::Phase phase = StepPhase(frame);
+  for (uint16_t i = 0; i < placed; ++i) {
+    const uint32_t angle = layout_source->places()[i].angle << 8;
+    const uint8_t sample =
+        waveform::Sample(waveform::kSparkle, static_cast<waveform::Phase>(phase - angle));
+    frame.target.pixels[i] = pixel_ops::ScalePixel(color, pixel_ops::WeightForLevel(sample));
+  }
+  return false;
+}
+
+void NoiseEffect::start(State &state, const EffectParams &params, PixelSpan target) {}
+
+bool NoiseEffect::render(State &state, Frame &frame) {
+  const uint16_t placed = PlacedPixels(frame.target);
+  const uint32_t color = frame.params.color;
+  // Not wrapped to a cycle: the field keeps drifting over new cells. The
+  // product passes 32 bits after about 13 M steps; the drift it leaves wraps
+  // with the lattice.
+  const uint32_t drift =
+      static_cast<uint32_t>((static_cast<uint64_t>(frame.step) * frame.params.phase_step) >> 8);
+  for (uint16_t i = 0; i < placed; ++i) {
+    const PixelPlace &place = layout_source->places()[i];
+    const uint8_t level = ValueNoise(place.x * kNoiseCells, place.y * kNoiseCells + drift);
+    frame.target.pixels[i] = pixel_ops::ScalePixel(color, pixel_ops::WeightForLevel(level));
+  }
+  return false;
+}
+
+void AttachLayout(const PixelLayout *layout) { layout_source = layout; }
+
+void StreamEffect::start(State &state, const EffectParams &params, PixelSpan target) {
+  Fill(target, 0);
+}
+
+bool StreamEffect::render(State &state, Frame &frame) {
+  if (stream_source != nullptr) {
+    stream_source->decodeDue(millis(), frame.target);
+  }
+  return false;
+}
+
+void StreamEffect::attach(FrameStream *stream) { stream_source = stream; }
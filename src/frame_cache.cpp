@@ -0,0 +1,56 @@
+#include "frame_cache.h"
+
+#include <algorithm>
+
+FrameCache::FrameCache(uint32_t *storage, std::size_t capacity)
+    : storage_(storage),
+      capacity_(capacity),
+      effect_(EffectId::kSolid),
+      color_(0),
+      flags_(0),
+      count_(0),
+      period_(0),
+      filled_{},
+      stats_{} {}
+
+bool FrameCache::bind(EffectId id, const EffectParams &params, uint16_t count, uint32_t period) {
+  // Periodic effects draw from color and flags alone and leave the level to
+  // the engine, so a brightness change keeps the frames.
+  if (bound() && id == effect_ && params.color == color_ && params.flags == flags_ &&
+      count == count_ && period == period_) {
+    return true;
+  }
+  period_ = 0;
+  if (period == 0) {
+    return false;
+  }
+  if (period > kMaxPeriod || static_cast<std::size_t>(period) * count > capacity_) {
+    ++stats_.over_budget;
+    return false;
+  }
+  effect_ = id;
+  color_ = params.color;
+  flags_ = params.flags;
+  count_ = count;
+  period_ = period;
+  std::fill(filled_, filled_ + (period + 31) / 32, 0);
+  return true;
+}
+
+bool FrameCache::replay(uint32_t step, uint32_t *pixels) {
+  const uint32_t index = step % period_;
+  if (!filled(index)) {
+    return false;
+  }
+  const uint32_t *frame = storage_ + static_cast<std::size_t>(index) * count_;
+  std::copy(frame, frame + count_, pixels);
+  ++stats_.hits;
+  return true;
+}
+
+void FrameCache::store(uint32_t step, const uint32_t *pixels) {
+  const uint32_t index = step % period_;
+  std::copy(pixels, pixels + count_, storage_ + static_cast<std::size_t>(index) * count_);
+  filled_[index / 32] |= 1u << (index % 32);
+  ++stats_.stores;
+}
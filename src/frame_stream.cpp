@@ -0,0 +1,363 @@
+#include "frame_stream.h"
+
+#include "serial_protocol.h"
+
+static_assert(kStreamHeaderSize + kMaxStreamOps + 1 == kMaxFrameBody,
+              "a chunk fills one protocol frame");
+static_assert(256 % FrameStream::kSlotCount == 0, "slot indexes wrap with uint8_t");
+
+namespace {
+
+// A frame due further ahead than this is taken as a new stream (the host
+// restarted its clock) and the playout clock is set again.
+constexpr uint32_t kResyncAheadMs = 1000;
+
+uint8_t *PutColor(uint8_t *out, uint32_t color) {
+  out[0] = static_cast<uint8_t>(color >> 16);
+  out[1] = static_cast<uint8_t>(color >> 8);
+  out[2] = static_cast<uint8_t>(color);
+  return out + 3;
+}
+
+uint32_t GetColor(const uint8_t *in) {
+  return (static_cast<uint32_t>(in[0]) << 16) | (static_cast<uint32_t>(in[1]) << 8) | in[2];
+}
+
+bool Before(uint32_t a, uint32_t b) { return static_cast<int32_t>(a - b) < 0; }
+
+}  // namespace
+
+std::size_t EncodeStreamOps(const uint32_t *previous, const uint32_t *current, uint16_t count,
+                            uint8_t *out, std::size_t capacity, uint16_t &pixels_done) {
+  std::size_t written = 0;
+  uint16_t i = 0;
+  while (i < count) {
+    if (previous != nullptr && current[i] == previous[i]) {
+      uint16_t skip = 1;
+      while (i + skip < count && skip < stream_op::kMaxCount &&
+             current[i + skip] == previous[i + skip]) {
+        ++skip;
+      }
+      if (i + skip == count) {
+        // Pixels past the last op keep their value anyway.
+        i = count;
+        break;
+      }
+      if (written + 1 > capacity) {
+        break;
+      }
+      out[written++] = static_cast<uint8_t>(stream_op::kSkip | (skip - 1));
+      i += skip;
+      continue;
+    }
+
+    uint16_t run = 1;
+    while (i + run < count && run < stream_op::kMaxCount && current[i + run] == current[i]) {
+      ++run;
+    }
+    if (run >= 2) {
+      if (written + 4 > capacity) {
+        break;
+      }
+      out[written++] = static_cast<uint8_t>(stream_op::kRun | (run - 1));
+      PutColor(out + written, current[i]);
+      written += 3;
+      i += run;
+      continue;
+    }
+
+    // A literal ends where a skip or a run of two would be cheaper.
+    uint16_t literal = 1;
+    while (i + literal < count && literal < stream_op::kMaxCount) {
+      const uint16_t next = i + literal;
+      if (previous != nullptr && current[next] == previous[next]) {
+        break;
+      }
+      if (next + 1 < count && current[next + 1] == current[next]) {
+        break;
+      }
+      ++literal;
+    }
+    if (written + 4 > capacity) {
+      break;
+    }
+    const std::size_t fits = (capacity - written - 1) / 3;
+    if (literal > fits) {
+      literal = static_cast<uint16_t>(fits);
+    }
+    out[written++] = static_cast<uint8_t>(stream_op::kLiteral | (literal - 1));
+    uint8_t *colors = out + written;
+    for (uint16_t k = 0; k < literal; ++k) {
+      colors = PutColor(colors, current[i + k]);
+    }
+    written += 3u * literal;
+    i += literal;
+  }
+  pixels_done = i;
+  return written;
+}
+
+std::size_t EncodeStreamFrame(const uint32_t *previous, const uint32_t *current, uint16_t count,
+                              uint8_t seq, uint16_t time_ms, uint8_t *out, std::size_t capacity) {
+  std::size_t total = 0;
+  uint16_t first = 0;
+  do {
+    uint8_t payload[kStreamHeaderSize + kMaxStreamOps];
+    uint16_t done = 0;
+    const std::size_t ops =
+        EncodeStreamOps(previous != nullptr ? previous + first : nullptr, current + first,
+                        static_cast<uint16_t>(count - first), payload + kStreamHeaderSize,
+                        kMaxStreamOps, done);
+    const uint8_t flags = static_cast<uint8_t>((previous == nullptr ? kStreamKeyframe : 0) |
+                                               (first + done == count ? kStreamEndOfFrame : 0));
+    payload[0] = seq;
+    payload[1] = static_cast<uint8_t>(time_ms & 0xff);
+    payload[2] = static_cast<uint8_t>(time_ms >> 8);
+    payload[3] = static_cast<uint8_t>(first & 0xff);
+    payload[4] = static_cast<uint8_t>(first >> 8);
+    payload[5] = flags;
+    const std::size_t size = EncodeFrame(protocol_cmd::kStreamFrame, payload,
+                                         kStreamHeaderSize + ops, out + total, capacity - total);
+    if (size == 0) {
+      return 0;
+    }
+    total += size;
+    first = static_cast<uint16_t>(first + done);
+  } while (first < count);
+  return total;
+}
+
+bool DecodeStreamOps(const uint8_t *ops, std::size_t length, uint16_t first_pixel,
+                     PixelSpan target) {
+  uint32_t *pixel = target.pixels + first_pixel;
+  const uint32_t *const end = target.pixels + target.count;
+  if (first_pixel > target.count) {
+    return false;
+  }
+  std::size_t i = 0;
+  while (i < length) {
+    const uint8_t op = ops[i++];
+    const uint16_t count = static_cast<uint16_t>((op & ~stream_op::kKindMask) + 1);
+    if (count > end - pixel) {
+      return false;
+    }
+    switch (op & stream_op::kKindMask) {
+      case stream_op::kSkip:
+        break;
+      case stream_op::kRun: {
+        if (length - i < 3) {
+          return false;
+        }
+        const uint32_t color = GetColor(ops + i);
+        i += 3;
+        for (uint16_t k = 0; k < count; ++k) {
+          pixel[k] = color;
+        }
+        break;
+      }
+      case stream_op::kLiteral:
+        if (length - i < 3u * count) {
+          return false;
+        }
+        for (uint16_t k = 0; k < count; ++k, i += 3) {
+          pixel[k] = GetColor(ops + i);
+        }
+        break;
+      default:
+        return false;
+    }
+    pixel += count;
+  }
+  return true;
+}
+
+FrameStream::FrameStream()
+    : slots_{},
+      head_(0),
+      tail_(0),
+      last_arrival_ms_(0),
+      keyframes_(0),
+      lost_generation_(UINT32_MAX),
+      need_keyframe_(true),
+      last_seq_(0),
+      seq_valid_(false),
+      in_frame_(false),
+      chunks_(0),
+      chunks_dropped_(0),
+      synced_(false),
+      clock_set_(false),
+      last_time_ms_(0),
+      stream_ms_(0),
+      playout_offset_ms_(0),
+      delay_ms_(kStartDelayMs),
+      frames_shown_(0),
+      frames_late_(0),
+      frames_dropped_(0) {}
+
+uint8_t *FrameStream::beginChunk(const StreamChunkHeader &header, std::size_t ops_length,
+                                 uint32_t now_ms, PushStatus &status) {
+  last_arrival_ms_.store(now_ms, std::memory_order_relaxed);
+  chunks_++;
+
+  // A new frame must follow the last one, and the last one must have ended.
+  const bool starts_frame = !in_frame_ || header.seq != last_seq_;
+  if (starts_frame && (in_frame_ || (seq_valid_ && header.seq != static_cast<uint8_t>(last_seq_ + 1)))) {
+    need_keyframe_ = true;
+  }
+  // The consumer lost a frame queued since the last keyframe.
+  const uint32_t keyframes = keyframes_.load(std::memory_order_relaxed);
+  if (lost_generation_.load(std::memory_order_relaxed) == keyframes) {
+    need_keyframe_ = true;
+  }
+  last_seq_ = header.seq;
+  seq_valid_ = true;
+  in_frame_ = (header.flags & kStreamEndOfFrame) == 0;
+
+  if (need_keyframe_) {
+    if ((header.flags & kStreamKeyframe) == 0 || !starts_frame) {
+      chunks_dropped_++;
+      status = PushStatus::kNeedKeyframe;
+      return nullptr;
+    }
+    need_keyframe_ = false;
+    keyframes_.store(keyframes + 1, std::memory_order_relaxed);
+  }
+
+  const uint8_t head = head_.load(std::memory_order_relaxed);
+  if (static_cast<uint8_t>(head - tail_.load(std::memory_order_acquire)) >= kSlotCount ||
+      ops_length > kMaxStreamOps) {
+    // The rest of this frame is useless without this chunk.
+    need_keyframe_ = true;
+    chunks_dropped_++;
+    status = PushStatus::kFull;
+    return nullptr;
+  }
+  Slot &free_slot = slot(head);
+  free_slot.header = header;
+  free_slot.length = static_cast<uint8_t>(ops_length);
+  free_slot.generation = keyframes_.load(std::memory_order_relaxed);
+  status = PushStatus::kQueued;
+  return free_slot.ops;
+}
+
+void FrameStream::commitChunk() {
+  head_.store(static_cast<uint8_t>(head_.load(std::memory_order_relaxed) + 1),
+              std::memory_order_release);
+}
+
+void FrameStream::restart() {
+  synced_ = false;
+  clock_set_ = false;
+  delay_ms_ = kStartDelayMs;
+}
+
+void FrameStream::discard() {
+  tail_.store(head_.load(std::memory_order_acquire), std::memory_order_release);
+  lost_generation_.store(keyframes_.load(std::memory_order_relaxed), std::memory_order_relaxed);
+}
+
+bool FrameStream::completeFrame(uint8_t &end) {
+  const uint8_t head = head_.load(std::memory_order_acquire);
+  uint8_t tail = tail_.load(std::memory_order_relaxed);
+  for (uint8_t i = tail; i != head; ++i) {
+    if (slot(i).header.seq != slot(tail).header.seq) {
+      // The frame at the tail lost its last chunk.
+      dropFrame(static_cast<uint8_t>(i - 1));
+      tail = i;
+    }
+    if (slot(i).header.flags & kStreamEndOfFrame) {
+      end = i;
+      return true;
+    }
+  }
+  return false;
+}
+
+void FrameStream::dropFrame(uint8_t end) {
+  tail_.store(static_cast<uint8_t>(end + 1), std::memory_order_release);
+  frames_dropped_++;
+  synced_ = false;
+  lost_generation_.store(slot(end).generation, std::memory_order_relaxed);
+}
+
+uint32_t FrameStream::dueMs(uint32_t now_ms) {
+  const uint16_t time_ms = slot(tail_.load(std::memory_order_relaxed)).header.time_ms;
+  if (clock_set_) {
+    const uint32_t due = playout_offset_ms_ + stream_ms_ +
+                         static_cast<uint16_t>(time_ms - last_time_ms_);
+    if (!Before(now_ms + kResyncAheadMs, due)) {
+      return due;
+    }
+  }
+  // The first frame, or a new stream: play it after the delay.
+  clock_set_ = true;
+  last_time_ms_ = time_ms;
+  stream_ms_ = 0;
+  playout_offset_ms_ = now_ms + delay_ms_;
+  return playout_offset_ms_;
+}
+
+uint32_t FrameStream::nextDueMs(uint32_t now_ms) {
+  uint8_t end;
+  while (completeFrame(end)) {
+    if (!synced_ && (slot(tail_.load(std::memory_order_relaxed)).header.flags & kStreamKeyframe) == 0) {
+      dropFrame(end);
+      continue;
+    }
+    const uint32_t due = dueMs(now_ms);
+    return Before(now_ms, due) ? due - now_ms : 0;
+  }
+  return kNoFrame;
+}
+
+uint16_t FrameStream::decodeDue(uint32_t now_ms, PixelSpan target) {
+  uint16_t shown = 0;
+  for (;;) {
+    const uint32_t wait = nextDueMs(now_ms);
+    if (wait != 0) {
+      return shown;
+    }
+    uint8_t end;
+    completeFrame(end);
+    uint8_t index = tail_.load(std::memory_order_relaxed);
+    const uint16_t time_ms = slot(index).header.time_ms;
+    const uint32_t due = dueMs(now_ms);
+    if (Before(due, now_ms)) {
+      // Arrived late: stretch the delay by as much, within the limit.
+      frames_late_++;
+      uint32_t stretch = now_ms - due;
+      if (stretch > static_cast<uint32_t>(kMaxDelayMs - delay_ms_)) {
+        stretch = kMaxDelayMs - delay_ms_;
+      }
+      delay_ms_ = static_cast<uint16_t>(delay_ms_ + stretch);
+      playout_offset_ms_ += stretch;
+    }
+
+    bool ok = true;
+    for (;; ++index) {
+      const Slot &chunk = slot(index);
+      ok = ok && DecodeStreamOps(chunk.ops, chunk.length, chunk.header.first_pixel, target);
+      if (index == end) {
+        break;
+      }
+    }
+    stream_ms_ += static_cast<uint16_t>(time_ms - last_time_ms_);
+    last_time_ms_ = time_ms;
+    if (!ok) {
+      dropFrame(end);
+      continue;
+    }
+    tail_.store(static_cast<uint8_t>(end + 1), std::memory_order_release);
+    synced_ = true;
+    frames_shown_++;
+    shown++;
+  }
+}
+
+uint32_t FrameStream::idleMs(uint32_t now_ms) const {
+  return now_ms - last_arrival_ms_.load(std::memory_order_relaxed);
+}
+
+FrameStream::Stats FrameStream::stats() const {
+  return Stats{chunks_, chunks_dropped_, frames_shown_, frames_late_, frames_dropped_, delay_ms_};
+}
@@ -0,0 +1,217 @@
+#include "instrumentation.h"
+
+#include <Arduino.h>
+
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+
+#include <cstring>
+
+namespace instrumentation {
+
+void Histogram::reset() {
+  for (std::atomic<uint32_t> &bucket : buckets_) {
+    bucket.store(0, std::memory_order_relaxed);
+  }
+  count_.store(0, std::memory_order_relaxed);
+  min_.store(UINT32_MAX, std::memory_order_relaxed);
+  max_.store(0, std::memory_order_relaxed);
+}
+
+uint32_t Histogram::percentile(uint8_t percent) const {
+  const uint32_t total = count();
+  if (total == 0) {
+    return 0;
+  }
+  // Rank of the sample, rounded up so p100 is the last one.
+  const uint32_t rank = static_cast<uint32_t>((static_cast<uint64_t>(total) * percent + 99) / 100);
+  uint32_t seen = 0;
+  for (std::size_t i = 0; i < kBuckets; ++i) {
+    seen += buckets_[i].load(std::memory_order_relaxed);
+    if (seen >= rank && seen > 0) {
+      const uint32_t upper = BucketUpper(i);
+      return upper < max() ? upper : max();
+    }
+  }
+  return max();
+}
+
+uint32_t Histogram::BucketUpper(std::size_t index) {
+  if (index < (1u << kSubBucketBits)) {
+    return static_cast<uint32_t>(index);
+  }
+  const unsigned shift = static_cast<unsigned>(index >> kSubBucketBits) - 1;
+  const uint32_t sub = static_cast<uint32_t>(index & ((1u << kSubBucketBits) - 1));
+  const uint32_t lower = ((1u << kSubBucketBits) | sub) << shift;
+  return lower + ((1u << shift) - 1);
+}
+
+#if LIGHTING_INSTRUMENTATION
+
+namespace {
+
+constexpr std::size_t kMaxWatchedTasks = 6;
+constexpr uint8_t kPercentiles[] = {50, 90, 99};
+
+const char *const kStageNames[] = {
+    "events", "frame", "encode", "transmit", "persist", "wake_late", "input",
+};
+static_assert(sizeof(kStageNames) / sizeof(kStageNames[0]) ==
+                  static_cast<std::size_t>(Stage::kCount),
+              "every Stage needs a name");
+
+Histogram stage_histograms[static_cast<std::size_t>(Stage::kCount)];
+std::atomic<uint32_t> deadlines_checked{0};
+std::atomic<uint32_t> deadlines_missed{0};
+std::atomic<uint32_t> inputs_dropped{0};
+// Written by TaskRGB only.
+std::atomic<uint32_t> power_frames{0};
+std::atomic<uint32_t> power_frames_limited{0};
+std::atomic<uint32_t> peak_wanted_ma{0};
+std::atomic<uint32_t> peak_drawn_ma{0};
+TaskHandle_t watched_tasks[kMaxWatchedTasks];
+// Written and read by TaskRGB only.
+bool frame_pending = false;
+unsigned long frame_due_us = 0;
+
+void Bump(std::atomic<uint32_t> &counter) {
+  counter.store(counter.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+}
+
+double CyclesToUs(uint32_t cycles) {
+  return static_cast<double>(cycles) / ESP.getCpuFreqMHz();
+}
+
+// |us| in CPU cycles, saturating at UINT32_MAX (about 27 s at 160 MHz) rather
+// than wrapping into a small sample.
+uint32_t UsToCycles(uint32_t us) {
+  const uint64_t cycles = static_cast<uint64_t>(us) * ESP.getCpuFreqMHz();
+  return cycles > UINT32_MAX ? UINT32_MAX : static_cast<uint32_t>(cycles);
+}
+
+}  // namespace
+
+uint32_t Cycles() { return ESP.getCycleCount(); }
+
+void Record(Stage stage, uint32_t cycles) {
+  stage_histograms[static_cast<std::size_t>(stage)].record(cycles);
+}
+
+void RecordDeadline(uint32_t late_us) {
+  Record(Stage::kWakeLateness, UsToCycles(late_us));
+  Bump(deadlines_checked);
+  if (late_us > kDeadlineSlackUs) {
+    Bump(deadlines_missed);
+  }
+}
+
+void RecordInput(uint32_t latency_us) {
+  Record(Stage::kInput, UsToCycles(latency_us));
+}
+
+void RecordInputDropped() { Bump(inputs_dropped); }
+
+uint32_t InputsDropped() { return inputs_dropped.load(std::memory_order_relaxed); }
+
+void RecordPower(uint32_t wanted_ma, uint32_t drawn_ma, bool limited) {
+  Bump(power_frames);
+  if (limited) {
+    Bump(power_frames_limited);
+  }
+  if (wanted_ma > peak_wanted_ma.load(std::memory_order_relaxed)) {
+    peak_wanted_ma.store(wanted_ma, std::memory_order_relaxed);
+  }
+  if (drawn_ma > peak_drawn_ma.load(std::memory_order_relaxed)) {
+    peak_drawn_ma.store(drawn_ma, std::memory_order_relaxed);
+  }
+}
+
+uint32_t PowerFrames() { return power_frames.load(std::memory_order_relaxed); }
+
+uint32_t PowerFramesLimited() { return power_frames_limited.load(std::memory_order_relaxed); }
+
+uint32_t PeakWantedMa() { return peak_wanted_ma.load(std::memory_order_relaxed); }
+
+uint32_t PeakDrawnMa() { return peak_drawn_ma.load(std::memory_order_relaxed); }
+
+void FrameDue(uint32_t delay_ms) {
+  frame_pending = delay_ms != UINT32_MAX;
+  frame_due_us = micros() + delay_ms * 1000UL;
+}
+
+void Woke(bool timed_out) {
+  if (frame_pending && timed_out) {
+    // A wake before the deadline (the tick rounds down) is on time, not
+    // four billion microseconds late.
+    const long late_us = static_cast<long>(micros() - frame_due_us);
+    RecordDeadline(late_us > 0 ? static_cast<uint32_t>(late_us) : 0);
+  }
+  frame_pending = false;
+}
+
+void WatchCurrentTask() {
+  TaskHandle_t task = xTaskGetCurrentTaskHandle();
+  const char *name = pcTaskGetName(task);
+  for (TaskHandle_t &slot : watched_tasks) {
+    if (slot == nullptr || slot == task || std::strcmp(pcTaskGetName(slot), name) == 0) {
+      slot = task;
+      return;
+    }
+  }
+}
+
+const Histogram &StageHistogram(Stage stage) {
+  return stage_histograms[static_cast<std::size_t>(stage)];
+}
+
+uint32_t DeadlinesChecked() { return deadlines_checked.load(std::memory_order_relaxed); }
+
+uint32_t DeadlinesMissed() { return deadlines_missed.load(std::memory_order_relaxed); }
+
+void Reset() {
+  for (Histogram &histogram : stage_histograms) {
+    histogram.reset();
+  }
+  deadlines_checked.store(0, std::memory_order_relaxed);
+  deadlines_missed.store(0, std::memory_order_relaxed);
+  inputs_dropped.store(0, std::memory_order_relaxed);
+  power_frames.store(0, std::memory_order_relaxed);
+  power_frames_limited.store(0, std::memory_order_relaxed);
+  peak_wanted_ma.store(0, std::memory_order_relaxed);
+  peak_drawn_ma.store(0, std::memory_order_relaxed);
+}
+
+void Dump() {
+  Serial.printf("%-10s %8s %9s %9s %9s %9s %9s  (us)\r\n", "stage", "count", "min", "p50", "p90",
+                "p99", "max");
+  for (std::size_t i = 0; i < static_cast<std::size_t>(Stage::kCount); ++i) {
+    const Histogram &histogram = stage_histograms[i];
+    Serial.printf("%-10s %8u %9.1f", kStageNames[i], static_cast<unsigned>(histogram.count()),
+                  CyclesToUs(histogram.min()));
+    for (uint8_t percent : kPercentiles) {
+      Serial.printf(" %9.1f", CyclesToUs(histogram.percentile(percent)));
+    }
+    Serial.printf(" %9.1f\r\n", CyclesToUs(histogram.max()));
+  }
+  const uint32_t checked = DeadlinesChecked();
+  const uint32_t missed = DeadlinesMissed();
+  Serial.printf("deadlines  %u checked, %u missed (%.2f%%)\r\n", static_cast<unsigned>(checked),
+                static_cast<unsigned>(missed), checked ? 100.0 * missed / checked : 0.0);
+  Serial.printf("inputs     %u dropped\r\n", static_cast<unsigned>(InputsDropped()));
+  const uint32_t powered = PowerFrames();
+  const uint32_t limited = PowerFramesLimited();
+  Serial.printf("power      %u frames, %u limited (%.2f%%), peak %u mA wanted, %u mA drawn\r\n",
+                static_cast<unsigned>(powered), static_cast<unsigned>(limited),
+                powered ? 100.0 * limited / powered : 0.0, static_cast<unsigned>(PeakWantedMa()),
+                static_cast<unsigned>(PeakDrawnMa()));
+  for (TaskHandle_t task : watched_tasks) {
+    if (task != nullptr) {
+      Serial.printf("stack      %-12s %u free at peak\r\n", pcTaskGetName(task),
+                    static_cast<unsigned>(uxTaskGetStackHighWaterMark(task)));
+    }
+  }
+}
+
+#endif  // LIGHTING_INSTRUMENTATION
+
+}  // namespace instrumentation
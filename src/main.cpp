@@ -1,7 +1,8 @@
 #include <Arduino.h>
 #include <Adafruit_NeoPixel.h>
-#include <OneButton.h>
 
+#include <algorithm>
+#include <cmath>
 #include <cstddef>
 
 #include <freertos/FreeRTOS.h>
@@ -9,8 +10,24 @@
 #include <freertos/queue.h>
 
 #include <Preferences.h>
+#include <WiFi.h>
+#include <lwip/sockets.h>
 
-#include "strandtest_nodelay.h"
+#include "button_gesture.h"
+#include "button_pad.h"
+#include "color_tables.h"
+#include "effect_engine.h"
+#include "frame_cache.h"
+#include "frame_stream.h"
+#include "instrumentation.h"
+#include "osc.h"
+#include "pixel_layout.h"
+#include "pixel_output.h"
+#include "rmt_transmitter.h"
+#include "serial_protocol.h"
+#include "settings_store.h"
+#include "spsc_ring.h"
+#include "waveform.h"
 
 #define KEY_USER_2     2
 #define KEY_USER_MAIN  4
@@ -21,26 +38,111 @@
 #define PIN_RGB_EN     10
 #define RGB_NUM        22
 
-OneButton main_button(KEY_USER_MAIN);
-Adafruit_NeoPixel strip(RGB_NUM, PIN_RGB, NEO_GRB + NEO_KHZ800);
-StrandtestController strandtest(strip);
+// Station credentials for the OSC listener, from build_flags; without an
+// SSID it is not started. LIGHTING_OSC follows whether one was given (a
+// string cannot be tested in #if) and keeps TaskOsc's stack out of RAM
+// when it is 0.
+#ifndef LIGHTING_OSC
+#ifdef LIGHTING_WIFI_SSID
+#define LIGHTING_OSC 1
+#else
+#define LIGHTING_OSC 0
+#endif
+#endif
+#ifndef LIGHTING_WIFI_SSID
+#define LIGHTING_WIFI_SSID ""
+#endif
+#ifndef LIGHTING_WIFI_PASSWORD
+#define LIGHTING_WIFI_PASSWORD ""
+#endif
+
+// Main, KEY_USER_2 and BOOT, in InputEvent::keys bit order; the gesture
+// layer hands what it recognises to TaskRGB through the input ring.
+ButtonGesture button_keys[3];
+ButtonPad button_pad(button_keys, 3);
+SpscRing<InputEvent, 16> input_ring;
+TaskHandle_t button_task_handle = nullptr;
+TaskHandle_t serial_task_handle = nullptr;
+ProtocolParser serial_parser;
+// Frames go out through the RMT peripheral while the next one renders.
+RmtTransmitter strip_transmitter(PIN_RGB);
+uint32_t strip_frame[RGB_NUM];
+uint8_t strip_wire[PixelOutput::WireBytes(RGB_NUM)];
+uint32_t strip_transition[2 * RGB_NUM];
+// Carries the fraction of each channel between frames at low levels.
+uint8_t strip_dither[PixelOutput::DitherBytes(RGB_NUM)];
+PixelOutput strip_output(strip_transmitter, NEO_GRB + NEO_KHZ800, strip_frame, strip_wire, RGB_NUM,
+                         strip_dither);
+EffectEngine effect_engine(strip_output, strip_transition);
+// Cycles of periodic effects replayed from RAM; a longer cycle renders live.
+// Theater chase fits. Rainbow already renders as a table copy, and theater
+// chase rainbow's 768 steps would take 66 KiB, so both stay live (see the
+// frame_cache bench).
+constexpr std::size_t kFrameCachePixels = 1024;
+uint32_t frame_cache_storage[kFrameCachePixels];
+FrameCache frame_cache(frame_cache_storage, kFrameCachePixels);
+// Frames pushed over serial for GlowMode::kStream.
+FrameStream frame_stream;
+// Where each pixel sits, for the spatial glow modes.
+PixelPlace strip_places[RGB_NUM];
+uint16_t strip_grid[RGB_NUM];
+PixelLayout strip_layout(strip_places, strip_grid, RGB_NUM);
+
+// Number of times TaskRGB has woken up, whether for a frame or an event.
+uint32_t rgb_task_wakeups = 0;
+// Number of times TaskButton has woken up, for an edge or a gesture deadline.
+uint32_t button_task_wakeups = 0;
 
 namespace {
 
 constexpr uint8_t kBrightnessHigh = 150;
 constexpr uint8_t kBrightnessLow = 12;
 
-constexpr TickType_t kButtonTaskDelay = pdMS_TO_TICKS(5);
-constexpr TickType_t kRgbTaskDelay = pdMS_TO_TICKS(10);
+constexpr uint16_t kLongPressIntervalMs = 1000;
+// KEY_USER_2 held steps the hue this often, by kHueStep wheel entries.
+constexpr uint16_t kHueRepeatMs = 150;
+constexpr uint8_t kHueStep = 8;
+// Frame period while the output dithers: 500 Hz, so the eight-frame
+// pattern of the finest fraction still repeats at 62 Hz. RGB_NUM pixels
+// take under 1 ms on the wire.
+constexpr uint16_t kDitherIntervalMs = 2;
+// WS2812B draw: about 20 mA per channel at full output and 1 mA per pixel
+// when dark. The budget is the strip's share of the 5 V rail switched by
+// PIN_RGB_EN; RGB_NUM pixels only reach the limiter's knee near white at
+// full brightness, and a longer strip is held under it instead of browning
+// the rail out.
+constexpr PixelOutput::PowerModel kStripPower{20, 20, 20, 1000, 1000};
+// Crossfade between glow modes on a long press.
+constexpr uint16_t kGlowTransitionMs = 600;
+// The stream falls back to the local glow mode after this long without a
+// frame.
+constexpr uint32_t kStreamTimeoutMs = 1000;
+
+// VRChat sends avatar parameters to port 9000 of its own host by default;
+// point it here with the launch option --osc=9000:<pc>:9001.
+constexpr uint16_t kOscPort = 9001;
+// Largest datagram without IP fragmentation on Ethernet-sized links.
+constexpr std::size_t kOscPacketSize = 1472;
+// How soon to retry parameters the event queue had no room for.
+constexpr uint32_t kOscRetryMs = 10;
 
-constexpr unsigned long kBreathingIntervalMs = 30;
+// Step of the waveform modes: short, so the level moves in small
+// increments; each mode's cycle sets its speed.
+constexpr uint16_t kWaveformStepMs = 10;
 constexpr uint8_t kSolidColorR = 200;
 constexpr uint8_t kSolidColorG = 200;
 constexpr uint8_t kSolidColorB = 200;
 
 constexpr char kPrefsNamespace[] = "lighting";
-constexpr char kPrefsBrightnessKey[] = "brightness";
-constexpr char kPrefsGlowKey[] = "glow";
+// A layout (pixel_layout.h) stored under this key replaces kDefaultLayout.
+constexpr char kLayoutKey[] = "layout";
+// The strip as a straight line across the plane, centred on its middle.
+constexpr uint8_t kDefaultLayout[] = {
+    LAYOUT_HEADER(1, 128, 128),
+    LAYOUT_LINE(RGB_NUM, 0, 128, 255, 128),
+};
+// Settings are committed once the user has stopped changing them for this long.
+constexpr uint32_t kSettingsIdleWindowMs = 2000;
 
 enum class BrightnessMode : uint8_t {
   kBright = 0,
@@ -53,41 +155,247 @@ enum class GlowMode : uint8_t {
   kRainbow,
   kTheaterChase,
   kTheaterChaseRainbow,
+  // Frames pushed over serial. Not in the long-press cycle and never
+  // persisted; the local mode it replaced is what is saved and restored.
+  kStream,
+  kPulse,
+  kHeartbeat,
+  kSparkle,
+  kRadialWave,
+  kSweep,
+  kNoise,
 };
 
-enum class ButtonEventType : uint8_t {
+enum class LightingEventType : uint8_t {
   kSingleClick = 0,
   kLongPress,
+  kSetGlow,
+  kSetBrightness,
+  kSetColor,
+  kSetSpeed,
+  kSetFlags,
+  kQueryState,
+  kFlush,
+  kStreamFrame,
+  // Gestures are waiting in input_ring; the event itself carries nothing.
+  kInput,
+  kPreviousGlow,
+  // Moves the colour |value| entries around the wheel.
+  kStepHue,
+  // Toggles the EffectParams flags in |value|.
+  kToggleFlags,
+  kResetStyle,
 };
 
-struct ButtonEvent {
-  ButtonEventType type;
+// Everything TaskRGB acts on, from the button or the serial protocol.
+// |value| is the operand: a mode, a packed colour, a step time or flags.
+struct LightingEvent {
+  LightingEventType type;
+  uint32_t value;
 };
 
-struct BreathingState {
-  uint8_t brightness;
-  int8_t direction;
-  unsigned long last_update_ms;
+// How each GlowMode runs on the effect engine, in long-press cycle order.
+// Bright/dim is the effect level; modes that modulate the level themselves
+// (breathing, pulse, heartbeat) take their range from the brightness mode
+// instead. |cycle_ms| is the waveform period of the modes that follow one,
+// at their own step time.
+struct GlowModeConfig {
+  GlowMode mode;
+  EffectId effect;
+  uint16_t step_ms;
+  uint16_t cycle_ms;
+  bool modulates_level;
 };
 
-constexpr GlowMode kGlowModes[] = {
-    GlowMode::kSolid,
-    GlowMode::kBreathing,
-    GlowMode::kRainbow,
-    GlowMode::kTheaterChase,
-    GlowMode::kTheaterChaseRainbow,
+constexpr GlowModeConfig kGlowModes[] = {
+    {GlowMode::kSolid, EffectId::kSolid, 0, 0, false},
+    {GlowMode::kBreathing, EffectId::kBreathing, kWaveformStepMs, 4000, true},
+    {GlowMode::kRainbow, EffectId::kRainbow, 8, 0, false},
+    {GlowMode::kTheaterChase, EffectId::kTheaterChase, 50, 0, false},
+    {GlowMode::kTheaterChaseRainbow, EffectId::kTheaterChaseRainbow, 40, 0, false},
+    {GlowMode::kPulse, EffectId::kPulse, kWaveformStepMs, 1500, true},
+    // 60 beats a minute.
+    {GlowMode::kHeartbeat, EffectId::kHeartbeat, kWaveformStepMs, 1000, true},
+    {GlowMode::kSparkle, EffectId::kSparkle, 20, 3000, false},
+    {GlowMode::kRadialWave, EffectId::kRadialWave, 20, 2000, false},
+    {GlowMode::kSweep, EffectId::kSweep, 20, 2000, false},
+    {GlowMode::kNoise, EffectId::kNoise, 20, 4000, false},
 };
 constexpr std::size_t kGlowModeCount = sizeof(kGlowModes) / sizeof(kGlowModes[0]);
 
-QueueHandle_t button_event_queue = nullptr;
+// Colour, speed and flags applied on top of every glow mode, set over the
+// serial protocol. A zero step_ms keeps each mode's own speed; static modes
+// ignore it.
+struct GlowStyle {
+  uint32_t color;
+  uint16_t step_ms;
+  uint8_t flags;
+};
+
+// What TaskRGB has been asked for while draining the queue; it is applied
+// once the queue is empty.
+struct LightingRequest {
+  BrightnessMode brightness;
+  GlowMode glow;
+  // The local mode, in kGlowModes; the same as |glow| unless streaming.
+  std::size_t glow_index;
+  GlowStyle style;
+  // Wheel entry kStepHue moves from.
+  uint8_t hue;
+  bool style_changed;
+  bool query;
+  bool flush;
+  // Set when the stream is left locally (button or kSetGlow); stream frames
+  // are then ignored until the host pauses for kStreamTimeoutMs.
+  bool stream_held;
+  bool discard_stream;
+};
+
+// Payload size range of each serial command.
+struct CommandSpec {
+  uint8_t command;
+  uint8_t min_length;
+  uint8_t max_length;
+};
+
+constexpr CommandSpec kCommands[] = {
+    {protocol_cmd::kSetGlow, 1, 1},
+    {protocol_cmd::kSetBrightness, 1, 1},
+    {protocol_cmd::kSetColor, 3, 3},
+    {protocol_cmd::kSetSpeed, 2, 2},
+    {protocol_cmd::kSetFlags, 1, 1},
+    {protocol_cmd::kQueryState, 0, 0},
+    {protocol_cmd::kFlush, 0, 0},
+    {protocol_cmd::kDumpStats, 0, 0},
+    {protocol_cmd::kResetStats, 0, 0},
+    {protocol_cmd::kStreamFrame, kStreamHeaderSize, kStreamHeaderSize + kMaxStreamOps},
+};
+
+// Avatar parameters the OSC listener acts on. Bools arrive as T/F, ints
+// as i and floats as f; any numeric type is accepted for each.
+enum class OscTarget : uint8_t {
+  // Bool: dim while set.
+  kDim = 0,
+  // Int: a GlowMode from the long-press cycle.
+  kGlow,
+  // Float: hue, 0 to 1 around the colour wheel.
+  kHue,
+  // Bool, as buttons: a click, and a long press (next glow mode).
+  kToggle,
+  kNext,
+};
+
+constexpr OscBinding kOscBindings[] = {
+    {"/avatar/parameters/LightDim", static_cast<uint8_t>(OscTarget::kDim), OscBindingKind::kValue},
+    {"/avatar/parameters/LightGlow", static_cast<uint8_t>(OscTarget::kGlow),
+     OscBindingKind::kValue},
+    {"/avatar/parameters/LightHue", static_cast<uint8_t>(OscTarget::kHue), OscBindingKind::kValue},
+    {"/avatar/parameters/LightToggle", static_cast<uint8_t>(OscTarget::kToggle),
+     OscBindingKind::kTrigger},
+    {"/avatar/parameters/LightNext", static_cast<uint8_t>(OscTarget::kNext),
+     OscBindingKind::kTrigger},
+};
+constexpr std::size_t kOscBindingCount = sizeof(kOscBindings) / sizeof(kOscBindings[0]);
+
+// The buttons, in InputEvent::keys bit order. Only KEY_USER_2 and BOOT
+// wait for double and triple clicks, so a click on the main key is applied
+// as soon as it is released.
+enum class ButtonKey : uint8_t {
+  kMain = 0,
+  kUser2,
+  kBoot,
+};
+
+constexpr uint8_t KeyBit(ButtonKey key) {
+  return static_cast<uint8_t>(1u << static_cast<uint8_t>(key));
+}
+
+struct ButtonKeyConfig {
+  uint8_t pin;
+  uint8_t max_clicks;
+  // kHoldRepeat period; 0 for none.
+  uint16_t repeat_ms;
+};
+
+constexpr ButtonKeyConfig kButtonKeys[] = {
+    {KEY_USER_MAIN, 1, kLongPressIntervalMs},
+    {KEY_USER_2, 2, kHueRepeatMs},
+    {KEY_USER_BOOT, 3, 0},
+};
+constexpr std::size_t kButtonKeyCount = sizeof(kButtonKeys) / sizeof(kButtonKeys[0]);
+static_assert(kButtonKeyCount == sizeof(button_keys) / sizeof(button_keys[0]),
+              "a ButtonGesture per key");
+
+// What each gesture does, as the event it turns into. |clicks| narrows a
+// kMultiClick binding to one run length.
+struct ButtonBinding {
+  uint8_t keys;
+  InputGesture gesture;
+  uint8_t clicks;
+  LightingEventType type;
+  uint32_t value;
+};
+
+constexpr ButtonBinding kButtonBindings[] = {
+    {KeyBit(ButtonKey::kMain), InputGesture::kClick, 0, LightingEventType::kSingleClick, 0},
+    {KeyBit(ButtonKey::kMain), InputGesture::kLongPressStop, 0, LightingEventType::kLongPress, 0},
+    {KeyBit(ButtonKey::kUser2), InputGesture::kClick, 0, LightingEventType::kStepHue, kHueStep},
+    {KeyBit(ButtonKey::kUser2), InputGesture::kHoldRepeat, 0, LightingEventType::kStepHue,
+     kHueStep},
+    {KeyBit(ButtonKey::kUser2), InputGesture::kDoubleClick, 0, LightingEventType::kPreviousGlow, 0},
+    {KeyBit(ButtonKey::kBoot), InputGesture::kClick, 0, LightingEventType::kToggleFlags,
+     kEffectFlagGamma},
+    {KeyBit(ButtonKey::kBoot), InputGesture::kMultiClick, 3, LightingEventType::kResetStyle, 0},
+    // Saves the settings now instead of after the idle window.
+    {KeyBit(ButtonKey::kMain) | KeyBit(ButtonKey::kUser2), InputGesture::kChord, 0,
+     LightingEventType::kFlush, 0},
+};
+
+constexpr UBaseType_t kEventQueueLength = 8;
+
+// Stack depths in bytes: the task's high-water mark in the memory bench
+// plus 1 KiB for the context switch and the drivers the host only stubs,
+// and another 1.5 KiB where the task reaches NVS (TaskPersist's commit,
+// WiFi.begin() in TaskOsc), rounded up to 256. kDumpStats reports what is
+// left on the device. The stats report's printf is most of TaskSerial's.
+constexpr uint32_t kButtonStackSize = 1536;
+constexpr uint32_t kRgbStackSize = 2304;
+constexpr uint32_t kSerialStackSize = LIGHTING_INSTRUMENTATION ? 4352 : 2048;
+constexpr uint32_t kPersistStackSize = 3072;
+constexpr uint32_t kOscStackSize = 3328;
+
+// Tasks and the event queue live in static storage, so none of them takes
+// heap at boot and none of the create calls can fail.
+StaticTask_t button_task_buffer;
+StackType_t button_task_stack[kButtonStackSize];
+StaticTask_t rgb_task_buffer;
+StackType_t rgb_task_stack[kRgbStackSize];
+StaticTask_t serial_task_buffer;
+StackType_t serial_task_stack[kSerialStackSize];
+StaticTask_t persist_task_buffer;
+StackType_t persist_task_stack[kPersistStackSize];
+#if LIGHTING_OSC
+StaticTask_t osc_task_buffer;
+StackType_t osc_task_stack[kOscStackSize];
+#endif
+StaticQueue_t event_queue_buffer;
+uint8_t event_queue_storage[kEventQueueLength * sizeof(LightingEvent)];
+
+QueueHandle_t lighting_event_queue = nullptr;
 
 Preferences preferences;
 bool preferences_ready = false;
+SettingsStore settings_store(preferences, kSettingsIdleWindowMs);
+portMUX_TYPE settings_mux = portMUX_INITIALIZER_UNLOCKED;
+TaskHandle_t persist_task_handle = nullptr;
+LightingSettings boot_settings{static_cast<uint8_t>(BrightnessMode::kBright),
+                               static_cast<uint8_t>(GlowMode::kSolid)};
 
 uint8_t BrightnessForMode(BrightnessMode mode) {
   return mode == BrightnessMode::kBright ? kBrightnessHigh : kBrightnessLow;
 }
 
+// Level range of the level-modulating modes.
 uint8_t BreathingMinimum(BrightnessMode mode) {
   return mode == BrightnessMode::kBright ? 20 : 5;
 }
@@ -96,12 +404,8 @@ uint8_t BreathingMaximum(BrightnessMode mode) {
   return mode == BrightnessMode::kBright ? kBrightnessHigh : 80;
 }
 
-uint8_t BreathingStep(BrightnessMode mode) {
-  return mode == BrightnessMode::kBright ? 3 : 1;
-}
-
 uint32_t MakeColor(uint8_t r, uint8_t g, uint8_t b) {
-  return strip.Color(r, g, b);
+  return color_tables::Pack(r, g, b);
 }
 
 BrightnessMode ToBrightnessMode(int value) {
@@ -115,268 +419,718 @@ BrightnessMode ToBrightnessMode(int value) {
 }
 
 GlowMode ToGlowMode(int value) {
-  for (GlowMode mode : kGlowModes) {
-    if (static_cast<int>(mode) == value) {
-      return mode;
+  for (const GlowModeConfig &config : kGlowModes) {
+    if (static_cast<int>(config.mode) == value) {
+      return config.mode;
     }
   }
   return GlowMode::kSolid;
 }
 
+GlowMode LocalGlow(const LightingRequest &request) {
+  return kGlowModes[request.glow_index].mode;
+}
+
 std::size_t GlowModeIndex(GlowMode mode) {
   for (std::size_t i = 0; i < kGlowModeCount; ++i) {
-    if (kGlowModes[i] == mode) {
+    if (kGlowModes[i].mode == mode) {
       return i;
     }
   }
   return 0;
 }
 
-BrightnessMode LoadPersistedBrightness() {
+void LoadSettings() {
   if (!preferences_ready) {
-    return BrightnessMode::kBright;
+    return;
   }
-  const int stored = preferences.getInt(kPrefsBrightnessKey,
-                                        static_cast<int>(BrightnessMode::kBright));
-  return ToBrightnessMode(stored);
+  settings_store.load(boot_settings);
 }
 
-GlowMode LoadPersistedGlow(std::size_t &index) {
-  if (!preferences_ready) {
-    index = 0;
-    return GlowMode::kSolid;
+// Precomputes the layout stored in NVS, or kDefaultLayout without a valid
+// one that fits the strip.
+void LoadStripLayout() {
+  uint8_t stored[kMaxLayoutBytes];
+  const std::size_t length =
+      preferences_ready ? LoadLayout(preferences, kLayoutKey, stored, sizeof(stored)) : 0;
+  if (length == 0 || !strip_layout.load(stored, length)) {
+    strip_layout.load(kDefaultLayout, sizeof(kDefaultLayout));
   }
-  const int stored = preferences.getInt(kPrefsGlowKey, static_cast<int>(GlowMode::kSolid));
-  const GlowMode mode = ToGlowMode(stored);
-  index = GlowModeIndex(mode);
-  return mode;
 }
 
-void SaveBrightnessPreference(BrightnessMode mode) {
+// Hands the applied state to TaskPersist; no flash I/O happens here.
+void PublishSettings(BrightnessMode brightness_mode, GlowMode glow_mode) {
   if (!preferences_ready) {
     return;
   }
-  preferences.putInt(kPrefsBrightnessKey, static_cast<int>(mode));
+  const LightingSettings settings{static_cast<uint8_t>(brightness_mode),
+                                  static_cast<uint8_t>(glow_mode)};
+  portENTER_CRITICAL(&settings_mux);
+  settings_store.update(settings, millis());
+  portEXIT_CRITICAL(&settings_mux);
+  xTaskNotifyGive(persist_task_handle);
 }
 
-void SaveGlowPreference(GlowMode mode) {
-  if (!preferences_ready) {
+// Returns false if the queue is full.
+bool PublishEvent(LightingEventType type, uint32_t value = 0) {
+  if (!lighting_event_queue) {
+    return false;
+  }
+  const LightingEvent event{type, value};
+  return xQueueSend(lighting_event_queue, &event, 0) == pdPASS;
+}
+
+GlowStyle DefaultGlowStyle() {
+  return GlowStyle{MakeColor(kSolidColorR, kSolidColorG, kSolidColorB), 0, 0};
+}
+
+EffectParams GlowModeParams(const GlowModeConfig &config, BrightnessMode brightness_mode,
+                            const GlowStyle &style) {
+  EffectParams params{};
+  params.color = style.color;
+  params.step_ms = (config.step_ms != 0 && style.step_ms != 0) ? style.step_ms : config.step_ms;
+  params.flags = style.flags;
+  params.level = BrightnessForMode(brightness_mode);
+  params.level_min = BreathingMinimum(brightness_mode);
+  params.level_max = BreathingMaximum(brightness_mode);
+  // From the mode's own step time, so a style step_ms changes the speed.
+  params.phase_step = waveform::PhaseStep(config.cycle_ms, config.step_ms);
+  return params;
+}
+
+// The stream only takes the level; its frames carry their own colours.
+EffectParams StreamParams(BrightnessMode brightness_mode) {
+  EffectParams params{};
+  params.level = BrightnessForMode(brightness_mode);
+  return params;
+}
+
+// Starts |glow_mode| from its first step at the current brightness, fading
+// over from what is showing for |transition_ms| (0 cuts).
+void StartGlowMode(GlowMode glow_mode, BrightnessMode brightness_mode, const GlowStyle &style,
+                   uint16_t transition_ms) {
+  if (glow_mode == GlowMode::kStream) {
+    frame_stream.restart();
+    effect_engine.crossfadeTo(EffectId::kStream, StreamParams(brightness_mode), transition_ms);
     return;
   }
-  preferences.putInt(kPrefsGlowKey, static_cast<int>(mode));
+  const GlowModeConfig &config = kGlowModes[GlowModeIndex(glow_mode)];
+  effect_engine.crossfadeTo(config.effect, GlowModeParams(config, brightness_mode, style),
+                            transition_ms);
 }
 
-void PublishButtonEvent(ButtonEventType type) {
-  if (!button_event_queue) {
+// A bright/dim or style change restarts level-modulating modes from the new
+// maximum; the others keep their phase and redraw with the new parameters.
+void ChangeParams(GlowMode glow_mode, BrightnessMode brightness_mode, const GlowStyle &style) {
+  if (glow_mode == GlowMode::kStream) {
+    effect_engine.setParams(StreamParams(brightness_mode));
+    return;
+  }
+  const GlowModeConfig &config = kGlowModes[GlowModeIndex(glow_mode)];
+  if (config.modulates_level) {
+    StartGlowMode(glow_mode, brightness_mode, style, 0);
     return;
   }
-  ButtonEvent event{type};
-  xQueueSend(button_event_queue, &event, 0);
+  effect_engine.setParams(GlowModeParams(config, brightness_mode, style));
 }
 
-void SyncBrightness(BrightnessMode brightness_mode,
-                    GlowMode glow_mode,
-                    BreathingState &breathing_state,
-                    bool &solid_needs_refresh) {
-  const uint8_t brightness = BrightnessForMode(brightness_mode);
-  switch (glow_mode) {
-    case GlowMode::kSolid:
-      strip.setBrightness(brightness);
-      strandtest.setBrightness(brightness);
-      solid_needs_refresh = true;
+void HandleEvent(const LightingEvent &event, LightingRequest &request) {
+  switch (event.type) {
+    case LightingEventType::kSingleClick:
+      request.brightness = (request.brightness == BrightnessMode::kBright) ? BrightnessMode::kDim
+                                                                           : BrightnessMode::kBright;
+      break;
+    case LightingEventType::kLongPress:
+      // Leaves the stream for the local mode first, then cycles.
+      if (request.glow == GlowMode::kStream) {
+        request.stream_held = true;
+      } else {
+        request.glow_index = (request.glow_index + 1) % kGlowModeCount;
+      }
+      request.glow = LocalGlow(request);
+      break;
+    case LightingEventType::kPreviousGlow:
+      if (request.glow == GlowMode::kStream) {
+        request.stream_held = true;
+      } else {
+        request.glow_index = (request.glow_index + kGlowModeCount - 1) % kGlowModeCount;
+      }
+      request.glow = LocalGlow(request);
+      break;
+    case LightingEventType::kSetGlow:
+      if (event.value == static_cast<uint32_t>(GlowMode::kStream)) {
+        request.glow = GlowMode::kStream;
+        request.stream_held = false;
+        break;
+      }
+      request.stream_held = request.stream_held || request.glow == GlowMode::kStream;
+      request.glow = ToGlowMode(static_cast<int>(event.value));
+      request.glow_index = GlowModeIndex(request.glow);
+      break;
+    case LightingEventType::kSetBrightness:
+      request.brightness = ToBrightnessMode(static_cast<int>(event.value));
       break;
-    case GlowMode::kBreathing:
-      breathing_state.brightness = BreathingMaximum(brightness_mode);
-      breathing_state.direction = -1;
-      breathing_state.last_update_ms = millis();
-      strip.setBrightness(breathing_state.brightness);
-      strip.fill(MakeColor(kSolidColorR, kSolidColorG, kSolidColorB), 0, strip.numPixels());
-      strip.show();
+    case LightingEventType::kSetColor:
+      request.style.color = event.value;
+      request.style_changed = true;
+      break;
+    case LightingEventType::kSetSpeed:
+      request.style.step_ms = static_cast<uint16_t>(event.value);
+      request.style_changed = true;
+      break;
+    case LightingEventType::kSetFlags:
+      request.style.flags = static_cast<uint8_t>(event.value);
+      request.style_changed = true;
+      break;
+    case LightingEventType::kStepHue:
+      request.hue = static_cast<uint8_t>(request.hue + event.value);
+      request.style.color = color_tables::kWheel[request.hue];
+      request.style_changed = true;
+      break;
+    case LightingEventType::kToggleFlags:
+      request.style.flags = static_cast<uint8_t>(request.style.flags ^ event.value);
+      request.style_changed = true;
+      break;
+    case LightingEventType::kResetStyle:
+      request.style = DefaultGlowStyle();
+      request.hue = 0;
+      request.style_changed = true;
+      break;
+    case LightingEventType::kQueryState:
+      request.query = true;
+      break;
+    case LightingEventType::kFlush:
+      request.flush = true;
+      break;
+    case LightingEventType::kStreamFrame:
+      if (request.stream_held) {
+        request.discard_stream = true;
+      } else {
+        request.glow = GlowMode::kStream;
+      }
       break;
-    case GlowMode::kRainbow:
-    case GlowMode::kTheaterChase:
-    case GlowMode::kTheaterChaseRainbow:
     default:
-      strandtest.setBrightness(brightness);
       break;
   }
 }
 
-void ConfigureForMode(GlowMode glow_mode,
-                      BrightnessMode brightness_mode,
-                      BreathingState &breathing_state,
-                      bool &solid_needs_refresh) {
-  switch (glow_mode) {
-    case GlowMode::kSolid:
-      strandtest.setAutoCycle(false);
-      SyncBrightness(brightness_mode, glow_mode, breathing_state, solid_needs_refresh);
+void SendReply(uint8_t command, uint8_t status, const uint8_t *data = nullptr,
+               std::size_t length = 0) {
+  constexpr std::size_t kMaxReplyPayload = 16;
+  uint8_t payload[kMaxReplyPayload];
+  payload[0] = status;
+  for (std::size_t i = 0; i < length && i + 1 < sizeof(payload); ++i) {
+    payload[i + 1] = data[i];
+  }
+  uint8_t frame[kMaxFrameSize];
+  const std::size_t size =
+      EncodeFrame(command | protocol_cmd::kReplyFlag, payload, length + 1, frame, sizeof(frame));
+  Serial.write(frame, size);
+}
+
+// Answers kQueryState from TaskRGB, after every command queued before it has
+// been applied.
+void SendStateReport(const LightingRequest &applied) {
+  const EffectParams &params = effect_engine.params();
+  const uint8_t state[] = {
+      static_cast<uint8_t>(applied.brightness),
+      static_cast<uint8_t>(applied.glow),
+      static_cast<uint8_t>(applied.style.color >> 16),
+      static_cast<uint8_t>(applied.style.color >> 8),
+      static_cast<uint8_t>(applied.style.color),
+      static_cast<uint8_t>(params.step_ms & 0xff),
+      static_cast<uint8_t>(params.step_ms >> 8),
+      applied.style.flags,
+      params.level,
+  };
+  SendReply(protocol_cmd::kQueryState, protocol_status::kOk, state, sizeof(state));
+}
+
+// Queues a kStreamFrame chunk and wakes TaskRGB. The ops are copied once,
+// from the parser's ring into a jitter-buffer slot, and decoded from there.
+uint8_t PushStreamChunk(const CommandView &command) {
+  const StreamChunkHeader header{command.u8(0), command.u16(1), command.u16(3), command.u8(5)};
+  const std::size_t ops_length = command.payloadLength() - kStreamHeaderSize;
+  FrameStream::PushStatus status;
+  uint8_t *ops = frame_stream.beginChunk(header, ops_length, millis(), status);
+  if (ops != nullptr) {
+    command.copy(kStreamHeaderSize, ops, ops_length);
+    frame_stream.commitChunk();
+    // A full queue means TaskRGB is awake anyway and will find the frame.
+    PublishEvent(LightingEventType::kStreamFrame);
+  }
+  switch (status) {
+    case FrameStream::PushStatus::kQueued:
+      return protocol_status::kOk;
+    case FrameStream::PushStatus::kFull:
+      return protocol_status::kBusy;
+    case FrameStream::PushStatus::kNeedKeyframe:
+    default:
+      return protocol_status::kNeedKeyframe;
+  }
+}
+
+// Validates one command and posts it to TaskRGB. Everything but kQueryState
+// is acknowledged here; the state report is TaskRGB's reply.
+void HandleCommand(const CommandView &command) {
+  const CommandSpec *spec = nullptr;
+  for (const CommandSpec &candidate : kCommands) {
+    if (candidate.command == command.command()) {
+      spec = &candidate;
+    }
+  }
+  if (spec == nullptr) {
+    SendReply(command.command(), protocol_status::kUnknownCommand);
+    return;
+  }
+  if (command.payloadLength() < spec->min_length || command.payloadLength() > spec->max_length) {
+    SendReply(command.command(), protocol_status::kBadLength);
+    return;
+  }
+
+  bool posted = true;
+  switch (command.command()) {
+    case protocol_cmd::kSetGlow:
+      if (static_cast<uint8_t>(ToGlowMode(command.u8(0))) != command.u8(0) &&
+          command.u8(0) != static_cast<uint8_t>(GlowMode::kStream)) {
+        SendReply(command.command(), protocol_status::kBadValue);
+        return;
+      }
+      posted = PublishEvent(LightingEventType::kSetGlow, command.u8(0));
       break;
-    case GlowMode::kBreathing:
-      strandtest.setAutoCycle(false);
-      SyncBrightness(brightness_mode, glow_mode, breathing_state, solid_needs_refresh);
+    case protocol_cmd::kSetBrightness:
+      if (static_cast<uint8_t>(ToBrightnessMode(command.u8(0))) != command.u8(0)) {
+        SendReply(command.command(), protocol_status::kBadValue);
+        return;
+      }
+      posted = PublishEvent(LightingEventType::kSetBrightness, command.u8(0));
+      break;
+    case protocol_cmd::kSetColor:
+      posted = PublishEvent(LightingEventType::kSetColor,
+                            MakeColor(command.u8(0), command.u8(1), command.u8(2)));
+      break;
+    case protocol_cmd::kSetSpeed:
+      posted = PublishEvent(LightingEventType::kSetSpeed, command.u16(0));
+      break;
+    case protocol_cmd::kSetFlags:
+      posted = PublishEvent(LightingEventType::kSetFlags, command.u8(0));
+      break;
+    case protocol_cmd::kQueryState:
+      if (PublishEvent(LightingEventType::kQueryState)) {
+        return;
+      }
+      posted = false;
       break;
-    case GlowMode::kRainbow:
-      strandtest.setAutoCycle(false);
-      strandtest.setPattern(StrandPattern::kRainbow);
-      strandtest.setRainbowWait(8);
-      SyncBrightness(brightness_mode, glow_mode, breathing_state, solid_needs_refresh);
+    case protocol_cmd::kFlush:
+      posted = PublishEvent(LightingEventType::kFlush);
       break;
-    case GlowMode::kTheaterChase:
-      strandtest.setAutoCycle(false);
-      strandtest.setPattern(StrandPattern::kTheaterChase,
-                            MakeColor(kSolidColorR, kSolidColorG, kSolidColorB));
-      strandtest.setTheaterChaseWait(50);
-      SyncBrightness(brightness_mode, glow_mode, breathing_state, solid_needs_refresh);
+    case protocol_cmd::kDumpStats:
+      INSTRUMENT_DUMP();
       break;
-    case GlowMode::kTheaterChaseRainbow:
-      strandtest.setAutoCycle(false);
-      strandtest.setPattern(StrandPattern::kTheaterChaseRainbow);
-      strandtest.setTheaterChaseRainbowWait(40);
-      SyncBrightness(brightness_mode, glow_mode, breathing_state, solid_needs_refresh);
+    case protocol_cmd::kResetStats:
+      INSTRUMENT_RESET();
       break;
+    case protocol_cmd::kStreamFrame:
+      SendReply(command.command(), PushStreamChunk(command));
+      return;
     default:
       break;
   }
+  SendReply(command.command(), posted ? protocol_status::kOk : protocol_status::kBusy);
 }
 
-void UpdateBreathing(BrightnessMode brightness_mode, BreathingState &breathing_state) {
-  const unsigned long now = millis();
-  if ((now - breathing_state.last_update_ms) < kBreathingIntervalMs) {
+void OnOscMessage(const OscMessage &message, void *context) {
+  static_cast<OscParameters *>(context)->update(message);
+}
+
+// Turns a changed avatar parameter into a lighting event. Returns false if
+// the queue is full, so the parameter is retried.
+bool DeliverOscParameter(uint8_t id, float value, void *context) {
+  // NaN and infinities are dropped before any conversion to an integer.
+  if (!std::isfinite(value)) {
+    return true;
+  }
+  switch (static_cast<OscTarget>(id)) {
+    case OscTarget::kDim:
+      return PublishEvent(LightingEventType::kSetBrightness,
+                          static_cast<uint32_t>(value >= 0.5f ? BrightnessMode::kDim
+                                                              : BrightnessMode::kBright));
+    case OscTarget::kGlow: {
+      // Values that are not a glow mode are ignored; the range check keeps
+      // the conversion defined.
+      if (value < 0.0f || value >= 256.0f) {
+        return true;
+      }
+      const int mode = static_cast<int>(value);
+      if (static_cast<int>(ToGlowMode(mode)) != mode) {
+        return true;
+      }
+      return PublishEvent(LightingEventType::kSetGlow, static_cast<uint32_t>(mode));
+    }
+    case OscTarget::kHue: {
+      // Wraps, so radial puppets (0 to 1) and axes (-1 to 1) both cover the
+      // wheel. A value just below a whole number can round |turns| up to 1,
+      // so the wheel index wraps as an int rather than converting 256.
+      const float turns = value - std::floor(value);
+      const int wheel = static_cast<int>(turns * 256.0f) & 0xff;
+      return PublishEvent(LightingEventType::kSetColor, color_tables::kWheel[wheel]);
+    }
+    case OscTarget::kToggle:
+      return PublishEvent(LightingEventType::kSingleClick);
+    case OscTarget::kNext:
+      return PublishEvent(LightingEventType::kLongPress);
+    default:
+      return true;
+  }
+}
+
+}  // namespace
+
+// OSC receive side. The packet buffer is the only copy of a datagram; the
+// parser reads it in place and the parameter table keeps the values.
+int osc_socket = -1;
+uint8_t osc_packet[kOscPacketSize];
+OscParser osc_parser;
+OscParameterState osc_parameter_state[kOscBindingCount];
+OscParameters osc_parameters(kOscBindings, osc_parameter_state, kOscBindingCount);
+
+// Hands a gesture to TaskRGB. A full ring drops it and counts the drop; a
+// full queue means TaskRGB is awake anyway and will drain the ring.
+void QueueInput(const InputEvent &event, void *context) {
+  if (!input_ring.push(event)) {
+    INSTRUMENT_INPUT_DROPPED();
     return;
   }
-  breathing_state.last_update_ms = now;
+  PublishEvent(LightingEventType::kInput);
+}
 
-  const uint8_t min_brightness = BreathingMinimum(brightness_mode);
-  const uint8_t max_brightness = BreathingMaximum(brightness_mode);
-  const uint8_t step = BreathingStep(brightness_mode);
+void ConfigureButtons() {
+  for (std::size_t k = 0; k < kButtonKeyCount; ++k) {
+    pinMode(kButtonKeys[k].pin, INPUT_PULLUP);
+    button_keys[k].setMaxClicks(kButtonKeys[k].max_clicks);
+    button_keys[k].setLongPressIntervalMs(kButtonKeys[k].repeat_ms);
+  }
+  button_pad.setSink(QueueInput, nullptr);
+}
 
-  if (breathing_state.direction > 0) {
-    if (breathing_state.brightness + step < max_brightness) {
-      breathing_state.brightness = breathing_state.brightness + step;
-    } else {
-      breathing_state.brightness = max_brightness;
-      breathing_state.direction = -1;
+// Samples every key into the gesture layer. Returns the milliseconds before
+// it needs another look without an edge.
+uint32_t ServiceButtons() {
+  uint32_t pressed = 0;
+  for (std::size_t k = 0; k < kButtonKeyCount; ++k) {
+    if (digitalRead(kButtonKeys[k].pin) == LOW) {
+      pressed |= 1u << k;
     }
-  } else {
-    if (breathing_state.brightness > min_brightness + step) {
-      breathing_state.brightness = breathing_state.brightness - step;
-    } else {
-      breathing_state.brightness = min_brightness;
-      breathing_state.direction = 1;
+  }
+  return button_pad.update(pressed, millis(), micros());
+}
+
+void ARDUINO_ISR_ATTR ButtonEdge() {
+  BaseType_t higher_priority_woken = pdFALSE;
+  vTaskNotifyGiveFromISR(button_task_handle, &higher_priority_woken);
+  portYIELD_FROM_ISR(higher_priority_woken);
+}
+
+void TaskButton(void *param) {
+  button_task_handle = xTaskGetCurrentTaskHandle();
+  INSTRUMENT_WATCH_TASK();
+  for (const ButtonKeyConfig &key : kButtonKeys) {
+    attachInterrupt(digitalPinToInterrupt(key.pin), ButtonEdge, CHANGE);
+  }
+
+  // Sleep until a GPIO edge on any key, or until the gesture layer has a
+  // debounce, long-press, repeat or click-gap deadline.
+  TickType_t wait = 0;
+  for (;;) {
+    ulTaskNotifyTake(pdTRUE, wait);
+    button_task_wakeups++;
+    const uint32_t delay_ms = ServiceButtons();
+    wait = delay_ms == ButtonGesture::kNoDeadline ? portMAX_DELAY : pdMS_TO_TICKS(delay_ms);
+  }
+}
+
+// Requests an immediate commit of the latest settings, bypassing the idle
+// window.
+void FlushSettings() {
+  portENTER_CRITICAL(&settings_mux);
+  settings_store.requestFlush();
+  portEXIT_CRITICAL(&settings_mux);
+  xTaskNotifyGive(persist_task_handle);
+}
+
+// Low-priority writer: sleeps until TaskRGB publishes a change, waits out
+// the idle window, then commits the latest snapshot to NVS.
+void TaskPersist(void *param) {
+  INSTRUMENT_WATCH_TASK();
+  TickType_t wait = 0;
+  for (;;) {
+    ulTaskNotifyTake(pdTRUE, wait);
+    LightingSettings settings;
+    uint32_t wait_ms = SettingsStore::kNoDeadline;
+    portENTER_CRITICAL(&settings_mux);
+    const bool due = settings_store.takePending(millis(), settings, wait_ms);
+    portEXIT_CRITICAL(&settings_mux);
+    if (due) {
+      INSTRUMENT_STAGE(kPersist);
+      if (!settings_store.commit(settings)) {
+        // Try again after an idle window, or sooner if TaskRGB publishes.
+        portENTER_CRITICAL(&settings_mux);
+        settings_store.restore(settings, millis());
+        portEXIT_CRITICAL(&settings_mux);
+        wait_ms = kSettingsIdleWindowMs;
+      }
     }
+    wait = wait_ms == SettingsStore::kNoDeadline ? portMAX_DELAY : pdMS_TO_TICKS(wait_ms);
   }
+}
 
-  strip.setBrightness(breathing_state.brightness);
-  // Reapply the base color because setBrightness rescales the pixel buffer.
-  strip.fill(MakeColor(kSolidColorR, kSolidColorG, kSolidColorB), 0, strip.numPixels());
-  strip.show();
+// Reads whatever the UART has into the parser and handles every complete
+// command. Called by TaskSerial when the UART signals a receive.
+void ServiceSerial() {
+  for (;;) {
+    std::size_t space = 0;
+    uint8_t *buffer = serial_parser.writeBuffer(space);
+    const std::size_t length = space == 0 ? 0 : Serial.read(buffer, space);
+    serial_parser.commitWrite(length);
+
+    CommandView command;
+    while (serial_parser.next(command)) {
+      HandleCommand(command);
+    }
+    if (length == 0) {
+      return;
+    }
+  }
 }
 
-}  // namespace
+void OnSerialReceive() { xTaskNotifyGive(serial_task_handle); }
 
-void ButtonClick(void *context) {
-  PublishButtonEvent(ButtonEventType::kSingleClick);
+void TaskSerial(void *param) {
+  serial_task_handle = xTaskGetCurrentTaskHandle();
+  INSTRUMENT_WATCH_TASK();
+  Serial.onReceive(OnSerialReceive);
+  for (;;) {
+    ServiceSerial();
+    ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+  }
+}
+
+// Opens the OSC socket on |port| (any free port if 0). Returns the port
+// bound, or 0 on failure.
+uint16_t BeginOsc(uint16_t port) {
+  if (osc_socket >= 0) {
+    close(osc_socket);
+  }
+  osc_socket = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+  if (osc_socket < 0) {
+    return 0;
+  }
+  sockaddr_in address{};
+  address.sin_family = AF_INET;
+  address.sin_port = htons(port);
+  address.sin_addr.s_addr = htonl(INADDR_ANY);
+  socklen_t address_length = sizeof(address);
+  if (bind(osc_socket, reinterpret_cast<sockaddr *>(&address), sizeof(address)) != 0 ||
+      getsockname(osc_socket, reinterpret_cast<sockaddr *>(&address), &address_length) != 0) {
+    close(osc_socket);
+    osc_socket = -1;
+    return 0;
+  }
+  return ntohs(address.sin_port);
 }
 
-void LongPressStop(void *context) {
-  PublishButtonEvent(ButtonEventType::kLongPress);
+// Parses every datagram waiting on the socket, then posts what changed to
+// TaskRGB: however many updates a burst carries, each parameter costs at
+// most one event. Returns true if some did not fit in the queue.
+bool ServiceOsc() {
+  for (;;) {
+    const ssize_t length = recv(osc_socket, osc_packet, sizeof(osc_packet), MSG_DONTWAIT);
+    if (length <= 0) {
+      break;
+    }
+    osc_parser.parse(osc_packet, static_cast<std::size_t>(length), OnOscMessage,
+                     &osc_parameters);
+  }
+  return osc_parameters.flush(DeliverOscParameter, nullptr);
 }
 
-void TaskButton(void *param) {
-  main_button.attachClick(ButtonClick, &main_button);
-  main_button.attachLongPressStop(LongPressStop, &main_button);
-  main_button.setLongPressIntervalMs(1000);
+// Joins the network, then sleeps in select() until datagrams arrive, or
+// for kOscRetryMs while parameters wait for room in the queue. It runs
+// above TaskRGB so the socket's small receive mailbox is emptied promptly.
+void TaskOsc(void *param) {
+  INSTRUMENT_WATCH_TASK();
+  WiFi.mode(WIFI_STA);
+  // Modem sleep holds incoming packets until the next beacon.
+  WiFi.setSleep(false);
+  WiFi.begin(LIGHTING_WIFI_SSID, LIGHTING_WIFI_PASSWORD);
+  while (WiFi.status() != WL_CONNECTED || BeginOsc(kOscPort) == 0) {
+    vTaskDelay(pdMS_TO_TICKS(500));
+  }
 
+  bool pending = false;
   for (;;) {
-    main_button.tick();
-    vTaskDelay(kButtonTaskDelay);
+    fd_set readable;
+    FD_ZERO(&readable);
+    FD_SET(osc_socket, &readable);
+    timeval retry{0, static_cast<long>(kOscRetryMs * 1000)};
+    select(osc_socket + 1, &readable, nullptr, nullptr, pending ? &retry : nullptr);
+    pending = ServiceOsc();
   }
 }
 
-void TaskRGB(void *param) {
-  std::size_t glow_mode_index = 0;
-  BrightnessMode requested_brightness = LoadPersistedBrightness();
-  GlowMode requested_glow = LoadPersistedGlow(glow_mode_index);
+// Time since the last stream frame arrived, or since the stream was entered
+// if that was later.
+uint32_t StreamIdleMs(unsigned long now, unsigned long stream_started) {
+  return std::min<uint32_t>(frame_stream.idleMs(now), now - stream_started);
+}
 
-  BrightnessMode applied_brightness = requested_brightness;
-  GlowMode applied_glow = requested_glow;
+// Gestures TaskRGB has applied, waiting for the first frame sent after
+// them: the one that shows them.
+struct PendingInputs {
+  uint32_t at_us[decltype(input_ring)::kCapacity];
+  std::size_t count;
+};
 
-  BreathingState breathing_state{};
-  breathing_state.brightness = BreathingMaximum(applied_brightness);
-  breathing_state.direction = -1;
-  breathing_state.last_update_ms = millis();
+// Applies every gesture in the input ring through kButtonBindings.
+void ApplyInputs(LightingRequest &request, PendingInputs &pending) {
+  InputEvent input;
+  while (input_ring.pop(input)) {
+    for (const ButtonBinding &binding : kButtonBindings) {
+      if (binding.keys != input.keys || binding.gesture != input.gesture ||
+          (binding.clicks != 0 && binding.clicks != input.clicks)) {
+        continue;
+      }
+      HandleEvent(LightingEvent{binding.type, binding.value}, request);
+      // A flush changes nothing on the strip.
+      if (binding.type != LightingEventType::kFlush &&
+          pending.count < sizeof(pending.at_us) / sizeof(pending.at_us[0])) {
+        pending.at_us[pending.count++] = input.at_us;
+      }
+    }
+  }
+}
 
-  bool solid_needs_refresh = true;
+void TaskRGB(void *param) {
+  LightingRequest requested{};
+  requested.brightness = ToBrightnessMode(boot_settings.brightness);
+  requested.glow = ToGlowMode(boot_settings.glow);
+  requested.glow_index = GlowModeIndex(requested.glow);
+  requested.style = DefaultGlowStyle();
 
-  digitalWrite(PIN_RGB_EN, HIGH);
-  strip.begin();
-  strip.show();
-  strandtest.begin();
-  strandtest.setAutoCycle(false);
+  LightingRequest applied = requested;
 
-  SyncBrightness(applied_brightness, applied_glow, breathing_state, solid_needs_refresh);
-  ConfigureForMode(applied_glow, applied_brightness, breathing_state, solid_needs_refresh);
+  digitalWrite(PIN_RGB_EN, HIGH);
+  strip_output.setPowerModel(kStripPower);
+  strip_output.begin();
+  effect_engine.setFrameCache(&frame_cache);
+  effect_engine.setDitherInterval(kDitherIntervalMs);
+  AttachLayout(&strip_layout);
+  StartGlowMode(applied.glow, applied.brightness, applied.style, 0);
+  INSTRUMENT_WATCH_TASK();
+  StreamEffect::attach(&frame_stream);
+  unsigned long stream_started = 0;
+  PendingInputs pending_inputs{};
 
+  TickType_t wait = 0;
   for (;;) {
-    ButtonEvent event;
-    while (xQueueReceive(button_event_queue, &event, 0) == pdPASS) {
-      switch (event.type) {
-        case ButtonEventType::kSingleClick:
-          requested_brightness = (requested_brightness == BrightnessMode::kBright)
-                                     ? BrightnessMode::kDim
-                                     : BrightnessMode::kBright;
-          break;
-        case ButtonEventType::kLongPress:
-          glow_mode_index = (glow_mode_index + 1) % kGlowModeCount;
-          requested_glow = kGlowModes[glow_mode_index];
-          break;
-        default:
-          break;
+    // Sleep until either an event arrives or the next frame is due.
+    LightingEvent event;
+    const bool received = xQueueReceive(lighting_event_queue, &event, wait) == pdPASS;
+    rgb_task_wakeups++;
+    INSTRUMENT_WOKE(!received);
+
+    {
+      INSTRUMENT_STAGE(kEvents);
+      if (received) {
+        do {
+          HandleEvent(event, requested);
+        } while (xQueueReceive(lighting_event_queue, &event, 0) == pdPASS);
       }
-    }
+      ApplyInputs(requested, pending_inputs);
 
-    if (requested_brightness != applied_brightness) {
-      applied_brightness = requested_brightness;
-      SyncBrightness(applied_brightness, applied_glow, breathing_state, solid_needs_refresh);
-      SaveBrightnessPreference(applied_brightness);
-    }
+      // A silent host releases the hold, and ends the stream if it is showing.
+      const unsigned long now = millis();
+      if (StreamIdleMs(now, stream_started) >= kStreamTimeoutMs) {
+        requested.stream_held = false;
+        if (requested.glow == GlowMode::kStream) {
+          requested.glow = LocalGlow(requested);
+        }
+      }
+      if (requested.discard_stream) {
+        requested.discard_stream = false;
+        frame_stream.discard();
+      }
 
-    if (requested_glow != applied_glow) {
-      applied_glow = requested_glow;
-      ConfigureForMode(applied_glow, applied_brightness, breathing_state, solid_needs_refresh);
-      SaveGlowPreference(applied_glow);
-    }
+      if (requested.brightness != applied.brightness || requested.style_changed) {
+        applied.brightness = requested.brightness;
+        applied.style = requested.style;
+        requested.style_changed = false;
+        ChangeParams(applied.glow, applied.brightness, applied.style);
+        PublishSettings(applied.brightness, LocalGlow(requested));
+      }
 
-    switch (applied_glow) {
-      case GlowMode::kSolid: {
-        if (solid_needs_refresh) {
-          const uint32_t color = MakeColor(kSolidColorR, kSolidColorG, kSolidColorB);
-          strip.fill(color, 0, strip.numPixels());
-          strip.show();
-          solid_needs_refresh = false;
+      if (requested.glow != applied.glow) {
+        if (requested.glow == GlowMode::kStream) {
+          stream_started = now;
         }
-        break;
+        applied.glow = requested.glow;
+        applied.glow_index = requested.glow_index;
+        StartGlowMode(applied.glow, applied.brightness, applied.style, kGlowTransitionMs);
+        PublishSettings(applied.brightness, LocalGlow(requested));
+      }
+
+      // The stream effect only draws when refreshed; do so once a frame is
+      // due on the playout clock.
+      if (applied.glow == GlowMode::kStream && frame_stream.nextDueMs(now) == 0) {
+        effect_engine.refresh();
+      }
+
+      if (requested.flush) {
+        requested.flush = false;
+        FlushSettings();
+      }
+
+      if (requested.query) {
+        requested.query = false;
+        SendStateReport(applied);
       }
-      case GlowMode::kBreathing:
-        UpdateBreathing(applied_brightness, breathing_state);
-        break;
-      case GlowMode::kRainbow:
-      case GlowMode::kTheaterChase:
-      case GlowMode::kTheaterChaseRainbow:
-        strandtest.update();
-        break;
-      default:
-        break;
     }
 
-    vTaskDelay(kRgbTaskDelay);
+    // Sleep until the active effect's next frame; a static effect that has
+    // been drawn waits for the next event.
+    uint32_t delay_ms;
+    const uint32_t frames_before = strip_output.stats().frames_sent;
+    {
+      INSTRUMENT_STAGE(kFrame);
+      delay_ms = effect_engine.render();
+    }
+    if (pending_inputs.count != 0) {
+      if (strip_output.stats().frames_sent != frames_before) {
+        for (std::size_t i = 0; i < pending_inputs.count; ++i) {
+          INSTRUMENT_INPUT_SHOWN(micros() - pending_inputs.at_us[i]);
+        }
+        pending_inputs.count = 0;
+      } else if (delay_ms == EffectEngine::kNoDeadline) {
+        // Drawn and unchanged: the gestures changed nothing on the strip.
+        pending_inputs.count = 0;
+      }
+    }
+    if (applied.glow == GlowMode::kStream) {
+      // Also wake for the next streamed frame and for the stream timeout.
+      const unsigned long now = millis();
+      const uint32_t idle_ms = StreamIdleMs(now, stream_started);
+      const uint32_t timeout_ms = idle_ms < kStreamTimeoutMs ? kStreamTimeoutMs - idle_ms : 0;
+      delay_ms = std::min({delay_ms, frame_stream.nextDueMs(now), timeout_ms});
+    }
+    INSTRUMENT_FRAME_DUE(delay_ms);
+    wait = delay_ms == EffectEngine::kNoDeadline ? portMAX_DELAY : pdMS_TO_TICKS(delay_ms);
   }
 }
 
 void setup() {
   pinMode(PIN_LED, OUTPUT);
   pinMode(PIN_RGB_EN, OUTPUT);
-  pinMode(KEY_USER_MAIN, INPUT_PULLUP);
+  ConfigureButtons();
 
   digitalWrite(PIN_LED, LOW);
   digitalWrite(PIN_RGB_EN, HIGH);
@@ -387,17 +1141,28 @@ void setup() {
   if (!preferences_ready) {
     Serial.println("Failed to initialise preferences storage.");
   }
+  LoadSettings();
+  LoadStripLayout();
 
-  button_event_queue = xQueueCreate(8, sizeof(ButtonEvent));
-  if (button_event_queue == nullptr) {
-    Serial.println("Failed to create button event queue.");
-    while (true) {
-      delay(1000);
-    }
-  }
+  lighting_event_queue = xQueueCreateStatic(kEventQueueLength, sizeof(LightingEvent),
+                                            event_queue_storage, &event_queue_buffer);
 
-  xTaskCreate(TaskButton, "TaskButton", 2048, nullptr, 3, nullptr);
-  xTaskCreate(TaskRGB, "TaskRGB", 4096, nullptr, 2, nullptr);
+  // TaskPersist first: each task below preempts setup() as soon as it
+  // exists, and PublishSettings()/FlushSettings() notify it unconditionally.
+  persist_task_handle = xTaskCreateStatic(TaskPersist, "TaskPersist", kPersistStackSize, nullptr,
+                                          1, persist_task_stack, &persist_task_buffer);
+  xTaskCreateStatic(TaskButton, "TaskButton", kButtonStackSize, nullptr, 3, button_task_stack,
+                    &button_task_buffer);
+  xTaskCreateStatic(TaskRGB, "TaskRGB", kRgbStackSize, nullptr, 2, rgb_task_stack,
+                    &rgb_task_buffer);
+  xTaskCreateStatic(TaskSerial, "TaskSerial", kSerialStackSize, nullptr, 2, serial_task_stack,
+                    &serial_task_buffer);
+#if LIGHTING_OSC
+  if (LIGHTING_WIFI_SSID[0] != '\0') {
+    xTaskCreateStatic(TaskOsc, "TaskOsc", kOscStackSize, nullptr, 3, osc_task_stack,
+                      &osc_task_buffer);
+  }
+#endif
 }
 
 void loop() {
@@ -0,0 +1,274 @@
+#include "osc.h"
+
+#include <cstring>
+
+namespace {
+
+constexpr char kBundleTag[] = "#bundle";
+// "#bundle\0" and the time tag.
+constexpr std::size_t kBundleHeaderSize = 16;
+
+uint32_t ReadU32(const uint8_t *data) {
+  return (static_cast<uint32_t>(data[0]) << 24) | (static_cast<uint32_t>(data[1]) << 16) |
+         (static_cast<uint32_t>(data[2]) << 8) | data[3];
+}
+
+uint64_t ReadU64(const uint8_t *data) {
+  return (static_cast<uint64_t>(ReadU32(data)) << 32) | ReadU32(data + 4);
+}
+
+// Size of the OSC string at |data| including its NUL padding to a multiple
+// of four, or 0 if it is not terminated inside |length|.
+std::size_t PaddedStringSize(const uint8_t *data, std::size_t length) {
+  const void *nul = std::memchr(data, 0, length);
+  if (nul == nullptr) {
+    return 0;
+  }
+  const std::size_t size = (static_cast<const uint8_t *>(nul) - data + 4) & ~std::size_t{3};
+  return size <= length ? size : 0;
+}
+
+// Bytes argument |tag| takes at |data|, or SIZE_MAX if it is malformed or
+// unknown.
+std::size_t ArgumentSize(char tag, const uint8_t *data, std::size_t length) {
+  switch (tag) {
+    case 'i':
+    case 'f':
+    case 'c':
+    case 'r':
+    case 'm':
+      return length >= 4 ? 4 : SIZE_MAX;
+    case 'h':
+    case 'd':
+    case 't':
+      return length >= 8 ? 8 : SIZE_MAX;
+    case 's':
+    case 'S': {
+      const std::size_t size = PaddedStringSize(data, length);
+      return size != 0 ? size : SIZE_MAX;
+    }
+    case 'b': {
+      if (length < 4) {
+        return SIZE_MAX;
+      }
+      // Checked before padding: near UINT32_MAX the padded size wraps on a
+      // 32-bit size_t.
+      const std::size_t declared = ReadU32(data);
+      if (declared > length - 4) {
+        return SIZE_MAX;
+      }
+      const std::size_t size = 4 + ((declared + 3) & ~std::size_t{3});
+      return size <= length ? size : SIZE_MAX;
+    }
+    case 'T':
+    case 'F':
+    case 'N':
+    case 'I':
+      return 0;
+    default:
+      return SIZE_MAX;
+  }
+}
+
+}  // namespace
+
+bool OscMessage::number(uint8_t index, float &value) const {
+  if (index >= argument_count_) {
+    return false;
+  }
+  const uint8_t *data = arguments_;
+  for (uint8_t i = 0; i < index; ++i) {
+    data += ArgumentSize(tags_[i], data, end_ - data);
+  }
+  switch (tags_[index]) {
+    case 'T':
+      value = 1.0f;
+      return true;
+    case 'F':
+      value = 0.0f;
+      return true;
+    case 'i':
+      value = static_cast<float>(static_cast<int32_t>(ReadU32(data)));
+      return true;
+    case 'h':
+      value = static_cast<float>(static_cast<int64_t>(ReadU64(data)));
+      return true;
+    case 'f': {
+      const uint32_t bits = ReadU32(data);
+      std::memcpy(&value, &bits, sizeof(value));
+      return true;
+    }
+    case 'd': {
+      const uint64_t bits = ReadU64(data);
+      double wide;
+      std::memcpy(&wide, &bits, sizeof(wide));
+      value = static_cast<float>(wide);
+      return true;
+    }
+    default:
+      return false;
+  }
+}
+
+bool OscParser::parse(const uint8_t *data, std::size_t length, OscMessageFn fn, void *context) {
+  stats_.packets++;
+  if (parseElement(data, length, 0, fn, context)) {
+    return true;
+  }
+  stats_.malformed++;
+  return false;
+}
+
+bool OscParser::parseElement(const uint8_t *data, std::size_t length, uint8_t depth,
+                             OscMessageFn fn, void *context) {
+  if (length == 0 || (length & 3) != 0) {
+    return false;
+  }
+  if (data[0] == '/') {
+    return parseMessage(data, length, fn, context);
+  }
+  if (length < kBundleHeaderSize || std::memcmp(data, kBundleTag, sizeof(kBundleTag)) != 0 ||
+      depth == kMaxOscBundleDepth) {
+    return false;
+  }
+  stats_.bundles++;
+  std::size_t offset = kBundleHeaderSize;
+  while (offset < length) {
+    if (length - offset < 4) {
+      return false;
+    }
+    const std::size_t size = ReadU32(data + offset);
+    offset += 4;
+    if (size > length - offset ||
+        !parseElement(data + offset, size, static_cast<uint8_t>(depth + 1), fn, context)) {
+      return false;
+    }
+    offset += size;
+  }
+  return true;
+}
+
+bool OscParser::parseMessage(const uint8_t *data, std::size_t length, OscMessageFn fn,
+                             void *context) {
+  const std::size_t address_size = PaddedStringSize(data, length);
+  if (address_size == 0) {
+    return false;
+  }
+  OscMessage message;
+  message.address_ = reinterpret_cast<const char *>(data);
+  message.end_ = data + length;
+
+  // A message without type tags is allowed by OSC 1.0 and has no arguments.
+  const uint8_t *tags = data + address_size;
+  std::size_t remaining = length - address_size;
+  if (remaining == 0 || tags[0] != ',') {
+    message.tags_ = "";
+    message.arguments_ = message.end_;
+  } else {
+    const std::size_t tags_size = PaddedStringSize(tags, remaining);
+    if (tags_size == 0) {
+      return false;
+    }
+    message.tags_ = reinterpret_cast<const char *>(tags + 1);
+    message.arguments_ = tags + tags_size;
+    remaining -= tags_size;
+
+    // Checks every argument fits, so number() can walk them unchecked.
+    const uint8_t *argument = message.arguments_;
+    std::size_t count = 0;
+    for (const char *tag = message.tags_; *tag != '\0'; ++tag, ++count) {
+      if (*tag == '[' || *tag == ']') {
+        return false;
+      }
+      const std::size_t size = ArgumentSize(*tag, argument, remaining);
+      if (size == SIZE_MAX) {
+        return false;
+      }
+      argument += size;
+      remaining -= size;
+    }
+    if (count > UINT8_MAX) {
+      return false;
+    }
+    message.argument_count_ = static_cast<uint8_t>(count);
+  }
+  stats_.messages++;
+  fn(message, context);
+  return true;
+}
+
+OscParameters::OscParameters(const OscBinding *bindings, OscParameterState *state,
+                             std::size_t count)
+    : bindings_(bindings), state_(state), count_(count), stats_{} {
+  for (std::size_t i = 0; i < count_; ++i) {
+    state_[i] = OscParameterState{};
+  }
+}
+
+bool OscParameters::update(const OscMessage &message) {
+  for (std::size_t i = 0; i < count_; ++i) {
+    if (std::strcmp(bindings_[i].address, message.address()) != 0) {
+      continue;
+    }
+    float value;
+    if (!message.number(0, value)) {
+      break;
+    }
+    stats_.matched++;
+    OscParameterState &state = state_[i];
+    if (bindings_[i].kind == OscBindingKind::kTrigger) {
+      const bool high = value >= 0.5f;
+      if (high && !state.high) {
+        if (state.pending) {
+          stats_.coalesced++;
+        }
+        state.pending = true;
+      }
+      state.high = high;
+      return true;
+    }
+    if (state.pending) {
+      stats_.coalesced++;
+    }
+    state.value = value;
+    state.pending = true;
+    return true;
+  }
+  stats_.unmatched++;
+  return false;
+}
+
+bool OscParameters::flush(DeliverFn fn, void *context) {
+  bool still_pending = false;
+  for (std::size_t i = 0; i < count_; ++i) {
+    OscParameterState &state = state_[i];
+    if (!state.pending) {
+      continue;
+    }
+    const bool trigger = bindings_[i].kind == OscBindingKind::kTrigger;
+    if (!trigger && state.sent_valid && state.sent == state.value) {
+      stats_.unchanged++;
+      state.pending = false;
+      continue;
+    }
+    if (!fn(bindings_[i].id, trigger ? 1.0f : state.value, context)) {
+      stats_.refused++;
+      still_pending = true;
+      continue;
+    }
+    stats_.delivered++;
+    state.pending = false;
+    state.sent = state.value;
+    state.sent_valid = true;
+  }
+  return still_pending;
+}
+
+bool OscParameters::pending() const {
+  for (std::size_t i = 0; i < count_; ++i) {
+    if (state_[i].pending) {
+      return true;
+    }
+  }
+  return false;
+}
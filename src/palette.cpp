@@ -0,0 +1,99 @@
+#include "palette.h"
+
+#include <cstring>
+
+namespace {
+
+using color_tables::ColorTable;
+using color_tables::Pack;
+
+constexpr std::size_t kStopCount = 16;
+
+struct PaletteStops {
+  uint32_t stops[kStopCount];
+};
+
+// Linear blend between stops, the 16 stops spread evenly over 256 entries and
+// the last stop blending back into the first so palettes cycle seamlessly.
+constexpr ColorTable ExpandPalette(const PaletteStops &palette) {
+  ColorTable table{};
+  for (std::size_t i = 0; i < color_tables::kTableSize; ++i) {
+    const uint32_t a = palette.stops[i / kStopCount];
+    const uint32_t b = palette.stops[(i / kStopCount + 1) % kStopCount];
+    const uint32_t frac = (i % kStopCount) * 16;
+    const uint32_t rb = (((a & 0xff00ff) * (256 - frac) + (b & 0xff00ff) * frac) >> 8) & 0xff00ff;
+    const uint32_t g = (((a & 0x00ff00) * (256 - frac) + (b & 0x00ff00) * frac) >> 8) & 0x00ff00;
+    table[i] = rb | g;
+  }
+  return table;
+}
+
+constexpr PaletteStops RainbowStops() {
+  PaletteStops palette{};
+  for (std::size_t i = 0; i < kStopCount; ++i) {
+    palette.stops[i] = color_tables::WheelColor(static_cast<uint8_t>(i * 16));
+  }
+  return palette;
+}
+
+constexpr PaletteStops kOceanStops = {{
+    Pack(0, 0, 40), Pack(0, 0, 90), Pack(0, 20, 140), Pack(0, 60, 180),
+    Pack(0, 100, 200), Pack(0, 140, 210), Pack(20, 180, 220), Pack(60, 210, 230),
+    Pack(120, 230, 240), Pack(60, 210, 230), Pack(20, 180, 220), Pack(0, 140, 210),
+    Pack(0, 100, 200), Pack(0, 60, 180), Pack(0, 20, 140), Pack(0, 0, 90),
+}};
+
+constexpr PaletteStops kLavaStops = {{
+    Pack(0, 0, 0), Pack(40, 0, 0), Pack(90, 0, 0), Pack(140, 0, 0),
+    Pack(190, 10, 0), Pack(230, 40, 0), Pack(255, 80, 0), Pack(255, 130, 0),
+    Pack(255, 180, 20), Pack(255, 220, 80), Pack(255, 255, 160), Pack(255, 180, 20),
+    Pack(255, 110, 0), Pack(220, 40, 0), Pack(150, 0, 0), Pack(70, 0, 0),
+}};
+
+constexpr PaletteStops kForestStops = {{
+    Pack(0, 40, 0), Pack(0, 70, 0), Pack(20, 100, 10), Pack(40, 130, 20),
+    Pack(80, 160, 30), Pack(120, 180, 40), Pack(90, 150, 30), Pack(50, 120, 20),
+    Pack(30, 90, 10), Pack(60, 110, 20), Pack(100, 140, 40), Pack(140, 170, 60),
+    Pack(100, 140, 40), Pack(50, 100, 20), Pack(20, 70, 10), Pack(0, 50, 0),
+}};
+
+constexpr PaletteStops kPartyStops = {{
+    Pack(85, 0, 171), Pack(132, 0, 124), Pack(181, 0, 75), Pack(229, 0, 27),
+    Pack(232, 23, 0), Pack(184, 71, 0), Pack(171, 119, 0), Pack(171, 171, 0),
+    Pack(171, 85, 0), Pack(221, 34, 0), Pack(242, 0, 14), Pack(194, 0, 62),
+    Pack(143, 0, 113), Pack(95, 0, 161), Pack(47, 0, 208), Pack(0, 7, 249),
+}};
+
+constexpr ColorTable kPaletteTables[kPaletteCount] = {
+    ExpandPalette(RainbowStops()), ExpandPalette(kOceanStops), ExpandPalette(kLavaStops),
+    ExpandPalette(kForestStops), ExpandPalette(kPartyStops),
+};
+
+constexpr const char *kPaletteNames[kPaletteCount] = {
+    "rainbow", "ocean", "lava", "forest", "party",
+};
+
+}  // namespace
+
+const color_tables::ColorTable &PaletteTable(PaletteId id) {
+  const std::size_t index = static_cast<std::size_t>(id);
+  return kPaletteTables[index < kPaletteCount ? index : 0];
+}
+
+const char *PaletteName(PaletteId id) {
+  const std::size_t index = static_cast<std::size_t>(id);
+  return kPaletteNames[index < kPaletteCount ? index : 0];
+}
+
+bool FindPalette(const char *name, PaletteId &id) {
+  if (name == nullptr) {
+    return false;
+  }
+  for (std::size_t i = 0; i < kPaletteCount; ++i) {
+    if (std::strcmp(kPaletteNames[i], name) == 0) {
+      id = static_cast<PaletteId>(i);
+      return true;
+    }
+  }
+  return false;
+}
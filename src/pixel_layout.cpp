@@ -0,0 +1,232 @@
+#include "pixel_layout.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace {
+
+constexpr uint8_t kLayoutVersion = 1;
+constexpr uint8_t kMatrixFlags = kMatrixColumnMajor | kMatrixSerpentine;
+constexpr float kTurn = 6.28318530718f;
+constexpr float kAngleSteps = 256.0f;
+constexpr int kPlaneMax = 255;
+
+uint16_t ReadU16(const uint8_t *at) { return static_cast<uint16_t>(at[0] | (at[1] << 8)); }
+
+uint8_t ToPlane(float value) {
+  return static_cast<uint8_t>(std::clamp(std::lround(value), 0L, static_cast<long>(kPlaneMax)));
+}
+
+// A circle of |radius| round |cx|, |cy| stays on the plane.
+bool CircleFits(uint8_t cx, uint8_t cy, uint8_t radius) {
+  return cx >= radius && cy >= radius && cx + radius <= kPlaneMax && cy + radius <= kPlaneMax;
+}
+
+// Pixels a validated segment places.
+uint16_t SegmentPixels(const uint8_t *segment) {
+  if (segment[0] == layout_kind::kMatrix) {
+    return static_cast<uint16_t>(segment[1] * segment[2]);
+  }
+  return ReadU16(segment + 1);
+}
+
+uint32_t SquaredDistance(const PixelPlace &place, uint8_t x, uint8_t y) {
+  const int32_t dx = place.x - x;
+  const int32_t dy = place.y - y;
+  return static_cast<uint32_t>(dx * dx + dy * dy);
+}
+
+// |squared| scaled so that |farthest| is 255.
+uint8_t Normalise(uint32_t squared, uint32_t farthest) {
+  if (farthest == 0) {
+    return 0;
+  }
+  return static_cast<uint8_t>(
+      std::lround(std::sqrt(static_cast<float>(squared) / static_cast<float>(farthest)) * 255.0f));
+}
+
+}  // namespace
+
+bool ValidateLayout(const uint8_t *layout, std::size_t length) {
+  if (layout == nullptr || length < kLayoutHeaderSize + kLayoutSegmentSize ||
+      length > kMaxLayoutBytes) {
+    return false;
+  }
+  if (layout[0] != 'L' || layout[1] != 'Y' || layout[2] != kLayoutVersion || layout[6] != 0 ||
+      layout[7] != 0) {
+    return false;
+  }
+  const uint8_t segments = layout[3];
+  if (segments == 0 || length != kLayoutHeaderSize + segments * kLayoutSegmentSize) {
+    return false;
+  }
+
+  bool matrix = false;
+  for (uint8_t s = 0; s < segments; ++s) {
+    const uint8_t *segment = layout + kLayoutHeaderSize + s * kLayoutSegmentSize;
+    switch (segment[0]) {
+      case layout_kind::kLine:
+        if (ReadU16(segment + 1) == 0 || segment[7] != 0) {
+          return false;
+        }
+        break;
+      case layout_kind::kRing:
+        if (segment[7] != 0) {
+          return false;
+        }
+        [[fallthrough]];  // A ring is an arc with no sweep operand.
+      case layout_kind::kArc:
+        if (ReadU16(segment + 1) == 0 || !CircleFits(segment[3], segment[4], segment[5])) {
+          return false;
+        }
+        break;
+      case layout_kind::kMatrix: {
+        const uint8_t columns = segment[1];
+        const uint8_t rows = segment[2];
+        const uint8_t pitch = segment[5];
+        if (matrix || columns == 0 || rows == 0 || (segment[6] & ~kMatrixFlags) != 0 ||
+            segment[7] != 0 || segment[3] + (columns - 1) * pitch > kPlaneMax ||
+            segment[4] + (rows - 1) * pitch > kPlaneMax) {
+          return false;
+        }
+        matrix = true;
+        break;
+      }
+      default:
+        return false;
+    }
+  }
+  return true;
+}
+
+std::size_t LoadLayout(Preferences &preferences, const char *key, uint8_t *buffer,
+                       std::size_t capacity) {
+  const std::size_t length = preferences.getBytesLength(key);
+  if (length == 0 || length > capacity) {
+    return 0;
+  }
+  if (preferences.getBytes(key, buffer, length) != length) {
+    return 0;
+  }
+  return ValidateLayout(buffer, length) ? length : 0;
+}
+
+PixelLayout::PixelLayout(PixelPlace *places, uint16_t *grid, std::size_t num_pixels)
+    : places_(places),
+      grid_(grid),
+      capacity_(num_pixels),
+      count_(0),
+      columns_(0),
+      rows_(0) {}
+
+bool PixelLayout::load(const uint8_t *layout, std::size_t length) {
+  if (!ValidateLayout(layout, length)) {
+    return false;
+  }
+  const uint8_t segments = layout[3];
+  std::size_t total = 0;
+  for (uint8_t s = 0; s < segments; ++s) {
+    total += SegmentPixels(layout + kLayoutHeaderSize + s * kLayoutSegmentSize);
+  }
+  if (total > capacity_) {
+    return false;
+  }
+
+  columns_ = 0;
+  rows_ = 0;
+  uint16_t placed = 0;
+  for (uint8_t s = 0; s < segments; ++s) {
+    placed += placeSegment(layout + kLayoutHeaderSize + s * kLayoutSegmentSize, placed);
+  }
+  count_ = placed;
+
+  // The polar tables, round the layout's centre.
+  const uint8_t cx = layout[4];
+  const uint8_t cy = layout[5];
+  uint32_t farthest = 0;
+  for (uint16_t i = 0; i < count_; ++i) {
+    farthest = std::max(farthest, SquaredDistance(places_[i], cx, cy));
+  }
+  for (uint16_t i = 0; i < count_; ++i) {
+    PixelPlace &place = places_[i];
+    const float turns =
+        std::atan2(static_cast<float>(place.y - cy), static_cast<float>(place.x - cx)) / kTurn;
+    place.angle = static_cast<uint8_t>(std::lround(turns * kAngleSteps) & 0xff);
+    place.radius = Normalise(SquaredDistance(place, cx, cy), farthest);
+  }
+  return true;
+}
+
+uint16_t PixelLayout::placeSegment(const uint8_t *segment, uint16_t first) {
+  PixelPlace *out = places_ + first;
+  switch (segment[0]) {
+    case layout_kind::kLine: {
+      const uint16_t count = ReadU16(segment + 1);
+      const float x0 = segment[3];
+      const float y0 = segment[4];
+      const float span = count > 1 ? static_cast<float>(count - 1) : 1.0f;
+      for (uint16_t i = 0; i < count; ++i) {
+        out[i].x = ToPlane(x0 + (segment[5] - x0) * i / span);
+        out[i].y = ToPlane(y0 + (segment[6] - y0) * i / span);
+      }
+      return count;
+    }
+    case layout_kind::kRing:
+    case layout_kind::kArc: {
+      const uint16_t count = ReadU16(segment + 1);
+      const float radius = segment[5];
+      // A ring spreads its pixels over the whole turn; an arc ends on its
+      // last pixel.
+      const float step = segment[0] == layout_kind::kRing
+                             ? kAngleSteps / count
+                             : (count > 1 ? static_cast<float>(segment[7]) / (count - 1) : 0.0f);
+      for (uint16_t i = 0; i < count; ++i) {
+        const float angle = (segment[6] + step * i) * kTurn / kAngleSteps;
+        out[i].x = ToPlane(segment[3] + radius * std::cos(angle));
+        out[i].y = ToPlane(segment[4] + radius * std::sin(angle));
+      }
+      return count;
+    }
+    case layout_kind::kMatrix: {
+      columns_ = segment[1];
+      rows_ = segment[2];
+      const uint8_t flags = segment[6];
+      const bool column_major = flags & kMatrixColumnMajor;
+      // Pixels per wired row, or per column wired down the matrix.
+      const uint16_t run = column_major ? rows_ : columns_;
+      const uint16_t count = static_cast<uint16_t>(columns_ * rows_);
+      for (uint16_t i = 0; i < count; ++i) {
+        const uint16_t line = i / run;
+        uint16_t along = i % run;
+        if ((flags & kMatrixSerpentine) && (line & 1)) {
+          along = static_cast<uint16_t>(run - 1 - along);
+        }
+        const uint16_t column = column_major ? line : along;
+        const uint16_t row = column_major ? along : line;
+        out[i].x = static_cast<uint8_t>(segment[3] + column * segment[5]);
+        out[i].y = static_cast<uint8_t>(segment[4] + row * segment[5]);
+        grid_[row * columns_ + column] = static_cast<uint16_t>(first + i);
+      }
+      return count;
+    }
+    default:
+      return 0;
+  }
+}
+
+uint16_t PixelLayout::pixelAt(uint8_t column, uint8_t row) const {
+  if (column >= columns_ || row >= rows_) {
+    return kNoPixel;
+  }
+  return grid_[row * columns_ + column];
+}
+
+void PixelLayout::distanceFrom(uint8_t x, uint8_t y, uint8_t *distances) const {
+  uint32_t farthest = 0;
+  for (uint16_t i = 0; i < count_; ++i) {
+    farthest = std::max(farthest, SquaredDistance(places_[i], x, y));
+  }
+  for (uint16_t i = 0; i < count_; ++i) {
+    distances[i] = Normalise(SquaredDistance(places_[i], x, y), farthest);
+  }
+}
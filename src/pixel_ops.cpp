@@ -0,0 +1,38 @@
+#include "pixel_ops.h"
+
+namespace pixel_ops {
+
+void Blend(uint32_t *dst, const uint32_t *a, const uint32_t *b, std::size_t count,
+           uint16_t weight) {
+  Mix(dst, a, static_cast<uint16_t>(kFullWeight - weight), b, weight, count);
+}
+
+void Mix(uint32_t *dst, const uint32_t *a, uint16_t weight_a, const uint32_t *b,
+         uint16_t weight_b, std::size_t count) {
+  for (std::size_t i = 0; i < count; ++i) {
+    dst[i] = MixPixel(a[i], weight_a, b[i], weight_b);
+  }
+}
+
+void Scale(uint32_t *pixels, std::size_t count, uint16_t weight) {
+  if (weight >= kFullWeight) {
+    return;
+  }
+  for (std::size_t i = 0; i < count; ++i) {
+    pixels[i] = ScalePixel(pixels[i], weight);
+  }
+}
+
+void Add(uint32_t *dst, const uint32_t *src, std::size_t count) {
+  for (std::size_t i = 0; i < count; ++i) {
+    dst[i] = AddPixel(dst[i], src[i]);
+  }
+}
+
+void Max(uint32_t *dst, const uint32_t *src, std::size_t count) {
+  for (std::size_t i = 0; i < count; ++i) {
+    dst[i] = MaxPixel(dst[i], src[i]);
+  }
+}
+
+}  // namespace pixel_ops
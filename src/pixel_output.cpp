@@ -0,0 +1,274 @@
+#include "pixel_output.h"
+
+#include <algorithm>
+#include <cstring>
+#include <utility>
+
+#include "instrumentation.h"
+
+namespace {
+constexpr uint8_t kDefaultBrightness = 255;
+constexpr uint8_t kFullIntensity = 255;
+// Block size for the change scans; memcmp compares a block far faster than
+// a byte loop.
+constexpr std::size_t kScanBlock = 64;
+
+// Offset of the first byte that differs between |a| and |b|, or |length|.
+std::size_t FirstDifference(const uint8_t *a, const uint8_t *b, std::size_t length) {
+  std::size_t offset = 0;
+  while (offset + kScanBlock <= length && std::memcmp(a + offset, b + offset, kScanBlock) == 0) {
+    offset += kScanBlock;
+  }
+  while (offset < length && a[offset] == b[offset]) {
+    offset++;
+  }
+  return offset;
+}
+
+// Fraction bits that are dithered. A fraction of 1/2^n repeats every 2^n
+// frames, so finer ones would blink slowly enough to see; three bits keep
+// the slowest pattern at 8 frames. The bits below them are dropped.
+constexpr uint32_t kDitherFractionBits = 3;
+constexpr uint32_t kDitherDropMask = (0x100u >> kDitherFractionBits) - 1;
+
+// Channel |value|, 8.8 fixed point, quantised to 8 bits; the fraction
+// dropped is kept in |residual| and added back in the next frame.
+inline uint8_t Quantize(uint32_t value, uint8_t &residual) {
+  const uint32_t sum = (value & ~kDitherDropMask) + residual;
+  residual = static_cast<uint8_t>(sum);
+  return static_cast<uint8_t>(sum >> 8);
+}
+
+// Odd step between the starting residuals of successive channels, about
+// 0.61 of 256, so neighbouring pixels of the same colour step up on
+// different frames instead of all at once.
+constexpr uint8_t kDitherSeedStep = 157;
+
+// Channel totals of a frame.
+struct ChannelSums {
+  uint32_t red;
+  uint32_t green;
+  uint32_t blue;
+};
+
+// Pixels summed before the packed lanes are folded into the totals: red and
+// blue share one accumulator at 16 bits each, which holds 257 pixels at 255.
+constexpr uint16_t kSumBlock = 256;
+
+// Sums each channel of |count| packed pixels: two masks and two adds a
+// pixel, red and blue added together in one 32-bit word.
+ChannelSums SumChannels(const uint32_t *frame, uint16_t count) {
+  ChannelSums sums{0, 0, 0};
+  for (uint16_t first = 0; first < count;) {
+    const uint16_t end = static_cast<uint16_t>(std::min<uint32_t>(count, first + kSumBlock));
+    uint32_t red_blue = 0;
+    uint32_t green = 0;
+    for (uint16_t i = first; i < end; ++i) {
+      red_blue += frame[i] & 0x00ff00ff;
+      green += frame[i] & 0x0000ff00;
+    }
+    sums.red += red_blue >> 16;
+    sums.green += green >> 8;
+    sums.blue += red_blue & 0xffff;
+    first = end;
+  }
+  return sums;
+}
+
+constexpr uint64_t kUaPerMa = 1000;
+// A channel sum times its model mA, times the scale, per mA drawn: a
+// channel at 255 on the full scale draws its model figure.
+constexpr uint64_t kFullScaleWeight = 255ull << 16;
+// Power limiter knee, as a fraction of the budget left after the idle draw.
+constexpr uint64_t kKneeNumerator = 3;
+constexpr uint64_t kKneeDenominator = 4;
+
+// One past the offset of the last byte that differs; |a| and |b| must
+// differ somewhere.
+std::size_t LastDifferenceEnd(const uint8_t *a, const uint8_t *b, std::size_t length) {
+  std::size_t end = length;
+  while (end >= kScanBlock &&
+         std::memcmp(a + end - kScanBlock, b + end - kScanBlock, kScanBlock) == 0) {
+    end -= kScanBlock;
+  }
+  while (a[end - 1] == b[end - 1]) {
+    end--;
+  }
+  return end;
+}
+}  // namespace
+
+PixelOutput::PixelOutput(StripTransmitter &transmitter, neoPixelType type, uint32_t *frame,
+                         uint8_t *wire, std::size_t num_pixels, uint8_t *dither)
+    : transmitter_(transmitter),
+      frame_(frame),
+      front_(wire),
+      back_(wire + kBytesPerPixel * num_pixels),
+      dither_(dither),
+      num_pixels_(static_cast<uint16_t>(std::min<std::size_t>(num_pixels, UINT16_MAX))),
+      r_offset_((type >> 4) & 0b11),
+      g_offset_((type >> 2) & 0b11),
+      b_offset_(type & 0b11),
+      brightness_(kDefaultBrightness),
+      intensity_(kFullIntensity),
+      valid_(false),
+      dithering_(false),
+      power_{},
+      wanted_ma_(0),
+      drawn_ma_(0),
+      dirty_first_(0),
+      dirty_count_(0),
+      stats_{} {
+  std::fill(frame_, frame_ + num_pixels_, 0);
+  std::fill(wire, wire + WireBytes(num_pixels_), 0);
+  seedDither();
+}
+
+void PixelOutput::begin() {
+  transmitter_.begin();
+  seedDither();
+  invalidate();
+  commit();
+}
+
+bool PixelOutput::commit() {
+  // (c * (brightness + 1) * (intensity + 1)) >> 16 reproduces
+  // Adafruit_NeoPixel's (c * (brightness + 1)) >> 8 at full intensity.
+  const uint32_t requested =
+      (static_cast<uint32_t>(brightness_) + 1) * (static_cast<uint32_t>(intensity_) + 1);
+  const std::size_t bytes = num_pixels_ * kBytesPerPixel;
+  uint32_t scale;
+  bool dither;
+  int first = -1;
+  int last = -1;
+
+  {
+    INSTRUMENT_STAGE(kEncode);
+    // The power estimate is timed as part of the encode.
+    scale = limitPower(requested);
+    dither = dither_ != nullptr && scale < kDitherScaleLimit;
+    // The back half holds a stale frame, so every pixel is written; the
+    // front half is only read, which is safe while it is being sent.
+    uint8_t *p = back_;
+    if (dither) {
+      // Each channel as c * scale / 256, 8 fractional bits, with the
+      // fraction carried per channel; |fraction| notes whether any was left.
+      uint8_t *residual = dither_;
+      uint32_t fraction = 0;
+      for (uint16_t i = 0; i < num_pixels_; i++, p += kBytesPerPixel, residual += kBytesPerPixel) {
+        const uint32_t color = frame_[i];
+        const uint32_t r = (((color >> 16) & 0xff) * scale) >> 8;
+        const uint32_t g = (((color >> 8) & 0xff) * scale) >> 8;
+        const uint32_t b = ((color & 0xff) * scale) >> 8;
+        fraction |= r | g | b;
+        p[r_offset_] = Quantize(r, residual[0]);
+        p[g_offset_] = Quantize(g, residual[1]);
+        p[b_offset_] = Quantize(b, residual[2]);
+      }
+      dithering_ = (fraction & 0xff & ~kDitherDropMask) != 0;
+    } else {
+      for (uint16_t i = 0; i < num_pixels_; i++, p += kBytesPerPixel) {
+        const uint32_t color = frame_[i];
+        p[r_offset_] = static_cast<uint8_t>((((color >> 16) & 0xff) * scale) >> 16);
+        p[g_offset_] = static_cast<uint8_t>((((color >> 8) & 0xff) * scale) >> 16);
+        p[b_offset_] = static_cast<uint8_t>(((color & 0xff) * scale) >> 16);
+      }
+      dithering_ = false;
+    }
+    // Then the changed range, scanned in blocks from either end rather
+    // than compared pixel by pixel inside the encode loop.
+    const std::size_t head = FirstDifference(back_, front_, bytes);
+    if (head != bytes) {
+      first = static_cast<int>(head / kBytesPerPixel);
+      last = static_cast<int>((LastDifferenceEnd(back_, front_, bytes) - 1) / kBytesPerPixel);
+    }
+  }
+
+  if (first < 0) {
+    if (valid_) {
+      stats_.frames_skipped++;
+      return false;
+    }
+    first = 0;
+    last = num_pixels_ - 1;
+  }
+  dirty_first_ = static_cast<uint16_t>(first);
+  dirty_count_ = static_cast<uint16_t>(last - first + 1);
+  valid_ = true;
+  {
+    INSTRUMENT_STAGE(kTransmit);
+    if (transmitter_.busy()) {
+      stats_.transmit_waits++;
+      transmitter_.wait();
+    }
+    transmitter_.transmit(back_, bytes);
+  }
+  std::swap(front_, back_);
+  stats_.frames_sent++;
+  if (dither) {
+    stats_.frames_dithered++;
+  }
+  if (power_.budget_ma != 0) {
+    const bool limited = scale < requested;
+    if (limited) {
+      stats_.frames_limited++;
+    }
+    INSTRUMENT_POWER(wanted_ma_, drawn_ma_, limited);
+  }
+  return true;
+}
+
+uint32_t PixelOutput::limitPower(uint32_t scale) {
+  if (power_.budget_ma == 0) {
+    wanted_ma_ = 0;
+    drawn_ma_ = 0;
+    return scale;
+  }
+  const ChannelSums sums = SumChannels(frame_, num_pixels_);
+  const uint64_t weighted = static_cast<uint64_t>(sums.red) * power_.red_ma +
+                            static_cast<uint64_t>(sums.green) * power_.green_ma +
+                            static_cast<uint64_t>(sums.blue) * power_.blue_ma;
+  const uint64_t idle_ua = static_cast<uint64_t>(num_pixels_) * power_.idle_ua;
+  const uint64_t lit_ua = weighted * scale * kUaPerMa / kFullScaleWeight;
+  const uint64_t budget_ua = power_.budget_ma * kUaPerMa;
+  const uint64_t available_ua = budget_ua > idle_ua ? budget_ua - idle_ua : 0;
+  const uint64_t knee_ua = available_ua * kKneeNumerator / kKneeDenominator;
+
+  uint64_t drawn_ua = lit_ua;
+  if (lit_ua > knee_ua) {
+    // Past the knee the excess is compressed into the room left below the
+    // budget: over * room / (room + over) rises with slope 1 at the knee
+    // and tends to |room|, so the limit is smooth and never reached.
+    const uint64_t room = available_ua - knee_ua;
+    const uint64_t over = lit_ua - knee_ua;
+    drawn_ua = knee_ua + over * room / (room + over);
+    scale = static_cast<uint32_t>(scale * drawn_ua / lit_ua);
+  }
+  wanted_ma_ = static_cast<uint32_t>((idle_ua + lit_ua) / kUaPerMa);
+  drawn_ma_ = static_cast<uint32_t>((idle_ua + drawn_ua) / kUaPerMa);
+  return scale;
+}
+
+void PixelOutput::invalidate() { valid_ = false; }
+
+void PixelOutput::seedDither() {
+  if (dither_ == nullptr) {
+    return;
+  }
+  for (std::size_t i = 0; i < DitherBytes(num_pixels_); ++i) {
+    dither_[i] = static_cast<uint8_t>(i * kDitherSeedStep);
+  }
+  dithering_ = false;
+}
+
+void PixelOutput::fill(uint32_t color, uint16_t first, uint16_t count) {
+  if (first >= num_pixels_) {
+    return;
+  }
+  const uint16_t end = (count == 0 || first + count > num_pixels_)
+                           ? num_pixels_
+                           : static_cast<uint16_t>(first + count);
+  std::fill(frame_ + first, frame_ + end, color);
+}
+
+void PixelOutput::resetStats() { stats_ = Stats{}; }
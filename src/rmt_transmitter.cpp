@@ -0,0 +1,98 @@
+#include "rmt_transmitter.h"
+
+#include <Arduino.h>
+
+namespace {
+
+// 80 MHz APB clock divided by 2: 25 ns per RMT tick.
+constexpr uint8_t kClockDivider = 2;
+constexpr uint16_t kZeroHighTicks = 16;  // 0.40 us
+constexpr uint16_t kZeroLowTicks = 34;   // 0.85 us
+constexpr uint16_t kOneHighTicks = 32;   // 0.80 us
+constexpr uint16_t kOneLowTicks = 18;    // 0.45 us
+constexpr unsigned long kNsPerByte = 8 * 1250;
+// Low time that latches a frame; WS2812B-V5 parts need 280 us.
+constexpr unsigned long kLatchUs = 300;
+
+rmt_item32_t Pulse(uint16_t high_ticks, uint16_t low_ticks) {
+  rmt_item32_t item{};
+  item.duration0 = high_ticks;
+  item.level0 = 1;
+  item.duration1 = low_ticks;
+  item.level1 = 0;
+  return item;
+}
+
+// Called by the driver, from its interrupt, whenever the RMT memory needs
+// refilling: converts whole bytes, MSB first, until |wanted_num| items.
+void IRAM_ATTR TranslateBytes(const void *src, rmt_item32_t *dest, size_t src_size,
+                              size_t wanted_num, size_t *translated_size, size_t *item_num) {
+  if (src == nullptr || dest == nullptr) {
+    *translated_size = 0;
+    *item_num = 0;
+    return;
+  }
+  const uint32_t zero = Pulse(kZeroHighTicks, kZeroLowTicks).val;
+  const uint32_t one = Pulse(kOneHighTicks, kOneLowTicks).val;
+  const uint8_t *bytes = static_cast<const uint8_t *>(src);
+  size_t size = 0;
+  size_t num = 0;
+  while (size < src_size && num + 8 <= wanted_num) {
+    const uint8_t byte = bytes[size];
+    for (int bit = 7; bit >= 0; --bit) {
+      dest[num++].val = ((byte >> bit) & 1) ? one : zero;
+    }
+    size++;
+  }
+  *translated_size = size;
+  *item_num = num;
+}
+
+}  // namespace
+
+RmtTransmitter::RmtTransmitter(uint8_t pin, rmt_channel_t channel)
+    : pin_(pin), channel_(channel), sending_(false), start_us_(0), done_after_us_(0) {}
+
+void RmtTransmitter::begin() {
+  rmt_config_t config{};
+  config.rmt_mode = RMT_MODE_TX;
+  config.channel = channel_;
+  config.gpio_num = static_cast<gpio_num_t>(pin_);
+  config.clk_div = kClockDivider;
+  config.mem_block_num = 1;
+  config.tx_config.idle_level = RMT_IDLE_LEVEL_LOW;
+  config.tx_config.idle_output_en = true;
+  rmt_config(&config);
+  rmt_driver_install(channel_, 0, 0);
+  rmt_translator_init(channel_, TranslateBytes);
+}
+
+void RmtTransmitter::transmit(const uint8_t *data, std::size_t length) {
+  start_us_ = micros();
+  done_after_us_ = length * kNsPerByte / 1000 + kLatchUs;
+  sending_ = true;
+  rmt_write_sample(channel_, data, length, false);
+}
+
+bool RmtTransmitter::busy() {
+  if (!sending_) {
+    return false;
+  }
+  if (rmt_wait_tx_done(channel_, 0) != ESP_OK || micros() - start_us_ < done_after_us_) {
+    return true;
+  }
+  sending_ = false;
+  return false;
+}
+
+void RmtTransmitter::wait() {
+  if (!sending_) {
+    return;
+  }
+  rmt_wait_tx_done(channel_, portMAX_DELAY);
+  const unsigned long elapsed = micros() - start_us_;
+  if (elapsed < done_after_us_) {
+    delayMicroseconds(done_after_us_ - elapsed);
+  }
+  sending_ = false;
+}
@@ -0,0 +1,98 @@
+#include "segmented_transmitter.h"
+
+#include <algorithm>
+#include <cstring>
+
+namespace {
+constexpr std::size_t kBytesPerPixel = 3;
+}  // namespace
+
+SegmentedTransmitter::SegmentedTransmitter(const StripChannel *channels, uint8_t channel_count,
+                                           const StripSegment *segments, uint8_t segment_count)
+    : channels_(channels),
+      channel_count_(std::min(channel_count, kMaxChannels)),
+      segments_(segments),
+      segment_count_(segment_count),
+      direct_{} {
+  for (uint8_t c = 0; c < channel_count_; ++c) {
+    if (channels_[c].staging != nullptr) {
+      continue;
+    }
+    for (uint8_t s = 0; s < segment_count_; ++s) {
+      const StripSegment &segment = segments_[s];
+      if (segment.channel == c && !segment.reversed && segment.offset == 0 &&
+          segment.count == channels_[c].pixels) {
+        direct_[c] = &segment;
+      }
+    }
+  }
+}
+
+void SegmentedTransmitter::begin() {
+  for (uint8_t c = 0; c < channel_count_; ++c) {
+    if (channels_[c].staging != nullptr) {
+      std::memset(channels_[c].staging, 0, kBytesPerPixel * channels_[c].pixels);
+    }
+    channels_[c].transmitter->begin();
+  }
+}
+
+void SegmentedTransmitter::transmit(const uint8_t *data, std::size_t length) {
+  const std::size_t frame_pixels = length / kBytesPerPixel;
+  for (uint8_t s = 0; s < segment_count_; ++s) {
+    const StripSegment &segment = segments_[s];
+    if (segment.channel >= channel_count_ || channels_[segment.channel].staging == nullptr ||
+        segment.first >= frame_pixels || segment.offset >= channels_[segment.channel].pixels) {
+      continue;
+    }
+    const StripChannel &channel = channels_[segment.channel];
+    const std::size_t count = std::min<std::size_t>(
+        {segment.count, frame_pixels - segment.first,
+         static_cast<std::size_t>(channel.pixels - segment.offset)});
+    const uint8_t *source = data + kBytesPerPixel * segment.first;
+    uint8_t *target = channel.staging + kBytesPerPixel * segment.offset;
+    if (!segment.reversed) {
+      std::memcpy(target, source, kBytesPerPixel * count);
+      continue;
+    }
+    // Reversed: the channel's first pixel is the segment's last.
+    const uint8_t *from = source + kBytesPerPixel * count;
+    for (std::size_t i = 0; i < count; ++i) {
+      from -= kBytesPerPixel;
+      target[0] = from[0];
+      target[1] = from[1];
+      target[2] = from[2];
+      target += kBytesPerPixel;
+    }
+  }
+
+  for (uint8_t c = 0; c < channel_count_; ++c) {
+    const StripChannel &channel = channels_[c];
+    if (direct_[c] != nullptr) {
+      const StripSegment &segment = *direct_[c];
+      if (segment.first < frame_pixels) {
+        const std::size_t count =
+            std::min<std::size_t>(segment.count, frame_pixels - segment.first);
+        channel.transmitter->transmit(data + kBytesPerPixel * segment.first,
+                                      kBytesPerPixel * count);
+      }
+    } else if (channel.staging != nullptr) {
+      channel.transmitter->transmit(channel.staging, kBytesPerPixel * channel.pixels);
+    }
+  }
+}
+
+bool SegmentedTransmitter::busy() {
+  for (uint8_t c = 0; c < channel_count_; ++c) {
+    if (channels_[c].transmitter->busy()) {
+      return true;
+    }
+  }
+  return false;
+}
+
+void SegmentedTransmitter::wait() {
+  for (uint8_t c = 0; c < channel_count_; ++c) {
+    channels_[c].transmitter->wait();
+  }
+}
@@ -0,0 +1,298 @@
+#include "sequence.h"
+
+#include "color_tables.h"
+
+namespace {
+
+constexpr uint8_t kSequenceVersion = 1;
+constexpr uint8_t kLastOpcode = sequence_op::kFlags;
+constexpr uint8_t kFullLevel = 255;
+constexpr unsigned long kFadeFrameMs = 10;
+// Delay handed back when update() ran out of instruction budget, so a
+// program that never waits cannot monopolise the render task.
+constexpr uint32_t kBudgetYieldMs = 1;
+
+// Operand bytes following each opcode, indexed by opcode.
+constexpr uint8_t kOperandBytes[kLastOpcode + 1] = {
+    0,  // kEnd
+    1,  // kEffect
+    3,  // kColor
+    2,  // kSpeed
+    1,  // kBrightness
+    3,  // kFade
+    2,  // kWait
+    2,  // kWaitDone
+    1,  // kLoop
+    0,  // kEndLoop
+    2,  // kJump
+    1,  // kFlags
+};
+
+uint16_t ReadU16(const uint8_t *at) { return static_cast<uint16_t>(at[0] | (at[1] << 8)); }
+
+}  // namespace
+
+bool ValidateSequence(const uint8_t *sequence, std::size_t length) {
+  if (sequence == nullptr || length <= kSequenceHeaderSize || length > kMaxSequenceBytes) {
+    return false;
+  }
+  if (sequence[0] != 'L' || sequence[1] != 'S' || sequence[2] != kSequenceVersion) {
+    return false;
+  }
+  const uint8_t *program = sequence + kSequenceHeaderSize;
+  const std::size_t size = length - kSequenceHeaderSize;
+
+  // Instruction starts outside any loop: the only legal jump targets.
+  uint8_t jump_targets[kMaxSequenceBytes / 8] = {};
+  uint8_t depth = 0;
+  for (std::size_t pc = 0; pc < size;) {
+    const uint8_t op = program[pc];
+    if (op > kLastOpcode || pc + 1 + kOperandBytes[op] > size) {
+      return false;
+    }
+    if (depth == 0) {
+      jump_targets[pc / 8] |= static_cast<uint8_t>(1 << (pc % 8));
+    }
+    switch (op) {
+      case sequence_op::kEffect:
+        if (program[pc + 1] >= static_cast<uint8_t>(EffectId::kCount)) {
+          return false;
+        }
+        break;
+      case sequence_op::kLoop:
+        if (program[pc + 1] == 0 || ++depth > kMaxSequenceLoopDepth) {
+          return false;
+        }
+        break;
+      case sequence_op::kEndLoop:
+        if (depth == 0) {
+          return false;
+        }
+        --depth;
+        break;
+      case sequence_op::kJump:
+        if (depth != 0) {
+          return false;
+        }
+        break;
+      default:
+        break;
+    }
+    pc += 1 + kOperandBytes[op];
+  }
+  if (depth != 0) {
+    return false;
+  }
+
+  for (std::size_t pc = 0; pc < size; pc += 1 + kOperandBytes[program[pc]]) {
+    if (program[pc] != sequence_op::kJump) {
+      continue;
+    }
+    const uint16_t target = ReadU16(program + pc + 1);
+    if (target >= size || !(jump_targets[target / 8] & (1 << (target % 8)))) {
+      return false;
+    }
+  }
+  return true;
+}
+
+std::size_t LoadSequence(Preferences &preferences, const char *key, uint8_t *buffer,
+                         std::size_t capacity) {
+  const std::size_t length = preferences.getBytesLength(key);
+  if (length == 0 || length > capacity) {
+    return 0;
+  }
+  if (preferences.getBytes(key, buffer, length) != length) {
+    return 0;
+  }
+  return ValidateSequence(buffer, length) ? length : 0;
+}
+
+SequencePlayer::SequencePlayer(EffectEngine &engine)
+    : engine_(engine),
+      program_(nullptr),
+      length_(0),
+      pc_(0),
+      running_(false),
+      params_{},
+      block_(Block::kNone),
+      block_start_(0),
+      block_ms_(0),
+      default_hold_ms_(0),
+      loops_{},
+      loop_depth_(0),
+      fading_(false),
+      fade_from_(0),
+      fade_to_(0),
+      fade_start_(0),
+      fade_ms_(0),
+      stats_{} {}
+
+bool SequencePlayer::load(const uint8_t *sequence, std::size_t length) {
+  if (!ValidateSequence(sequence, length)) {
+    return false;
+  }
+  program_ = sequence + kSequenceHeaderSize;
+  length_ = static_cast<uint16_t>(length - kSequenceHeaderSize);
+  running_ = false;
+  return true;
+}
+
+void SequencePlayer::start(unsigned long now_ms) {
+  pc_ = 0;
+  running_ = program_ != nullptr;
+  params_ = EffectParams{};
+  params_.level = kFullLevel;
+  block_ = Block::kNone;
+  block_start_ = now_ms;
+  loop_depth_ = 0;
+  fading_ = false;
+}
+
+uint32_t SequencePlayer::update(unsigned long now_ms) {
+  updateFade(now_ms);
+  if (!running_) {
+    return nextDelayMs(now_ms);
+  }
+  stats_.updates++;
+
+  uint8_t executed = 0;
+  while (running_) {
+    // block_start_ is the sequence's own clock: the time the current wait
+    // began, which is when the previous one ended.
+    if (block_ != Block::kNone) {
+      const unsigned long elapsed = now_ms - block_start_;
+      if (elapsed >= block_ms_) {
+        // Chain the next wait from this one's deadline rather than from a
+        // late update(), so a show keeps its overall tempo.
+        block_start_ += block_ms_;
+      } else if (block_ == Block::kWaitDone && engine_.complete()) {
+        block_start_ = now_ms;
+      } else {
+        break;
+      }
+      block_ = Block::kNone;
+    }
+    if (executed == kMaxStepsPerUpdate) {
+      break;
+    }
+    executed++;
+    if (!step(now_ms)) {
+      break;
+    }
+  }
+
+  stats_.instructions += executed;
+  if (executed > stats_.max_instructions_per_update) {
+    stats_.max_instructions_per_update = executed;
+  }
+  if (running_ && block_ == Block::kNone) {
+    return kBudgetYieldMs;
+  }
+  return nextDelayMs(now_ms);
+}
+
+uint32_t SequencePlayer::nextDelayMs(unsigned long now_ms) const {
+  if (!running_) {
+    return fading_ ? kFadeFrameMs : kNoDeadline;
+  }
+  if (block_ == Block::kNone) {
+    return kBudgetYieldMs;
+  }
+  if (block_ == Block::kWaitDone && engine_.complete()) {
+    return 0;
+  }
+  const unsigned long elapsed = now_ms - block_start_;
+  uint32_t delay_ms = elapsed >= block_ms_ ? 0 : static_cast<uint32_t>(block_ms_ - elapsed);
+  if (fading_ && delay_ms > kFadeFrameMs) {
+    delay_ms = kFadeFrameMs;
+  }
+  return delay_ms;
+}
+
+bool SequencePlayer::step(unsigned long now_ms) {
+  if (pc_ >= length_) {
+    running_ = false;
+    return false;
+  }
+  const uint8_t op = program_[pc_];
+  const uint16_t at = static_cast<uint16_t>(pc_ + 1);
+  pc_ = static_cast<uint16_t>(at + kOperandBytes[op]);
+
+  switch (op) {
+    case sequence_op::kEnd:
+      running_ = false;
+      return false;
+    case sequence_op::kEffect:
+      engine_.start(static_cast<EffectId>(program_[at]), params_);
+      break;
+    case sequence_op::kColor:
+      params_.color = color_tables::Pack(program_[at], program_[at + 1], program_[at + 2]);
+      break;
+    case sequence_op::kSpeed:
+      params_.step_ms = ReadU16(program_ + at);
+      break;
+    case sequence_op::kBrightness:
+      fading_ = false;
+      engine_.output().setBrightness(program_[at]);
+      engine_.output().commit();
+      break;
+    case sequence_op::kFade:
+      fading_ = true;
+      fade_from_ = engine_.output().brightness();
+      fade_to_ = program_[at];
+      fade_start_ = now_ms;
+      fade_ms_ = ReadU16(program_ + at + 1);
+      updateFade(now_ms);
+      break;
+    case sequence_op::kWait:
+      block_ = Block::kWait;
+      block_ms_ = ReadU16(program_ + at);
+      return false;
+    case sequence_op::kWaitDone: {
+      const uint16_t timeout_ms = ReadU16(program_ + at);
+      block_ = Block::kWaitDone;
+      block_ms_ = timeout_ms ? timeout_ms : default_hold_ms_;
+      return false;
+    }
+    case sequence_op::kLoop:
+      loops_[loop_depth_++] = LoopFrame{pc_, program_[at]};
+      break;
+    case sequence_op::kEndLoop: {
+      LoopFrame &loop = loops_[loop_depth_ - 1];
+      if (--loop.remaining > 0) {
+        pc_ = loop.start;
+      } else {
+        loop_depth_--;
+      }
+      break;
+    }
+    case sequence_op::kJump:
+      pc_ = ReadU16(program_ + at);
+      break;
+    case sequence_op::kFlags:
+      params_.flags = program_[at];
+      break;
+    default:
+      break;
+  }
+  return true;
+}
+
+void SequencePlayer::updateFade(unsigned long now_ms) {
+  if (!fading_) {
+    return;
+  }
+  const unsigned long elapsed = now_ms - fade_start_;
+  int level = fade_to_;
+  if (elapsed < fade_ms_) {
+    level = fade_from_ + (static_cast<int>(fade_to_) - fade_from_) * static_cast<long>(elapsed) /
+                             static_cast<long>(fade_ms_);
+  } else {
+    fading_ = false;
+  }
+  if (engine_.output().brightness() != level) {
+    engine_.output().setBrightness(static_cast<uint8_t>(level));
+    engine_.output().commit();
+  }
+}
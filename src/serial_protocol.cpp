@@ -0,0 +1,122 @@
+#include "serial_protocol.h"
+
+#include <algorithm>
+#include <cstring>
+
+#include "crc16.h"
+
+static_assert((ProtocolParser::kRingSize & (ProtocolParser::kRingSize - 1)) == 0,
+              "the ring is indexed by masking");
+static_assert(kMaxFrameSize <= ProtocolParser::kRingSize, "a frame must fit in the ring");
+
+std::size_t EncodeFrame(uint8_t command, const uint8_t *payload, std::size_t payload_length,
+                        uint8_t *out, std::size_t capacity) {
+  const std::size_t body = payload_length + 1;
+  if (body > kMaxFrameBody || capacity < body + kFrameOverhead) {
+    return 0;
+  }
+  out[0] = kFrameSync;
+  out[1] = static_cast<uint8_t>(body);
+  out[2] = static_cast<uint8_t>(~body);
+  out[3] = command;
+  if (payload_length != 0) {
+    std::memcpy(out + 4, payload, payload_length);
+  }
+  const uint16_t crc = Crc16(out + 1, body + 2);
+  out[3 + body] = static_cast<uint8_t>(crc & 0xff);
+  out[4 + body] = static_cast<uint8_t>(crc >> 8);
+  return body + kFrameOverhead;
+}
+
+uint8_t CommandView::u8(uint8_t offset) const {
+  return ring_[(start_ + offset) & (ProtocolParser::kRingSize - 1)];
+}
+
+uint16_t CommandView::u16(uint8_t offset) const {
+  return static_cast<uint16_t>(u8(offset) | (u8(static_cast<uint8_t>(offset + 1)) << 8));
+}
+
+void CommandView::copy(uint8_t offset, uint8_t *out, std::size_t length) const {
+  const std::size_t first = (start_ + offset) & (ProtocolParser::kRingSize - 1);
+  const std::size_t head_part = std::min(length, ProtocolParser::kRingSize - first);
+  std::memcpy(out, ring_ + first, head_part);
+  std::memcpy(out + head_part, ring_, length - head_part);
+}
+
+ProtocolParser::ProtocolParser() : ring_{}, head_(0), tail_(0), stats_{} {}
+
+uint8_t *ProtocolParser::writeBuffer(std::size_t &length) {
+  const std::size_t free_space = kRingSize - buffered();
+  const std::size_t to_end = kRingSize - (head_ & kMask);
+  length = std::min(free_space, to_end);
+  return ring_ + (head_ & kMask);
+}
+
+void ProtocolParser::commitWrite(std::size_t length) { head_ = static_cast<uint16_t>(head_ + length); }
+
+std::size_t ProtocolParser::feed(const uint8_t *data, std::size_t length) {
+  std::size_t taken = 0;
+  while (taken < length) {
+    std::size_t space = 0;
+    uint8_t *out = writeBuffer(space);
+    if (space == 0) {
+      break;
+    }
+    const std::size_t chunk = std::min(space, length - taken);
+    std::memcpy(out, data + taken, chunk);
+    commitWrite(chunk);
+    taken += chunk;
+  }
+  return taken;
+}
+
+bool ProtocolParser::next(CommandView &view) {
+  for (;;) {
+    const std::size_t available = buffered();
+    if (available == 0) {
+      return false;
+    }
+    if (at(0) != kFrameSync) {
+      drop();
+      continue;
+    }
+    if (available < 3) {
+      return false;
+    }
+    const uint8_t body = at(1);
+    if (body == 0 || body > kMaxFrameBody || at(2) != static_cast<uint8_t>(~body)) {
+      drop();
+      continue;
+    }
+    if (available < body + kFrameOverhead) {
+      return false;
+    }
+
+    // The CRC covers the length bytes and body, which may wrap around the
+    // ring end.
+    const uint16_t first = (tail_ + 1) & kMask;
+    const std::size_t span = body + 2u;
+    const std::size_t head_part = std::min<std::size_t>(span, kRingSize - first);
+    uint16_t crc = Crc16(ring_ + first, head_part);
+    crc = Crc16(ring_, span - head_part, crc);
+    const uint16_t received = static_cast<uint16_t>(at(3 + body) | (at(4 + body) << 8));
+    if (crc != received) {
+      stats_.crc_errors++;
+      drop();
+      continue;
+    }
+
+    view.ring_ = ring_;
+    view.command_ = at(3);
+    view.start_ = static_cast<uint16_t>((tail_ + 4) & kMask);
+    view.length_ = static_cast<uint8_t>(body - 1);
+    tail_ = static_cast<uint16_t>(tail_ + body + kFrameOverhead);
+    stats_.frames++;
+    return true;
+  }
+}
+
+void ProtocolParser::drop() {
+  tail_++;
+  stats_.dropped_bytes++;
+}
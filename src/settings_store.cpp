@@ -0,0 +1,140 @@
+#include "settings_store.h"
+
+#include <cstddef>
+
+#include "crc16.h"
+
+namespace {
+
+constexpr char kSettingsKey[] = "state";
+constexpr char kLegacyBrightnessKey[] = "brightness";
+constexpr char kLegacyGlowKey[] = "glow";
+constexpr uint8_t kSettingsVersion = 1;
+
+struct SettingsBlob {
+  uint8_t version;
+  uint8_t brightness;
+  uint8_t glow;
+  uint8_t reserved;
+  uint16_t crc;
+};
+
+// CRC over the blob up to, but excluding, the CRC field.
+uint16_t BlobCrc(const SettingsBlob &blob) {
+  return Crc16(reinterpret_cast<const uint8_t *>(&blob), offsetof(SettingsBlob, crc));
+}
+
+bool SameSettings(const LightingSettings &a, const LightingSettings &b) {
+  return a.brightness == b.brightness && a.glow == b.glow;
+}
+
+}  // namespace
+
+SettingsStore::SettingsStore(Preferences &preferences, uint32_t idle_window_ms)
+    : preferences_(preferences),
+      idle_window_ms_(idle_window_ms),
+      pending_{},
+      dirty_(false),
+      flush_requested_(false),
+      last_update_ms_(0),
+      stored_{},
+      stored_valid_(false),
+      legacy_keys_present_(false),
+      stats_{} {}
+
+bool SettingsStore::load(LightingSettings &settings) {
+  SettingsBlob blob{};
+  if (preferences_.getBytesLength(kSettingsKey) == sizeof(blob) &&
+      preferences_.getBytes(kSettingsKey, &blob, sizeof(blob)) == sizeof(blob)) {
+    if (blob.version == kSettingsVersion && blob.crc == BlobCrc(blob)) {
+      settings.brightness = blob.brightness;
+      settings.glow = blob.glow;
+      stored_ = settings;
+      stored_valid_ = true;
+      return true;
+    }
+    stats_.crc_failures++;
+  }
+  return loadLegacy(settings);
+}
+
+bool SettingsStore::loadLegacy(LightingSettings &settings) {
+  const bool has_brightness = preferences_.isKey(kLegacyBrightnessKey);
+  const bool has_glow = preferences_.isKey(kLegacyGlowKey);
+  if (!has_brightness && !has_glow) {
+    return false;
+  }
+  legacy_keys_present_ = true;
+  if (has_brightness) {
+    settings.brightness = static_cast<uint8_t>(preferences_.getInt(kLegacyBrightnessKey, 0));
+  }
+  if (has_glow) {
+    settings.glow = static_cast<uint8_t>(preferences_.getInt(kLegacyGlowKey, 0));
+  }
+  // Queue the migration to the blob layout for the first commit window.
+  pending_ = settings;
+  dirty_ = true;
+  return true;
+}
+
+void SettingsStore::update(const LightingSettings &settings, uint32_t now_ms) {
+  pending_ = settings;
+  dirty_ = true;
+  last_update_ms_ = now_ms;
+  stats_.updates++;
+}
+
+void SettingsStore::requestFlush() { flush_requested_ = true; }
+
+bool SettingsStore::takePending(uint32_t now_ms, LightingSettings &settings, uint32_t &wait_ms) {
+  if (!dirty_) {
+    flush_requested_ = false;
+    wait_ms = kNoDeadline;
+    return false;
+  }
+  const uint32_t idle = now_ms - last_update_ms_;
+  if (!flush_requested_ && idle < idle_window_ms_) {
+    wait_ms = idle_window_ms_ - idle;
+    return false;
+  }
+  settings = pending_;
+  dirty_ = false;
+  flush_requested_ = false;
+  wait_ms = kNoDeadline;
+  return true;
+}
+
+bool SettingsStore::commit(const LightingSettings &settings) {
+  if (stored_valid_ && SameSettings(stored_, settings)) {
+    stats_.skipped_commits++;
+    return true;
+  }
+  SettingsBlob blob{};
+  blob.version = kSettingsVersion;
+  blob.brightness = settings.brightness;
+  blob.glow = settings.glow;
+  blob.crc = BlobCrc(blob);
+  if (preferences_.putBytes(kSettingsKey, &blob, sizeof(blob)) != sizeof(blob)) {
+    stats_.failed_commits++;
+    return false;
+  }
+  stored_ = settings;
+  stored_valid_ = true;
+  stats_.commits++;
+
+  if (legacy_keys_present_) {
+    preferences_.remove(kLegacyBrightnessKey);
+    preferences_.remove(kLegacyGlowKey);
+    legacy_keys_present_ = false;
+  }
+  return true;
+}
+
+void SettingsStore::restore(const LightingSettings &settings, uint32_t now_ms) {
+  if (dirty_) {
+    return;
+  }
+  pending_ = settings;
+  dirty_ = true;
+  last_update_ms_ = now_ms;
+}
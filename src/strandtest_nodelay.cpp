@@ -2,97 +2,105 @@
 
 #include "strandtest_nodelay.h"
 
+#include "color_tables.h"
+
 namespace {
 constexpr int kDefaultPatternIntervalMs = 5000;
 constexpr int kDefaultColorPatternWaitMs = 50;
 constexpr uint8_t kDefaultRainbowWaitMs = 10;
 constexpr uint8_t kDefaultTheaterChaseRainbowWaitMs = 50;
 constexpr uint8_t kDefaultBrightness = 50;
-constexpr int kTheaterChaseLoopTarget = 10;
-constexpr int kTheaterChaseStride = 3;
-
-struct CycleEntry {
-  StrandPattern pattern;
-  uint8_t r;
-  uint8_t g;
-  uint8_t b;
-};
-
-constexpr CycleEntry kDefaultCycle[] = {
-    {StrandPattern::kColorWipe, 255, 0, 0},
-    {StrandPattern::kColorWipe, 0, 255, 0},
-    {StrandPattern::kColorWipe, 0, 0, 255},
-    {StrandPattern::kTheaterChase, 127, 127, 127},
-    {StrandPattern::kTheaterChase, 127, 0, 0},
-    {StrandPattern::kTheaterChase, 0, 0, 127},
-    {StrandPattern::kRainbow, 0, 0, 0},
-    {StrandPattern::kTheaterChaseRainbow, 0, 0, 0},
+constexpr uint8_t kFullLevel = 255;
+
+constexpr uint8_t EffectByte(EffectId id) { return static_cast<uint8_t>(id); }
+
+// The strandtest demo: each entry holds until its effect completes or the
+// pattern interval passes, then the show repeats.
+constexpr uint8_t kDefaultCycle[] = {
+    SEQUENCE_HEADER,
+    sequence_op::kSpeed, SEQUENCE_U16(kDefaultColorPatternWaitMs),
+    sequence_op::kColor, 255, 0, 0,
+    sequence_op::kEffect, EffectByte(EffectId::kColorWipe),
+    sequence_op::kWaitDone, SEQUENCE_U16(0),
+    sequence_op::kColor, 0, 255, 0,
+    sequence_op::kEffect, EffectByte(EffectId::kColorWipe),
+    sequence_op::kWaitDone, SEQUENCE_U16(0),
+    sequence_op::kColor, 0, 0, 255,
+    sequence_op::kEffect, EffectByte(EffectId::kColorWipe),
+    sequence_op::kWaitDone, SEQUENCE_U16(0),
+    sequence_op::kColor, 127, 127, 127,
+    sequence_op::kEffect, EffectByte(EffectId::kTheaterChase),
+    sequence_op::kWaitDone, SEQUENCE_U16(0),
+    sequence_op::kColor, 127, 0, 0,
+    sequence_op::kEffect, EffectByte(EffectId::kTheaterChase),
+    sequence_op::kWaitDone, SEQUENCE_U16(0),
+    sequence_op::kColor, 0, 0, 127,
+    sequence_op::kEffect, EffectByte(EffectId::kTheaterChase),
+    sequence_op::kWaitDone, SEQUENCE_U16(0),
+    sequence_op::kSpeed, SEQUENCE_U16(kDefaultRainbowWaitMs),
+    sequence_op::kEffect, EffectByte(EffectId::kRainbow),
+    sequence_op::kWaitDone, SEQUENCE_U16(0),
+    sequence_op::kSpeed, SEQUENCE_U16(kDefaultTheaterChaseRainbowWaitMs),
+    sequence_op::kEffect, EffectByte(EffectId::kTheaterChaseRainbow),
+    sequence_op::kWaitDone, SEQUENCE_U16(0),
+    sequence_op::kJump, SEQUENCE_U16(0),
 };
 
-constexpr std::size_t kDefaultCycleLength = sizeof(kDefaultCycle) / sizeof(kDefaultCycle[0]);
+constexpr EffectId EffectForPattern(StrandPattern pattern) {
+  switch (pattern) {
+    case StrandPattern::kTheaterChase:
+      return EffectId::kTheaterChase;
+    case StrandPattern::kRainbow:
+      return EffectId::kRainbow;
+    case StrandPattern::kTheaterChaseRainbow:
+      return EffectId::kTheaterChaseRainbow;
+    case StrandPattern::kColorWipe:
+    default:
+      return EffectId::kColorWipe;
+  }
+}
 }  // namespace
 
-StrandtestController::StrandtestController(Adafruit_NeoPixel &strip)
-    : strip_(strip),
-      pixel_previous_(0),
-      pattern_previous_(0),
+StrandtestController::StrandtestController(EffectEngine &engine)
+    : engine_(engine),
+      player_(engine),
       pattern_current_(StrandPattern::kColorWipe),
-      pattern_interval_(kDefaultPatternIntervalMs),
-      pattern_complete_(false),
       auto_cycle_(true),
-      pattern_index_(0),
-      force_refresh_(true),
-      primary_color_(strip.Color(255, 0, 0)),
+      primary_color_(color_tables::Pack(255, 0, 0)),
       color_wipe_wait_(kDefaultColorPatternWaitMs),
       theater_chase_wait_(kDefaultColorPatternWaitMs),
       rainbow_wait_(kDefaultRainbowWaitMs),
       theater_chase_rainbow_wait_(kDefaultTheaterChaseRainbowWaitMs),
-      pixel_interval_(kDefaultColorPatternWaitMs),
-      pixel_queue_(0),
-      pixel_cycle_(0),
-      pixel_number_(strip.numPixels()),
-      color_wipe_position_(0),
-      theater_chase_offset_(0),
-      theater_chase_loops_(0) {}
+      gamma_correction_(false) {
+  player_.load(kDefaultCycle, sizeof(kDefaultCycle));
+  player_.setDefaultHoldMs(kDefaultPatternIntervalMs);
+}
 
 void StrandtestController::begin() {
-  strip_.begin();
-  strip_.show();
-  strip_.setBrightness(kDefaultBrightness);
+  engine_.output().begin();
+  engine_.output().setBrightness(kDefaultBrightness);
 
-  const unsigned long now = millis();
   if (auto_cycle_) {
-    applyDefaultCycleEntry(pattern_index_, now);
+    startSequence();
   } else {
-    applyPattern(pattern_current_, now);
+    applyPattern(pattern_current_);
   }
 }
 
 void StrandtestController::update() {
-  const unsigned long current_millis = millis();
-  handleAutoCycle(current_millis);
-
-  if (force_refresh_ ||
-      (current_millis - pixel_previous_) >= static_cast<unsigned long>(pixel_interval_)) {
-    pixel_previous_ = current_millis;
-    force_refresh_ = false;
+  handleAutoCycle(millis());
+  engine_.render();
+}
 
-    switch (pattern_current_) {
-      case StrandPattern::kTheaterChaseRainbow:
-        theaterChaseRainbow(theater_chase_rainbow_wait_);
-        break;
-      case StrandPattern::kRainbow:
-        rainbow(rainbow_wait_);
-        break;
-      case StrandPattern::kTheaterChase:
-        theaterChase(primary_color_, theater_chase_wait_);
-        break;
-      case StrandPattern::kColorWipe:
-      default:
-        colorWipe(primary_color_, color_wipe_wait_);
-        break;
+unsigned long StrandtestController::nextFrameDelayMs() const {
+  uint32_t delay_ms = engine_.nextFrameDelayMs();
+  if (auto_cycle_) {
+    const uint32_t sequence_delay = player_.nextDelayMs(millis());
+    if (sequence_delay < delay_ms) {
+      delay_ms = sequence_delay;
     }
   }
+  return delay_ms;
 }
 
 void StrandtestController::setAutoCycle(bool enabled) {
@@ -100,19 +108,26 @@ void StrandtestController::setAutoCycle(bool enabled) {
     return;
   }
   auto_cycle_ = enabled;
-  const unsigned long now = millis();
-  pattern_previous_ = now;
   if (auto_cycle_) {
-    pattern_index_ = 0;
-    applyDefaultCycleEntry(pattern_index_, now);
+    startSequence();
   } else {
-    applyPattern(pattern_current_, now);
+    player_.stop();
+    applyPattern(pattern_current_);
+  }
+}
+
+bool StrandtestController::setSequence(const uint8_t *sequence, std::size_t length) {
+  if (!player_.load(sequence, length)) {
+    return false;
+  }
+  if (auto_cycle_) {
+    startSequence();
   }
+  return true;
 }
 
 void StrandtestController::setPattern(StrandPattern pattern) {
-  const unsigned long now = millis();
-  applyPattern(pattern, now);
+  applyPattern(pattern);
 }
 
 void StrandtestController::setPattern(StrandPattern pattern, uint32_t color) {
@@ -129,8 +144,10 @@ void StrandtestController::setPatternInterval(int interval_ms) {
   if (interval_ms < 0) {
     interval_ms = 0;
   }
-  pattern_interval_ = interval_ms;
-  pattern_previous_ = millis();
+  if (interval_ms > UINT16_MAX) {
+    interval_ms = UINT16_MAX;
+  }
+  player_.setDefaultHoldMs(static_cast<uint16_t>(interval_ms));
 }
 
 void StrandtestController::setColorWipeWait(int wait_ms) {
@@ -168,130 +185,70 @@ void StrandtestController::setTheaterChaseRainbowWait(uint8_t wait_ms) {
 }
 
 void StrandtestController::setBrightness(uint8_t brightness) {
-  strip_.setBrightness(brightness);
-  strip_.show();
+  engine_.output().setBrightness(brightness);
+  engine_.output().commit();
 }
 
-void StrandtestController::colorWipe(uint32_t color, int wait) {
-  pixel_interval_ = wait;
-  strip_.setPixelColor(color_wipe_position_++, color);
-  strip_.show();
-  if (color_wipe_position_ >= pixel_number_) {
-    color_wipe_position_ = 0;
-    pattern_complete_ = true;
-  }
-}
-
-void StrandtestController::theaterChase(uint32_t color, int wait) {
-  pixel_interval_ = wait;
-
-  strip_.clear();
-  for (int c = theater_chase_offset_; c < pixel_number_; c += kTheaterChaseStride) {
-    strip_.setPixelColor(c, color);
-  }
-  strip_.show();
-
-  theater_chase_offset_++;
-  if (theater_chase_offset_ >= kTheaterChaseStride) {
-    theater_chase_offset_ = 0;
-    theater_chase_loops_++;
-  }
-
-  if (theater_chase_loops_ >= kTheaterChaseLoopTarget) {
-    theater_chase_offset_ = 0;
-    theater_chase_loops_ = 0;
-    pattern_complete_ = true;
+void StrandtestController::setGammaCorrection(bool enabled) {
+  gamma_correction_ = enabled;
+  if (!auto_cycle_) {
+    engine_.setParams(patternParams(pattern_current_));
   }
 }
 
-uint32_t StrandtestController::wheel(uint8_t wheel_pos) {
-  wheel_pos = 255 - wheel_pos;
-  if (wheel_pos < 85) {
-    return strip_.Color(255 - wheel_pos * 3, 0, wheel_pos * 3);
-  }
-  if (wheel_pos < 170) {
-    wheel_pos -= 85;
-    return strip_.Color(0, wheel_pos * 3, 255 - wheel_pos * 3);
-  }
-  wheel_pos -= 170;
-  return strip_.Color(wheel_pos * 3, 255 - wheel_pos * 3, 0);
+void StrandtestController::setFrameInterval(uint16_t interval_ms) {
+  engine_.setFrameInterval(interval_ms);
 }
 
-void StrandtestController::rainbow(uint8_t wait) {
-  if (pixel_interval_ != wait) {
-    pixel_interval_ = wait;
-  }
-  for (uint16_t i = 0; i < pixel_number_; i++) {
-    strip_.setPixelColor(i, wheel((i + pixel_cycle_) & 255));
-  }
-  strip_.show();
-  pixel_cycle_++;
-  if (pixel_cycle_ >= 256) {
-    pixel_cycle_ = 0;
-  }
-}
-
-void StrandtestController::theaterChaseRainbow(uint8_t wait) {
-  if (pixel_interval_ != wait) {
-    pixel_interval_ = wait;
-  }
-  for (int i = 0; i < pixel_number_; i += kTheaterChaseStride) {
-    const int index = i + pixel_queue_;
-    if (index < pixel_number_) {
-      strip_.setPixelColor(index, wheel((i + pixel_cycle_) % 255));
-    }
-  }
-  strip_.show();
-  for (int i = 0; i < pixel_number_; i += kTheaterChaseStride) {
-    const int index = i + pixel_queue_;
-    if (index < pixel_number_) {
-      strip_.setPixelColor(index, strip_.Color(0, 0, 0));
-    }
-  }
-  pixel_queue_++;
-  pixel_cycle_++;
-  if (pixel_queue_ >= kTheaterChaseStride) {
-    pixel_queue_ = 0;
-  }
-  if (pixel_cycle_ >= 256) {
-    pixel_cycle_ = 0;
+EffectParams StrandtestController::patternParams(StrandPattern pattern) const {
+  int wait;
+  switch (pattern) {
+    case StrandPattern::kTheaterChaseRainbow:
+      wait = theater_chase_rainbow_wait_;
+      break;
+    case StrandPattern::kRainbow:
+      wait = rainbow_wait_;
+      break;
+    case StrandPattern::kTheaterChase:
+      wait = theater_chase_wait_;
+      break;
+    case StrandPattern::kColorWipe:
+    default:
+      wait = color_wipe_wait_;
+      break;
   }
+  EffectParams params{};
+  params.color = primary_color_;
+  params.level = kFullLevel;
+  // A zero wait means "as fast as possible": one step per millisecond.
+  params.step_ms = static_cast<uint16_t>(wait > 0 ? wait : 1);
+  params.flags = gamma_correction_ ? kEffectFlagGamma : 0;
+  return params;
 }
 
 void StrandtestController::resetPatternState() {
-  pattern_complete_ = false;
-  force_refresh_ = true;
-  pixel_queue_ = 0;
-  pixel_cycle_ = 0;
-  color_wipe_position_ = 0;
-  theater_chase_offset_ = 0;
-  theater_chase_loops_ = 0;
+  // While a sequence is playing it owns the engine; the new settings apply
+  // when the controller goes back to a fixed pattern.
+  if (auto_cycle_) {
+    return;
+  }
+  engine_.start(EffectForPattern(pattern_current_), patternParams(pattern_current_));
 }
 
 void StrandtestController::handleAutoCycle(unsigned long current_millis) {
   if (!auto_cycle_) {
     return;
   }
-  if (pattern_complete_ ||
-      (current_millis - pattern_previous_) >= static_cast<unsigned long>(pattern_interval_)) {
-    pattern_index_ = (pattern_index_ + 1) % kDefaultCycleLength;
-    applyDefaultCycleEntry(pattern_index_, current_millis);
-  }
+  player_.update(current_millis);
 }
 
-void StrandtestController::applyPattern(StrandPattern pattern, unsigned long current_millis) {
-  pattern_current_ = pattern;
-  pattern_previous_ = current_millis;
-  resetPatternState();
+void StrandtestController::startSequence() {
+  const unsigned long now = millis();
+  player_.start(now);
+  player_.update(now);
 }
 
-void StrandtestController::applyDefaultCycleEntry(std::size_t index, unsigned long current_millis) {
-  if (index >= kDefaultCycleLength) {
-    index = 0;
-  }
-  const auto &entry = kDefaultCycle[index];
-  if (entry.pattern == StrandPattern::kColorWipe || entry.pattern == StrandPattern::kTheaterChase) {
-    primary_color_ = strip_.Color(entry.r, entry.g, entry.b);
-  }
-  applyPattern(entry.pattern, current_millis);
+void StrandtestController::applyPattern(StrandPattern pattern) {
+  pattern_current_ = pattern;
+  engine_.start(EffectForPattern(pattern_current_), patternParams(pattern_current_));
 }
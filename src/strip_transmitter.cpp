@@ -0,0 +1,17 @@
+#include "strip_transmitter.h"
+
+#include <algorithm>
+#include <cstring>
+
+void NeoPixelTransmitter::begin() { strip_.begin(); }
+
+void NeoPixelTransmitter::transmit(const uint8_t *data, std::size_t length) {
+  const std::size_t capacity = static_cast<std::size_t>(strip_.numPixels()) * 3;
+  std::memcpy(strip_.getPixels(), data, std::min(length, capacity));
+  strip_.show();
+}
+
+void NeoPixelTransmitter::wait() {
+  while (!strip_.canShow()) {
+  }
+}
@@ -0,0 +1,127 @@
+// Render-path regression tests for the native build, on the simulated
+// clock: every golden scenario (bench/golden.h) must put the frames in
+// bench/golden/<scenario>.gld on the wire, byte for byte, and commit no more
+// often than recorded; and the main key must drive TaskRGB's brightness and
+// glow mode. Run from the project root:
+//   pio test -e native
+// After an intended change to the output, rewrite the files with
+//   .pio/build/native/program 1 golden --record
+
+#include <unity.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include "effect.h"
+#include "golden.h"
+#include "host_sim.h"
+#include "sim_buttons.h"
+
+namespace {
+
+constexpr uint64_t kUsPerMs = 1000;
+constexpr uint64_t kClickUs = golden::kClickMs * kUsPerMs;
+constexpr uint64_t kLongPressUs = golden::kLongPressMs * kUsPerMs;
+constexpr uint64_t kSettleUs = golden::kSettleMs * kUsPerMs;
+// Between the start of one press and the next; longer than a long press,
+// and than the main key's click gap.
+constexpr uint64_t kPressPeriodUs = 1500 * kUsPerMs;
+// GlowMode::kSolid.
+constexpr int kSolidGlow = 0;
+
+// Where each long press from kSolid lands: the kGlowModes order in main.cpp,
+// back round to kSolid.
+constexpr EffectId kGlowCycle[] = {
+    EffectId::kBreathing, EffectId::kRainbow, EffectId::kTheaterChase,
+    EffectId::kTheaterChaseRainbow, EffectId::kPulse, EffectId::kHeartbeat,
+    EffectId::kSparkle, EffectId::kRadialWave, EffectId::kSweep,
+    EffectId::kNoise, EffectId::kSolid,
+};
+constexpr std::size_t kGlowCycleLength = sizeof(kGlowCycle) / sizeof(kGlowCycle[0]);
+
+const golden::Scenario *current_scenario = nullptr;
+
+// Presses the main key |count| times from the next period on, holding it
+// for |held_us|, and keeps what TaskRGB applied after each release.
+void PressMain(std::size_t count, uint64_t held_us, golden::AppliedState *applied) {
+  const uint64_t origin = host_sim::NowUs();
+  for (std::size_t i = 0; i < count; ++i) {
+    const uint64_t down = origin + (i + 1) * kPressPeriodUs;
+    sim_buttons::SchedulePress(sim_buttons::kMainPin, down, held_us);
+    host_sim::Schedule(down + held_us + kSettleUs,
+                       [applied, i] { applied[i] = golden::Applied(); });
+  }
+  host_sim::RunTask("TaskRGB", (count + 1) * kPressPeriodUs);
+  sim_buttons::Reset();
+}
+
+}  // namespace
+
+void setUp() {}
+
+void tearDown() {}
+
+void test_scenario_matches_golden() {
+  const golden::Scenario &scenario = *current_scenario;
+  golden::Recording recording;
+  scenario.fn(scenario.variant, recording);
+  TEST_ASSERT_EQUAL_UINT32_MESSAGE(0, golden::ButtonMismatches(),
+                                   "a press was applied differently from the script");
+
+  golden::Recording expected;
+  const std::string path = golden::GoldenPath(scenario.name);
+  char message[160];
+  std::snprintf(message, sizeof(message), "cannot read %s (record it with golden --record)",
+                path.c_str());
+  TEST_ASSERT_TRUE_MESSAGE(golden::ReadGolden(path, expected), message);
+  if (golden::Describe(expected, recording, message, sizeof(message))) {
+    TEST_FAIL_MESSAGE(message);
+  }
+  // Frames rendered and committed without changing the wire are work the
+  // recording did not need.
+  TEST_ASSERT_LESS_OR_EQUAL_UINT32_MESSAGE(expected.commits, recording.commits,
+                                           "more commits than recorded");
+}
+
+// A click toggles BrightnessMode: bright to dim and back, in the same mode.
+void test_click_toggles_brightness() {
+  golden::Boot(kSolidGlow);
+  golden::AppliedState applied[2];
+  PressMain(2, kClickUs, applied);
+  TEST_ASSERT_TRUE_MESSAGE(applied[0].dim, "first click left it bright");
+  TEST_ASSERT_FALSE_MESSAGE(applied[1].dim, "second click left it dim");
+  for (const golden::AppliedState &state : applied) {
+    TEST_ASSERT_EQUAL_UINT8(static_cast<uint8_t>(EffectId::kSolid),
+                            static_cast<uint8_t>(state.effect));
+  }
+}
+
+// A long press advances glow_mode_index through every local mode and wraps,
+// leaving the brightness alone.
+void test_long_press_advances_glow_mode() {
+  golden::Boot(kSolidGlow);
+  golden::AppliedState applied[kGlowCycleLength];
+  PressMain(kGlowCycleLength, kLongPressUs, applied);
+  for (std::size_t i = 0; i < kGlowCycleLength; ++i) {
+    char message[64];
+    std::snprintf(message, sizeof(message), "long press %zu", i + 1);
+    TEST_ASSERT_EQUAL_UINT8_MESSAGE(static_cast<uint8_t>(kGlowCycle[i]),
+                                    static_cast<uint8_t>(applied[i].effect), message);
+    TEST_ASSERT_FALSE_MESSAGE(applied[i].dim, message);
+  }
+}
+
+int main(int argc, char **argv) {
+  UNITY_BEGIN();
+  const std::vector<golden::Scenario> scenarios = golden::Scenarios();
+  for (const golden::Scenario &scenario : scenarios) {
+    current_scenario = &scenario;
+    UnityDefaultTestRun(test_scenario_matches_golden, scenario.name.c_str(), __LINE__);
+  }
+  RUN_TEST(test_click_toggles_brightness);
+  RUN_TEST(test_long_press_advances_glow_mode);
+  return UNITY_END();
+}